@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <sparkle/sprout/region.hpp>
+
+namespace sprk
+{
+	class SproutGraph;
+
+	/*
+	 * dominator tree over the regions' imm_dom links. a DFS stamps every
+	 * region with entry/exit numbers, so `a dominates b` is two integer
+	 * compares. common dominators are LCA queries answered by binary lifting
+	 * in O(log depth). regions whose imm_dom is NULL_REGION root their own
+	 * tree; regions in different trees have no common dominator
+	 */
+	class DominatorTree
+	{
+	public:
+		void build(const SproutGraph &graph);
+
+		/* true if `a` is `b` or an ancestor of `b` in the dominator tree */
+		[[nodiscard]] bool dominates(const RegionRef a, const RegionRef b) const
+		{
+			if (a >= pre.size() || b >= pre.size() || pre[a] == UNVISITED || pre[b] == UNVISITED)
+				return false;
+
+			return pre[a] <= pre[b] && post[b] <= post[a];
+		}
+
+		/* nearest common dominator of `a` and `b`; NULL_REGION if they share none */
+		[[nodiscard]] RegionRef lca(RegionRef a, RegionRef b) const;
+
+		[[nodiscard]] uint32_t depth(const RegionRef region) const
+		{
+			return depths[region];
+		}
+
+		[[nodiscard]] RegionRef size() const
+		{
+			return static_cast<RegionRef>(pre.size());
+		}
+
+	private:
+		static constexpr uint32_t UNVISITED = UINT32_MAX;
+
+		std::vector<uint32_t> pre;
+		std::vector<uint32_t> post;
+		std::vector<uint32_t> depths;
+		std::vector<RegionRef> up; /* up[k * size + r] is r's 2^k-th dominator */
+		uint32_t levels = 0;
+
+		[[nodiscard]] RegionRef ancestor(const uint32_t k, const RegionRef region) const
+		{
+			return up[k * pre.size() + region];
+		}
+	};
+}
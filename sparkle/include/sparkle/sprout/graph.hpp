@@ -0,0 +1,379 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <sparkle/sprout/domtree.hpp>
+#include <sparkle/sprout/node.hpp>
+#include <sparkle/sprout/region.hpp>
+#include <sparkle/sprout/strings.hpp>
+
+namespace sprk
+{
+	/*
+	 * read-only view over a node's inputs or users; edge pools relocate
+	 * when a list grows, so a span is only valid until the next edge edit
+	 */
+	struct NodeSpan
+	{
+		const NodeRef *first = nullptr;
+		uint32_t count = 0;
+
+		[[nodiscard]] const NodeRef *begin() const
+		{
+			return first;
+		}
+
+		[[nodiscard]] const NodeRef *end() const
+		{
+			return first + count;
+		}
+
+		[[nodiscard]] uint32_t size() const
+		{
+			return count;
+		}
+
+		[[nodiscard]] bool empty() const
+		{
+			return count == 0;
+		}
+
+		NodeRef operator[](const uint32_t i) const
+		{
+			return first[i];
+		}
+	};
+
+	/* old -> new refs produced by SproutGraph::compact; dropped slots map to NULL_REF / NULL_REGION */
+	struct GraphRemap
+	{
+		std::vector<NodeRef> nodes;
+		std::vector<RegionRef> regions;
+
+		[[nodiscard]] NodeRef node(const NodeRef ref) const
+		{
+			return ref < nodes.size() ? nodes[ref] : NULL_REF;
+		}
+
+		[[nodiscard]] RegionRef region(const RegionRef ref) const
+		{
+			return ref < regions.size() ? regions[ref] : NULL_REGION;
+		}
+	};
+
+	/*
+	 * node table in structure-of-arrays form; each field lives in its own
+	 * column indexed by NodeRef so a pass only pulls the columns it reads into
+	 * cache. type, edges, flags and fn_ref are the hot columns; values, names
+	 * and result types sit in side columns that traversals never touch.
+	 *
+	 * inputs and users have no fixed bound. each node owns a power-of-two
+	 * block in a shared pool per direction; a full block moves to one twice
+	 * its size and the old block is recycled for the next list of that size
+	 */
+	class SproutGraph
+	{
+	public:
+		SproutGraph() = default;
+		SproutGraph(const SproutGraph &) = delete;
+		SproutGraph &operator=(const SproutGraph &) = delete;
+
+		SproutGraph(SproutGraph &&) = default;
+		SproutGraph &operator=(SproutGraph &&) = default;
+
+		/* appends a node of the given type */
+		NodeRef create(NodeType type);
+
+		/* detaches and releases the node; the slot stays behind as a tombstone */
+		void remove(NodeRef ref);
+
+		void reserve(size_t count);
+
+		/*
+		 * drops every tombstoned node and removed region and renumbers the
+		 * rest in order, so [0, size()) is dense again. every ref stored in
+		 * the graph is rewritten; refs held elsewhere go through the remap
+		 */
+		GraphRemap compact();
+
+		[[nodiscard]] bool contains(const NodeRef ref) const
+		{
+			return ref < types.size() && !(flag_col[ref] & NODE_REMOVED);
+		}
+
+		/* number of slots including tombstones; valid refs are [0, size()) */
+		[[nodiscard]] NodeRef size() const
+		{
+			return static_cast<NodeRef>(types.size());
+		}
+
+		[[nodiscard]] NodeRef live_size() const
+		{
+			return size() - removed;
+		}
+
+		/* hot columns */
+		[[nodiscard]] NodeType type(const NodeRef ref) const
+		{
+			return types[ref];
+		}
+
+		[[nodiscard]] NodeSpan inputs(const NodeRef ref) const
+		{
+			return { input_pool.data() + input_lists[ref].offset, input_lists[ref].count };
+		}
+
+		[[nodiscard]] NodeSpan users(const NodeRef ref) const
+		{
+			return { user_pool.data() + user_lists[ref].offset, user_lists[ref].count };
+		}
+
+		[[nodiscard]] uint32_t flags(const NodeRef ref) const
+		{
+			return flag_col[ref];
+		}
+
+		[[nodiscard]] NodeRef fn_ref(const NodeRef ref) const
+		{
+			return fn_refs[ref];
+		}
+
+		[[nodiscard]] NodeRef mem_obj(const NodeRef ref) const
+		{
+			return mem_objs[ref];
+		}
+
+		/* side columns */
+		[[nodiscard]] const NodeValue &value(const NodeRef ref) const
+		{
+			return values[ref];
+		}
+
+		[[nodiscard]] StringId string_id(const NodeRef ref) const
+		{
+			return string_ids[ref];
+		}
+
+		/* the node's name; empty when it has none */
+		[[nodiscard]] std::string_view name(const NodeRef ref) const
+		{
+			return string_table.view(string_ids[ref]);
+		}
+
+		[[nodiscard]] StringTable &strings()
+		{
+			return string_table;
+		}
+
+		[[nodiscard]] const StringTable &strings() const
+		{
+			return string_table;
+		}
+
+		[[nodiscard]] uint32_t result(const NodeRef ref) const
+		{
+			return results[ref];
+		}
+
+		void set_type(const NodeRef ref, const NodeType type)
+		{
+			types[ref] = type;
+		}
+
+		/* NODE_REMOVED and NODE_PINNED belong to the graph and are kept as they are */
+		void set_flags(const NodeRef ref, const uint32_t flags)
+		{
+			constexpr uint32_t owned = NODE_REMOVED | NODE_PINNED;
+			flag_col[ref] = (flags & ~owned) | (flag_col[ref] & owned);
+		}
+
+		void set_fn_ref(const NodeRef ref, const NodeRef fn)
+		{
+			fn_refs[ref] = fn;
+		}
+
+		void set_mem_obj(const NodeRef ref, const NodeRef obj)
+		{
+			mem_objs[ref] = obj;
+			pin(obj);
+		}
+
+		void set_value(const NodeRef ref, NodeValue value)
+		{
+			if (const auto *target = std::get_if<NodeRef>(&value))
+				pin(*target);
+			values[ref] = std::move(value);
+		}
+
+		void set_string_id(const NodeRef ref, const StringId id)
+		{
+			string_ids[ref] = id;
+		}
+
+		void set_name(const NodeRef ref, const std::string_view name)
+		{
+			string_ids[ref] = string_table.intern(name);
+		}
+
+		void set_result(const NodeRef ref, const uint32_t result)
+		{
+			results[ref] = result;
+		}
+
+		/* edges; every input slot has a matching entry in the input's user list */
+
+		/* appends `input` to the node's inputs and records the node as its user */
+		void add_input(NodeRef ref, NodeRef input);
+
+		/* rewrites input slot `index` and moves the user entry along with it */
+		void set_input(NodeRef ref, uint32_t index, NodeRef input);
+
+		/* drops one user entry; the user's input slot is left untouched */
+		void remove_user(NodeRef ref, NodeRef user);
+
+		/* redirects every use of `from` to `to` in O(uses) */
+		void replace_all_uses(NodeRef from, NodeRef to);
+
+		/* region table; see region.cpp */
+
+		RegionRef create_region(std::string name, RegionType type = RegionType::ROOT, uint32_t type_id = 0);
+
+		[[nodiscard]] const SproutRegion &region(const RegionRef ref) const
+		{
+			return regions[ref];
+		}
+
+		/* number of region slots including removed ones */
+		[[nodiscard]] RegionRef region_count() const
+		{
+			return static_cast<RegionRef>(regions.size());
+		}
+
+		[[nodiscard]] bool contains_region(const RegionRef ref) const
+		{
+			return ref < regions.size() && !regions[ref].removed;
+		}
+
+		/* owning region of a node in O(1); NULL_REGION when unplaced or removed */
+		[[nodiscard]] RegionRef region_of(const NodeRef ref) const
+		{
+			return node_regions[ref];
+		}
+
+		/* a node belongs to one region; adding it elsewhere moves the index entry */
+		void add_node(RegionRef region, NodeRef node);
+
+		void replace_nodes(RegionRef region, std::vector<NodeRef> nodes);
+
+		/* links `child` under `parent`; the child's depth follows the parent's */
+		void add_child(RegionRef parent, RegionRef child);
+
+		/* same, at position `index` among the children; sibling order is control order */
+		void insert_child(RegionRef parent, RegionRef child, size_t index);
+
+		/* unlinks `child`; its slot stays in the table, detached */
+		void remove_child(RegionRef parent, RegionRef child);
+
+		/*
+		 * unlinks the region from its parent and the dominator tree; regions
+		 * it dominated move up to its dominator. its nodes and children are
+		 * left unowned, so callers remove it once it is empty
+		 */
+		void remove_region(RegionRef region);
+
+		void set_ctrl_deps(RegionRef region, NodeRef control);
+
+		void set_imm_dominator(RegionRef region, RegionRef dom);
+
+		void set_region_type(RegionRef region, RegionType type, uint32_t type_id = 0);
+
+		/*
+		 * dominance queries go through a DominatorTree that is rebuilt on first
+		 * use after create_region or set_imm_dominator; each query is then O(1)
+		 * for dominates and O(log depth) for the common dominator. the rebuild
+		 * writes cached state, so concurrent readers need a prior warm-up call
+		 */
+		[[nodiscard]] const DominatorTree &dominator_tree() const;
+
+		/* true if `a` is `b` or sits on b's immediate-dominator chain */
+		[[nodiscard]] bool dominates(RegionRef a, RegionRef b) const
+		{
+			return dominator_tree().dominates(a, b);
+		}
+
+		/* nearest region on a's dominator chain that dominates `b`; NULL_REGION if none */
+		[[nodiscard]] RegionRef find_common_dominator(const RegionRef a, const RegionRef b) const
+		{
+			return dominator_tree().lca(a, b);
+		}
+
+	private:
+		/* a node's slice of an edge pool */
+		struct EdgeList
+		{
+			uint32_t offset = 0;
+			uint32_t count = 0;
+			uint32_t capacity = 0;
+		};
+
+		/* shared storage for one edge direction */
+		struct EdgePool
+		{
+			std::vector<NodeRef> slots;
+			std::vector<std::vector<uint32_t> > free_blocks; /* offsets by log2(capacity) */
+
+			void push(EdgeList &list, NodeRef value);
+
+			void release(EdgeList &list);
+
+			/* fills an empty list with a right-sized block at the end of the pool */
+			void assign(EdgeList &list, const NodeRef *first, uint32_t count);
+
+			NodeRef *data()
+			{
+				return slots.data();
+			}
+
+			const NodeRef *data() const
+			{
+				return slots.data();
+			}
+		};
+
+		/* hot */
+		std::vector<NodeType> types;
+		std::vector<EdgeList> input_lists;
+		std::vector<EdgeList> user_lists;
+		EdgePool input_pool;
+		EdgePool user_pool;
+		std::vector<uint32_t> flag_col;
+		std::vector<NodeRef> fn_refs;
+		std::vector<NodeRef> mem_objs;
+
+		/* cold */
+		std::vector<NodeValue> values;
+		std::vector<StringId> string_ids;
+		std::vector<uint32_t> results;
+		std::vector<RegionRef> node_regions; /* reverse of SproutRegion::nodes */
+
+		StringTable string_table;
+		std::vector<SproutRegion> regions;
+		mutable DominatorTree dom_tree;
+		mutable bool dom_stale = true;
+
+		NodeRef removed = 0;
+
+		void add_user(NodeRef ref, NodeRef user);
+
+		/*
+		 * mem_obj, NodeRef values and region ctrl_deps point at a node without
+		 * a user entry. the target is flagged so a use-list check alone never
+		 * takes it for dead; the flag is sticky and errs on the safe side
+		 */
+		void pin(const NodeRef ref)
+		{
+			if (ref < flag_col.size())
+				flag_col[ref] |= NODE_PINNED;
+		}
+	};
+}
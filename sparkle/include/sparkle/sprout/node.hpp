@@ -1,16 +1,21 @@
 #pragma once
 
-#include <cstddef>
 #include <cstdint>
-#include <type_traits>
 #include <variant>
-#include <string>
 
 namespace sprk 
 {
     using NodeRef = uint32_t;
     inline constexpr NodeRef NULL_REF = UINT32_MAX;
 
+    /* id into the module string table; see strings.hpp */
+    enum class StringId : uint32_t {};
+    inline constexpr StringId NULL_STRING = StringId {};
+
+    /* node flag bits */
+    inline constexpr uint32_t NODE_REMOVED = 1u << 0; /* slot released by a pass */
+    inline constexpr uint32_t NODE_PINNED = 1u << 1;  /* referenced outside the edge lists; see SproutGraph */
+
     enum class NodeType : uint32_t
     {
         /* primitive nodes */
@@ -37,6 +42,7 @@ namespace sprk
 
         /* memory operations */
         MALLOC, /* allocate */
+        STACK_ALLOC, /* fixed slot in the function's frame; a MALLOC that never outlives it */
         FREE, /* free */
         LOAD, /* load */
         STORE, /* store */
@@ -49,37 +55,17 @@ namespace sprk
 
         /* casting */
         REINTERPRET_CAST,
-    };
-
-    template<size_t MAX_INPUTS = 4, size_t MAX_USERS = 4>
-    struct SproutNode
-    {
-        using NodeValue = std::variant<std::monostate, int64_t, double, void*, NodeRef, std::string>;
-
-        size_t expr_hash = {};
-        uint64_t string_id = {};
-        NodeValue value;
-
-        NodeRef inputs[MAX_INPUTS] = {};
-        NodeRef users[MAX_USERS] = {};
-        NodeRef id = {};
-        NodeRef fn_ref = {};
-        NodeRef mem_obj = {};
-        uint32_t result = {}; /* unique hash for result type */
-        uint32_t flags = {};
-        NodeType type = {};
-        uint8_t input_count = {};
-        uint8_t user_count = {};
-
-        SproutNode() = default;
-        SproutNode(const SproutNode&) = delete;
-        SproutNode& operator=(const SproutNode&) = delete;
 
-        SproutNode(SproutNode&&) = default;
-        SproutNode& operator=(SproutNode&&) = default;
+        /* vector operations on 32-bit lanes; the value holds the lane count, 0 for the VECTOR_SETVL grant */
+        VECTOR_LOAD, /* lanes from ptr */
+        VECTOR_STORE, /* lanes to ptr; inputs: ptr, vector */
+        VECTOR_ADD,
+        VECTOR_MUL,
+        VECTOR_SPLAT, /* scalar copied to every lane */
+        VECTOR_SETVL, /* lanes granted for a remaining element count; strip-mining */
     };
 
-    static_assert(std::is_standard_layout_v<SproutNode<>>, "SproutNode must have standard layout");
-    static_assert(std::is_move_constructible_v<SproutNode<>>, "SproutNode must be move constructible");
+    /* literal payload of CONST nodes and friends; string literals are interned */
+    using NodeValue = std::variant<std::monostate, int64_t, double, void*, NodeRef, StringId>;
 }
 
@@ -4,6 +4,7 @@
 #include <set>
 #include <vector>
 #include <sparkle/sprout/passes/pass.hpp>
+#include <sparkle/sprout/utils/bitset.hpp>
 
 namespace sprk
 {
@@ -15,6 +16,42 @@ namespace sprk
 		UNINITIALIZED_READ
 	};
 
+	enum class AliasMode : uint8_t
+	{
+		/*
+		 * unification: every pointer has one class of objects it may reach,
+		 * and an assignment merges the classes on both sides. near-linear
+		 * time, but anything that meets at a phi or a store ends up together
+		 */
+		STEENSGAARD,
+
+		/*
+		 * inclusion: points-to sets grow along copies, loads and stores to a
+		 * fixed point, as sparse bitvectors of locations. precise enough to
+		 * keep apart pointers that only share a use
+		 */
+		ANDERSEN
+	};
+
+	/* a field of an allocation: the object and the constant byte offset into it */
+	struct MemoryLocation
+	{
+		static constexpr int64_t ANY_OFFSET = INT64_MIN; /* not a constant offset; may be any field */
+
+		NodeRef object;
+		int64_t offset;
+
+		bool operator<(const MemoryLocation &other) const
+		{
+			return object != other.object ? object < other.object : offset < other.offset;
+		}
+
+		bool operator==(const MemoryLocation &other) const
+		{
+			return object == other.object && offset == other.offset;
+		}
+	};
+
 	struct PointsToInfo
 	{
 		NodeRef alloc_node;
@@ -34,49 +71,99 @@ namespace sprk
 		std::string to_string() const;
 	};
 
+	/*
+	 * whole-module points-to analysis. MALLOC, STACK_ALLOC and ADDR_OF
+	 * create objects; a PTR_ADD of a constant moves to another field of the
+	 * same object and any other offset reaches every field. loads and
+	 * stores carry pointers through memory, one content set per field. SSA
+	 * values keep each definition apart, so pointers are flow-sensitive;
+	 * memory contents are merged over the whole module.
+	 *
+	 * a pointer from outside the analysis (a PARAM, a call result, integer
+	 * arithmetic) may point anywhere, and an object that reaches a call or
+	 * unknown memory escapes: what is read from it is unknown too. such
+	 * pointers get an empty points-to set, which every query treats as
+	 * "may alias anything"
+	 */
 	class AliasAnalysisPass final : public SproutPass
 	{
 	public:
-		AliasAnalysisPass() = default;
+		explicit AliasAnalysisPass(const AliasMode mode = AliasMode::ANDERSEN) : mode(mode) {}
+
+		void run(RegionRef root, SproutGraph &graph) override;
 
-		void run(const std::shared_ptr<SproutRegion> &root,
-		         std::vector<std::unique_ptr<SproutNode<> > > &nodes) override;
+		/* analysis only; the graph is left untouched */
+		[[nodiscard]] AnalysisSet preserved_analyses() const override
+		{
+			return ALL_ANALYSES;
+		}
 
 		[[nodiscard]] const std::vector<MemoryIssue> &get_issues() const
 		{
 			return issues;
 		}
 
+		[[nodiscard]] AliasMode get_mode() const
+		{
+			return mode;
+		}
+
+		/* whether the pointers may reach the same object, at any offset */
 		[[nodiscard]] bool points_to_same_memory(NodeRef ptr1, NodeRef ptr2) const;
 
+		/*
+		 * whether accesses through the pointers may overlap: the same object
+		 * at the same constant offset, or at an offset that is not constant.
+		 * fields are told apart by offset alone, so this holds for accesses
+		 * of one field each; a wider access such as a VECTOR_LOAD needs
+		 * points_to_same_memory
+		 */
+		[[nodiscard]] bool may_alias(NodeRef ptr1, NodeRef ptr2) const;
+
+		/* objects the pointer may reach; empty if that is unknown */
 		[[nodiscard]] const std::set<NodeRef> &get_points_to_set(NodeRef ptr) const;
 
-		void dump_results(const std::vector<std::unique_ptr<SproutNode<> > > &nodes,
-		                  const std::shared_ptr<SproutRegion> &root,
+		/* fields the pointer may reach, ascending; empty if that is unknown */
+		[[nodiscard]] std::vector<MemoryLocation> get_locations(NodeRef ptr) const;
+
+		void dump_results(const SproutGraph &graph,
+		                  RegionRef root,
 		                  bool colorize = true) const;
 
 	private:
-		std::map<NodeRef, std::vector<NodeRef> > memory_operations; /* alloc node -> operations */
+		/* past this many constant offsets into one object, new ones fold into ANY_OFFSET */
+		static constexpr size_t MAX_FIELDS = 64;
+
+		AliasMode mode;
 		std::map<NodeRef, std::set<NodeRef> > points_to_map;        /* ptr -> set of memory objects */
 		std::vector<std::set<NodeRef> > alias_groups;               /* groups of pointers that may alias */
 		std::vector<MemoryIssue> issues;                            /* detected issues */
 
-		void detect_memory_issues(const std::vector<std::unique_ptr<SproutNode<> > > &nodes);
+		std::vector<MemoryLocation> locations;                      /* location ids index this */
+		std::map<MemoryLocation, uint32_t> location_ids;
+		std::map<NodeRef, std::vector<uint32_t> > object_fields;    /* object -> its location ids */
+		std::vector<SparseBitVector> value_locations;               /* per NodeRef */
+		BitVector unknown_values;                                   /* per NodeRef; may point anywhere */
 
-		void detect_use_after_free(NodeRef alloc_node, const std::vector<NodeRef> &ops,
-		                           const std::vector<std::unique_ptr<SproutNode<> > > &nodes);
+		/* the id of a field, made on first use; ANY_OFFSET once the object has too many */
+		uint32_t location_of(NodeRef object, int64_t offset);
 
-		void detect_double_free(NodeRef alloc_node, const std::vector<NodeRef> &ops,
-		                        const std::vector<std::unique_ptr<SproutNode<> > > &nodes);
+		/* the offset a PTR_ADD moves by; ANY_OFFSET unless it is a constant */
+		[[nodiscard]] static int64_t offset_of(NodeRef ptr_add, const SproutGraph &graph);
 
-		void detect_uninitialized_read(NodeRef alloc_node, const std::vector<NodeRef> &ops,
-		                               const std::vector<std::unique_ptr<SproutNode<> > > &nodes);
+		void solve_andersen(const SproutGraph &graph);
 
-		void detect_memory_leaks(const std::vector<std::unique_ptr<SproutNode<> > > &nodes);
+		void solve_steensgaard(const SproutGraph &graph);
 
-		/* topological sort */
-		std::vector<NodeRef> sort_memory_ops(NodeRef alloc_node,
-		                                     const std::vector<NodeRef> &operations,
-		                                     const std::vector<std::unique_ptr<SproutNode<> > > &nodes);
+		/*
+		 * one walk of the region tree in program order, tracking whether each
+		 * object may be uninitialised, initialised or freed. an operation
+		 * reaches its mem_obj, or else the objects its address points to; a
+		 * report needs a single such object, more only weaken its state.
+		 * branch arms start from the same state and meet after, loop bodies
+		 * and exception regions meet the state they were entered with. a
+		 * MALLOC that may still be live at the end is a leak
+		 */
+		void detect_memory_issues(RegionRef root, const SproutGraph &graph);
 	};
 }
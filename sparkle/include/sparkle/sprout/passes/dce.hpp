@@ -1,37 +1,106 @@
 #pragma once
 
-#include <set>
-#include <sparkle/sprout/passes/pass.hpp>
+#include <vector>
+#include <sparkle/sprout/passes/function.hpp>
+#include <sparkle/sprout/utils/bitset.hpp>
 
 namespace sprk
 {
-	class DCEPass final : public SproutPass
+	enum class DCEMode : uint8_t
+	{
+		/* liveness from RET/EXIT only; nothing is removed, see remove_dead_nodes */
+		MARK,
+
+		/*
+		 * STORE, PTR_STORE, VECTOR_STORE, FREE and CALL are roots too; a live
+		 * node keeps its fn_ref, mem_obj and the ctrl_dep of every enclosing
+		 * region. dead nodes are removed, emptied regions deleted and the
+		 * graph compacted
+		 */
+		AGGRESSIVE
+	};
+
+	/* marks from the roots of each function; see FunctionPass */
+	class DCEPass final : public FunctionPass
 	{
 	public:
-		DCEPass() = default;
+		explicit DCEPass(const DCEMode mode = DCEMode::MARK) : mode(mode) {}
 
-		void run(const std::shared_ptr<SproutRegion> &root,
-		         std::vector<std::unique_ptr<SproutNode<> > > &nodes) override;
+		[[nodiscard]] AnalysisSet preserved_analyses() const override
+		{
+			return mode == DCEMode::MARK ? ALL_ANALYSES : NO_ANALYSES;
+		}
 
-		[[nodiscard]] std::set<NodeRef> get_dead_nodes() const
+		void begin(const SproutGraph &graph, size_t unit_count) override;
+
+		void run_function(const FunctionUnit &unit,
+		                  const SproutGraph &graph,
+		                  WorkerScratch &scratch,
+		                  FunctionEdits &edits) override;
+
+		void finish(RegionRef root,
+		            SproutGraph &graph,
+		            const std::vector<FunctionEdits> &edits) override;
+
+		/* dead nodes in ascending order; valid until the next run. after an
+		 * aggressive run these are refs from before compaction */
+		[[nodiscard]] NodeSpan get_dead_nodes() const
 		{
-			return dead_nodes;
+			return { dead_nodes.data(), static_cast<uint32_t>(dead_nodes.size()) };
 		}
 
-		[[nodiscard]] std::set<NodeRef> get_alive_nodes() const
+		/* one bit per NodeRef that existed when the pass last ran */
+		[[nodiscard]] const BitVector &get_alive_nodes() const
 		{
 			return alive_nodes;
 		}
 
-		void remove_dead_nodes(std::shared_ptr<SproutRegion> &root, std::vector<std::unique_ptr<SproutNode<>>> &nodes);
+		/* false for nodes created after the last run */
+		[[nodiscard]] bool is_dead(const NodeRef ref) const
+		{
+			return ref < dead_bits.size() && dead_bits.test(ref);
+		}
 
-		void dump_results(const std::set<NodeRef> &dead_nodes,
-		                  const std::vector<std::unique_ptr<SproutNode<> > > &nodes,
-		                  const std::shared_ptr<SproutRegion> &root,
+		/* renumbering from the last aggressive run; empty after a MARK run */
+		[[nodiscard]] const GraphRemap &get_remap() const
+		{
+			return remap;
+		}
+
+		[[nodiscard]] uint32_t get_removed_regions() const
+		{
+			return removed_regions;
+		}
+
+		void remove_dead_nodes(RegionRef root, SproutGraph &graph);
+
+		/*
+		 * incremental cleanup after a rewrite. `dirty` are nodes whose uses
+		 * changed; one left without users that is not a root, a store, free
+		 * or call, pinned or a FUNCTION is removed, and its inputs are checked
+		 * in turn. cost follows the removed nodes and their regions, not the
+		 * module. dead cycles keep each other used and wait for a full run.
+		 * returns the removed refs in ascending order
+		 */
+		std::vector<NodeRef> remove_dead_from(const std::vector<NodeRef> &dirty, SproutGraph &graph);
+
+		void dump_results(NodeSpan dead_nodes,
+		                  const SproutGraph &graph,
+		                  RegionRef root,
 		                  bool colorize = true);
 
 	private:
-		std::set<NodeRef> dead_nodes;
-		std::set<NodeRef> alive_nodes;
+		DCEMode mode;
+		std::vector<NodeRef> dead_nodes;
+		BitVector alive_nodes;
+		BitVector dead_bits;
+		std::vector<std::vector<NodeRef> > reached; /* per unit; may include other functions' nodes */
+		GraphRemap remap;
+		uint32_t removed_regions = 0;
+
+		[[nodiscard]] bool is_root(NodeType type) const;
+
+		/* removes the dead nodes and empty regions, then compacts */
+		void sweep(RegionRef root, SproutGraph &graph);
 	};
 }
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <vector>
+#include <sparkle/sprout/passes/function.hpp>
+
+namespace sprk
+{
+	/* a MALLOC the pass looked at */
+	struct StackPromotion
+	{
+		NodeRef alloc;
+		NodeRef escape = NULL_REF; /* the use that keeps it on the heap; NULL_REF if promoted */
+		uint32_t frees = 0;        /* FREEs removed with it */
+	};
+
+	/*
+	 * escape analysis per function. a MALLOC of a fixed size (no inputs, or
+	 * CONSTs only) whose pointer is only
+	 *
+	 *	- the address of a LOAD, STORE, their PTR_ and VECTOR_ forms, or a FREE
+	 *	- moved by a PTR_ADD or a REINTERPRET_CAST, or compared by a CMP
+	 *	- merged by a PHI whose other inputs are pointers into it as well
+	 *
+	 * never reaches a call, memory, a RET or another function, so it does
+	 * not outlive the function. it becomes a STACK_ALLOC in place, keeping
+	 * its ref, and its FREEs are removed
+	 */
+	class StackPromotionPass final : public FunctionPass
+	{
+	public:
+		StackPromotionPass() = default;
+
+		void begin(const SproutGraph &graph, size_t unit_count) override;
+
+		void run_function(const FunctionUnit &unit,
+		                  const SproutGraph &graph,
+		                  WorkerScratch &scratch,
+		                  FunctionEdits &edits) override;
+
+		void finish(RegionRef root,
+		            SproutGraph &graph,
+		            const std::vector<FunctionEdits> &edits) override;
+
+		/* one entry per MALLOC inside a function, per function in region order */
+		[[nodiscard]] const std::vector<StackPromotion> &get_results() const
+		{
+			return results;
+		}
+
+		void dump_results(const SproutGraph &graph, bool colorize = true) const;
+
+	private:
+		std::vector<StackPromotion> results;
+		std::vector<std::vector<StackPromotion> > unit_results;
+	};
+}
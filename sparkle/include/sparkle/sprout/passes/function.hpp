@@ -0,0 +1,209 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <sparkle/sprout/passes/pass.hpp>
+#include <sparkle/sprout/utils/bitset.hpp>
+#include <sparkle/sprout/utils/threadpool.hpp>
+
+namespace sprk
+{
+	/* the slice of the module one function-level task works on */
+	struct FunctionUnit
+	{
+		size_t index = 0;                 /* position in region order; slot for per-function results */
+		RegionRef region = NULL_REGION;   /* FUNCTION region; NULL_REGION for nodes outside any function */
+		NodeSpan nodes;                   /* nodes of the function and its nested regions, ascending */
+	};
+
+	/* per-worker memory, reused from one function to the next */
+	struct WorkerScratch
+	{
+		BitVector marks;                /* one bit per NodeRef; all clear between functions */
+		std::vector<NodeRef> worklist;
+		std::vector<NodeRef> touched;   /* refs whose mark must be cleared afterwards */
+		BitVector region_marks;         /* one bit per RegionRef, same rules */
+		std::vector<RegionRef> touched_regions;
+
+		/* sets the mark and records it for reset; false if it was already set */
+		bool mark(const NodeRef ref)
+		{
+			if (!marks.insert(ref))
+				return false;
+
+			touched.push_back(ref);
+			return true;
+		}
+
+		bool mark_region(const RegionRef ref)
+		{
+			if (!region_marks.insert(ref))
+				return false;
+
+			touched_regions.push_back(ref);
+			return true;
+		}
+
+		void reset()
+		{
+			for (const NodeRef ref: touched)
+				marks.reset(ref);
+			for (const RegionRef ref: touched_regions)
+				region_marks.reset(ref);
+			touched.clear();
+			touched_regions.clear();
+			worklist.clear();
+		}
+	};
+
+	/*
+	 * graph edits a function records while other functions run alongside.
+	 * created nodes get a staged ref (STAGED bit set) that other staged
+	 * nodes and rewrites may use; the driver applies every function's edits
+	 * in region order once all of them are done, so the final NodeRefs do
+	 * not depend on the thread count or on scheduling
+	 */
+	class FunctionEdits
+	{
+	public:
+		static constexpr NodeRef STAGED = 1u << 31;
+		static constexpr RegionRef STAGED_REGION = 1u << 31;
+
+		[[nodiscard]] static bool is_staged(const NodeRef ref)
+		{
+			return ref != NULL_REF && (ref & STAGED);
+		}
+
+		[[nodiscard]] static bool is_staged_region(const RegionRef ref)
+		{
+			return ref != NULL_REGION && (ref & STAGED_REGION);
+		}
+
+		/* stages a node to be created and placed in `region`, which may be staged */
+		NodeRef create(NodeType type, NodeRef fn_ref, RegionRef region, std::string name = {});
+
+		/* appends an input to a staged node */
+		void add_input(NodeRef staged, NodeRef input);
+
+		void set_value(NodeRef staged, NodeValue value);
+
+		void set_result(NodeRef staged, uint32_t result);
+
+		/*
+		 * stages a region linked under `parent` right after `sibling`, sharing
+		 * the sibling's immediate dominator and running under `ctrl_dep`,
+		 * which may be staged
+		 */
+		RegionRef create_region(std::string name,
+		                        RegionType type,
+		                        RegionRef parent,
+		                        RegionRef sibling,
+		                        NodeRef ctrl_dep);
+
+		/* moves an existing node to the end of `region`, which may be staged; it keeps its ref */
+		void move(NodeRef ref, RegionRef region);
+
+		/* redirects every use of `from` to `to` after all staged nodes exist */
+		void replace_all_uses(NodeRef from, NodeRef to);
+
+		/* removes `ref` after the rewrites if it has no users left and is not pinned */
+		void remove(NodeRef ref);
+
+		[[nodiscard]] bool empty() const
+		{
+			return nodes.empty() && moves.empty() && rewrites.empty() && removals.empty() && staged_regions.empty();
+		}
+
+		/* creates the staged regions and nodes, wires them, runs the moves, the rewrites, then the removals */
+		void apply(SproutGraph &graph);
+
+		/* the real ref of a staged one once applied; other refs pass through */
+		[[nodiscard]] NodeRef resolve(NodeRef ref) const;
+
+		[[nodiscard]] RegionRef resolve_region(RegionRef ref) const;
+
+	private:
+		struct StagedNode
+		{
+			NodeType type;
+			NodeRef fn_ref;
+			RegionRef region;
+			std::string name;
+			std::vector<NodeRef> inputs;
+			NodeValue value;
+			uint32_t result = 0;
+		};
+
+		struct StagedRegion
+		{
+			std::string name;
+			RegionType type;
+			RegionRef parent;
+			RegionRef sibling;
+			NodeRef ctrl_dep;
+		};
+
+		std::vector<StagedRegion> staged_regions;
+		std::vector<RegionRef> created_regions;
+		std::vector<StagedNode> nodes;
+		std::vector<std::pair<NodeRef, RegionRef> > moves;
+		std::vector<std::pair<NodeRef, NodeRef> > rewrites;
+		std::vector<NodeRef> removals;
+		std::vector<NodeRef> created;
+	};
+
+	/*
+	 * a pass whose work splits by function. run_function gets read-only
+	 * access to the graph and may be called for different functions at the
+	 * same time, so it must only write to its own per-function slot and
+	 * the edits it is handed. nodes outside every FUNCTION region form one
+	 * extra unit, the last one, so the units cover the whole graph. run from
+	 * a FUNCTION region, the pass sees that function and the nodes outside
+	 * every region
+	 */
+	class FunctionPass : public SproutPass
+	{
+	public:
+		/* runs every unit on the calling thread */
+		void run(RegionRef root, SproutGraph &graph) override;
+
+		/* sizes per-function result slots before any unit runs */
+		virtual void begin(const SproutGraph &graph, size_t unit_count) {}
+
+		virtual void run_function(const FunctionUnit &unit,
+		                          const SproutGraph &graph,
+		                          WorkerScratch &scratch,
+		                          FunctionEdits &edits) = 0;
+
+		/* merges per-function results after all edits are applied, in unit order */
+		virtual void finish(RegionRef root,
+		                    SproutGraph &graph,
+		                    const std::vector<FunctionEdits> &edits) {}
+	};
+
+	/* dispatches a FunctionPass over the FUNCTION regions under a root */
+	class FunctionPassDriver
+	{
+	public:
+		/* `threads` counts the caller; 0 picks the hardware concurrency */
+		explicit FunctionPassDriver(unsigned threads = 0) : pool(threads) {}
+
+		void run(FunctionPass &pass, RegionRef root, SproutGraph &graph);
+
+		[[nodiscard]] unsigned threads() const
+		{
+			return pool.size();
+		}
+
+	private:
+		WorkStealingPool pool;
+		std::vector<WorkerScratch> scratch;
+
+		/* CSR of node refs per unit, rebuilt for every run */
+		std::vector<RegionRef> unit_regions;
+		std::vector<uint32_t> unit_offsets;
+		std::vector<NodeRef> unit_nodes;
+
+		void partition(RegionRef root, const SproutGraph &graph);
+	};
+}
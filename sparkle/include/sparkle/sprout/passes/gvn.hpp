@@ -0,0 +1,64 @@
+#pragma once
+
+#include <vector>
+#include <sparkle/sprout/passes/function.hpp>
+
+namespace sprk
+{
+	/* a folded node and the leader that now carries its uses */
+	struct GVNFold
+	{
+		NodeRef node;
+		NodeRef leader;
+	};
+
+	/*
+	 * hash-consing value numbering per function. regions are walked parent
+	 * before children, nodes in region order; a pure node whose key (opcode,
+	 * result type, value, operands by leader, commutative operands sorted)
+	 * is already in the table folds into that leader if the leader's region
+	 * contains or dominates its own. folded nodes are removed, so run it
+	 * before PRE, which then only sees the redundancies GVN cannot reach
+	 * (ones with no dominating copy); IPOPass does so for each function it
+	 * simplifies
+	 */
+	class GVNPass final : public FunctionPass
+	{
+	public:
+		GVNPass() = default;
+
+		[[nodiscard]] AnalysisSet required_analyses() const override
+		{
+			return analysis_bit(AnalysisKind::DOMINATORS);
+		}
+
+		/* regions are untouched */
+		[[nodiscard]] AnalysisSet preserved_analyses() const override
+		{
+			return analysis_bit(AnalysisKind::DOMINATORS);
+		}
+
+		void begin(const SproutGraph &graph, size_t unit_count) override;
+
+		void run_function(const FunctionUnit &unit,
+		                  const SproutGraph &graph,
+		                  WorkerScratch &scratch,
+		                  FunctionEdits &edits) override;
+
+		void finish(RegionRef root,
+		            SproutGraph &graph,
+		            const std::vector<FunctionEdits> &edits) override;
+
+		/* in region order per function; the folded refs are gone from the graph */
+		[[nodiscard]] const std::vector<GVNFold> &get_results() const
+		{
+			return folds;
+		}
+
+		void dump_results(bool colorize = true) const;
+
+	private:
+		std::vector<GVNFold> folds;
+		std::vector<std::vector<GVNFold> > unit_folds;
+	};
+}
@@ -1,11 +1,14 @@
 #pragma once
 
+#include <memory>
+#include <string>
 #include <unordered_map>
 #include <unordered_set>
 #include <vector>
 #include <set>
 #include <queue>
 #include <sparkle/sprout/passes/pass.hpp>
+#include <sparkle/sprout/utils/profile.hpp>
 
 namespace sprk
 {
@@ -25,14 +28,26 @@ namespace sprk
 			NodeRef caller = {};
 			NodeRef callee = {};
 			NodeRef call_site = {};
-			uint16_t benefit = 0;
-			bool is_recursive = false; /* for tail call or smth */
+			uint32_t benefit = 0;      /* static score, plus the site's hotness under a profile */
+			uint64_t count = 0;        /* profiled executions of the call site */
+			int32_t growth = 0;        /* nodes the caller gains by inlining; negative when it shrinks */
+			bool is_recursive = false; /* the callee is on a call cycle */
 		};
 
 		std::unordered_map<NodeRef, std::vector<NodeRef>> call_graph;
+
+		/*
+		 * strongly connected components of the call graph, callees before
+		 * their callers; every FUNCTION is in exactly one
+		 */
+		std::vector<std::vector<NodeRef>> sccs;
+		std::unordered_map<NodeRef, uint32_t> scc_of;  /* index into sccs */
+		std::unordered_set<NodeRef> recursive_fns;     /* in an SCC of several functions, or calls itself */
 		std::unordered_set<NodeRef> pure_fns;
 		std::vector<ConstPropOpp> const_opps;
 		std::vector<InlineOpp> inline_opps;
+		uint64_t max_count = 0;  /* hottest call site of the profile; 0 without one */
+		std::vector<std::string> stale_records; /* profile records that match nothing in the module */
 	};
 
 	class IPAPass final : public SproutPass
@@ -40,31 +55,52 @@ namespace sprk
 	public:
 		IPAPass() = default;
 
-		void run(const std::shared_ptr<SproutRegion>& root,
-				 std::vector<std::unique_ptr<SproutNode<>>>& nodes) override;
+		void run(RegionRef root, SproutGraph& graph) override;
+
+		/* analysis only; the graph is left untouched */
+		[[nodiscard]] AnalysisSet preserved_analyses() const override
+		{
+			return ALL_ANALYSES;
+		}
 
 		[[nodiscard]] const IPAResult& get_results() const
 		{
 			return ipa_results;
 		}
 
+		/*
+		 * execution counts that weight the inlining benefit of each call
+		 * site by its hotness; a site that never ran scores 0. null or empty
+		 * for the static score alone. each run binds it to the module again,
+		 * so refs renumbered since it was recorded do not matter
+		 */
+		void set_profile(std::shared_ptr<const ProfileData> profile_data)
+		{
+			profile = std::move(profile_data);
+		}
+
 		void dump_results(bool colorize = true);
 
 	private:
 		IPAResult ipa_results;
+		std::shared_ptr<const ProfileData> profile;
+		ProfileCounts profile_counts; /* the profile bound to the graph of the current run */
+
+		void build_call_graph(const SproutGraph& graph);
 
-		void build_call_graph(const std::vector<std::unique_ptr<SproutNode<>>>& nodes);
+		/* Tarjan's algorithm; it emits each component once all it calls is emitted */
+		void build_sccs(const SproutGraph& graph);
 
-		void analyze_function_purity(const std::vector<std::unique_ptr<SproutNode<>>>& nodes);
+		void analyze_function_purity(const SproutGraph& graph);
 
-		void find_const_prop_opp(const std::vector<std::unique_ptr<SproutNode<>>>& nodes);
+		void find_const_prop_opp(const SproutGraph& graph);
 
-		void find_inline_opp(const std::vector<std::unique_ptr<SproutNode<>>>& nodes);
+		void find_inline_opp(const SproutGraph& graph);
 
 		/* utils */
-		bool is_pure_node(const SproutNode<>* node) const;
+		bool is_pure_node(NodeType type) const;
 
-		[[nodiscard]] uint16_t compute_inlining_benefit(NodeRef callee,
-			const std::vector<std::unique_ptr<SproutNode<>>>& nodes) const;
+		[[nodiscard]] uint32_t compute_inlining_benefit(NodeRef callee,
+			const SproutGraph& graph) const;
 	};
 }
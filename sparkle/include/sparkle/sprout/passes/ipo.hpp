@@ -1,6 +1,7 @@
 #pragma once
 
 #include <map>
+#include <memory>
 #include <vector>
 #include <functional>
 #include <sparkle/sprout/passes/pass.hpp>
@@ -13,17 +14,46 @@ namespace sprk
 		std::vector<std::pair<NodeRef, NodeRef> > inlined_functions; /* caller-callee pairs */
 		std::vector<std::pair<NodeRef, NodeRef> > const_props;       /* param constants pairs */
 
+		std::vector<NodeRef> recursive_calls;                          /* call sites kept; the callee is on a call cycle */
+		std::vector<NodeRef> unprofitable_calls;                       /* benefit 0: never ran, or the callee is too big */
+		std::vector<NodeRef> over_budget_calls;                        /* would have grown the module past the budget */
+
 		uint32_t removed_calls = 0;
 		uint32_t const_replaced = 0;
+		uint32_t simplified_nodes = 0;                                 /* removed by the cleanup of each component */
+		int64_t growth = 0;                                            /* nodes the inlining added, net */
+		int64_t budget = 0;
 	};
 
+	/*
+	 * inlines bottom-up over the call graph's SCCs. every function of a
+	 * component first takes in the callees inlined into it, then the
+	 * component is simplified with SCCP, GVN, PRE and DCE before any caller
+	 * clones it, so callers copy the folded body once instead of its calls.
+	 * calls to a function on a call cycle stay calls; the functions of a
+	 * recursive component are simplified together like any other
+	 *
+	 * what gets inlined is chosen module-wide first. sites that shrink
+	 * their caller always go in; the rest go by benefit per node of growth,
+	 * hottest first under a profile, until the module would grow by more
+	 * than `growth_percent` of its size or `min_growth` nodes, whichever is
+	 * larger. the growth is measured again on the body as it is when cloned
+	 */
 	class IPOPass final : public SproutPass
 	{
 	public:
-		explicit IPOPass(const std::shared_ptr<IPAPass> &ipa_pass) : ipa_pass(ipa_pass) {}
+		explicit IPOPass(const std::shared_ptr<IPAPass> &ipa_pass,
+		                 const uint32_t growth_percent = 20,
+		                 const uint32_t min_growth = 32) : ipa_pass(ipa_pass),
+		                                                   growth_percent(growth_percent),
+		                                                   min_growth(min_growth) {}
+
+		void run(RegionRef root, SproutGraph &graph) override;
 
-		void run(const std::shared_ptr<SproutRegion> &root,
-		         std::vector<std::unique_ptr<SproutNode<> > > &nodes) override;
+		[[nodiscard]] AnalysisSet required_analyses() const override
+		{
+			return analysis_bit(AnalysisKind::IPA);
+		}
 
 		[[nodiscard]] const IPOResult &get_results() const
 		{
@@ -36,37 +66,48 @@ namespace sprk
 		IPOResult ipo_results;
 		std::map<NodeRef, NodeRef> orig_to_clone;
 		std::set<NodeRef> functions_to_remove;
-		std::unordered_set<NodeRef> nodes_to_remove;
 		std::shared_ptr<IPAPass> ipa_pass;
-		NodeRef next_node_id = {}; /* here to track next node id for cloning */
+		uint32_t growth_percent;
+		uint32_t min_growth;
 
-		void perform_inlining(const std::shared_ptr<SproutRegion> &root,
-		                      std::vector<std::unique_ptr<SproutNode<> > > &nodes);
+		/* clone values and call sites the cleanup should look at */
+		std::vector<NodeRef> dirty_nodes;
+
+		void perform_inlining(SproutGraph &graph);
+
+		/* indices into the IPA's opportunities that fit the budget */
+		std::unordered_set<size_t> select_inlines(const SproutGraph &graph);
+
+		/* runs SCCP, GVN and PRE on each function of a component, then removes what they left dead */
+		void simplify_component(const std::vector<NodeRef> &functions, SproutGraph &graph);
 
 		/* propagate constant */
-		void prop_constant(const std::vector<std::unique_ptr<SproutNode<> > > &nodes);
+		void prop_constant(SproutGraph &graph);
 
-		std::shared_ptr<SproutRegion> clone_region(const std::shared_ptr<SproutRegion> &src_region,
-		                                           const std::shared_ptr<SproutRegion> &dest_parent,
-		                                           std::vector<std::unique_ptr<SproutNode<> > > &nodes);
+		RegionRef clone_region(RegionRef src_region,
+		                       RegionRef dest_parent,
+		                       SproutGraph &graph);
 
-		void connect_inlined_nodes(std::vector<std::unique_ptr<SproutNode<> > > &nodes);
+		void connect_inlined_nodes(SproutGraph &graph);
 
 		static void map_params_to_args(NodeRef callee,
 		                        NodeRef call_site,
-		                        const std::vector<std::unique_ptr<SproutNode<> > > &nodes,
+		                        const SproutGraph &graph,
 		                        std::map<NodeRef, NodeRef> &param_to_arg);
 
 		void replace_call_with_inlined(NodeRef call_site,
 		                               NodeRef inlined_return,
-		                               std::vector<std::unique_ptr<SproutNode<> > > &nodes);
+		                               SproutGraph &graph);
+
+		/* true if inlining a call of `opp` is legal and its value can replace the call */
+		[[nodiscard]] bool can_inline(const IPAResult::InlineOpp &opp, const SproutGraph &graph) const;
 
-		void remove_dead_functions(const std::shared_ptr<SproutRegion> &root,
-		                           std::vector<std::unique_ptr<SproutNode<> > > &nodes);
+		void remove_dead_functions(RegionRef root,
+		                           SproutGraph &graph);
 
 		std::vector<NodeRef> inline_function_body(
-			const std::shared_ptr<SproutRegion> &callee_region,
-			const std::shared_ptr<SproutRegion> &caller_region,
-			std::vector<std::unique_ptr<SproutNode<> > > &nodes);
+			RegionRef callee_region,
+			RegionRef caller_region,
+			SproutGraph &graph);
 	};
 }
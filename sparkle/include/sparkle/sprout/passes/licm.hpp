@@ -0,0 +1,91 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+#include <sparkle/sprout/passes/aa.hpp>
+#include <sparkle/sprout/passes/function.hpp>
+
+namespace sprk
+{
+	/* a node taken out of a LOOP_BODY; `to` is the preheader, or the staged exit for a sunk store */
+	struct LICMMove
+	{
+		NodeRef node;
+		RegionRef from;
+		RegionRef to;
+	};
+
+	/*
+	 * loop-invariant code motion per function. loops are visited innermost
+	 * first; a pure node in a LOOP_BODY whose inputs are all defined outside
+	 * it, and available at its preheader (the loop's immediate dominator,
+	 * or its parent if it has none), moves to the end of the preheader, so a
+	 * node hoisted out of an inner loop may leave the outer one as well. DIV
+	 * only moves with a constant divisor other than 0 or -1, since the loop
+	 * may run zero times.
+	 *
+	 * memory goes through the alias analysis: a LOAD or PTR_LOAD of a known
+	 * allocation is hoisted when no store or free in the loop may touch the
+	 * same memory, and a STORE or PTR_STORE of invariant operands directly
+	 * in the body is sunk into a BRANCH_THEN placed right after the loop
+	 * when nothing else in the loop may touch its memory. the branch runs
+	 * if the loop did: under the loop's control when that is available at
+	 * the preheader, or, for a counted loop (see match_induction_loop),
+	 * under CMP(init, bound) added to the preheader, since the control in
+	 * its body is false once it exits. a CALL in the loop keeps every
+	 * memory operation where it is
+	 */
+	class LICMPass final : public FunctionPass
+	{
+	public:
+		explicit LICMPass(const std::shared_ptr<AliasAnalysisPass> &aa_pass) : aa_pass(aa_pass) {}
+
+		[[nodiscard]] AnalysisSet required_analyses() const override
+		{
+			return analysis_bit(AnalysisKind::ALIAS) | analysis_bit(AnalysisKind::DOMINATORS);
+		}
+
+		/* nodes keep their refs, so points-to sets stay valid; sinking adds regions */
+		[[nodiscard]] AnalysisSet preserved_analyses() const override
+		{
+			return analysis_bit(AnalysisKind::ALIAS);
+		}
+
+		void begin(const SproutGraph &graph, size_t unit_count) override;
+
+		void run_function(const FunctionUnit &unit,
+		                  const SproutGraph &graph,
+		                  WorkerScratch &scratch,
+		                  FunctionEdits &edits) override;
+
+		void finish(RegionRef root,
+		            SproutGraph &graph,
+		            const std::vector<FunctionEdits> &edits) override;
+
+		/* per function, one entry per loop a node left, in the order they were moved */
+		[[nodiscard]] const std::vector<LICMMove> &get_hoisted() const
+		{
+			return hoisted;
+		}
+
+		[[nodiscard]] const std::vector<LICMMove> &get_sunk() const
+		{
+			return sunk;
+		}
+
+		void dump_results(const SproutGraph &graph, bool colorize = true) const;
+
+	private:
+		std::shared_ptr<AliasAnalysisPass> aa_pass;
+		std::vector<LICMMove> hoisted;
+		std::vector<LICMMove> sunk;
+
+		struct UnitResult
+		{
+			std::vector<LICMMove> hoisted;
+			std::vector<LICMMove> sunk;
+		};
+
+		std::vector<UnitResult> units;
+	};
+}
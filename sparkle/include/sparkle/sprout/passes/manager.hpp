@@ -0,0 +1,75 @@
+#pragma once
+
+#include <array>
+#include <memory>
+#include <vector>
+#include <sparkle/sprout/passes/aa.hpp>
+#include <sparkle/sprout/passes/ipa.hpp>
+#include <sparkle/sprout/passes/function.hpp>
+#include <sparkle/sprout/passes/pass.hpp>
+
+namespace sprk
+{
+	/*
+	 * runs a pipeline of passes over one module and owns the analyses they
+	 * share. before each pass the analyses it requires are recomputed if they
+	 * were invalidated; after it, everything the pass does not preserve is
+	 * marked invalid. passes that consume an analysis are constructed with
+	 * the manager's instance, e.g. IPOPass(manager.ipa()).
+	 *
+	 * the dominator tree lives in SproutGraph, which already rebuilds it when
+	 * regions change; the manager only makes sure it is built before a pass
+	 * that requires it runs.
+	 *
+	 * FunctionPasses go through a FunctionPassDriver with `threads` workers
+	 */
+	class PassManager
+	{
+	public:
+		explicit PassManager(unsigned threads = 1);
+
+		/* appends a pass to the pipeline */
+		void add(std::shared_ptr<SproutPass> pass);
+
+		void run(RegionRef root, SproutGraph &graph);
+
+		/* recomputes whichever of `analyses` is invalid */
+		void compute(AnalysisSet analyses, RegionRef root, SproutGraph &graph);
+
+		/* marks `analyses` stale, e.g. after editing the graph outside the pipeline */
+		void invalidate(AnalysisSet analyses);
+
+		[[nodiscard]] bool is_valid(const AnalysisKind kind) const
+		{
+			return valid & analysis_bit(kind);
+		}
+
+		/* how many times an analysis has been computed by this manager */
+		[[nodiscard]] uint32_t compute_count(const AnalysisKind kind) const
+		{
+			return compute_counts[static_cast<size_t>(kind)];
+		}
+
+		[[nodiscard]] const std::shared_ptr<IPAPass> &ipa() const
+		{
+			return ipa_pass;
+		}
+
+		[[nodiscard]] const std::shared_ptr<AliasAnalysisPass> &alias() const
+		{
+			return aa_pass;
+		}
+
+	private:
+		std::vector<std::shared_ptr<SproutPass> > passes;
+		std::shared_ptr<IPAPass> ipa_pass;
+		std::shared_ptr<AliasAnalysisPass> aa_pass;
+		FunctionPassDriver driver;
+
+		AnalysisSet valid = NO_ANALYSES;
+		std::array<uint32_t, static_cast<size_t>(AnalysisKind::COUNT)> compute_counts = {};
+
+		/* the analysis a pipeline entry provides, if it is one of ours */
+		[[nodiscard]] AnalysisSet provided_by(const SproutPass *pass) const;
+	};
+}
@@ -1,16 +1,47 @@
 #pragma once
 
+#include <sparkle/sprout/graph.hpp>
 #include <sparkle/sprout/node.hpp>
 #include <sparkle/sprout/region.hpp>
-#include <sparkle/sprout/passes/pass.hpp>
 
 namespace sprk
 {
+	/* analyses whose results the pass manager caches between passes */
+	enum class AnalysisKind : uint8_t
+	{
+		IPA,        /* call graph, purity, inlining and const-prop opportunities */
+		ALIAS,      /* points-to sets and memory issues */
+		DOMINATORS, /* region dominator tree */
+		COUNT
+	};
+
+	/* one bit per AnalysisKind */
+	using AnalysisSet = uint32_t;
+
+	constexpr AnalysisSet analysis_bit(const AnalysisKind kind)
+	{
+		return 1u << static_cast<uint32_t>(kind);
+	}
+
+	constexpr AnalysisSet NO_ANALYSES = 0;
+	constexpr AnalysisSet ALL_ANALYSES = (1u << static_cast<uint32_t>(AnalysisKind::COUNT)) - 1;
+
 	class SproutPass
 	{
 	public:
 		virtual ~SproutPass() = default;
-		virtual void run(const std::shared_ptr<SproutRegion>& root,
-			 std::vector<std::unique_ptr<SproutNode<>>>& nodes) = 0;
+		virtual void run(RegionRef root, SproutGraph& graph) = 0;
+
+		/* analyses the pass reads; the manager brings them up to date before run */
+		[[nodiscard]] virtual AnalysisSet required_analyses() const
+		{
+			return NO_ANALYSES;
+		}
+
+		/* analyses still valid after run; the rest are recomputed on next use */
+		[[nodiscard]] virtual AnalysisSet preserved_analyses() const
+		{
+			return NO_ANALYSES;
+		}
 	};
 }
@@ -3,57 +3,106 @@
 #include <map>
 #include <set>
 #include <vector>
-#include <sparkle/sprout/passes/pass.hpp>
+#include <sparkle/sprout/passes/function.hpp>
 
 namespace sprk
 {
 	using ExprHash = uint64_t;
 
+	enum class PREMode : uint8_t
+	{
+		/* every group of equal expressions moves to its common dominator; the originals are left to DCE */
+		HOIST,
+		/*
+		 * lazy code motion over the function's region flow graph: availability
+		 * and anticipability decide where a computation is both safe and
+		 * needed, it is placed as late as that allows, and the originals it
+		 * makes redundant are deleted. never adds work to a path
+		 */
+		LAZY_CODE_MOTION
+	};
+
 	struct PREResult
 	{
 		NodeRef original_node;
 		NodeRef hoisted_node;
-		std::shared_ptr<SproutRegion> target_region;
+		RegionRef target_region = NULL_REGION;
 		int instances_removed = 0;
+		int instances_inserted = 0;
 
-		std::string to_string() const;
+		std::string to_string(const SproutGraph &graph) const;
 	};
 
-	class PREPass final : public SproutPass
+	/* groups and hoists per function; hoisted nodes are created when the driver merges */
+	class PREPass final : public FunctionPass
 	{
 	public:
-		PREPass() = default;
+		explicit PREPass(PREMode mode = PREMode::HOIST) : mode(mode) {}
+
+		void begin(const SproutGraph &graph, size_t unit_count) override;
+
+		void run_function(const FunctionUnit &unit,
+		                  const SproutGraph &graph,
+		                  WorkerScratch &scratch,
+		                  FunctionEdits &edits) override;
 
-		void run(const std::shared_ptr<SproutRegion> &root,
-		         std::vector<std::unique_ptr<SproutNode<> > > &nodes) override;
+		void finish(RegionRef root,
+		            SproutGraph &graph,
+		            const std::vector<FunctionEdits> &edits) override;
+
+		[[nodiscard]] AnalysisSet required_analyses() const override
+		{
+			return analysis_bit(AnalysisKind::DOMINATORS);
+		}
+
+		/* hoisting moves nodes between regions but never rewires imm_dom; lazy code motion may add an else region */
+		[[nodiscard]] AnalysisSet preserved_analyses() const override
+		{
+			return mode == PREMode::HOIST ? analysis_bit(AnalysisKind::DOMINATORS) : NO_ANALYSES;
+		}
 
 		[[nodiscard]] const std::vector<PREResult> &get_results() const
 		{
 			return pre_results;
 		}
 
+		/*
+		 * nodes whose uses were redirected to a hoisted copy, or in lazy code
+		 * motion the inputs of deleted originals; see DCEPass::remove_dead_from
+		 */
+		[[nodiscard]] const std::vector<NodeRef> &get_dirty_nodes() const
+		{
+			return dirty_nodes;
+		}
+
 		void dump_results(
+			const SproutGraph &graph,
 			bool colorize = true) const;
 
+		/* groups ADD/SUB/MUL/DIV/CMP nodes by expression hash; singletons dropped */
+		std::map<ExprHash, std::vector<NodeRef> > find_redundant_expressions(
+			const SproutGraph &graph);
+
 	private:
+		PREMode mode;
 		std::vector<PREResult> pre_results;
+		std::vector<std::vector<PREResult> > unit_results; /* hoisted_node is staged until finish */
+		std::vector<NodeRef> dirty_nodes;
+		std::vector<std::vector<NodeRef> > unit_dirty;
 
-		std::map<ExprHash, std::vector<NodeRef> > find_redundant_expressions(
-			const std::vector<std::unique_ptr<SproutNode<> > > &nodes);
+		ExprHash compute_expr_hash(const SproutGraph &graph, NodeRef node) const;
 
-		ExprHash compute_expr_hash(const SproutNode<> *node) const;
+		void hoist(const FunctionUnit &unit, const SproutGraph &graph, FunctionEdits &edits);
 
-		std::shared_ptr<SproutRegion> find_common_dominator(
-			const std::vector<NodeRef> &nodes,
-			const std::vector<std::unique_ptr<SproutNode<> > > &node_vec,
-			const std::shared_ptr<SproutRegion> &root);
+		void lazy_code_motion(const FunctionUnit &unit, const SproutGraph &graph, FunctionEdits &edits);
 
-		std::shared_ptr<SproutRegion> find_node_region(
-			NodeRef node_ref,
-			const std::shared_ptr<SproutRegion> &root);
+		RegionRef find_common_dominator(
+			const std::vector<NodeRef> &nodes,
+			const SproutGraph &graph);
 
-		std::shared_ptr<SproutRegion> find_common_dominator(
-			std::shared_ptr<SproutRegion> r1,
-			std::shared_ptr<SproutRegion> r2);
+		RegionRef find_common_dominator(
+			const SproutGraph &graph,
+			RegionRef r1,
+			RegionRef r2);
 	};
 }
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <vector>
+#include <sparkle/sprout/passes/function.hpp>
+
+namespace sprk
+{
+	/* a node proved constant and the CONST node that now carries its uses */
+	struct SCCPFold
+	{
+		NodeRef node;
+		NodeRef constant;
+		NodeValue value;
+	};
+
+	/*
+	 * sparse conditional constant propagation per function. nodes start
+	 * unknown and only move down to constant, then varying; regions start
+	 * unexecuted. a BRANCH_THEN runs unless its control is the constant 0,
+	 * a BRANCH_ELSE unless it is nonzero, and a LOOP_BODY unless it is 0.
+	 * a LOOP_BODY whose control is computed inside it runs whenever its
+	 * parent does, since that control is only evaluated in the body. nodes in a region that never runs are never evaluated, so a phi only
+	 * meets the arms that can execute. int64 and double arithmetic folds;
+	 * CMP compares less-than, the way the demos build it.
+	 *
+	 * constant ADD/SUB/MUL/DIV/CMP/PHI nodes are replaced by CONST nodes in
+	 * the same region, and a phi left with one live arm forwards it. a
+	 * region that never runs is deleted with its subtree when nothing live
+	 * reads it. the inputs of everything dropped, and the new constants,
+	 * are kept for DCEPass::remove_dead_from
+	 */
+	class SCCPPass final : public FunctionPass
+	{
+	public:
+		SCCPPass() = default;
+
+		void begin(const SproutGraph &graph, size_t unit_count) override;
+
+		void run_function(const FunctionUnit &unit,
+		                  const SproutGraph &graph,
+		                  WorkerScratch &scratch,
+		                  FunctionEdits &edits) override;
+
+		void finish(RegionRef root,
+		            SproutGraph &graph,
+		            const std::vector<FunctionEdits> &edits) override;
+
+		/* per function in node order; the folded refs are gone from the graph */
+		[[nodiscard]] const std::vector<SCCPFold> &get_results() const
+		{
+			return folds;
+		}
+
+		/* phis replaced by their only executable arm */
+		[[nodiscard]] const std::vector<NodeRef> &get_forwarded_phis() const
+		{
+			return forwarded_phis;
+		}
+
+		/* outermost regions deleted as unreachable; their slots are removed, not compacted */
+		[[nodiscard]] const std::vector<RegionRef> &get_pruned_regions() const
+		{
+			return pruned_regions;
+		}
+
+		[[nodiscard]] const std::vector<NodeRef> &get_dirty_nodes() const
+		{
+			return dirty_nodes;
+		}
+
+		void dump_results(bool colorize = true) const;
+
+	private:
+		std::vector<SCCPFold> folds;
+		std::vector<NodeRef> forwarded_phis;
+		std::vector<RegionRef> pruned_regions;
+		std::vector<NodeRef> dirty_nodes;
+
+		struct UnitResult
+		{
+			std::vector<SCCPFold> folds;
+			std::vector<NodeRef> forwarded_phis;
+			std::vector<RegionRef> dead_regions;
+			std::vector<NodeRef> dirty_nodes;
+		};
+
+		std::vector<UnitResult> units;
+	};
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <array>
+#include <memory>
+#include <vector>
+#include <sparkle/sprout/passes/aa.hpp>
+#include <sparkle/sprout/passes/function.hpp>
+
+namespace sprk
+{
+	/* one group of four adjacent stores the pass costed */
+	struct SLPResult
+	{
+		RegionRef block;
+		NodeRef store;              /* the first of the four stores */
+		uint32_t scalar_cost = 0;   /* scalar nodes, addresses included, that go away if the group is packed */
+		uint32_t vector_cost = 0;   /* vector nodes that replace them */
+		bool packed = false;
+	};
+
+	/*
+	 * superword-level parallelism in BASIC_BLOCK regions. four PTR_STOREs
+	 * of 32-bit elements at base + o, o + 4, o + 8 and o + 12 (a PTR_ADD of a
+	 * constant, or the base itself for 0) seed a tree that is packed
+	 * operand by operand: four ADDs or four MULs become a VECTOR_ADD or
+	 * VECTOR_MUL, four PTR_LOADs from adjacent offsets of one base a
+	 * VECTOR_LOAD, and four copies of one value a VECTOR_SPLAT. anything
+	 * else leaves the group scalar.
+	 *
+	 * the vector nodes go where the last of the four stores was, so every
+	 * load and store the tree moves past must hit different memory: the
+	 * same base at another offset, or a base the alias analysis keeps
+	 * apart. a call in between keeps the group scalar.
+	 *
+	 * the cost model counts one per node: a scalar node is saved only when
+	 * nothing outside the tree reads it, and a group is packed when it saves
+	 * at least `min_savings` nodes over the vector nodes it needs. lanes
+	 * still read elsewhere stay in place, scalar
+	 */
+	class SLPVectorizePass final : public FunctionPass
+	{
+	public:
+		explicit SLPVectorizePass(const std::shared_ptr<AliasAnalysisPass> &aa_pass,
+		                          const uint32_t min_savings = 1) : aa_pass(aa_pass), min_savings(min_savings) {}
+
+		[[nodiscard]] AnalysisSet required_analyses() const override
+		{
+			return analysis_bit(AnalysisKind::ALIAS);
+		}
+
+		void begin(const SproutGraph &graph, size_t unit_count) override;
+
+		/* only builds and costs the trees; packing reorders blocks, so it runs in finish */
+		void run_function(const FunctionUnit &unit,
+		                  const SproutGraph &graph,
+		                  WorkerScratch &scratch,
+		                  FunctionEdits &edits) override;
+
+		void finish(RegionRef root,
+		            SproutGraph &graph,
+		            const std::vector<FunctionEdits> &edits) override;
+
+		/* one entry per legal group, per function in region order */
+		[[nodiscard]] const std::vector<SLPResult> &get_results() const
+		{
+			return results;
+		}
+
+		void dump_results(const SproutGraph &graph, bool colorize = true) const;
+
+	private:
+		static constexpr size_t LANES = 4;
+
+		/* four isomorphic scalars and the vector node they become */
+		struct Pack
+		{
+			NodeType type;                     /* the vector node type */
+			std::array<NodeRef, LANES> lanes;
+			int operands[2] = { -1, -1 };      /* packs of the inputs, for VECTOR_ADD/MUL/STORE */
+		};
+
+		/* a costed group of stores, packed by finish */
+		struct Tree
+		{
+			RegionRef block;
+			NodeRef anchor;                    /* the last of the stores; the vector nodes go before it */
+			std::vector<Pack> packs;           /* operands first; the stores last */
+			std::vector<NodeRef> removed;      /* scalar nodes nothing outside the tree reads */
+		};
+
+		std::shared_ptr<AliasAnalysisPass> aa_pass;
+		uint32_t min_savings;
+		std::vector<SLPResult> results;
+		std::vector<std::vector<SLPResult> > unit_results;
+		std::vector<std::vector<Tree> > units;
+	};
+}
@@ -0,0 +1,119 @@
+#pragma once
+
+#include <memory>
+#include <unordered_map>
+#include <vector>
+#include <sparkle/sprout/passes/aa.hpp>
+#include <sparkle/sprout/passes/function.hpp>
+
+namespace sprk
+{
+	/* an object whose fields went into SSA values */
+	struct SROAResult
+	{
+		NodeRef object;
+		uint32_t fields = 0;  /* fields promoted; the rest stay in memory */
+		uint32_t loads = 0;   /* loads replaced by the value they read */
+		uint32_t stores = 0;  /* stores removed */
+		uint32_t phis = 0;    /* PHIs placed where regions merge */
+	};
+
+	/* a load that now takes the value of an earlier store in its region */
+	struct ForwardedLoad
+	{
+		NodeRef load;
+		NodeRef store;
+	};
+
+	/*
+	 * scalar replacement of aggregates and store-to-load forwarding per
+	 * function.
+	 *
+	 * an object (MALLOC, STACK_ALLOC, or the only ADDR_OF of a value) whose
+	 * pointer is only the address of LOADs, STOREs and their PTR_ forms,
+	 * directly or through PTR_ADDs of constants (plus FREEs for a MALLOC),
+	 * splits into one field per offset. a field becomes an SSA value when
+	 * every load of it is reached by a store on every path; an ADDR_OF's
+	 * field 0 starts out as the value it takes the address of. regions run
+	 * their own nodes before their children, and values meet the same way
+	 * the alias analysis walks memory states:
+	 *
+	 *	- after a BRANCH_THEN and BRANCH_ELSE pair, in a PHI(then, else,
+	 *	  control) added to their parent
+	 *	- after a lone branch, in a PHI of the arm and the value before it
+	 *	- in a LOOP_BODY, in a PHI(init, next) put first in the loop, which
+	 *	  is also the value after the loop
+	 *
+	 * accesses under an EXCEPTION region or a branch with no control keep
+	 * the whole object in memory. the loads and stores of promoted fields
+	 * are removed, and so are addresses and STACK_ALLOCs or ADDR_OFs that
+	 * nothing reads anymore.
+	 *
+	 * in each region, a LOAD or PTR_LOAD of any other memory takes the value
+	 * of the last store to the same address: the same pointer, or the same
+	 * base moved by PTR_ADDs of equal constants. a store the alias analysis
+	 * cannot keep apart, a free of the same object or a call in between
+	 * stops it
+	 */
+	class SROAPass final : public FunctionPass
+	{
+	public:
+		explicit SROAPass(const std::shared_ptr<AliasAnalysisPass> &aa_pass) : aa_pass(aa_pass) {}
+
+		[[nodiscard]] AnalysisSet required_analyses() const override
+		{
+			return analysis_bit(AnalysisKind::ALIAS);
+		}
+
+		void begin(const SproutGraph &graph, size_t unit_count) override;
+
+		/* finds the fields to promote and forwards stores; the SSA values are built in finish */
+		void run_function(const FunctionUnit &unit,
+		                  const SproutGraph &graph,
+		                  WorkerScratch &scratch,
+		                  FunctionEdits &edits) override;
+
+		void finish(RegionRef root,
+		            SproutGraph &graph,
+		            const std::vector<FunctionEdits> &edits) override;
+
+		/* per function in region order, objects in ref order */
+		[[nodiscard]] const std::vector<SROAResult> &get_results() const
+		{
+			return results;
+		}
+
+		[[nodiscard]] const std::vector<ForwardedLoad> &get_forwarded() const
+		{
+			return forwarded;
+		}
+
+		void dump_results(const SproutGraph &graph, bool colorize = true) const;
+
+	private:
+		/* one field of one object */
+		struct Slot
+		{
+			NodeRef object;
+			int64_t offset;
+			NodeRef initial = NULL_REF; /* value before any store; NULL_REF if undefined */
+		};
+
+		struct UnitResult
+		{
+			RegionRef region = NULL_REGION;                  /* the FUNCTION region */
+			std::vector<Slot> slots;                         /* promoted fields only */
+			std::unordered_map<NodeRef, uint32_t> accesses;  /* load or store -> slot */
+			std::vector<NodeRef> addresses;                  /* PTR_ADDs of promoted objects */
+			std::vector<ForwardedLoad> forwarded;
+		};
+
+		std::shared_ptr<AliasAnalysisPass> aa_pass;
+		std::vector<SROAResult> results;
+		std::vector<ForwardedLoad> forwarded;
+		std::vector<UnitResult> units;
+
+		/* builds the SSA values of one function's promoted fields and removes their memory operations */
+		void promote(const UnitResult &unit, SproutGraph &graph);
+	};
+}
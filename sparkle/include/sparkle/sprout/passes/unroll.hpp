@@ -0,0 +1,91 @@
+#pragma once
+
+#include <vector>
+#include <sparkle/sprout/passes/function.hpp>
+
+namespace sprk
+{
+	/* what happened to one recognised loop */
+	struct LoopUnrollResult
+	{
+		RegionRef loop;
+		NodeRef induction;
+		int64_t trip_count = -1;  /* -1 if the bounds are not constant */
+		uint32_t factor = 1;      /* body copies per trip; the trip count when `full` */
+		uint32_t remainder = 0;   /* trips peeled after a partially unrolled loop */
+		uint32_t reduced = 0;     /* MULs of the induction variable turned into additions */
+		bool full = false;        /* the loop region is gone, replaced by straight-line copies */
+	};
+
+	/*
+	 * unrolling and strength reduction of counted loops. a LOOP_BODY without
+	 * child regions is recognised when its ctrl_dep is a CONTROL on
+	 * CMP(i, bound), both in the loop, and i = PHI(init, i + step) with a
+	 * positive constant step; the loop runs while i < bound, and its trip
+	 * count is known when init and bound are constants. loop-carried values
+	 * are PHIs of the same (preheader value, next value) shape.
+	 *
+	 * first, every MUL of i by a loop-invariant value becomes a PHI that
+	 * starts at init * c and adds step * c each trip; a PTR_ADD of an
+	 * invariant base by such a MUL becomes a pointer PHI advanced by
+	 * PTR_ADD. a MUL or PTR_ADD with a user outside the loop is left as it
+	 * is, since the PHI runs one increment ahead once the loop exits. the
+	 * preheader is the loop's immediate dominator, or its parent if it has
+	 * none.
+	 *
+	 * then a loop with a known trip count up to `full_limit` is replaced by
+	 * a BASIC_BLOCK of that many body copies. a longer one gets `factor`
+	 * copies of its body per trip, its bound lowered to a multiple of the
+	 * factor, and the leftover trips peeled into a BASIC_BLOCK after it.
+	 * uses outside the loop read the value of the last trip. run SCCP and
+	 * DCE afterwards to fold the copied induction arithmetic
+	 */
+	class LoopUnrollPass final : public FunctionPass
+	{
+	public:
+		explicit LoopUnrollPass(const uint32_t factor = 4, const uint32_t full_limit = 8) : factor(factor),
+			full_limit(full_limit) {}
+
+		void begin(const SproutGraph &graph, size_t unit_count) override;
+
+		/* only recognises loops; the rewrite needs the regions, so it runs in finish */
+		void run_function(const FunctionUnit &unit,
+		                  const SproutGraph &graph,
+		                  WorkerScratch &scratch,
+		                  FunctionEdits &edits) override;
+
+		void finish(RegionRef root,
+		            SproutGraph &graph,
+		            const std::vector<FunctionEdits> &edits) override;
+
+		/* one entry per recognised loop, per function in region order */
+		[[nodiscard]] const std::vector<LoopUnrollResult> &get_results() const
+		{
+			return results;
+		}
+
+		void dump_results(const SproutGraph &graph, bool colorize = true) const;
+
+	private:
+		/* a loop found by run_function, rewritten by finish */
+		struct CountedLoop
+		{
+			RegionRef loop;
+			NodeRef induction;
+			NodeRef compare;
+			int64_t step;
+			int64_t trip_count;
+			bool unrollable;                 /* no node the copies could not duplicate */
+			std::vector<NodeRef> reducible;  /* MULs of the induction by an invariant */
+		};
+
+		uint32_t factor;
+		uint32_t full_limit;
+		std::vector<LoopUnrollResult> results;
+		std::vector<std::vector<CountedLoop> > units;
+
+		[[nodiscard]] uint32_t reduce(const CountedLoop &counted, RegionRef preheader, SproutGraph &graph) const;
+
+		void unroll(const CountedLoop &counted, RegionRef preheader, SproutGraph &graph, LoopUnrollResult &result) const;
+	};
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+#include <sparkle/sprout/passes/aa.hpp>
+#include <sparkle/sprout/passes/function.hpp>
+
+namespace sprk
+{
+	/* how a vector loop covers the trip count */
+	enum class VectorTarget : uint8_t
+	{
+		/* fixed 128-bit vectors of four lanes, leftover trips run in the scalar loop after it */
+		NEON,
+
+		/* each trip asks VECTOR_SETVL for as many lanes as remain; no scalar loop is left */
+		RVV
+	};
+
+	struct VectorizeResult
+	{
+		RegionRef loop;                    /* the scalar loop */
+		RegionRef vector_loop;
+		RegionRef epilogue = NULL_REGION;  /* the scalar loop, kept for the leftover trips; NEON only */
+		uint32_t lanes;                    /* 0 for the strip-mined RVV loop */
+		uint32_t operations = 0;           /* vector nodes created */
+	};
+
+	/*
+	 * loop vectorizer for element-wise loops over 32-bit elements. a leaf
+	 * LOOP_BODY qualifies when it has the counted shape LoopUnrollPass
+	 * recognises with a step of 1, and its body only has:
+	 *
+	 *  - MUL(i, 4) feeding PTR_ADD(base, i * 4) with a loop-invariant base
+	 *  - PTR_LOAD and PTR_STORE through such addresses
+	 *  - ADD and MUL of loaded values and loop-invariant scalars
+	 *
+	 * and nothing computed per element is read after the loop. every load
+	 * and store must hit memory that the alias analysis keeps apart from
+	 * every store with another base; the same base at the same index is fine.
+	 *
+	 * the vector loop goes in front of the scalar one and steps by the lane
+	 * count: invariant scalars become VECTOR_SPLATs, loads, stores and the
+	 * arithmetic their VECTOR_ counterparts. see VectorTarget for how each
+	 * target handles the tail; target/<arch>/lowering.hpp turns the result
+	 * into machine code
+	 */
+	class VectorizePass final : public FunctionPass
+	{
+	public:
+		VectorizePass(const std::shared_ptr<AliasAnalysisPass> &aa_pass,
+		              const VectorTarget target) : aa_pass(aa_pass), target(target) {}
+
+		[[nodiscard]] AnalysisSet required_analyses() const override
+		{
+			return analysis_bit(AnalysisKind::ALIAS);
+		}
+
+		void begin(const SproutGraph &graph, size_t unit_count) override;
+
+		/* only checks loops; the rewrite adds regions, so it runs in finish */
+		void run_function(const FunctionUnit &unit,
+		                  const SproutGraph &graph,
+		                  WorkerScratch &scratch,
+		                  FunctionEdits &edits) override;
+
+		void finish(RegionRef root,
+		            SproutGraph &graph,
+		            const std::vector<FunctionEdits> &edits) override;
+
+		/* one entry per vectorized loop, per function in region order */
+		[[nodiscard]] const std::vector<VectorizeResult> &get_results() const
+		{
+			return results;
+		}
+
+		void dump_results(const SproutGraph &graph, bool colorize = true) const;
+
+	private:
+		/* a loop run_function found vectorizable */
+		struct VectorLoop
+		{
+			RegionRef loop;
+			NodeRef induction;
+			NodeRef compare;
+			std::vector<NodeRef> body; /* every node but the induction and its control, defs first */
+		};
+
+		std::shared_ptr<AliasAnalysisPass> aa_pass;
+		VectorTarget target;
+		std::vector<VectorizeResult> results;
+		std::vector<std::vector<VectorLoop> > units;
+	};
+}
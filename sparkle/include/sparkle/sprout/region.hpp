@@ -1,13 +1,15 @@
 #pragma once
 
 #include <cstdint>
-#include <memory>
 #include <string>
 #include <vector>
 #include <sparkle/sprout/node.hpp>
 
 namespace sprk
 {
+    using RegionRef = uint32_t;
+    inline constexpr RegionRef NULL_REGION = UINT32_MAX;
+
     enum class RegionType : uint8_t
     {
         ROOT,
@@ -19,31 +21,17 @@ namespace sprk
         EXCEPTION
     };
 
-    class SproutRegion : public std::enable_shared_from_this<SproutRegion>
+    /*
+     * one entry of the region table owned by SproutGraph. parent, child and
+     * dominator links are plain RegionRef indices into that table, so walking
+     * the tree is integer chasing with no refcounting. all mutation goes
+     * through SproutGraph, which keeps the links consistent
+     */
+    class SproutRegion
     {
     public:
         explicit SproutRegion(std::string region_name) : name(std::move(region_name)) {}
 
-        /* analysis helper */
-        bool dominates(const std::shared_ptr<const SproutRegion>& other) const;
-
-        std::shared_ptr<const SproutRegion> find_common_dominator(const std::shared_ptr<SproutRegion>& other) const;
-
-        /* setter */
-        void add_node(NodeRef node);
-
-        void add_child(const std::shared_ptr<SproutRegion>& child);
-
-        void remove_child(const std::shared_ptr<SproutRegion>& child);
-
-        void replace_nodes(std::vector<NodeRef> new_nodes);
-
-        void set_ctrl_deps(NodeRef control);
-
-        void set_imm_dominator(const std::shared_ptr<SproutRegion> &dom);
-
-        void set_type(RegionType t, uint32_t id = 0);
-
         const std::string& get_name() const
         {
             return name;
@@ -54,14 +42,14 @@ namespace sprk
             return nodes; 
         }
 
-        const std::vector<std::shared_ptr<SproutRegion>>& get_children() const 
+        const std::vector<RegionRef>& get_children() const 
         { 
             return children; 
         }
 
-        std::shared_ptr<SproutRegion> get_parent() const
+        RegionRef get_parent() const
         { 
-            return parent.lock(); 
+            return parent; 
         }
 
         NodeRef get_ctrl_dep() const
@@ -69,12 +57,12 @@ namespace sprk
             return ctrl_dep; 
         }
 
-        std::shared_ptr<SproutRegion> get_imm_dom() const 
+        RegionRef get_imm_dom() const 
         { 
-            return imm_dom.lock(); 
+            return imm_dom; 
         }
 
-        const std::vector<std::shared_ptr<SproutRegion>>& get_dom_regions() const 
+        const std::vector<RegionRef>& get_dom_regions() const 
         { 
             return dom_regions; 
         }
@@ -95,17 +83,20 @@ namespace sprk
         }
 
     private:
+        friend class SproutGraph;
+
         std::vector<NodeRef> nodes;
-        std::vector<std::shared_ptr<SproutRegion>> children;
-        std::vector<std::shared_ptr<SproutRegion>> dom_regions; /* dominance info */
+        std::vector<RegionRef> children;
+        std::vector<RegionRef> dom_regions; /* dominance info */
         std::string name;
-        std::weak_ptr<SproutRegion> parent;
-        std::weak_ptr<SproutRegion> imm_dom; /* dominance info */
+        RegionRef parent = NULL_REGION;
+        RegionRef imm_dom = NULL_REGION; /* dominance info */
         NodeRef ctrl_dep = NULL_REF;
 
         /* metadata */
         uint32_t type_id = 0;
         uint32_t region_depth = 0;
         RegionType type = RegionType::ROOT;
+        bool removed = false; /* unlinked by remove_region; dropped by compact */
     };
 }
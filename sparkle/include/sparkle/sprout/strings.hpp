@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+#include <vector>
+#include <sparkle/sprout/node.hpp>
+
+namespace sprk
+{
+	/*
+	 * module-wide string interner. every distinct name or string literal is
+	 * stored once, back to back in a single character pool, and handed out
+	 * as a dense 32-bit StringId; equal strings get equal ids, so comparing
+	 * names is an integer compare. id 0 is the empty string and stands for
+	 * "no name". everything is released at once with the table
+	 */
+	class StringTable
+	{
+	public:
+		StringTable();
+
+		/* returns the id of `str`, adding it on first sight */
+		StringId intern(std::string_view str);
+
+		/* the view is invalidated by the next intern() that adds a string */
+		[[nodiscard]] std::string_view view(const StringId id) const
+		{
+			const auto i = static_cast<uint32_t>(id);
+			return { pool.data() + offsets[i], offsets[i + 1] - offsets[i] };
+		}
+
+		/* number of distinct strings including the empty one */
+		[[nodiscard]] uint32_t size() const
+		{
+			return static_cast<uint32_t>(hashes.size());
+		}
+
+		/* bytes held by the character pool */
+		[[nodiscard]] size_t pool_size() const
+		{
+			return pool.size();
+		}
+
+	private:
+		static constexpr uint32_t EMPTY_SLOT = UINT32_MAX;
+
+		std::vector<char> pool;
+		std::vector<uint32_t> offsets; /* string i spans [offsets[i], offsets[i + 1]) */
+		std::vector<uint32_t> hashes;
+		std::vector<uint32_t> index; /* open addressing, linear probe; holds ids */
+
+		void grow_index();
+	};
+}
@@ -0,0 +1,263 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+namespace sprk
+{
+	/*
+	 * dense bit per index, typically a NodeRef. one 64-bit word covers 64
+	 * nodes, so a million-node graph fits in 128 KiB and membership is a
+	 * shift and a mask instead of a tree lookup
+	 */
+	class BitVector
+	{
+	public:
+		BitVector() = default;
+
+		explicit BitVector(const size_t size)
+		{
+			resize(size);
+		}
+
+		/* new bits start cleared */
+		void resize(const size_t size)
+		{
+			bit_count = size;
+			words.resize((size + 63) / 64, 0);
+
+			/* shrinking leaves stale bits past the end of the last word */
+			if (size % 64)
+				words.back() &= (uint64_t { 1 } << (size % 64)) - 1;
+		}
+
+		/* clears every bit and keeps the size */
+		void clear()
+		{
+			std::fill(words.begin(), words.end(), 0);
+		}
+
+		/* sets every bit below size() */
+		void set_all()
+		{
+			std::fill(words.begin(), words.end(), ~uint64_t { 0 });
+			if (bit_count % 64)
+				words.back() = (uint64_t { 1 } << (bit_count % 64)) - 1;
+		}
+
+		/* word-wise set operations; both sides must have the same size */
+		BitVector &operator&=(const BitVector &other)
+		{
+			for (size_t w = 0; w < words.size(); w++)
+				words[w] &= other.words[w];
+			return *this;
+		}
+
+		BitVector &operator|=(const BitVector &other)
+		{
+			for (size_t w = 0; w < words.size(); w++)
+				words[w] |= other.words[w];
+			return *this;
+		}
+
+		/* this &= ~other */
+		BitVector &subtract(const BitVector &other)
+		{
+			for (size_t w = 0; w < words.size(); w++)
+				words[w] &= ~other.words[w];
+			return *this;
+		}
+
+		[[nodiscard]] bool any() const
+		{
+			return std::any_of(words.begin(), words.end(), [](const uint64_t word) { return word != 0; });
+		}
+
+		[[nodiscard]] size_t size() const
+		{
+			return bit_count;
+		}
+
+		[[nodiscard]] bool test(const size_t i) const
+		{
+			return words[i / 64] >> (i % 64) & 1;
+		}
+
+		void set(const size_t i)
+		{
+			words[i / 64] |= uint64_t { 1 } << (i % 64);
+		}
+
+		void reset(const size_t i)
+		{
+			words[i / 64] &= ~(uint64_t { 1 } << (i % 64));
+		}
+
+		/* sets bit `i`; false if it was already set */
+		bool insert(const size_t i)
+		{
+			uint64_t &word = words[i / 64];
+			const uint64_t mask = uint64_t { 1 } << (i % 64);
+			if (word & mask)
+				return false;
+
+			word |= mask;
+			return true;
+		}
+
+		[[nodiscard]] size_t count() const
+		{
+			size_t total = 0;
+			for (const uint64_t word: words)
+				total += __builtin_popcountll(word);
+			return total;
+		}
+
+		/* calls fn(index) for every set bit in ascending order */
+		template<typename Fn>
+		void for_each(Fn &&fn) const
+		{
+			for (size_t w = 0; w < words.size(); w++)
+			{
+				for (uint64_t word = words[w]; word; word &= word - 1)
+					fn(w * 64 + __builtin_ctzll(word));
+			}
+		}
+
+		bool operator==(const BitVector &other) const
+		{
+			return bit_count == other.bit_count && words == other.words;
+		}
+
+		bool operator!=(const BitVector &other) const
+		{
+			return !(*this == other);
+		}
+
+	private:
+		std::vector<uint64_t> words;
+		size_t bit_count = 0;
+	};
+
+	/*
+	 * bits of an unbounded index space, stored as the non-zero 64-bit words
+	 * only, sorted by word index. a set of a few indices spread over a large
+	 * space costs a few words, and a union is one merge of the two lists
+	 */
+	class SparseBitVector
+	{
+	public:
+		[[nodiscard]] bool empty() const
+		{
+			return blocks.empty();
+		}
+
+		[[nodiscard]] bool test(const size_t i) const
+		{
+			const auto it = find(i / 64);
+			return it != blocks.end() && it->index == i / 64 && (it->bits >> (i % 64) & 1);
+		}
+
+		/* sets bit `i`; false if it was already set */
+		bool insert(const size_t i)
+		{
+			const uint64_t mask = uint64_t { 1 } << (i % 64);
+			const auto it = find(i / 64);
+			if (it == blocks.end() || it->index != i / 64)
+			{
+				blocks.insert(it, { i / 64, mask });
+				return true;
+			}
+
+			if (it->bits & mask)
+				return false;
+
+			it->bits |= mask;
+			return true;
+		}
+
+		/* this |= other; true if a bit was added */
+		bool union_with(const SparseBitVector &other)
+		{
+			std::vector<Block> merged;
+			merged.reserve(blocks.size() + other.blocks.size());
+
+			bool changed = false;
+			auto a = blocks.begin();
+			auto b = other.blocks.begin();
+			while (a != blocks.end() || b != other.blocks.end())
+			{
+				if (b == other.blocks.end() || (a != blocks.end() && a->index < b->index))
+				{
+					merged.push_back(*a++);
+				}
+				else if (a == blocks.end() || b->index < a->index)
+				{
+					merged.push_back(*b++);
+					changed = true;
+				}
+				else
+				{
+					changed |= (b->bits & ~a->bits) != 0;
+					merged.push_back({ a->index, a->bits | b->bits });
+					++a;
+					++b;
+				}
+			}
+
+			if (changed)
+				blocks = std::move(merged);
+			return changed;
+		}
+
+		[[nodiscard]] size_t count() const
+		{
+			size_t total = 0;
+			for (const Block &block: blocks)
+				total += __builtin_popcountll(block.bits);
+			return total;
+		}
+
+		/* calls fn(index) for every set bit in ascending order */
+		template<typename Fn>
+		void for_each(Fn &&fn) const
+		{
+			for (const Block &block: blocks)
+			{
+				for (uint64_t word = block.bits; word; word &= word - 1)
+					fn(block.index * 64 + __builtin_ctzll(word));
+			}
+		}
+
+		bool operator==(const SparseBitVector &other) const
+		{
+			return blocks.size() == other.blocks.size() &&
+			       std::equal(blocks.begin(), blocks.end(), other.blocks.begin(), [](const Block &a, const Block &b)
+			       {
+				       return a.index == b.index && a.bits == b.bits;
+			       });
+		}
+
+	private:
+		struct Block
+		{
+			size_t index;
+			uint64_t bits;
+		};
+
+		std::vector<Block> blocks;
+
+		std::vector<Block>::iterator find(const size_t index)
+		{
+			return std::lower_bound(blocks.begin(), blocks.end(), index,
+			                        [](const Block &block, const size_t i) { return block.index < i; });
+		}
+
+		[[nodiscard]] std::vector<Block>::const_iterator find(const size_t index) const
+		{
+			return std::lower_bound(blocks.begin(), blocks.end(), index,
+			                        [](const Block &block, const size_t i) { return block.index < i; });
+		}
+	};
+}
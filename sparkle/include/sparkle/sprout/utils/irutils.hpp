@@ -1,26 +1,58 @@
 #pragma once
 
-#include <memory>
 #include <vector>
+#include <sparkle/sprout/graph.hpp>
 #include <sparkle/sprout/node.hpp>
 #include <sparkle/sprout/region.hpp>
 
 namespace sprk
 {
-	std::shared_ptr<SproutRegion> find_function_region(NodeRef func_node,
-																const std::shared_ptr<SproutRegion> &root);
+	/*
+	 * a LOOP_BODY whose ctrl_dep is CONTROL(CMP(i, bound)), both in the loop
+	 * and read by nothing else, with i = PHI(init, i + step) in the loop and
+	 * init outside it. the loop runs while i < bound
+	 */
+	struct InductionLoop
+	{
+		NodeRef control = NULL_REF;
+		NodeRef compare = NULL_REF;
+		NodeRef induction = NULL_REF;
+		NodeRef init = NULL_REF;
+		NodeRef next = NULL_REF;  /* the ADD feeding the back edge */
+		NodeRef step = NULL_REF;  /* the other ADD operand */
+		NodeRef bound = NULL_REF;
+	};
 
-	std::shared_ptr<SproutRegion> find_node_region(NodeRef node_ref,
-														const std::shared_ptr<SproutRegion> &root);
+	/* fills `out` if `loop` has the shape above */
+	bool match_induction_loop(RegionRef loop,
+							  const SproutGraph& graph,
+							  InductionLoop& out);
+
+	/* the FUNCTION region that holds `func_node`, or NULL_REGION */
+	RegionRef find_function_region(NodeRef func_node,
+									const SproutGraph& graph);
+
+	RegionRef find_node_region(NodeRef node_ref,
+								const SproutGraph& graph);
 
 	std::vector<NodeRef> collect_function_params(NodeRef func_node,
-													  const std::vector<std::unique_ptr<SproutNode<>>> &nodes);
+													  const SproutGraph& graph);
 
 	std::vector<NodeRef> collect_function_returns(NodeRef func_node,
-													   const std::vector<std::unique_ptr<SproutNode<>>> &nodes);
+													   const SproutGraph& graph);
+
+	size_t function_size(NodeRef func_node,
+							const SproutGraph& graph);
+
+	/*
+	 * nodes a caller gains if `call_site` is inlined: the callee's body less
+	 * its boundary, RETs and PARAMs, minus the call, its CALL_PARAMs and the
+	 * index constants only they read. negative when inlining shrinks it
+	 */
+	int32_t inlining_growth(NodeRef call_site,
+							const SproutGraph& graph);
 
 	NodeRef clone_node(NodeRef orig_node,
-							std::vector<std::unique_ptr<SproutNode<>>> &nodes,
-							NodeRef &next_id,
+							SproutGraph& graph,
 							const std::string &suffix = "_inlined");
 }
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <cstdint>
+#include <iosfwd>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include <sparkle/sprout/graph.hpp>
+
+namespace sprk
+{
+	/* a profile's counts attached to the refs of one graph */
+	class ProfileCounts
+	{
+	public:
+		/*
+		 * the site's own count, or else that of the closest enclosing region
+		 * with one; 0 if neither was recorded or `call_site` is not a CALL
+		 */
+		[[nodiscard]] uint64_t call_count(NodeRef call_site, const SproutGraph &graph) const;
+
+		[[nodiscard]] uint64_t region_count(const RegionRef region) const
+		{
+			const auto it = region_counts.find(region);
+			return it == region_counts.end() ? 0 : it->second;
+		}
+
+		/* records that name a function or ordinal the graph does not have, as written */
+		[[nodiscard]] const std::vector<std::string> &get_stale() const
+		{
+			return stale;
+		}
+
+	private:
+		friend class ProfileData;
+
+		std::unordered_map<NodeRef, uint64_t> call_counts;
+		std::unordered_map<RegionRef, uint64_t> region_counts;
+		std::vector<std::string> stale;
+	};
+
+	/*
+	 * execution counts from an instrumented run. refs are renumbered by
+	 * compaction and differ between builds, so records are keyed by the
+	 * name of the function they are in and an ordinal inside it: a call
+	 * site by its place among the function's CALLs, and a region by its
+	 * place in a preorder walk of the function's regions, the FUNCTION
+	 * region being 0. both orders are the region walk: a region's own nodes,
+	 * then its children. the text form is one record per line, `#` starting
+	 * a comment, and the function name taking the rest of the line:
+	 *
+	 *	call <site> <count> <function>
+	 *	region <region> <count> <function>
+	 *
+	 * a record for the same key again adds to it, so the profiles of
+	 * several runs can be concatenated
+	 */
+	class ProfileData
+	{
+	public:
+		void add_call(const std::string &function, const uint32_t site, const uint64_t count)
+		{
+			call_counts[{ function, site }] += count;
+		}
+
+		void add_region(const std::string &function, const uint32_t region, const uint64_t count)
+		{
+			region_counts[{ function, region }] += count;
+		}
+
+		/* keyed from a node or region of `graph`; false if it is not inside a FUNCTION region */
+		bool add_call(const SproutGraph &graph, NodeRef call_site, uint64_t count);
+
+		bool add_region(const SproutGraph &graph, RegionRef region, uint64_t count);
+
+		/*
+		 * looks every record up in the module under `root`. records of a
+		 * function that is missing or whose name is not unique, or past its
+		 * last call or region, attach to nothing and are listed as stale
+		 */
+		[[nodiscard]] ProfileCounts bind(RegionRef root, const SproutGraph &graph) const;
+
+		[[nodiscard]] bool empty() const
+		{
+			return call_counts.empty() && region_counts.empty();
+		}
+
+		/* false at the first malformed line; the records before it are kept */
+		bool read(std::istream &in);
+
+		/* by function name, then ordinal, calls first */
+		void write(std::ostream &out) const;
+
+		bool load(const std::string &path);
+
+		bool save(const std::string &path) const;
+
+	private:
+		using Key = std::pair<std::string, uint32_t>;
+
+		std::map<Key, uint64_t> call_counts;
+		std::map<Key, uint64_t> region_counts;
+	};
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace sprk
+{
+	/*
+	 * fixed set of workers for batches of independent tasks. every batch is
+	 * dealt out in contiguous blocks, one queue per worker; a worker drains
+	 * its own queue from the back and steals from the front of the others
+	 * once it runs dry, so uneven task sizes still even out. the calling
+	 * thread takes part as worker 0
+	 */
+	class WorkStealingPool
+	{
+	public:
+		/* `workers` counts the caller; 0 picks the hardware concurrency */
+		explicit WorkStealingPool(unsigned workers = 0);
+
+		~WorkStealingPool();
+
+		WorkStealingPool(const WorkStealingPool &) = delete;
+		WorkStealingPool &operator=(const WorkStealingPool &) = delete;
+
+		[[nodiscard]] unsigned size() const
+		{
+			return static_cast<unsigned>(queues.size());
+		}
+
+		/* calls fn(task, worker) once for each task in [0, count) and waits for all of them */
+		void run(size_t count, const std::function<void(size_t, unsigned)> &fn);
+
+	private:
+		struct TaskQueue
+		{
+			std::mutex lock;
+			std::deque<size_t> tasks;
+		};
+
+		std::vector<std::unique_ptr<TaskQueue> > queues;
+		std::vector<std::thread> threads;
+
+		std::mutex lock;
+		std::condition_variable wake;
+		std::condition_variable done;
+		const std::function<void(size_t, unsigned)> *job = nullptr;
+		uint64_t generation = 0;
+		unsigned busy = 0;
+		bool stopping = false;
+
+		void worker_loop(unsigned worker);
+
+		void drain(unsigned worker);
+
+		bool next_task(unsigned worker, size_t &task);
+	};
+}
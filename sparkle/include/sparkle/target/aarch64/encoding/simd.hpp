@@ -13,4 +13,6 @@ namespace sprk::aarch64
     uint32_t encode_tbl(int rd, int rn, int rm, uint32_t len, bool is16b);
     uint32_t encode_dup_elem(int rd, int rn, uint32_t index, uint32_t arrangement);
     uint32_t encode_dup_gen(int rd, int rn, uint32_t arrangement);
+    uint32_t encode_ld1(int rt, int rn, uint32_t arrangement);
+    uint32_t encode_st1(int rt, int rn, uint32_t arrangement);
 }
\ No newline at end of file
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <vector>
+#include <sparkle/target/lowering.hpp>
+
+namespace sprk::aarch64
+{
+    /*
+     * lowers `loops`, in order, to A64 with 128-bit NEON for the vector
+     * nodes; live-ins arrive in x0-x7 and scratch values use x9-x17 and
+     * v0-v31. a loop falls through to the next one when it exits. false if
+     * a node has no lowering or the registers run out
+     */
+    bool lower_loops(const SproutGraph &graph, const std::vector<RegionRef> &loops, LoweredCode &out);
+
+    /* lowers a straight-line BASIC_BLOCK, such as one SLPVectorizePass packed, the same way */
+    bool lower_block(const SproutGraph &graph, RegionRef block, LoweredCode &out);
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include <sparkle/sprout/graph.hpp>
+
+/*
+ * lowering of the loops VectorizePass produces; there is no general
+ * instruction selection yet, so only the node types those loops use are
+ * handled. each target's lowering.hpp has a lower_loops for its encoders
+ */
+namespace sprk
+{
+    /* machine code for a run of loops and where its inputs are expected */
+    struct LoweredCode
+    {
+        std::vector<uint32_t> words;
+        std::vector<std::pair<NodeRef, int> > live_ins; /* value, argument register */
+    };
+
+    /* a region in the order the lowering walks it; a block has no compare or phis */
+    struct LoweringPlan
+    {
+        RegionRef region = NULL_REGION;
+        NodeRef compare = NULL_REF; /* a loop runs while compare's first input is below its second */
+        std::vector<NodeRef> phis;  /* (preheader value, next value) */
+        std::vector<NodeRef> body;  /* everything else but the CONTROL, in region order */
+
+        /* body index of a node's last read; body.size() if it is read on the back edge or after the loop */
+        std::unordered_map<NodeRef, size_t> last_use;
+    };
+
+    /* false unless `loop` is a LOOP_BODY on CONTROL(CMP) with two-input PHIs */
+    bool plan_loop(const SproutGraph &graph, RegionRef loop, LoweringPlan &out);
+
+    /* false unless `block` is a BASIC_BLOCK without child regions */
+    bool plan_block(const SproutGraph &graph, RegionRef block, LoweringPlan &out);
+
+    /* true for a 32-bit element: a PTR_LOAD, or ADD/SUB/MUL with one as an operand */
+    bool is_element(const SproutGraph &graph, NodeRef ref);
+
+    /* registers handed out lowest first */
+    class RegisterPool
+    {
+    public:
+        explicit RegisterPool(std::vector<int> registers) : free(std::move(registers)) {}
+
+        /* -1 once every register is taken */
+        int take()
+        {
+            if (free.empty())
+                return -1;
+
+            const int reg = free.front();
+            free.erase(free.begin());
+            touched.push_back(reg);
+            return reg;
+        }
+
+        /* the highest register take() never handed out, for a value live across all the code; -1 if none */
+        int take_untouched()
+        {
+            for (auto it = free.rbegin(); it != free.rend(); ++it)
+            {
+                if (std::find(touched.begin(), touched.end(), *it) == touched.end())
+                {
+                    const int reg = *it;
+                    free.erase(std::next(it).base());
+                    return reg;
+                }
+            }
+            return -1;
+        }
+
+        void give(const int reg)
+        {
+            free.insert(std::upper_bound(free.begin(), free.end(), reg), reg);
+        }
+
+    private:
+        std::vector<int> free;
+        std::vector<int> touched;
+    };
+}
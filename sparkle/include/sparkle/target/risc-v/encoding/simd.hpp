@@ -21,4 +21,7 @@ namespace sprk::riscv
 
     /* Vector Floating-point Add, Vector-Vector */
     uint32_t encode_vfadd_vv(int vd, int vs1, int vs2, bool mask_used);
-}
+
+    /* Vector Integer Move, scalar to every element */
+    uint32_t encode_vmv_v_x(int vd, int rs1);
+}
\ No newline at end of file
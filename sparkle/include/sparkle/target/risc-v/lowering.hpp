@@ -0,0 +1,16 @@
+#pragma once
+
+#include <vector>
+#include <sparkle/target/lowering.hpp>
+
+namespace sprk::riscv
+{
+    /*
+     * lowers `loops`, in order, to RV64IM with RVV 1.0 for the vector nodes,
+     * each VECTOR_SETVL a vsetvli of e32, m1; live-ins arrive in a0-a7 and
+     * scratch values use t0-t6 and v1-v31. a loop falls through to the next
+     * one when it exits. false if a node has no lowering or the registers
+     * run out
+     */
+    bool lower_loops(const SproutGraph &graph, const std::vector<RegionRef> &loops, LoweredCode &out);
+}
@@ -0,0 +1,110 @@
+#include <algorithm>
+#include <sparkle/sprout/domtree.hpp>
+#include <sparkle/sprout/graph.hpp>
+
+namespace sprk
+{
+	void DominatorTree::build(const SproutGraph &graph)
+	{
+		const RegionRef count = graph.region_count();
+		pre.assign(count, UNVISITED);
+		post.assign(count, UNVISITED);
+		depths.assign(count, 0);
+
+		/* children in CSR form, straight from the imm_dom links */
+		std::vector<uint32_t> first(count + 1, 0);
+		for (RegionRef r = 0; r < count; r++)
+		{
+			if (const RegionRef dom = graph.region(r).get_imm_dom(); dom != NULL_REGION)
+				first[dom + 1]++;
+		}
+
+		for (RegionRef r = 0; r < count; r++)
+			first[r + 1] += first[r];
+
+		std::vector<RegionRef> children(first[count]);
+		std::vector<uint32_t> fill(first.begin(), first.end() - 1);
+		for (RegionRef r = 0; r < count; r++)
+		{
+			if (const RegionRef dom = graph.region(r).get_imm_dom(); dom != NULL_REGION)
+				children[fill[dom]++] = r;
+		}
+
+		/* iterative DFS from every root; a region is closed once its children are */
+		uint32_t clock = 0;
+		uint32_t max_depth = 0;
+		std::vector<std::pair<RegionRef, uint32_t> > stack; /* region, next child slot */
+		for (RegionRef root = 0; root < count; root++)
+		{
+			if (graph.region(root).get_imm_dom() != NULL_REGION)
+				continue;
+
+			pre[root] = clock++;
+			stack.emplace_back(root, first[root]);
+			while (!stack.empty())
+			{
+				auto &[region, next] = stack.back();
+				if (next == first[region + 1])
+				{
+					post[region] = clock++;
+					stack.pop_back();
+					continue;
+				}
+
+				const RegionRef child = children[next++];
+				depths[child] = depths[region] + 1;
+				max_depth = std::max(max_depth, depths[child]);
+				pre[child] = clock++;
+				stack.emplace_back(child, first[child]);
+			}
+		}
+
+		levels = 1;
+		while ((1u << levels) <= max_depth)
+			levels++;
+
+		/* regions on an imm_dom cycle are never visited and keep no ancestors */
+		up.assign(static_cast<size_t>(levels) * count, NULL_REGION);
+		for (RegionRef r = 0; r < count; r++)
+		{
+			if (pre[r] != UNVISITED)
+				up[r] = graph.region(r).get_imm_dom();
+		}
+
+		for (uint32_t k = 1; k < levels; k++)
+		{
+			for (RegionRef r = 0; r < count; r++)
+			{
+				if (const RegionRef mid = ancestor(k - 1, r); mid != NULL_REGION)
+					up[k * count + r] = ancestor(k - 1, mid);
+			}
+		}
+	}
+
+	RegionRef DominatorTree::lca(RegionRef a, const RegionRef b) const
+	{
+		if (a == NULL_REGION)
+			return b;
+
+		if (b == NULL_REGION)
+			return a;
+
+		if (a >= pre.size() || b >= pre.size() || pre[a] == UNVISITED || pre[b] == UNVISITED)
+			return NULL_REGION;
+
+		if (dominates(a, b))
+			return a;
+
+		if (dominates(b, a))
+			return b;
+
+		/* climb from `a` to the highest ancestor that still does not cover `b` */
+		for (uint32_t k = levels; k-- > 0;)
+		{
+			if (const RegionRef next = ancestor(k, a); next != NULL_REGION && !dominates(next, b))
+				a = next;
+		}
+
+		return ancestor(0, a);
+	}
+}
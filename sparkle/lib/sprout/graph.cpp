@@ -0,0 +1,316 @@
+#include <algorithm>
+#include <sparkle/sprout/graph.hpp>
+
+namespace sprk
+{
+	namespace
+	{
+		constexpr uint32_t MIN_EDGE_BLOCK = 2;
+
+		uint32_t block_class(const uint32_t capacity)
+		{
+			uint32_t cls = 0;
+			while ((MIN_EDGE_BLOCK << cls) < capacity)
+				cls++;
+			return cls;
+		}
+	}
+
+	void SproutGraph::EdgePool::push(EdgeList &list, const NodeRef value)
+	{
+		if (list.count == list.capacity)
+		{
+			const uint32_t capacity = list.capacity ? list.capacity * 2 : MIN_EDGE_BLOCK;
+			const uint32_t cls = block_class(capacity);
+			if (cls >= free_blocks.size())
+				free_blocks.resize(cls + 1);
+
+			uint32_t offset;
+			if (!free_blocks[cls].empty())
+			{
+				offset = free_blocks[cls].back();
+				free_blocks[cls].pop_back();
+			}
+			else
+			{
+				offset = static_cast<uint32_t>(slots.size());
+				slots.resize(slots.size() + capacity, NULL_REF);
+			}
+
+			const uint32_t count = list.count;
+			std::copy_n(slots.begin() + list.offset, count, slots.begin() + offset);
+			release(list);
+			list = { offset, count, capacity };
+		}
+
+		slots[list.offset + list.count++] = value;
+	}
+
+	void SproutGraph::EdgePool::release(EdgeList &list)
+	{
+		if (list.capacity)
+		{
+			/* blocks handed out by assign() may be of a class this pool never grew into */
+			const uint32_t cls = block_class(list.capacity);
+			if (cls >= free_blocks.size())
+				free_blocks.resize(cls + 1);
+			free_blocks[cls].push_back(list.offset);
+		}
+
+		list = {};
+	}
+
+	void SproutGraph::EdgePool::assign(EdgeList &list, const NodeRef *first, const uint32_t count)
+	{
+		if (count == 0)
+			return;
+
+		const uint32_t capacity = MIN_EDGE_BLOCK << block_class(count);
+		const auto offset = static_cast<uint32_t>(slots.size());
+		slots.resize(slots.size() + capacity, NULL_REF);
+		std::copy_n(first, count, slots.begin() + offset);
+		list = { offset, count, capacity };
+	}
+
+	NodeRef SproutGraph::create(const NodeType type)
+	{
+		const NodeRef ref = size();
+		types.push_back(type);
+		input_lists.emplace_back();
+		user_lists.emplace_back();
+		flag_col.push_back(0);
+		fn_refs.push_back(NULL_REF);
+		mem_objs.push_back(NULL_REF);
+
+		values.emplace_back();
+		string_ids.push_back(NULL_STRING);
+		results.push_back(0);
+		node_regions.push_back(NULL_REGION);
+		return ref;
+	}
+
+	void SproutGraph::remove(const NodeRef ref)
+	{
+		if (!contains(ref))
+			return;
+
+		/* drop the def-use entries that point at this node */
+		for (const NodeRef input: inputs(ref))
+		{
+			if (contains(input))
+				remove_user(input, ref);
+		}
+
+		values[ref] = {};
+		node_regions[ref] = NULL_REGION;
+		input_pool.release(input_lists[ref]);
+		user_pool.release(user_lists[ref]);
+		flag_col[ref] |= NODE_REMOVED;
+		removed++;
+	}
+
+	void SproutGraph::reserve(const size_t count)
+	{
+		types.reserve(count);
+		input_lists.reserve(count);
+		user_lists.reserve(count);
+		input_pool.slots.reserve(count * MIN_EDGE_BLOCK);
+		user_pool.slots.reserve(count * MIN_EDGE_BLOCK);
+		flag_col.reserve(count);
+		fn_refs.reserve(count);
+		mem_objs.reserve(count);
+		values.reserve(count);
+		string_ids.reserve(count);
+		results.reserve(count);
+		node_regions.reserve(count);
+	}
+
+	GraphRemap SproutGraph::compact()
+	{
+		GraphRemap remap;
+		remap.nodes.assign(size(), NULL_REF);
+		remap.regions.assign(regions.size(), NULL_REGION);
+
+		NodeRef live = 0;
+		for (NodeRef i = 0; i < size(); i++)
+		{
+			if (contains(i))
+				remap.nodes[i] = live++;
+		}
+
+		RegionRef kept = 0;
+		for (RegionRef r = 0; r < regions.size(); r++)
+		{
+			if (!regions[r].removed)
+				remap.regions[r] = kept++;
+		}
+
+		/* slide the columns down; new index <= old index, so in place is safe */
+		EdgePool new_inputs, new_users;
+		std::vector<EdgeList> new_input_lists(live), new_user_lists(live);
+		std::vector<NodeRef> buffer;
+		for (NodeRef i = 0; i < size(); i++)
+		{
+			const NodeRef to = remap.nodes[i];
+			if (to == NULL_REF)
+				continue;
+
+			/* input slots keep their position so operand order survives */
+			buffer.clear();
+			for (const NodeRef input: inputs(i))
+				buffer.push_back(remap.node(input));
+			new_inputs.assign(new_input_lists[to], buffer.data(), static_cast<uint32_t>(buffer.size()));
+
+			buffer.clear();
+			for (const NodeRef user: users(i))
+			{
+				if (const NodeRef mapped = remap.node(user); mapped != NULL_REF)
+					buffer.push_back(mapped);
+			}
+			new_users.assign(new_user_lists[to], buffer.data(), static_cast<uint32_t>(buffer.size()));
+
+			types[to] = types[i];
+			flag_col[to] = flag_col[i];
+			fn_refs[to] = remap.node(fn_refs[i]);
+			mem_objs[to] = remap.node(mem_objs[i]);
+			if (to != i)
+				values[to] = std::move(values[i]);
+			if (const auto *ref = std::get_if<NodeRef>(&values[to]))
+				values[to] = remap.node(*ref);
+			string_ids[to] = string_ids[i];
+			results[to] = results[i];
+			node_regions[to] = remap.region(node_regions[i]);
+		}
+
+		types.resize(live);
+		flag_col.resize(live);
+		fn_refs.resize(live);
+		mem_objs.resize(live);
+		values.resize(live);
+		string_ids.resize(live);
+		results.resize(live);
+		node_regions.resize(live);
+		input_lists = std::move(new_input_lists);
+		user_lists = std::move(new_user_lists);
+		input_pool = std::move(new_inputs);
+		user_pool = std::move(new_users);
+		removed = 0;
+
+		const auto remap_nodes = [&remap](std::vector<NodeRef> &list)
+		{
+			std::vector<NodeRef> out;
+			out.reserve(list.size());
+			for (const NodeRef ref: list)
+			{
+				if (const NodeRef mapped = remap.node(ref); mapped != NULL_REF)
+					out.push_back(mapped);
+			}
+			list = std::move(out);
+		};
+
+		const auto remap_regions = [&remap](std::vector<RegionRef> &list)
+		{
+			std::vector<RegionRef> out;
+			out.reserve(list.size());
+			for (const RegionRef ref: list)
+			{
+				if (const RegionRef mapped = remap.region(ref); mapped != NULL_REGION)
+					out.push_back(mapped);
+			}
+			list = std::move(out);
+		};
+
+		for (RegionRef r = 0; r < regions.size(); r++)
+		{
+			const RegionRef to = remap.regions[r];
+			if (to == NULL_REGION)
+				continue;
+
+			SproutRegion &region = regions[r];
+			remap_nodes(region.nodes);
+			remap_regions(region.children);
+			remap_regions(region.dom_regions);
+			region.parent = remap.region(region.parent);
+			region.imm_dom = remap.region(region.imm_dom);
+			region.ctrl_dep = remap.node(region.ctrl_dep);
+			if (to != r)
+				regions[to] = std::move(region);
+		}
+
+		regions.erase(regions.begin() + kept, regions.end());
+		dom_stale = true;
+		return remap;
+	}
+
+	void SproutGraph::add_input(const NodeRef ref, const NodeRef input)
+	{
+		input_pool.push(input_lists[ref], input);
+		if (contains(input))
+			add_user(input, ref);
+	}
+
+	void SproutGraph::set_input(const NodeRef ref, const uint32_t index, const NodeRef input)
+	{
+		NodeRef &slot = input_pool.slots[input_lists[ref].offset + index];
+		if (slot == input)
+			return;
+
+		if (contains(slot))
+			remove_user(slot, ref);
+
+		slot = input;
+		if (contains(input))
+			add_user(input, ref);
+	}
+
+	void SproutGraph::remove_user(const NodeRef ref, const NodeRef user)
+	{
+		EdgeList &list = user_lists[ref];
+		NodeRef *first = user_pool.data() + list.offset;
+		NodeRef *last = first + list.count;
+
+		/* keep the order stable; dumps print users in insertion order */
+		if (NodeRef *it = std::find(first, last, user); it != last)
+		{
+			std::copy(it + 1, last, it);
+			list.count--;
+		}
+	}
+
+	void SproutGraph::replace_all_uses(const NodeRef from, const NodeRef to)
+	{
+		if (from == to || !contains(from))
+			return;
+
+		/*
+		 * each user entry stands for one input slot, so rewriting the first
+		 * slot that still reads `from` per entry visits every use once. the
+		 * user list of `from` is dropped in one go instead of entry by entry
+		 */
+		EdgeList &from_users = user_lists[from];
+		for (uint32_t u = 0; u < from_users.count; u++)
+		{
+			const NodeRef user = user_pool.slots[from_users.offset + u];
+			const EdgeList &list = input_lists[user];
+			NodeRef *slots = input_pool.data() + list.offset;
+			for (uint32_t i = 0; i < list.count; i++)
+			{
+				if (slots[i] == from)
+				{
+					slots[i] = to;
+					break;
+				}
+			}
+
+			if (contains(to))
+				add_user(to, user);
+		}
+
+		from_users.count = 0;
+	}
+
+	void SproutGraph::add_user(const NodeRef ref, const NodeRef user)
+	{
+		user_pool.push(user_lists[ref], user);
+	}
+}
@@ -1,5 +1,6 @@
 #include <algorithm>
 #include <iostream>
+#include <unordered_map>
 #include <sparkle/sprout/passes/aa.hpp>
 #include <sparkle/sprout/utils/dump.hpp>
 
@@ -33,119 +34,369 @@ namespace sprk
 		}
 	}
 
-	void AliasAnalysisPass::run(const std::shared_ptr<SproutRegion> &root,
-	                            std::vector<std::unique_ptr<SproutNode<> > > &nodes)
+	void AliasAnalysisPass::run(const RegionRef root, SproutGraph &graph)
 	{
-		memory_operations.clear();
 		points_to_map.clear();
 		alias_groups.clear();
 		issues.clear();
 
-		/* 1st pass: collect all memory operation */
-		for (size_t i = 0; i < nodes.size(); i++)
+		/* 1st pass: points-to sets of every value */
+		locations.clear();
+		location_ids.clear();
+		object_fields.clear();
+		value_locations.assign(graph.size(), {});
+		unknown_values = BitVector(graph.size());
+
+		if (mode == AliasMode::STEENSGAARD)
+			solve_steensgaard(graph);
+		else
+			solve_andersen(graph);
+
+		/* pass 2: the objects behind each location set; unknown pointers keep an empty one */
+		for (NodeRef i = 0; i < graph.size(); i++)
 		{
-			if (!nodes[i])
+			if (!graph.contains(i) || unknown_values.test(i) || value_locations[i].empty())
 				continue;
 
-			/* track alloc node */
-			if (nodes[i]->type == NodeType::MALLOC ||
-			    nodes[i]->type == NodeType::ADDR_OF)
+			std::set<NodeRef> &objects = points_to_map[i];
+			value_locations[i].for_each([&](const size_t id) { objects.insert(locations[id].object); });
+		}
+
+		/* 3rd pass: compute alias group */
+		std::map<NodeRef, std::set<NodeRef> > target_to_pointers;
+
+		/* invert the points-to relation */
+		/* for each target, find all pointers to it */
+		for (const auto &[ptr_node, targets]: points_to_map)
+		{
+			for (NodeRef target: targets)
+				target_to_pointers[target].insert(ptr_node);
+		}
+
+		/* create an alias group of all pointers per target */
+		for (const auto &[target, pointers]: target_to_pointers)
+		{
+			if (pointers.size() > 1)
+				alias_groups.push_back(pointers);
+		}
+
+		/* 4th pass: detect all memory issues */
+		detect_memory_issues(root, graph);
+	}
+
+	namespace
+	{
+		/* values whose points-to set the analysis derives; the rest may point anywhere, except constants */
+		bool is_modeled(const NodeType type)
+		{
+			switch (type)
 			{
-				memory_operations[i] = {};
+				case NodeType::CONST:
+				case NodeType::MALLOC:
+				case NodeType::STACK_ALLOC:
+				case NodeType::ADDR_OF:
+				case NodeType::PHI:
+				case NodeType::PTR_ADD:
+				case NodeType::REINTERPRET_CAST:
+				case NodeType::LOAD:
+				case NodeType::PTR_LOAD:
+					return true;
+				default:
+					return false;
 			}
+		}
 
-			/* track operation on memobj */
-			if (nodes[i]->mem_obj != NULL_REF)
-				memory_operations[nodes[i]->mem_obj].push_back(i);
+		/* the arguments a call hands to code the analysis cannot follow */
+		template<typename Fn>
+		void for_each_argument(const SproutGraph &graph, const NodeRef call, Fn &&fn)
+		{
+			const NodeSpan inputs = graph.inputs(call);
+			for (uint32_t i = 1; i < inputs.size(); i++)
+			{
+				const NodeRef input = inputs[i];
+				if (graph.contains(input) && graph.type(input) == NodeType::CALL_PARAM)
+				{
+					if (graph.inputs(input).size() >= 2)
+						fn(graph.inputs(input)[1]);
+				}
+				else
+				{
+					fn(input);
+				}
+			}
+		}
+	}
+
+	uint32_t AliasAnalysisPass::location_of(const NodeRef object, int64_t offset)
+	{
+		std::vector<uint32_t> &fields = object_fields[object];
+		if (offset != MemoryLocation::ANY_OFFSET && fields.size() >= MAX_FIELDS &&
+		    !location_ids.count({ object, offset }))
+		{
+			offset = MemoryLocation::ANY_OFFSET;
 		}
 
-		/* pass 2: init p2info */
-		for (size_t i = 0; i < nodes.size(); i++)
+		const auto [it, fresh] = location_ids.try_emplace({ object, offset }, static_cast<uint32_t>(locations.size()));
+		if (fresh)
 		{
-			if (!nodes[i])
-				continue;
+			locations.push_back({ object, offset });
+			fields.push_back(it->second);
+		}
 
-			switch (nodes[i]->type)
+		return it->second;
+	}
+
+	int64_t AliasAnalysisPass::offset_of(const NodeRef ptr_add, const SproutGraph &graph)
+	{
+		const NodeSpan inputs = graph.inputs(ptr_add);
+		if (inputs.size() < 2 || !graph.contains(inputs[1]) || graph.type(inputs[1]) != NodeType::CONST ||
+		    !std::holds_alternative<int64_t>(graph.value(inputs[1])))
+		{
+			return MemoryLocation::ANY_OFFSET;
+		}
+
+		return std::get<int64_t>(graph.value(inputs[1]));
+	}
+
+	void AliasAnalysisPass::solve_andersen(const SproutGraph &graph)
+	{
+		std::vector<SparseBitVector> &pts = value_locations;
+		std::vector<SparseBitVector> contents;         /* per location: what was stored there */
+		std::vector<bool> unknown_contents;            /* per location: something unknown may be stored there */
+		std::set<NodeRef> escaped;
+		std::map<NodeRef, std::set<NodeRef> > readers; /* object -> loads whose address may reach it */
+
+		std::vector<NodeRef> worklist;
+		BitVector queued(graph.size());
+		const auto push = [&](const NodeRef ref)
+		{
+			if (queued.insert(ref))
+				worklist.push_back(ref);
+		};
+
+		/* locations appear while solving; an escaped object's new fields start out unknown */
+		const auto field = [&](const NodeRef object, const int64_t offset)
+		{
+			const uint32_t id = location_of(object, offset);
+			while (contents.size() < locations.size())
+			{
+				contents.emplace_back();
+				unknown_contents.push_back(escaped.count(locations[contents.size() - 1].object) > 0);
+			}
+			return id;
+		};
+
+		const auto flow = [&](const NodeRef from, const NodeRef to)
+		{
+			bool changed = pts[to].union_with(pts[from]);
+			if (unknown_values.test(from))
+				changed |= unknown_values.insert(to);
+			if (changed)
+				push(to);
+		};
+
+		const auto evaluate_load = [&](const NodeRef load)
+		{
+			const NodeRef address = graph.inputs(load)[0];
+			bool changed = unknown_values.test(address) && unknown_values.insert(load);
+
+			/* copy; reading may not add fields, but stay safe against the vector moving */
+			const SparseBitVector reached = pts[address];
+			reached.for_each([&](const size_t id)
 			{
-				case NodeType::ADDR_OF: /* &var -> points to var */
+				const MemoryLocation read = locations[id];
+				readers[read.object].insert(load);
+				for (const uint32_t other: object_fields[read.object])
 				{
-					if (nodes[i]->input_count > 0)
-					{
-						NodeRef target_var = nodes[i]->inputs[0];
-						points_to_map[i].insert(target_var);
-					}
-					break;
+					const int64_t offset = locations[other].offset;
+					if (read.offset != MemoryLocation::ANY_OFFSET && offset != MemoryLocation::ANY_OFFSET &&
+					    offset != read.offset)
+						continue;
+
+					changed |= pts[load].union_with(contents[other]);
+					if (unknown_contents[other])
+						changed |= unknown_values.insert(load);
 				}
+			});
 
-				case NodeType::MALLOC: /* malloc() -> points to itself */
+			if (changed)
+				push(load);
+		};
+
+		const auto notify = [&](const NodeRef object)
+		{
+			if (const auto it = readers.find(object); it != readers.end())
+			{
+				/* copy; evaluating registers readers */
+				const std::vector<NodeRef> loads(it->second.begin(), it->second.end());
+				for (const NodeRef load: loads)
+					evaluate_load(load);
+			}
+		};
+
+		/* unknown code may read an escaped object and write anything into it */
+		const auto escape = [&](const SparseBitVector &from)
+		{
+			std::vector<NodeRef> pending;
+			from.for_each([&](const size_t id) { pending.push_back(locations[id].object); });
+			while (!pending.empty())
+			{
+				const NodeRef object = pending.back();
+				pending.pop_back();
+				if (!escaped.insert(object).second)
+					continue;
+
+				for (const uint32_t id: object_fields[object])
 				{
-					points_to_map[i].insert(i);
-					break;
+					unknown_contents[id] = true;
+					contents[id].for_each([&](const size_t inner) { pending.push_back(locations[inner].object); });
 				}
-
-				default:
-					break;
+				notify(object);
 			}
-		}
+		};
 
-		/* pass 3: propagate p2info */
-		/* note: this is a fixed-point algorithm; improve later ig */
-		auto changed = true;
-		while (changed)
+		const auto evaluate_store = [&](const NodeRef store)
 		{
-			changed = false;
+			const NodeSpan inputs = graph.inputs(store);
+			if (inputs.size() < 2)
+				return;
 
-			for (size_t i = 0; i < nodes.size(); i++)
+			const NodeRef address = inputs[0];
+			const NodeRef value = inputs[1];
+			if (unknown_values.test(address))
+				escape(pts[value]);
+
+			const SparseBitVector reached = pts[address];
+			reached.for_each([&](const size_t id)
 			{
-				if (!nodes[i])
-					continue;
+				bool changed = contents[id].union_with(pts[value]);
+				if (unknown_values.test(value) && !unknown_contents[id])
+				{
+					unknown_contents[id] = true;
+					changed = true;
+				}
+
+				if (escaped.count(locations[id].object))
+					escape(pts[value]);
+				if (changed)
+					notify(locations[id].object);
+			});
+		};
 
-				std::set<NodeRef> old_points_to = points_to_map[i];
-				switch (nodes[i]->type)
+		/* a vector store writes several fields with values that are not pointers */
+		const auto evaluate_vector_store = [&](const NodeRef store)
+		{
+			const SparseBitVector reached = pts[graph.inputs(store)[0]];
+			reached.for_each([&](const size_t id)
+			{
+				const uint32_t any = field(locations[id].object, MemoryLocation::ANY_OFFSET);
+				if (!unknown_contents[any])
 				{
-					case NodeType::PHI: /* merge points-to sets of all ins */
+					unknown_contents[any] = true;
+					notify(locations[any].object);
+				}
+			});
+		};
+
+		for (NodeRef i = 0; i < graph.size(); i++)
+		{
+			if (!graph.contains(i))
+				continue;
+
+			const NodeType type = graph.type(i);
+			if (type == NodeType::MALLOC || type == NodeType::STACK_ALLOC)
+				pts[i].insert(field(i, 0));
+			else if (type == NodeType::ADDR_OF && !graph.inputs(i).empty())
+				pts[i].insert(field(graph.inputs(i)[0], 0));
+			else if (!is_modeled(type))
+				unknown_values.insert(i);
+			else
+				continue;
+
+			push(i);
+		}
+
+		while (!worklist.empty())
+		{
+			const NodeRef value = worklist.back();
+			worklist.pop_back();
+			queued.reset(value);
+
+			for (const NodeRef user: graph.users(value))
+			{
+				const NodeSpan inputs = graph.inputs(user);
+				switch (graph.type(user))
+				{
+					case NodeType::PHI:
 					{
-						for (uint8_t j = 0; j < nodes[i]->input_count; j++)
-						{
-							NodeRef input = nodes[i]->inputs[j];
-							const auto &input_points_to = points_to_map[input];
-							for (NodeRef target: input_points_to)
-							{
-								if (points_to_map[i].insert(target).second)
-									changed = true;
-							}
-						}
+						/* the control input names the branch; it is not an arm */
+						if (graph.type(value) != NodeType::CONTROL)
+							flow(value, user);
 						break;
 					}
 
-					case NodeType::PTR_ADD: /* ptr math: p + offset; first in is the pointer */
+					case NodeType::REINTERPRET_CAST:
 					{
-						if (nodes[i]->input_count > 0)
-						{
-							NodeRef ptr_input = nodes[i]->inputs[0];
-							const auto &input_points_to = points_to_map[ptr_input];
-
-							for (NodeRef target: input_points_to)
-							{
-								if (points_to_map[i].insert(target).second)
-									changed = true;
-							}
-						}
+						if (inputs[0] == value)
+							flow(value, user);
 						break;
 					}
 
-					case NodeType::REINTERPRET_CAST: /* ptr casting */
+					case NodeType::PTR_ADD:
 					{
-						if (nodes[i]->input_count > 0)
+						if (inputs[0] != value)
+							break;
+
+						const int64_t step = offset_of(user, graph);
+						bool changed = unknown_values.test(value) && unknown_values.insert(user);
+
+						const SparseBitVector reached = pts[value];
+						reached.for_each([&](const size_t id)
 						{
-							NodeRef ptr_input = nodes[i]->inputs[0];
-							const auto &input_points_to = points_to_map[ptr_input];
-							for (NodeRef target: input_points_to)
-							{
-								if (points_to_map[i].insert(target).second)
-									changed = true;
-							}
-						}
+							const MemoryLocation from = locations[id];
+							const int64_t offset = from.offset == MemoryLocation::ANY_OFFSET ||
+							                       step == MemoryLocation::ANY_OFFSET
+								                       ? MemoryLocation::ANY_OFFSET
+								                       : from.offset + step;
+							changed |= pts[user].insert(field(from.object, offset));
+						});
+
+						if (changed)
+							push(user);
+						break;
+					}
+
+					case NodeType::LOAD:
+					case NodeType::PTR_LOAD:
+					{
+						if (inputs[0] == value)
+							evaluate_load(user);
+						break;
+					}
+
+					case NodeType::STORE:
+					case NodeType::PTR_STORE:
+						evaluate_store(user);
+						break;
+
+					case NodeType::VECTOR_STORE:
+					{
+						if (inputs[0] == value)
+							evaluate_vector_store(user);
+						break;
+					}
+
+					case NodeType::CALL_PARAM:
+					{
+						if (inputs.size() >= 2 && inputs[1] == value)
+							escape(pts[value]);
+						break;
+					}
+
+					case NodeType::CALL:
+					{
+						if (inputs[0] != value)
+							escape(pts[value]);
 						break;
 					}
 
@@ -154,192 +405,551 @@ namespace sprk
 				}
 			}
 		}
+	}
 
-		/* 4th pass: compute alias group */
-		std::map<NodeRef, std::set<NodeRef> > target_to_pointers;
+	void AliasAnalysisPass::solve_steensgaard(const SproutGraph &graph)
+	{
+		constexpr uint32_t NONE = UINT32_MAX;
 
-		/* invert the points-to relation */
-		/* for each target, find all pointers to it */
-		for (const auto &[ptr_node, targets]: points_to_map)
+		/* one element per value, then one per object; a class has at most one class it points to */
+		std::vector<uint32_t> parent;
+		std::vector<uint32_t> pointee;
+		std::vector<bool> unknown; /* on the class of targets: it may hold memory the analysis cannot see */
+
+		const auto make = [&]
 		{
-			for (NodeRef target: targets)
-				target_to_pointers[target].insert(ptr_node);
+			parent.push_back(static_cast<uint32_t>(parent.size()));
+			pointee.push_back(NONE);
+			unknown.push_back(false);
+			return parent.back();
+		};
+
+		const auto find = [&](uint32_t e)
+		{
+			while (parent[e] != e)
+			{
+				parent[e] = parent[parent[e]];
+				e = parent[e];
+			}
+			return e;
+		};
+
+		const auto join = [&](const uint32_t a, const uint32_t b)
+		{
+			std::vector<std::pair<uint32_t, uint32_t> > pending = { { a, b } };
+			while (!pending.empty())
+			{
+				const uint32_t x = find(pending.back().first);
+				const uint32_t y = find(pending.back().second);
+				pending.pop_back();
+				if (x == y)
+					continue;
+
+				/* merging two classes merges what they point to */
+				parent[y] = x;
+				unknown[x] = unknown[x] || unknown[y];
+				if (pointee[x] == NONE)
+					pointee[x] = pointee[y];
+				else if (pointee[y] != NONE)
+					pending.emplace_back(pointee[x], pointee[y]);
+			}
+		};
+
+		const auto target = [&](const uint32_t e)
+		{
+			if (pointee[find(e)] == NONE)
+			{
+				const uint32_t fresh = make();
+				pointee[find(e)] = fresh;
+			}
+			return find(pointee[find(e)]);
+		};
+
+		for (NodeRef i = 0; i < graph.size(); i++)
+			make();
+
+		std::map<NodeRef, uint32_t> objects;
+		const auto object = [&](const NodeRef ref)
+		{
+			const auto [it, fresh] = objects.try_emplace(ref, 0);
+			if (fresh)
+				it->second = make();
+			return it->second;
+		};
+
+		std::vector<std::pair<NodeRef, NodeRef> > stores;
+		std::vector<NodeRef> arguments;
+		for (NodeRef i = 0; i < graph.size(); i++)
+		{
+			if (!graph.contains(i))
+				continue;
+
+			const NodeSpan inputs = graph.inputs(i);
+			switch (graph.type(i))
+			{
+				case NodeType::MALLOC:
+				case NodeType::STACK_ALLOC:
+					join(target(i), object(i));
+					break;
+				case NodeType::ADDR_OF:
+				{
+					if (!inputs.empty())
+						join(target(i), object(inputs[0]));
+					break;
+				}
+				case NodeType::PHI:
+				{
+					for (const NodeRef input: inputs)
+					{
+						if (graph.contains(input) && graph.type(input) != NodeType::CONTROL)
+							join(target(i), target(input));
+					}
+					break;
+				}
+				case NodeType::PTR_ADD:
+				case NodeType::REINTERPRET_CAST:
+				{
+					if (!inputs.empty())
+						join(target(i), target(inputs[0]));
+					break;
+				}
+				case NodeType::LOAD:
+				case NodeType::PTR_LOAD:
+				{
+					if (!inputs.empty())
+						join(target(i), target(target(inputs[0])));
+					break;
+				}
+				case NodeType::STORE:
+				case NodeType::PTR_STORE:
+				{
+					if (inputs.size() >= 2)
+					{
+						join(target(target(inputs[0])), target(inputs[1]));
+						stores.emplace_back(inputs[0], inputs[1]);
+					}
+					break;
+				}
+				case NodeType::VECTOR_STORE:
+				{
+					if (!inputs.empty())
+						unknown[target(target(inputs[0]))] = true;
+					break;
+				}
+				case NodeType::CALL:
+					for_each_argument(graph, i, [&](const NodeRef argument) { arguments.push_back(argument); });
+					[[fallthrough]];
+				default:
+				{
+					if (!is_modeled(graph.type(i)))
+						unknown[target(i)] = true;
+					break;
+				}
+			}
 		}
 
-		/* create an alias group of all pointers per target */
-		for (const auto &[target, pointers]: target_to_pointers)
+		/* escapes and unknown memory spread until nothing changes */
+		for (const NodeRef argument: arguments)
+			unknown[target(target(argument))] = true;
+
+		bool changed = true;
+		while (changed)
 		{
-			if (pointers.size() > 1)
-				alias_groups.push_back(pointers);
+			changed = false;
+			for (const auto &[address, value]: stores)
+			{
+				if (unknown[target(address)] && !unknown[target(target(value))])
+				{
+					unknown[target(target(value))] = true;
+					changed = true;
+				}
+			}
+
+			/* memory nobody can see holds pointers to anything */
+			for (uint32_t e = 0; e < parent.size(); e++)
+			{
+				if (find(e) == e && unknown[e] && pointee[e] != NONE && !unknown[find(pointee[e])])
+				{
+					unknown[find(pointee[e])] = true;
+					changed = true;
+				}
+			}
 		}
 
-		/* 5th pass: detect all memory issues */
-		detect_memory_issues(nodes);
-	}
+		/* a value's field is its offset from the object's start, through constant PTR_ADDs */
+		constexpr int64_t UNSET = INT64_MAX;
+		std::vector<int64_t> offsets(graph.size(), UNSET);
+		std::vector<NodeRef> worklist;
+		const auto meet = [&](const NodeRef ref, const int64_t offset)
+		{
+			int64_t &current = offsets[ref];
+			const int64_t next = current == UNSET || current == offset ? offset : MemoryLocation::ANY_OFFSET;
+			if (next != current)
+			{
+				current = next;
+				worklist.push_back(ref);
+			}
+		};
 
-	void AliasAnalysisPass::detect_memory_issues(const std::vector<std::unique_ptr<SproutNode<> > > &nodes)
-	{
-		for (const auto &[alloc_node, operations]: memory_operations)
+		for (NodeRef i = 0; i < graph.size(); i++)
 		{
-			if (operations.empty())
+			if (!graph.contains(i))
 				continue;
 
-			std::vector<NodeRef> sorted_ops = sort_memory_ops(alloc_node, operations, nodes);
-
-			detect_use_after_free(alloc_node, sorted_ops, nodes);
-			detect_double_free(alloc_node, sorted_ops, nodes);
-			detect_uninitialized_read(alloc_node, sorted_ops, nodes);
+			const NodeType type = graph.type(i);
+			if (type == NodeType::MALLOC || type == NodeType::STACK_ALLOC || type == NodeType::ADDR_OF)
+				meet(i, 0);
+			else if (type != NodeType::PHI && type != NodeType::PTR_ADD && type != NodeType::REINTERPRET_CAST)
+				meet(i, MemoryLocation::ANY_OFFSET);
 		}
 
-		detect_memory_leaks(nodes);
-	}
+		while (!worklist.empty())
+		{
+			const NodeRef value = worklist.back();
+			worklist.pop_back();
 
-	std::vector<NodeRef> AliasAnalysisPass::sort_memory_ops(NodeRef alloc_node, const std::vector<NodeRef> &operations,
-	                                                        const std::vector<std::unique_ptr<SproutNode<> > > &nodes)
-	{
-		/* currently assumes the IR is roughly in topological order */
-		std::vector<NodeRef> result = operations;
-		std::sort(result.begin(), result.end());
-		return result;
-	}
+			for (const NodeRef user: graph.users(value))
+			{
+				const NodeType type = graph.type(user);
+				if (type == NodeType::PHI && graph.type(value) != NodeType::CONTROL)
+				{
+					meet(user, offsets[value]);
+				}
+				else if (type == NodeType::REINTERPRET_CAST && graph.inputs(user)[0] == value)
+				{
+					meet(user, offsets[value]);
+				}
+				else if (type == NodeType::PTR_ADD && graph.inputs(user)[0] == value)
+				{
+					const int64_t step = offset_of(user, graph);
+					meet(user, offsets[value] == MemoryLocation::ANY_OFFSET || step == MemoryLocation::ANY_OFFSET
+						           ? MemoryLocation::ANY_OFFSET
+						           : offsets[value] + step);
+				}
+			}
+		}
 
-	void AliasAnalysisPass::detect_use_after_free(NodeRef alloc_node,
-	                                              const std::vector<NodeRef> &ops,
-	                                              const std::vector<std::unique_ptr<SproutNode<> > > &nodes)
-	{
-		auto is_freed = false;
-		NodeRef free_node = NULL_REF;
-		for (NodeRef op_node: ops)
+		std::map<uint32_t, std::vector<NodeRef> > class_objects;
+		for (const auto &[ref, element]: objects)
+			class_objects[find(element)].push_back(ref);
+
+		for (NodeRef i = 0; i < graph.size(); i++)
 		{
-			if (op_node >= nodes.size() || !nodes[op_node])
+			if (!graph.contains(i) || pointee[find(i)] == NONE)
 				continue;
 
-			if (nodes[op_node]->type == NodeType::FREE)
+			const uint32_t targets = find(pointee[find(i)]);
+			if (unknown[targets])
 			{
-				is_freed = true;
-				free_node = op_node;
-			}
-			else if (is_freed &&
-			         (nodes[op_node]->type == NodeType::LOAD ||
-			          nodes[op_node]->type == NodeType::STORE ||
-			          nodes[op_node]->type == NodeType::PTR_LOAD ||
-			          nodes[op_node]->type == NodeType::PTR_STORE))
-			{
-				/* ohemgee! it's use after free! */
-				MemoryIssue issue;
-				issue.type = MemoryIssueType::USE_AFTER_FREE;
-				issue.memory_obj = alloc_node;
-				issue.issue_node = op_node;
-				issue.free_node = free_node;
-				issues.push_back(issue);
+				unknown_values.insert(i);
+				continue;
 			}
+
+			const int64_t offset = offsets[i] == UNSET ? MemoryLocation::ANY_OFFSET : offsets[i];
+			for (const NodeRef ref: class_objects[targets])
+				value_locations[i].insert(location_of(ref, offset));
 		}
 	}
 
-	void AliasAnalysisPass::detect_double_free(NodeRef alloc_node, const std::vector<NodeRef> &ops,
-	                                           const std::vector<std::unique_ptr<SproutNode<> > > &nodes)
+	namespace
 	{
-		auto is_freed = false;
-		NodeRef first_free_node = NULL_REF;
+		/* the states an object may be in; a set, so meeting two paths is an or */
+		enum : uint8_t
+		{
+			UNINIT = 1,
+			INIT = 2,
+			FREED = 4
+		};
 
-		for (const NodeRef op_node: ops)
+		/*
+		 * per-object states with an undo log, so a branch arm can be walked,
+		 * rolled back and met with the other without copying the whole table
+		 */
+		class MemoryStates
 		{
-			if (op_node >= nodes.size() || !nodes[op_node])
-				continue;
+		public:
+			[[nodiscard]] uint8_t get(const uint32_t slot) const
+			{
+				return states[slot];
+			}
+
+			void set(const uint32_t slot, const uint8_t state)
+			{
+				if (states[slot] == state)
+					return;
 
-			if (nodes[op_node]->type == NodeType::FREE)
+				undo.emplace_back(slot, states[slot]);
+				states[slot] = state;
+			}
+
+			uint32_t slot_of(const NodeRef object)
 			{
-				if (is_freed)
+				const auto [it, fresh] = slots.try_emplace(object, static_cast<uint32_t>(states.size()));
+				if (fresh)
 				{
-					/* double free */
-					MemoryIssue issue;
-					issue.type = MemoryIssueType::DOUBLE_FREE;
-					issue.memory_obj = alloc_node;
-					issue.issue_node = op_node;
-					issue.free_node = first_free_node;
-					issues.push_back(issue);
+					states.push_back(0);
+					first_free.push_back(NULL_REF);
+					stamps.push_back(0);
 				}
-				else
+				return it->second;
+			}
+
+			static constexpr uint32_t NONE = UINT32_MAX;
+
+			/* NONE if the object is not tracked */
+			[[nodiscard]] uint32_t find(const NodeRef object) const
+			{
+				const auto it = slots.find(object);
+				return it == slots.end() ? NONE : it->second;
+			}
+
+			[[nodiscard]] size_t mark() const
+			{
+				return undo.size();
+			}
+
+			/* each slot changed since `from`, with its state at that point */
+			std::vector<std::pair<uint32_t, uint8_t> > changes(const size_t from)
+			{
+				std::vector<std::pair<uint32_t, uint8_t> > result;
+				stamp++;
+				for (size_t i = from; i < undo.size(); i++)
 				{
-					is_freed = true;
-					first_free_node = op_node;
+					if (stamps[undo[i].first] != stamp)
+					{
+						stamps[undo[i].first] = stamp;
+						result.push_back(undo[i]);
+					}
 				}
+				return result;
 			}
-		}
+
+			void rollback(const size_t to)
+			{
+				while (undo.size() > to)
+				{
+					states[undo.back().first] = undo.back().second;
+					undo.pop_back();
+				}
+			}
+
+			const std::unordered_map<NodeRef, uint32_t> &tracked() const
+			{
+				return slots;
+			}
+
+			std::vector<NodeRef> first_free; /* per slot; the free a later one is reported against */
+
+		private:
+			std::unordered_map<NodeRef, uint32_t> slots;
+			std::vector<uint8_t> states;
+			std::vector<std::pair<uint32_t, uint8_t> > undo;
+			std::vector<uint32_t> stamps;
+			uint32_t stamp = 0;
+		};
 	}
 
-	void AliasAnalysisPass::detect_uninitialized_read(NodeRef alloc_node, const std::vector<NodeRef> &ops,
-	                                                  const std::vector<std::unique_ptr<SproutNode<> > > &nodes)
+	void AliasAnalysisPass::detect_memory_issues(const RegionRef root, const SproutGraph &graph)
 	{
-		auto is_initialized = false;
-		for (NodeRef op_node: ops)
+		MemoryStates states;
+
+		const auto report = [&](const MemoryIssueType type, const NodeRef object, const NodeRef node,
+		                        const NodeRef free_node)
 		{
-			if (op_node >= nodes.size() || !nodes[op_node])
-				continue;
+			MemoryIssue issue;
+			issue.type = type;
+			issue.memory_obj = object;
+			issue.issue_node = node;
+			issue.free_node = free_node;
+			issues.push_back(issue);
+		};
 
-			if (nodes[op_node]->type == NodeType::STORE ||
-			    nodes[op_node]->type == NodeType::PTR_STORE)
+		/* the tracked objects an operation on `address` may reach */
+		std::vector<std::pair<NodeRef, uint32_t> > targets;
+		const auto collect = [&](const NodeRef op, const NodeRef address)
+		{
+			targets.clear();
+			if (graph.mem_obj(op) != NULL_REF)
 			{
-				is_initialized = true;
+				if (const uint32_t slot = states.find(graph.mem_obj(op)); slot != MemoryStates::NONE)
+					targets.emplace_back(graph.mem_obj(op), slot);
+				return;
 			}
-			else if (!is_initialized &&
-			         (nodes[op_node]->type == NodeType::LOAD ||
-			          nodes[op_node]->type == NodeType::PTR_LOAD))
-			{
-				/* detected!!!!!!!!!! :< */
-				MemoryIssue issue;
-				issue.type = MemoryIssueType::UNINITIALIZED_READ;
-				issue.memory_obj = alloc_node;
-				issue.issue_node = op_node;
-				issue.free_node = NULL_REF;
-				issues.push_back(issue);
+
+			for (const NodeRef object: get_points_to_set(address))
+			{
+				if (const uint32_t slot = states.find(object); slot != MemoryStates::NONE)
+					targets.emplace_back(object, slot);
 			}
-		}
-	}
+		};
 
-	void AliasAnalysisPass::detect_memory_leaks(const std::vector<std::unique_ptr<SproutNode<> > > &nodes)
-	{
-		for (const auto &[alloc_node, operations]: memory_operations)
+		const auto visit = [&](const NodeRef node)
 		{
-			if (nodes[alloc_node]->type != NodeType::MALLOC)
-				continue;
+			if (!graph.contains(node))
+				return;
 
-			auto is_freed = false;
-			for (const NodeRef op_node: operations)
+			const NodeType type = graph.type(node);
+			const NodeSpan inputs = graph.inputs(node);
+			switch (type)
 			{
-				if (op_node >= nodes.size() || !nodes[op_node])
-					continue;
+				case NodeType::MALLOC:
+				case NodeType::STACK_ALLOC:
+					states.set(states.slot_of(node), UNINIT);
+					break;
+
+				case NodeType::ADDR_OF:
+				{
+					/* the variable is the object the points-to sets name */
+					states.set(states.slot_of(node), UNINIT);
+					if (!inputs.empty() && states.find(inputs[0]) == MemoryStates::NONE)
+						states.set(states.slot_of(inputs[0]), UNINIT);
+					break;
+				}
+
+				case NodeType::LOAD:
+				case NodeType::PTR_LOAD:
+				case NodeType::VECTOR_LOAD:
+				{
+					collect(node, inputs.empty() ? NULL_REF : inputs[0]);
+					if (targets.size() != 1)
+						break;
+
+					const auto [object, slot] = targets[0];
+					if (states.get(slot) & FREED)
+						report(MemoryIssueType::USE_AFTER_FREE, object, node, states.first_free[slot]);
+					if (states.get(slot) & UNINIT)
+						report(MemoryIssueType::UNINITIALIZED_READ, object, node, NULL_REF);
+					break;
+				}
+
+				case NodeType::STORE:
+				case NodeType::PTR_STORE:
+				case NodeType::VECTOR_STORE:
+				{
+					collect(node, inputs.empty() ? NULL_REF : inputs[0]);
+					for (const auto &[object, slot]: targets)
+					{
+						/* live states become initialised; a freed one stays freed */
+						const uint8_t state = states.get(slot);
+						if (targets.size() == 1 && (state & FREED))
+							report(MemoryIssueType::USE_AFTER_FREE, object, node, states.first_free[slot]);
+						states.set(slot, static_cast<uint8_t>((state & FREED) | (state & (UNINIT | INIT) ? INIT : 0)));
+					}
+					break;
+				}
+
+				case NodeType::FREE:
+				{
+					collect(node, inputs.empty() ? NULL_REF : inputs[0]);
+					for (const auto &[object, slot]: targets)
+					{
+						const uint8_t state = states.get(slot);
+						if (targets.size() == 1 && (state & FREED))
+							report(MemoryIssueType::DOUBLE_FREE, object, node, states.first_free[slot]);
+						if (states.first_free[slot] == NULL_REF)
+							states.first_free[slot] = node;
+
+						/* freeing one of several objects only may free each */
+						states.set(slot, targets.size() == 1 ? FREED : static_cast<uint8_t>(state | FREED));
+					}
+					break;
+				}
 
-				if (nodes[op_node]->type == NodeType::FREE)
+				case NodeType::CALL:
 				{
-					is_freed = true;
+					/* the callee may fill in what it is handed; reading it after is fine */
+					for_each_argument(graph, node, [&](const NodeRef argument)
+					{
+						for (const NodeRef object: get_points_to_set(argument))
+						{
+							if (const uint32_t slot = states.find(object); slot != MemoryStates::NONE)
+								states.set(slot, static_cast<uint8_t>((states.get(slot) & FREED) | INIT));
+						}
+					});
 					break;
 				}
+
+				default:
+					break;
 			}
+		};
 
-			if (!is_freed)
+		/* the state after the region met with the state before it, for regions that may not run */
+		const auto optional = [&](const auto &walk, const RegionRef region)
+		{
+			const size_t mark = states.mark();
+			walk(walk, region);
+			for (const auto &[slot, before]: states.changes(mark))
+				states.set(slot, static_cast<uint8_t>(states.get(slot) | before));
+		};
+
+		const auto walk = [&](const auto &self, const RegionRef region) -> void
+		{
+			for (const NodeRef node: graph.region(region).get_nodes())
+				visit(node);
+
+			const std::vector<RegionRef> &children = graph.region(region).get_children();
+			for (size_t i = 0; i < children.size(); i++)
 			{
-				/* possible leak */
-				MemoryIssue issue;
-				issue.type = MemoryIssueType::MEMORY_LEAK;
-				issue.memory_obj = alloc_node;
-				issue.issue_node = NULL_REF;
-				issue.free_node = NULL_REF;
-				issues.push_back(issue);
+				const RegionType type = graph.region(children[i]).get_type();
+				if (type == RegionType::BRANCH_THEN && i + 1 < children.size() &&
+				    graph.region(children[i + 1]).get_type() == RegionType::BRANCH_ELSE)
+				{
+					/* both arms start from here; walk one, keep its states, undo it, walk the other */
+					const size_t mark = states.mark();
+					self(self, children[i]);
+
+					std::vector<std::pair<uint32_t, uint8_t> > then_states = states.changes(mark);
+					for (auto &[slot, state]: then_states)
+						state = states.get(slot);
+					states.rollback(mark);
+
+					self(self, children[++i]);
+					const std::vector<std::pair<uint32_t, uint8_t> > else_before = states.changes(mark);
+
+					/* a slot only one arm changed meets the state from before the branch */
+					std::unordered_map<uint32_t, uint8_t> met(then_states.begin(), then_states.end());
+					for (const auto &[slot, before]: else_before)
+						met.try_emplace(slot, before);
+					for (const auto &[slot, state]: met)
+						states.set(slot, static_cast<uint8_t>(states.get(slot) | state));
+				}
+				else if (type == RegionType::BRANCH_THEN || type == RegionType::BRANCH_ELSE ||
+				         type == RegionType::LOOP_BODY || type == RegionType::EXCEPTION)
+				{
+					optional(self, children[i]);
+				}
+				else
+				{
+					self(self, children[i]);
+				}
 			}
+		};
+
+		walk(walk, root);
+
+		/* in ref order, so reports do not depend on the hash table */
+		std::vector<NodeRef> allocations;
+		for (const auto &[object, slot]: states.tracked())
+		{
+			if (graph.contains(object) && graph.type(object) == NodeType::MALLOC &&
+			    (states.get(slot) & (UNINIT | INIT)))
+				allocations.push_back(object);
 		}
+
+		std::sort(allocations.begin(), allocations.end());
+		for (const NodeRef object: allocations)
+			report(MemoryIssueType::MEMORY_LEAK, object, NULL_REF, NULL_REF);
 	}
 
 	bool AliasAnalysisPass::points_to_same_memory(const NodeRef ptr1, const NodeRef ptr2) const
 	{
-		const auto it1 = points_to_map.find(ptr1);
-		const auto it2 = points_to_map.find(ptr2);
-		if (it1 == points_to_map.end() || it2 == points_to_map.end())
+		const std::set<NodeRef> &set1 = get_points_to_set(ptr1);
+		const std::set<NodeRef> &set2 = get_points_to_set(ptr2);
+		if (set1.empty() || set2.empty())
 			return true;
 
 		/* if intersects */
-		const auto &set1 = it1->second;
-		const auto &set2 = it2->second;
 		for (NodeRef target: set1)
 		{
 			if (set2.find(target) != set2.end())
@@ -349,6 +959,26 @@ namespace sprk
 		return false;
 	}
 
+	bool AliasAnalysisPass::may_alias(const NodeRef ptr1, const NodeRef ptr2) const
+	{
+		const std::vector<MemoryLocation> lhs = get_locations(ptr1);
+		const std::vector<MemoryLocation> rhs = get_locations(ptr2);
+		if (lhs.empty() || rhs.empty())
+			return true;
+
+		for (const MemoryLocation &a: lhs)
+		{
+			for (const MemoryLocation &b: rhs)
+			{
+				if (a.object == b.object && (a.offset == b.offset || a.offset == MemoryLocation::ANY_OFFSET ||
+				                             b.offset == MemoryLocation::ANY_OFFSET))
+					return true;
+			}
+		}
+
+		return false;
+	}
+
 	const std::set<NodeRef> &AliasAnalysisPass::get_points_to_set(const NodeRef ptr) const
 	{
 		static const std::set<NodeRef> empty_set;
@@ -356,8 +986,19 @@ namespace sprk
 		return (it != points_to_map.end()) ? it->second : empty_set;
 	}
 
-	void AliasAnalysisPass::dump_results(const std::vector<std::unique_ptr<SproutNode<> > > &nodes,
-	                                     const std::shared_ptr<SproutRegion> &root, bool colorize) const
+	std::vector<MemoryLocation> AliasAnalysisPass::get_locations(const NodeRef ptr) const
+	{
+		std::vector<MemoryLocation> result;
+		if (ptr >= value_locations.size() || unknown_values.test(ptr))
+			return result;
+
+		value_locations[ptr].for_each([&](const size_t id) { result.push_back(locations[id]); });
+		std::sort(result.begin(), result.end());
+		return result;
+	}
+
+	void AliasAnalysisPass::dump_results(const SproutGraph &graph,
+	                                     const RegionRef root, bool colorize) const
 	{
 		const char *red = colorize ? RED : "";
 		const char *yellow = colorize ? YELLOW : "";
@@ -397,18 +1038,18 @@ namespace sprk
 
 					std::cout << ptr;
 
-					if (ptr < nodes.size() && nodes[ptr])
+					if (graph.contains(ptr))
 					{
-						const auto &node = nodes[ptr];
-						if (node->string_id)
-							std::cout << " (" << reinterpret_cast<const char *>(node->string_id) << ")";
+						if (graph.string_id(ptr) != NULL_STRING)
+							std::cout << " (" << graph.name(ptr) << ")";
 					}
 				}
 				std::cout << std::endl;
 			}
 		}
 
-		std::cout << blue << "\npoints-to information:" << reset << std::endl;
+		std::cout << blue << "\npoints-to information ("
+		          << (mode == AliasMode::STEENSGAARD ? "steensgaard" : "andersen") << "):" << reset << std::endl;
 		if (points_to_map.empty())
 		{
 			std::cout << "  no points-to information found." << std::endl;
@@ -422,19 +1063,18 @@ namespace sprk
 
 				std::cout << cyan << "  node #" << ptr;
 
-				if (ptr < nodes.size() && nodes[ptr])
+				if (graph.contains(ptr))
 				{
-					const auto &node = nodes[ptr];
-					std::cout << " (" << nttostr(node->type);
-					if (node->string_id)
-						std::cout << " " << reinterpret_cast<const char *>(node->string_id);
+					std::cout << " (" << nttostr(graph.type(ptr));
+					if (graph.string_id(ptr) != NULL_STRING)
+						std::cout << " " << graph.name(ptr);
 					std::cout << ")";
 				}
 
 				std::cout << reset << " points to: ";
 
 				auto first = true;
-				for (const NodeRef target: targets)
+				for (const auto &[target, offset]: get_locations(ptr))
 				{
 					if (!first)
 						std::cout << ", ";
@@ -442,12 +1082,17 @@ namespace sprk
 
 					std::cout << target;
 
-					if (target < nodes.size() && nodes[target])
+					if (graph.contains(target))
 					{
-						if (const auto &node = nodes[target];
-							node->string_id)
-							std::cout << " (" << reinterpret_cast<const char *>(node->string_id) << ")";
+						if (graph.string_id(target) != NULL_STRING)
+							std::cout << " (" << graph.name(target) << ")";
 					}
+
+					/* the field; the object's start is left bare */
+					if (offset == MemoryLocation::ANY_OFFSET)
+						std::cout << " +?";
+					else if (offset != 0)
+						std::cout << " +" << offset;
 				}
 				std::cout << std::endl;
 			}
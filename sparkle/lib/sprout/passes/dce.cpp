@@ -1,5 +1,6 @@
+#include <algorithm>
+#include <functional>
 #include <iostream>
-#include <queue>
 #include <sparkle/sprout/node.hpp>
 #include <sparkle/sprout/region.hpp>
 #include <sparkle/sprout/passes/dce.hpp>
@@ -7,128 +8,239 @@
 
 namespace sprk
 {
-	void DCEPass::run(const std::shared_ptr<SproutRegion> &root, std::vector<std::unique_ptr<SproutNode<> > > &nodes)
+	namespace
 	{
+		/* a call may reach any of the others */
+		bool has_side_effects(const NodeType type)
+		{
+			switch (type)
+			{
+				case NodeType::STORE:
+				case NodeType::PTR_STORE:
+				case NodeType::VECTOR_STORE:
+				case NodeType::FREE:
+				case NodeType::CALL:
+					return true;
+				default:
+					return false;
+			}
+		}
+	}
+
+	void DCEPass::begin(const SproutGraph &graph, const size_t unit_count)
+	{
+		alive_nodes.resize(graph.size());
 		alive_nodes.clear();
+		dead_bits.resize(graph.size());
+		dead_bits.clear();
 		dead_nodes.clear();
+		reached.assign(unit_count, {});
+		remap = {};
+		removed_regions = 0;
+	}
 
-		std::queue<NodeRef> worklist;
-
-		/* 1st pass: find the RET and EXIT nodes */
-		for (size_t i = 0; i < nodes.size(); i++)
+	void DCEPass::run_function(const FunctionUnit &unit,
+	                           const SproutGraph &graph,
+	                           WorkerScratch &scratch,
+	                           FunctionEdits &edits)
+	{
+		const auto mark = [&scratch, &graph](const NodeRef ref)
 		{
-			if (!nodes[i])
-				continue;
+			/* skip invalid */
+			if (graph.contains(ref) && scratch.mark(ref))
+				scratch.worklist.push_back(ref);
+		};
 
-			if (nodes[i]->type == NodeType::RET || nodes[i]->type == NodeType::EXIT)
-			{
-				worklist.push(static_cast<NodeRef>(i));
-				alive_nodes.insert(static_cast<NodeRef>(i));
-			}
+		/* 1st pass: find the roots */
+		for (const NodeRef i: unit.nodes)
+		{
+			if (is_root(graph.type(i)))
+				mark(i);
 		}
 
-		/* 2nd pass: mark all reachable nodes */
-		while (!worklist.empty())
+		/* 2nd pass: mark all reachable nodes; calls may lead into other functions */
+		while (!scratch.worklist.empty())
 		{
-			const NodeRef curr = worklist.front();
-			worklist.pop();
+			const NodeRef curr = scratch.worklist.back();
+			scratch.worklist.pop_back();
 
-			if (curr >= nodes.size() || !nodes[curr])
+			for (const NodeRef input: graph.inputs(curr))
+				mark(input);
+
+			if (mode != DCEMode::AGGRESSIVE)
 				continue;
 
-			/* add all inputs to the worklist */
-			for (uint8_t i = 0; i < nodes[curr]->input_count; i++)
+			/* refs outside the input list keep their target alive too */
+			mark(graph.fn_ref(curr));
+			mark(graph.mem_obj(curr));
+			if (const auto *ref = std::get_if<NodeRef>(&graph.value(curr)))
+				mark(*ref);
+
+			/* a live node keeps the control nodes its regions execute under */
+			for (RegionRef r = graph.region_of(curr);
+			     r != NULL_REGION && scratch.mark_region(r);
+			     r = graph.region(r).get_parent())
 			{
-				NodeRef input = nodes[curr]->inputs[i];
+				mark(graph.region(r).get_ctrl_dep());
+			}
+		}
 
-				/* skip invalid */
-				if (input >= nodes.size() || !nodes[input])
-					continue;
+		reached[unit.index].assign(scratch.touched.begin(), scratch.touched.end());
+	}
 
-				if (alive_nodes.find(input) == alive_nodes.end())
-				{
-					alive_nodes.insert(input);
-					worklist.push(input);
-				}
-			}
+	void DCEPass::finish(const RegionRef root,
+	                     SproutGraph &graph,
+	                     const std::vector<FunctionEdits> &edits)
+	{
+		/* reachability from all roots is the union of reachability per function */
+		for (const auto &nodes: reached)
+		{
+			for (const NodeRef ref: nodes)
+				alive_nodes.set(ref);
 		}
+		reached.clear();
 
 		/* find & put all unreachable nodes into the dead set */
-		for (size_t i = 0; i < nodes.size(); ++i)
+		for (NodeRef i = 0; i < graph.size(); ++i)
 		{
-			if (nodes[i] && alive_nodes.find(static_cast<NodeRef>(i)) == alive_nodes.end())
-				dead_nodes.insert(static_cast<NodeRef>(i));
+			if (graph.contains(i) && !alive_nodes.test(i))
+			{
+				dead_bits.set(i);
+				dead_nodes.push_back(i);
+			}
 		}
 
-		// remove_dead_nodes(const_cast<std::shared_ptr<SproutRegion> &>(root), nodes);
+		if (mode == DCEMode::AGGRESSIVE)
+			sweep(root, graph);
 	}
 
-	void DCEPass::remove_dead_nodes(std::shared_ptr<SproutRegion> &root,
-									std::vector<std::unique_ptr<SproutNode<> > > &nodes)
+	bool DCEPass::is_root(const NodeType type) const
 	{
-		if (dead_nodes.empty())
-			return;
+		switch (type)
+		{
+			case NodeType::RET:
+			case NodeType::EXIT:
+				return true;
 
-		/* disconnect */
+			default:
+				return has_side_effects(type) && mode == DCEMode::AGGRESSIVE;
+		}
+	}
+
+	void DCEPass::sweep(const RegionRef root, SproutGraph &graph)
+	{
 		for (const NodeRef dead_ref: dead_nodes)
+			graph.remove(dead_ref);
+
+		/* post-order, so a parent sees its children's deletions */
+		std::function<void(RegionRef)> prune = [&](const RegionRef region)
 		{
-			if (dead_ref >= nodes.size() || !nodes[dead_ref])
-				continue;
+			/* cpy; removing a child edits the list */
+			const std::vector<RegionRef> children = graph.region(region).get_children();
+			for (const RegionRef child: children)
+				prune(child);
 
-			for (uint8_t i = 0; i < nodes[dead_ref]->input_count; i++)
-			{
-				NodeRef input_ref = nodes[dead_ref]->inputs[i];
-				if (input_ref >= nodes.size() || !nodes[input_ref])
-					continue;
+			const SproutRegion &r = graph.region(region);
+			if (region == root || !r.get_children().empty())
+				return;
 
-				auto *input_node = nodes[input_ref].get();
-				for (uint8_t j = 0; j < input_node->user_count; j++)
-				{
-					if (input_node->users[j] == dead_ref)
-					{
-						/* if it's not the last user, shift the array */
-						if (j < input_node->user_count - 1)
-						{
-							for (uint8_t k = j; k < input_node->user_count - 1; k++)
-								input_node->users[k] = input_node->users[k + 1];
-						}
-						input_node->user_count--;
-						break;
-					}
-				}
+			const auto &nodes = r.get_nodes();
+			if (std::none_of(nodes.begin(), nodes.end(), [&graph](const NodeRef n) { return graph.contains(n); }))
+			{
+				graph.remove_region(region);
+				removed_regions++;
 			}
-		}
+		};
 
-		std::function<void(std::shared_ptr<SproutRegion> &)> clean_region =
-				[&](const std::shared_ptr<SproutRegion> &region)
+		if (root != NULL_REGION)
+			prune(root);
+
+		remap = graph.compact();
+	}
+
+	void DCEPass::remove_dead_nodes(const RegionRef root, SproutGraph &graph)
+	{
+		if (dead_nodes.empty())
+			return;
+
+		std::function<void(RegionRef)> clean_region =
+				[&](const RegionRef region)
 				{
-					if (!region)
+					if (region == NULL_REGION)
 						return;
 
 					std::vector<NodeRef> live_nodes;
-					for (NodeRef node_ref: region->get_nodes())
+					for (NodeRef node_ref: graph.region(region).get_nodes())
 					{
-						if (dead_nodes.find(node_ref) == dead_nodes.end())
+						if (!is_dead(node_ref))
 							live_nodes.push_back(node_ref);
 					}
 
 
-					region->replace_nodes(std::move(live_nodes));
-					for (auto child: region->get_children()) /* `get_children()` already returns references */
+					graph.replace_nodes(region, std::move(live_nodes));
+					for (const RegionRef child: graph.region(region).get_children())
 						clean_region(child);
 				};
 
 		clean_region(root);
+
+		/* disconnects from the inputs' user lists and leaves a tombstone */
 		for (const NodeRef dead_ref: dead_nodes)
+			graph.remove(dead_ref);
+	}
+
+	std::vector<NodeRef> DCEPass::remove_dead_from(const std::vector<NodeRef> &dirty, SproutGraph &graph)
+	{
+		std::vector<NodeRef> worklist(dirty.begin(), dirty.end());
+		std::vector<NodeRef> removed;
+		std::vector<RegionRef> touched_regions;
+
+		while (!worklist.empty())
+		{
+			const NodeRef curr = worklist.back();
+			worklist.pop_back();
+
+			/* stores, frees and calls never have users; whatever the mode, only a full run may drop them */
+			if (!graph.contains(curr) || !graph.users(curr).empty() || is_root(graph.type(curr)) ||
+			    has_side_effects(graph.type(curr)) || graph.type(curr) == NodeType::FUNCTION ||
+			    (graph.flags(curr) & NODE_PINNED))
+				continue;
+
+			/* cpy; remove releases the input list */
+			const NodeSpan span = graph.inputs(curr);
+			const std::vector<NodeRef> inputs(span.begin(), span.end());
+
+			if (const RegionRef region = graph.region_of(curr); region != NULL_REGION)
+				touched_regions.push_back(region);
+
+			graph.remove(curr);
+			removed.push_back(curr);
+
+			for (const NodeRef input: inputs)
+				worklist.push_back(input);
+		}
+
+		/* drop the tombstones from the regions that held them, once per region */
+		std::sort(touched_regions.begin(), touched_regions.end());
+		touched_regions.erase(std::unique(touched_regions.begin(), touched_regions.end()), touched_regions.end());
+		for (const RegionRef region: touched_regions)
 		{
-			if (dead_ref < nodes.size() && nodes[dead_ref])
-				nodes[dead_ref].reset(); /* free mem */
+			std::vector<NodeRef> live_nodes;
+			for (const NodeRef node_ref: graph.region(region).get_nodes())
+			{
+				if (graph.contains(node_ref))
+					live_nodes.push_back(node_ref);
+			}
+			graph.replace_nodes(region, std::move(live_nodes));
 		}
+
+		std::sort(removed.begin(), removed.end());
+		return removed;
 	}
 
-	void DCEPass::dump_results(const std::set<NodeRef> &dead_nodes,
-	                           const std::vector<std::unique_ptr<SproutNode<> > > &nodes,
-	                           const std::shared_ptr<SproutRegion> &root,
+	void DCEPass::dump_results(const NodeSpan dead_nodes,
+	                           const SproutGraph &graph,
+	                           const RegionRef root,
 	                           const bool colorize)
 	{
 		const char *header_color = colorize ? BLUE : "";
@@ -136,79 +248,89 @@ namespace sprk
 		const char *live_color = colorize ? GREEN : "";
 		const char *reset = colorize ? RESET : "";
 
+		BitVector listed(graph.size());
+		for (const NodeRef node_ref: dead_nodes)
+		{
+			if (node_ref < listed.size())
+				listed.set(node_ref);
+		}
+
+		const auto is_listed = [&listed](const NodeRef ref)
+		{
+			return ref < listed.size() && listed.test(ref);
+		};
+
 		std::cout << header_color << "\nDCE results" << reset << "\n";
 		std::cout << "found " << dead_nodes.size() << " dead nodes:" << "\n";
 
 		for (const NodeRef node_ref: dead_nodes)
 		{
-			if (node_ref >= nodes.size() || !nodes[node_ref])
+			if (!graph.contains(node_ref))
 			{
 				std::cout << "  " << dead_color << "invalid node reference: "
 						<< node_ref << reset << "\n";
 				continue;
 			}
 
-			const auto &node = nodes[node_ref];
 			std::cout << "  " << dead_color << "node #" << node_ref << ": "
-					<< nttostr(node->type);
+					<< nttostr(graph.type(node_ref));
 
-			if (node->string_id)
-				std::cout << " (name: " << node->string_id << ")";
+			if (graph.string_id(node_ref) != NULL_STRING)
+				std::cout << " (name: " << graph.name(node_ref) << ")";
 
 			std::cout << reset << "\n";
 		}
 
 		std::cout << "\n";
-		std::cout << "remaining nodes: " << (nodes.size() - dead_nodes.size()) << "\n";
+		std::cout << "remaining nodes: " << (graph.live_size() - dead_nodes.size()) << "\n";
 
-		std::function<void(const std::shared_ptr<SproutRegion> &, int)> dump_region =
-				[&](const std::shared_ptr<SproutRegion> &region, const int indent)
+		std::function<void(RegionRef, int)> dump_region =
+				[&](const RegionRef region, const int indent)
 		{
-			if (!region)
+			if (region == NULL_REGION)
 				return;
 
 			const std::string indentation(indent * 2, ' ');
-			std::cout << indentation << "region: " << region->get_name()
-					<< " (" << rttostr(region->get_type()) << ")" << "\n";
+			std::cout << indentation << "region: " << graph.region(region).get_name()
+					<< " (" << rttostr(graph.region(region).get_type()) << ")" << "\n";
 
-			for (NodeRef node_ref: region->get_nodes())
+			for (NodeRef node_ref: graph.region(region).get_nodes())
 			{
 				/* skip the deads */
-				if (dead_nodes.find(node_ref) != dead_nodes.end())
+				if (is_listed(node_ref))
 					continue;
 
-				if (node_ref >= nodes.size() || !nodes[node_ref])
+				if (!graph.contains(node_ref))
 				{
 					std::cout << indentation << "  invalid node reference: " << node_ref << "\n";
 					continue;
 				}
 
-				const auto &node = nodes[node_ref];
 				std::cout << indentation << "  " << live_color << "node #" << node_ref << ": "
-						<< nttostr(node->type);
+						<< nttostr(graph.type(node_ref));
 
-				if (node->string_id)
-					std::cout << " (name: " << reinterpret_cast<const char *>(node->string_id) << ")";
+				if (graph.string_id(node_ref) != NULL_STRING)
+					std::cout << " (name: " << graph.name(node_ref) << ")";
 
-				if (std::holds_alternative<int64_t>(node->value))
-					std::cout << " = " << std::get<int64_t>(node->value);
+				if (std::holds_alternative<int64_t>(graph.value(node_ref)))
+					std::cout << " = " << std::get<int64_t>(graph.value(node_ref));
 
-				if (node->fn_ref != NULL_REF)
-					std::cout << " [fn: " << node->fn_ref << "]";
+				if (graph.fn_ref(node_ref) != NULL_REF)
+					std::cout << " [fn: " << graph.fn_ref(node_ref) << "]";
 
-				if (node->mem_obj != NULL_REF)
-					std::cout << " [mem: " << node->mem_obj << "]";
+				if (graph.mem_obj(node_ref) != NULL_REF)
+					std::cout << " [mem: " << graph.mem_obj(node_ref) << "]";
 
 				std::cout << reset << "\n";
 
-				if (node->input_count > 0)
+				if (const NodeSpan inputs = graph.inputs(node_ref);
+					!inputs.empty())
 				{
 					std::cout << indentation << "    inputs: ";
 					auto first = true;
-					for (uint8_t i = 0; i < node->input_count; i++)
+					for (const NodeRef input: inputs)
 					{
-						if (NodeRef input = node->inputs[i];
-							dead_nodes.find(input) == dead_nodes.end())
+						if (!is_listed(input))
 						{
 							if (!first)
 								std::cout << ", ";
@@ -219,14 +341,14 @@ namespace sprk
 					std::cout << "\n";
 				}
 
-				if (node->user_count > 0)
+				if (const NodeSpan users = graph.users(node_ref);
+					!users.empty())
 				{
 					std::cout << indentation << "    users: ";
 					auto first = true;
-					for (uint8_t i = 0; i < node->user_count; i++)
+					for (const NodeRef user: users)
 					{
-						if (NodeRef user = node->users[i];
-							dead_nodes.find(user) == dead_nodes.end())
+						if (!is_listed(user))
 						{
 							if (!first)
 								std::cout << ", ";
@@ -238,7 +360,7 @@ namespace sprk
 				}
 			}
 
-			for (const auto &child: region->get_children())
+			for (const RegionRef child: graph.region(region).get_children())
 				dump_region(child, indent + 1);
 		};
 		dump_region(root, 0);
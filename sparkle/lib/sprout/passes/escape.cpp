@@ -0,0 +1,217 @@
+#include <iostream>
+#include <sparkle/sprout/passes/escape.hpp>
+#include <sparkle/sprout/utils/dump.hpp>
+
+namespace sprk
+{
+	namespace
+	{
+		bool is_access(const NodeType type)
+		{
+			switch (type)
+			{
+				case NodeType::LOAD:
+				case NodeType::STORE:
+				case NodeType::PTR_LOAD:
+				case NodeType::PTR_STORE:
+				case NodeType::VECTOR_LOAD:
+				case NodeType::VECTOR_STORE:
+				case NodeType::FREE:
+					return true;
+				default:
+					return false;
+			}
+		}
+
+		bool has_fixed_size(const SproutGraph &graph, const NodeRef alloc)
+		{
+			for (const NodeRef input: graph.inputs(alloc))
+			{
+				if (!graph.contains(input) || graph.type(input) != NodeType::CONST)
+					return false;
+			}
+			return true;
+		}
+	}
+
+	void StackPromotionPass::begin(const SproutGraph &graph, const size_t unit_count)
+	{
+		results.clear();
+		unit_results.assign(unit_count, {});
+	}
+
+	void StackPromotionPass::run_function(const FunctionUnit &unit,
+	                                      const SproutGraph &graph,
+	                                      WorkerScratch &scratch,
+	                                      FunctionEdits &edits)
+	{
+		if (unit.region == NULL_REGION)
+			return;
+
+		std::vector<NodeRef> phis;
+		std::vector<NodeRef> frees;
+		for (const NodeRef alloc: unit.nodes)
+		{
+			if (!graph.contains(alloc) || graph.type(alloc) != NodeType::MALLOC)
+				continue;
+
+			StackPromotion promotion { alloc };
+			if (!has_fixed_size(graph, alloc))
+				promotion.escape = alloc;
+
+			/* every value that is a pointer into the allocation, marked in scratch */
+			phis.clear();
+			frees.clear();
+			scratch.mark(alloc);
+			scratch.worklist.push_back(alloc);
+			while (!scratch.worklist.empty() && promotion.escape == NULL_REF)
+			{
+				const NodeRef pointer = scratch.worklist.back();
+				scratch.worklist.pop_back();
+
+				for (const NodeRef user: graph.users(pointer))
+				{
+					const NodeType type = graph.type(user);
+					const NodeSpan inputs = graph.inputs(user);
+					if (graph.fn_ref(user) != graph.fn_ref(alloc))
+					{
+						promotion.escape = user;
+						break;
+					}
+
+					/* the pointer as an address is fine; as any other operand it is stored or freed by value */
+					if (is_access(type))
+					{
+						bool address_only = true;
+						for (uint32_t i = 1; i < inputs.size(); i++)
+							address_only &= inputs[i] != pointer;
+
+						if (!address_only)
+						{
+							promotion.escape = user;
+							break;
+						}
+
+						if (type == NodeType::FREE && scratch.mark(user))
+							frees.push_back(user);
+						continue;
+					}
+
+					switch (type)
+					{
+						case NodeType::PTR_ADD:
+						case NodeType::REINTERPRET_CAST:
+						{
+							if (inputs[0] != pointer)
+							{
+								promotion.escape = user;
+								break;
+							}
+							if (scratch.mark(user))
+								scratch.worklist.push_back(user);
+							break;
+						}
+
+						case NodeType::PHI:
+						{
+							/* its other inputs are checked once every pointer is known */
+							if (scratch.mark(user))
+							{
+								phis.push_back(user);
+								scratch.worklist.push_back(user);
+							}
+							break;
+						}
+
+						case NodeType::CMP:
+							break;
+
+						default:
+							promotion.escape = user;
+							break;
+					}
+
+					if (promotion.escape != NULL_REF)
+						break;
+				}
+			}
+
+			/* a PHI that also merges some other pointer would let a FREE release that one */
+			for (const NodeRef phi: phis)
+			{
+				for (const NodeRef input: graph.inputs(phi))
+				{
+					if (promotion.escape == NULL_REF && !scratch.marks.test(input) &&
+					    graph.type(input) != NodeType::CONTROL)
+						promotion.escape = phi;
+				}
+			}
+
+			scratch.reset();
+			if (promotion.escape == NULL_REF)
+			{
+				promotion.frees = static_cast<uint32_t>(frees.size());
+				for (const NodeRef release: frees)
+					edits.remove(release);
+			}
+
+			unit_results[unit.index].push_back(promotion);
+		}
+	}
+
+	void StackPromotionPass::finish(const RegionRef root,
+	                                SproutGraph &graph,
+	                                const std::vector<FunctionEdits> &edits)
+	{
+		/* the FREEs are gone; the allocations change kind in place, so every use stays valid */
+		for (const auto &unit: unit_results)
+		{
+			for (const StackPromotion &promotion: unit)
+			{
+				if (promotion.escape == NULL_REF)
+					graph.set_type(promotion.alloc, NodeType::STACK_ALLOC);
+			}
+			results.insert(results.end(), unit.begin(), unit.end());
+		}
+		unit_results.clear();
+	}
+
+	void StackPromotionPass::dump_results(const SproutGraph &graph, const bool colorize) const
+	{
+		const char *header_color = colorize ? BLUE : "";
+		const char *promoted_color = colorize ? GREEN : "";
+		const char *kept_color = colorize ? YELLOW : "";
+		const char *reset = colorize ? RESET : "";
+
+		const auto describe = [&](const NodeRef ref)
+		{
+			std::cout << "node #" << ref;
+			if (graph.contains(ref))
+				std::cout << " (" << nttostr(graph.type(ref)) << " " << graph.name(ref) << ")";
+		};
+
+		std::cout << header_color << "\nstack promotion results" << reset << "\n";
+		for (const StackPromotion &promotion: results)
+		{
+			std::cout << "  " << (promotion.escape == NULL_REF ? promoted_color : kept_color);
+			describe(promotion.alloc);
+			std::cout << reset;
+
+			if (promotion.escape == NULL_REF)
+			{
+				std::cout << ": on the stack, " << promotion.frees << " frees removed\n";
+				continue;
+			}
+
+			std::cout << ": kept, ";
+			if (promotion.escape == promotion.alloc)
+				std::cout << "its size is not a constant\n";
+			else
+			{
+				std::cout << "escapes through ";
+				describe(promotion.escape);
+				std::cout << "\n";
+			}
+		}
+	}
+}
@@ -0,0 +1,257 @@
+#include <algorithm>
+#include <sparkle/sprout/passes/function.hpp>
+
+namespace sprk
+{
+	NodeRef FunctionEdits::create(const NodeType type, const NodeRef fn_ref, const RegionRef region, std::string name)
+	{
+		StagedNode node;
+		node.type = type;
+		node.fn_ref = fn_ref;
+		node.region = region;
+		node.name = std::move(name);
+		nodes.push_back(std::move(node));
+		return STAGED | static_cast<NodeRef>(nodes.size() - 1);
+	}
+
+	void FunctionEdits::set_value(const NodeRef staged, NodeValue value)
+	{
+		nodes[staged & ~STAGED].value = std::move(value);
+	}
+
+	void FunctionEdits::set_result(const NodeRef staged, const uint32_t result)
+	{
+		nodes[staged & ~STAGED].result = result;
+	}
+
+	RegionRef FunctionEdits::create_region(std::string name,
+	                                       const RegionType type,
+	                                       const RegionRef parent,
+	                                       const RegionRef sibling,
+	                                       const NodeRef ctrl_dep)
+	{
+		staged_regions.push_back({ std::move(name), type, parent, sibling, ctrl_dep });
+		return STAGED_REGION | static_cast<RegionRef>(staged_regions.size() - 1);
+	}
+
+	void FunctionEdits::add_input(const NodeRef staged, const NodeRef input)
+	{
+		nodes[staged & ~STAGED].inputs.push_back(input);
+	}
+
+	void FunctionEdits::move(const NodeRef ref, const RegionRef region)
+	{
+		moves.emplace_back(ref, region);
+	}
+
+	void FunctionEdits::replace_all_uses(const NodeRef from, const NodeRef to)
+	{
+		rewrites.emplace_back(from, to);
+	}
+
+	void FunctionEdits::remove(const NodeRef ref)
+	{
+		removals.push_back(ref);
+	}
+
+	void FunctionEdits::apply(SproutGraph &graph)
+	{
+		created_regions.clear();
+		for (const StagedRegion &staged: staged_regions)
+		{
+			const RegionRef parent = resolve_region(staged.parent);
+			const RegionRef sibling = resolve_region(staged.sibling);
+			const RegionRef ref = graph.create_region(staged.name, staged.type);
+
+			const auto &children = graph.region(parent).get_children();
+			const auto at = std::find(children.begin(), children.end(), sibling);
+			graph.insert_child(parent, ref, (at == children.end() ? children.size() : at - children.begin() + 1));
+			graph.set_imm_dominator(ref, sibling == NULL_REGION ? parent : graph.region(sibling).get_imm_dom());
+			created_regions.push_back(ref);
+		}
+
+		created.clear();
+		for (const StagedNode &node: nodes)
+		{
+			const NodeRef ref = graph.create(node.type);
+			if (!node.name.empty())
+				graph.set_name(ref, node.name);
+			graph.set_fn_ref(ref, node.fn_ref);
+			if (node.value.index() != 0)
+				graph.set_value(ref, node.value);
+			graph.set_result(ref, node.result);
+			created.push_back(ref);
+		}
+
+		/* inputs go in once every staged node has a ref, so staged nodes may read each other */
+		for (size_t i = 0; i < nodes.size(); i++)
+		{
+			for (const NodeRef input: nodes[i].inputs)
+				graph.add_input(created[i], resolve(input));
+
+			if (nodes[i].region != NULL_REGION)
+				graph.add_node(resolve_region(nodes[i].region), created[i]);
+		}
+
+		/* a staged region may run under a staged control */
+		for (size_t i = 0; i < staged_regions.size(); i++)
+		{
+			if (staged_regions[i].ctrl_dep != NULL_REF)
+				graph.set_ctrl_deps(created_regions[i], resolve(staged_regions[i].ctrl_dep));
+		}
+
+		/* a moved node is appended to its new region; the old list drops it below */
+		std::vector<RegionRef> touched;
+		for (const auto &[ref, region]: moves)
+		{
+			if (const RegionRef from = graph.region_of(ref); from != NULL_REGION)
+				touched.push_back(from);
+			graph.add_node(resolve_region(region), ref);
+		}
+
+		for (const auto &[from, to]: rewrites)
+			graph.replace_all_uses(resolve(from), resolve(to));
+
+		for (const NodeRef removal: removals)
+		{
+			const NodeRef ref = resolve(removal);
+			if (!graph.contains(ref) || !graph.users(ref).empty() || (graph.flags(ref) & NODE_PINNED))
+				continue;
+
+			if (const RegionRef region = graph.region_of(ref); region != NULL_REGION)
+				touched.push_back(region);
+			graph.remove(ref);
+		}
+
+		/* a function's removals usually share a handful of regions */
+		std::sort(touched.begin(), touched.end());
+		touched.erase(std::unique(touched.begin(), touched.end()), touched.end());
+		for (const RegionRef region: touched)
+		{
+			std::vector<NodeRef> live_nodes;
+			for (const NodeRef node: graph.region(region).get_nodes())
+			{
+				if (graph.contains(node) && graph.region_of(node) == region)
+					live_nodes.push_back(node);
+			}
+			graph.replace_nodes(region, std::move(live_nodes));
+		}
+	}
+
+	NodeRef FunctionEdits::resolve(const NodeRef ref) const
+	{
+		return is_staged(ref) ? created[ref & ~STAGED] : ref;
+	}
+
+	RegionRef FunctionEdits::resolve_region(const RegionRef ref) const
+	{
+		return is_staged_region(ref) ? created_regions[ref & ~STAGED_REGION] : ref;
+	}
+
+	void FunctionPass::run(const RegionRef root, SproutGraph &graph)
+	{
+		FunctionPassDriver(1).run(*this, root, graph);
+	}
+
+	void FunctionPassDriver::run(FunctionPass &pass, const RegionRef root, SproutGraph &graph)
+	{
+		partition(root, graph);
+
+		/* the tree rebuilds lazily; build it now so workers only read it */
+		static_cast<void>(graph.dominator_tree());
+
+		const size_t unit_count = unit_regions.size();
+		pass.begin(graph, unit_count);
+
+		scratch.resize(pool.size());
+		for (WorkerScratch &s: scratch)
+		{
+			s.reset();
+			s.marks.resize(graph.size());
+			s.region_marks.resize(graph.region_count());
+		}
+
+		std::vector<FunctionEdits> edits(unit_count);
+		const SproutGraph &shared = graph;
+		pool.run(unit_count, [&](const size_t i, const unsigned worker)
+		{
+			FunctionUnit unit;
+			unit.index = i;
+			unit.region = unit_regions[i];
+			unit.nodes = { unit_nodes.data() + unit_offsets[i], unit_offsets[i + 1] - unit_offsets[i] };
+
+			pass.run_function(unit, shared, scratch[worker], edits[i]);
+			scratch[worker].reset();
+		});
+
+		/* serial merge in region order keeps NodeRefs identical for any thread count */
+		for (FunctionEdits &e: edits)
+		{
+			if (!e.empty())
+				e.apply(graph);
+		}
+
+		pass.finish(root, graph, edits);
+	}
+
+	void FunctionPassDriver::partition(const RegionRef root, const SproutGraph &graph)
+	{
+		unit_regions.clear();
+
+		/*
+		 * outermost FUNCTION region above each region, in preorder; the rest share
+		 * the last unit. regions outside the root's subtree belong to no unit, so
+		 * a FUNCTION root runs the pass on that one function
+		 */
+		constexpr uint32_t OUTSIDE = UINT32_MAX - 1;
+		std::vector<uint32_t> unit_of(graph.region_count(), OUTSIDE);
+		std::vector<std::pair<RegionRef, uint32_t> > stack;
+		if (root != NULL_REGION)
+			stack.emplace_back(root, UINT32_MAX);
+
+		while (!stack.empty())
+		{
+			auto [region, unit] = stack.back();
+			stack.pop_back();
+
+			if (unit == UINT32_MAX && graph.region(region).get_type() == RegionType::FUNCTION)
+			{
+				unit = static_cast<uint32_t>(unit_regions.size());
+				unit_regions.push_back(region);
+			}
+			unit_of[region] = unit;
+
+			const auto &children = graph.region(region).get_children();
+			for (auto it = children.rbegin(); it != children.rend(); ++it)
+				stack.emplace_back(*it, unit);
+		}
+
+		const auto rest = static_cast<uint32_t>(unit_regions.size());
+		unit_regions.push_back(NULL_REGION);
+
+		const auto unit_for = [&](const NodeRef ref)
+		{
+			const RegionRef region = graph.region_of(ref);
+			return (region == NULL_REGION || unit_of[region] == UINT32_MAX) ? rest : unit_of[region];
+		};
+
+		/* counting sort keeps each unit's nodes in ascending order */
+		unit_offsets.assign(unit_regions.size() + 1, 0);
+		for (NodeRef i = 0; i < graph.size(); i++)
+		{
+			if (graph.contains(i) && unit_for(i) != OUTSIDE)
+				unit_offsets[unit_for(i) + 1]++;
+		}
+
+		for (size_t u = 1; u < unit_offsets.size(); u++)
+			unit_offsets[u] += unit_offsets[u - 1];
+
+		unit_nodes.resize(unit_offsets.back());
+		std::vector<uint32_t> cursor(unit_offsets.begin(), unit_offsets.end() - 1);
+		for (NodeRef i = 0; i < graph.size(); i++)
+		{
+			if (graph.contains(i) && unit_for(i) != OUTSIDE)
+				unit_nodes[cursor[unit_for(i)]++] = i;
+		}
+	}
+}
@@ -0,0 +1,295 @@
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <unordered_map>
+#include <sparkle/sprout/passes/gvn.hpp>
+#include <sparkle/sprout/utils/dump.hpp>
+
+namespace sprk
+{
+	namespace
+	{
+		/* pure, memory-free nodes whose value is fixed by their key */
+		bool is_numberable(const NodeType type)
+		{
+			switch (type)
+			{
+				case NodeType::CONST:
+				case NodeType::ADD:
+				case NodeType::SUB:
+				case NodeType::MUL:
+				case NodeType::DIV:
+				case NodeType::CMP:
+				case NodeType::PTR_ADD:
+				case NodeType::REINTERPRET_CAST:
+					return true;
+				default:
+					return false;
+			}
+		}
+
+		bool is_commutative(const NodeType type)
+		{
+			return type == NodeType::ADD || type == NodeType::MUL;
+		}
+
+		uint64_t mix(uint64_t hash, const uint64_t value)
+		{
+			hash ^= value + 0x9e3779b97f4a7c15ull + (hash << 6) + (hash >> 2);
+			return hash;
+		}
+
+		uint64_t hash_value(const NodeValue &value)
+		{
+			uint64_t bits = value.index();
+			if (const auto *i = std::get_if<int64_t>(&value))
+				bits = mix(bits, static_cast<uint64_t>(*i));
+			else if (const auto *d = std::get_if<double>(&value))
+			{
+				uint64_t raw;
+				std::memcpy(&raw, d, sizeof(raw));
+				bits = mix(bits, raw);
+			}
+			else if (const auto *p = std::get_if<void *>(&value))
+				bits = mix(bits, reinterpret_cast<uintptr_t>(*p));
+			else if (const auto *r = std::get_if<NodeRef>(&value))
+				bits = mix(bits, *r);
+			else if (const auto *s = std::get_if<StringId>(&value))
+				bits = mix(bits, static_cast<uint32_t>(*s));
+			return bits;
+		}
+
+		/* doubles compare by bits so a NaN constant still matches itself */
+		bool same_value(const NodeValue &a, const NodeValue &b)
+		{
+			if (a.index() != b.index())
+				return false;
+
+			if (const auto *d = std::get_if<double>(&a))
+				return std::memcmp(d, &std::get<double>(b), sizeof(double)) == 0;
+			return a == b;
+		}
+
+		/*
+		 * open-addressing table from value key to leader nodes. keys are kept
+		 * beside the slots with their operands in one pool, so a probe hit is
+		 * confirmed field by field and a hash collision never folds
+		 */
+		class ValueTable
+		{
+		public:
+			struct Key
+			{
+				NodeType type;
+				uint32_t result;
+				const NodeValue *value;
+				const NodeRef *operands;
+				uint32_t operand_count;
+				uint64_t hash;
+			};
+
+			explicit ValueTable(const size_t expected)
+			{
+				size_t capacity = 16;
+				while (capacity < expected * 2)
+					capacity *= 2;
+				slots.assign(capacity, UINT32_MAX);
+			}
+
+			/* calls accept(leader) for each entry with an equal key until it returns true */
+			template<typename Accept>
+			NodeRef find(const Key &key, Accept &&accept) const
+			{
+				const size_t mask = slots.size() - 1;
+				for (size_t i = key.hash & mask; slots[i] != UINT32_MAX; i = (i + 1) & mask)
+				{
+					const Entry &entry = entries[slots[i]];
+					if (entry.hash == key.hash && equal(entry, key) && accept(entry.leader))
+						return entry.leader;
+				}
+
+				return NULL_REF;
+			}
+
+			void insert(const Key &key, const NodeRef leader)
+			{
+				if ((entries.size() + 1) * 2 > slots.size())
+					grow();
+
+				Entry entry;
+				entry.type = key.type;
+				entry.result = key.result;
+				entry.value = *key.value;
+				entry.operand_offset = static_cast<uint32_t>(operand_pool.size());
+				entry.operand_count = key.operand_count;
+				entry.hash = key.hash;
+				entry.leader = leader;
+				operand_pool.insert(operand_pool.end(), key.operands, key.operands + key.operand_count);
+
+				place(static_cast<uint32_t>(entries.size()), key.hash);
+				entries.push_back(std::move(entry));
+			}
+
+		private:
+			struct Entry
+			{
+				NodeType type;
+				uint32_t result;
+				NodeValue value;
+				uint32_t operand_offset;
+				uint32_t operand_count;
+				uint64_t hash;
+				NodeRef leader;
+			};
+
+			std::vector<uint32_t> slots; /* entry index or UINT32_MAX */
+			std::vector<Entry> entries;
+			std::vector<NodeRef> operand_pool;
+
+			bool equal(const Entry &entry, const Key &key) const
+			{
+				return entry.type == key.type && entry.result == key.result &&
+				       entry.operand_count == key.operand_count &&
+				       std::equal(key.operands, key.operands + key.operand_count,
+				                  operand_pool.begin() + entry.operand_offset) &&
+				       same_value(entry.value, *key.value);
+			}
+
+			void place(const uint32_t index, const uint64_t hash)
+			{
+				const size_t mask = slots.size() - 1;
+				size_t i = hash & mask;
+				while (slots[i] != UINT32_MAX)
+					i = (i + 1) & mask;
+				slots[i] = index;
+			}
+
+			void grow()
+			{
+				slots.assign(slots.size() * 2, UINT32_MAX);
+				for (uint32_t e = 0; e < entries.size(); e++)
+					place(e, entries[e].hash);
+			}
+		};
+	}
+
+	void GVNPass::begin(const SproutGraph &graph, const size_t unit_count)
+	{
+		folds.clear();
+		unit_folds.assign(unit_count, {});
+	}
+
+	void GVNPass::run_function(const FunctionUnit &unit,
+	                           const SproutGraph &graph,
+	                           WorkerScratch &scratch,
+	                           FunctionEdits &edits)
+	{
+		/* region order: parent before children; nodes outside functions in ref order */
+		std::vector<NodeRef> order;
+		if (unit.region == NULL_REGION)
+			order.assign(unit.nodes.begin(), unit.nodes.end());
+		else
+		{
+			std::vector<RegionRef> stack = { unit.region };
+			while (!stack.empty())
+			{
+				const RegionRef region = stack.back();
+				stack.pop_back();
+
+				for (const NodeRef node: graph.region(region).get_nodes())
+				{
+					if (graph.contains(node))
+						order.push_back(node);
+				}
+
+				const auto &children = graph.region(region).get_children();
+				stack.insert(stack.end(), children.rbegin(), children.rend());
+			}
+		}
+
+		/* leader of every node folded so far; operands are read through it */
+		std::unordered_map<NodeRef, NodeRef> leader_of;
+		const auto leader = [&leader_of](const NodeRef ref)
+		{
+			const auto it = leader_of.find(ref);
+			return it == leader_of.end() ? ref : it->second;
+		};
+
+		/* a leader is usable if its region contains or dominates the node's */
+		const auto available = [&graph](const NodeRef leader_ref, const NodeRef node)
+		{
+			const RegionRef from = graph.region_of(leader_ref);
+			const RegionRef to = graph.region_of(node);
+			if (from == to)
+				return true;
+			if (from == NULL_REGION || to == NULL_REGION)
+				return false;
+
+			for (RegionRef r = graph.region(to).get_parent(); r != NULL_REGION; r = graph.region(r).get_parent())
+			{
+				if (r == from)
+					return true;
+			}
+
+			return graph.dominates(from, to);
+		};
+
+		ValueTable table(order.size());
+		std::vector<NodeRef> operands;
+		for (const NodeRef node: order)
+		{
+			const NodeType type = graph.type(node);
+			if (!is_numberable(type))
+				continue;
+
+			operands.clear();
+			for (const NodeRef input: graph.inputs(node))
+				operands.push_back(leader(input));
+			if (is_commutative(type))
+				std::sort(operands.begin(), operands.end());
+
+			uint64_t hash = mix(static_cast<uint64_t>(type), graph.result(node));
+			hash = mix(hash, hash_value(graph.value(node)));
+			for (const NodeRef operand: operands)
+				hash = mix(hash, operand);
+
+			const ValueTable::Key key = {
+				type, graph.result(node), &graph.value(node),
+				operands.data(), static_cast<uint32_t>(operands.size()), hash
+			};
+
+			const NodeRef found = table.find(key, [&](const NodeRef candidate) { return available(candidate, node); });
+			if (found == NULL_REF)
+			{
+				table.insert(key, node);
+				continue;
+			}
+
+			leader_of[node] = found;
+			edits.replace_all_uses(node, found);
+			edits.remove(node);
+			unit_folds[unit.index].push_back({ node, found });
+		}
+	}
+
+	void GVNPass::finish(const RegionRef root,
+	                     SproutGraph &graph,
+	                     const std::vector<FunctionEdits> &edits)
+	{
+		for (const auto &unit: unit_folds)
+			folds.insert(folds.end(), unit.begin(), unit.end());
+		unit_folds.clear();
+	}
+
+	void GVNPass::dump_results(const bool colorize) const
+	{
+		const char *header_color = colorize ? BLUE : "";
+		const char *fold_color = colorize ? GREEN : "";
+		const char *reset = colorize ? RESET : "";
+
+		std::cout << header_color << "\nGVN results" << reset << "\n";
+		std::cout << "folded " << folds.size() << " nodes:" << "\n";
+		for (const GVNFold &fold: folds)
+			std::cout << "  " << fold_color << "node #" << fold.node << " -> #" << fold.leader << reset << "\n";
+	}
+}
@@ -1,31 +1,36 @@
 #include <algorithm>
+#include <functional>
 #include <iostream>
 #include <sparkle/sprout/passes/ipa.hpp>
 #include <sparkle/sprout/utils/dump.hpp>
+#include <sparkle/sprout/utils/irutils.hpp>
 
 namespace sprk
 {
-	void IPAPass::run(const std::shared_ptr<SproutRegion> &root, std::vector<std::unique_ptr<SproutNode<> > > &nodes)
+	void IPAPass::run(const RegionRef root, SproutGraph &graph)
 	{
 		ipa_results = {}; /* clear */
-
-		build_call_graph(nodes);
-		analyze_function_purity(nodes);
-		find_const_prop_opp(nodes);
-		find_inline_opp(nodes);
+		profile_counts = profile ? profile->bind(root, graph) : ProfileCounts {};
+		ipa_results.stale_records = profile_counts.get_stale();
+
+		build_call_graph(graph);
+		build_sccs(graph);
+		analyze_function_purity(graph);
+		find_const_prop_opp(graph);
+		find_inline_opp(graph);
 	}
 
-	void IPAPass::build_call_graph(const std::vector<std::unique_ptr<SproutNode<>>>& nodes)
+	void IPAPass::build_call_graph(const SproutGraph& graph)
 	{
-		for (const auto& node : nodes)
+		for (NodeRef i = 0; i < graph.size(); ++i)
 		{
-			if (!node || node->type != NodeType::CALL)
+			if (!graph.contains(i) || graph.type(i) != NodeType::CALL)
 				continue;
 
-			if (node->input_count > 0) /* find the function being called */
+			if (const NodeSpan inputs = graph.inputs(i); !inputs.empty()) /* find the function being called */
 			{
-				NodeRef caller_fn = node->fn_ref;
-				NodeRef callee_fn = node->inputs[0];
+				NodeRef caller_fn = graph.fn_ref(i);
+				NodeRef callee_fn = inputs[0];
 
 				if (caller_fn != NULL_REF && callee_fn != NULL_REF)
 					ipa_results.call_graph[caller_fn].push_back(callee_fn);
@@ -33,27 +38,94 @@ namespace sprk
 		}
 	}
 
-	void IPAPass::analyze_function_purity(const std::vector<std::unique_ptr<SproutNode<> > > &nodes)
+	void IPAPass::build_sccs(const SproutGraph &graph)
+	{
+		std::unordered_map<NodeRef, uint32_t> index;
+		std::unordered_map<NodeRef, uint32_t> low;
+		std::unordered_set<NodeRef> on_stack;
+		std::vector<NodeRef> stack;
+
+		std::function<void(NodeRef)> connect = [&](const NodeRef fn)
+		{
+			const auto order = static_cast<uint32_t>(index.size());
+			index[fn] = order;
+			low[fn] = order;
+			stack.push_back(fn);
+			on_stack.insert(fn);
+
+			if (const auto it = ipa_results.call_graph.find(fn); it != ipa_results.call_graph.end())
+			{
+				for (const NodeRef callee: it->second)
+				{
+					if (!graph.contains(callee) || graph.type(callee) != NodeType::FUNCTION)
+						continue;
+
+					if (!index.count(callee))
+					{
+						connect(callee);
+						low[fn] = std::min(low[fn], low[callee]);
+					}
+					else if (on_stack.count(callee))
+					{
+						low[fn] = std::min(low[fn], index[callee]);
+					}
+
+					if (callee == fn)
+						ipa_results.recursive_fns.insert(fn);
+				}
+			}
+
+			/* fn roots a component; everything above it on the stack belongs to it */
+			if (low[fn] != index[fn])
+				return;
+
+			std::vector<NodeRef> scc;
+			NodeRef member;
+			do
+			{
+				member = stack.back();
+				stack.pop_back();
+				on_stack.erase(member);
+				ipa_results.scc_of[member] = static_cast<uint32_t>(ipa_results.sccs.size());
+				scc.push_back(member);
+			}
+			while (member != fn);
+
+			if (scc.size() > 1)
+				ipa_results.recursive_fns.insert(scc.begin(), scc.end());
+
+			std::sort(scc.begin(), scc.end());
+			ipa_results.sccs.push_back(std::move(scc));
+		};
+
+		for (NodeRef i = 0; i < graph.size(); ++i)
+		{
+			if (graph.contains(i) && graph.type(i) == NodeType::FUNCTION && !index.count(i))
+				connect(i);
+		}
+	}
+
+	void IPAPass::analyze_function_purity(const SproutGraph &graph)
 	{
 		/* 1st pass: analyze all fn nodes */
 		std::unordered_set<NodeRef> potential;
-		for (size_t i = 0; i < nodes.size(); ++i)
+		for (NodeRef i = 0; i < graph.size(); ++i)
 		{
-			if (!nodes[i] || nodes[i]->type != NodeType::FUNCTION)
+			if (!graph.contains(i) || graph.type(i) != NodeType::FUNCTION)
 				continue;
 			potential.insert(i);
 		}
 
 		/* 2nd pass: check impurity */
-		for (const auto& node : nodes)
+		for (NodeRef i = 0; i < graph.size(); ++i)
 		{
-			if (!node)
+			if (!graph.contains(i))
 				continue;
 
 			/* if this is pure */
-			if (!is_pure_node(node.get()))
+			if (!is_pure_node(graph.type(i)))
 			{
-				NodeRef fn = node->fn_ref;
+				NodeRef fn = graph.fn_ref(i);
 				potential.erase(fn);
 			}
 		}
@@ -62,21 +134,21 @@ namespace sprk
 		ipa_results.pure_fns = potential;
 	}
 
-	void IPAPass::find_const_prop_opp(const std::vector<std::unique_ptr<SproutNode<> > > &nodes)
+	void IPAPass::find_const_prop_opp(const SproutGraph &graph)
 	{
-		for (size_t i = 0; i < nodes.size(); ++i)
+		for (NodeRef i = 0; i < graph.size(); ++i)
 		{
-			if (!nodes[i] || nodes[i]->type != NodeType::CALL_PARAM)
+			if (!graph.contains(i) || graph.type(i) != NodeType::CALL_PARAM)
 				continue;
 
 			/* if it is a literal/constant */
-			if (nodes[i]->input_count == 2)
+			if (graph.inputs(i).size() == 2)
 			{
-				if (NodeRef constant = nodes[i]->inputs[1];
-					nodes[constant] && nodes[constant]->type == NodeType::CONST)
+				if (NodeRef constant = graph.inputs(i)[1];
+					graph.contains(constant) && graph.type(constant) == NodeType::CONST)
 				{
 					IPAResult::ConstPropOpp opp = {};
-					opp.function = nodes[i]->fn_ref;
+					opp.function = graph.fn_ref(i);
 					opp.param = i;
 					opp.const_val = constant;
 					ipa_results.const_opps.push_back(opp);
@@ -85,48 +157,58 @@ namespace sprk
 		}
 	}
 
-	void IPAPass::find_inline_opp(const std::vector<std::unique_ptr<SproutNode<> > > &nodes)
+	void IPAPass::find_inline_opp(const SproutGraph &graph)
 	{
-		for (const auto& [caller, callees] : ipa_results.call_graph)
+		/* one opportunity per call site, in the function that holds it */
+		for (NodeRef i = 0; i < graph.size(); ++i)
 		{
-			for (const NodeRef calle2 : callees)
+			if (!graph.contains(i) || graph.type(i) != NodeType::CALL || graph.inputs(i).empty())
+				continue;
+
+			const NodeRef caller = graph.fn_ref(i);
+			const NodeRef callee = graph.inputs(i)[0];
+			if (caller == NULL_REF || !ipa_results.scc_of.count(caller) || !ipa_results.scc_of.count(callee))
+				continue;
+
+			IPAResult::InlineOpp opp;
+			opp.caller = caller;
+			opp.callee = callee;
+			opp.call_site = i;
+			opp.is_recursive = ipa_results.recursive_fns.count(callee) > 0;
+			opp.benefit = compute_inlining_benefit(callee, graph);
+			opp.growth = inlining_growth(i, graph);
+			if (profile)
 			{
-				const bool is_recursive = (caller == calle2);
-				for (size_t i = 0; i < nodes.size(); ++i)
-				{
-					/* find call sites */
-					if (!nodes[i] || nodes[i]->type != NodeType::CALL)
-						continue;
+				opp.count = profile_counts.call_count(i, graph);
+				ipa_results.max_count = std::max(ipa_results.max_count, opp.count);
+			}
 
-					if (nodes[i]->inputs[0] == calle2)
-					{
-						IPAResult::InlineOpp opp;
-						opp.caller = caller;
-						opp.callee = calle2;
-						opp.call_site = i;
-						opp.is_recursive = is_recursive;
-						opp.benefit = compute_inlining_benefit(calle2, nodes);
-
-						ipa_results.inline_opps.push_back(opp);
-					}
-				}
+			ipa_results.inline_opps.push_back(opp);
+		}
+
+		/* hotness against the hottest site, in [0, 100]; a site that never ran gains nothing */
+		if (profile && !profile->empty())
+		{
+			for (IPAResult::InlineOpp &opp: ipa_results.inline_opps)
+			{
+				opp.benefit = opp.count == 0
+					              ? 0
+					              : opp.benefit + static_cast<uint32_t>(opp.count * 100 / ipa_results.max_count);
 			}
 		}
 
-		std::sort(ipa_results.inline_opps.begin(),
+		/* bottom-up: the callers of one component after every component they call */
+		std::stable_sort(ipa_results.inline_opps.begin(),
 			  ipa_results.inline_opps.end(),
-			  [&nodes](const IPAResult::InlineOpp& a, const IPAResult::InlineOpp& b)
+			  [this, &graph](const IPAResult::InlineOpp& a, const IPAResult::InlineOpp& b)
 			  {
-				  const auto size_a = std::count_if(nodes.begin(), nodes.end(),
-					  [&](const auto& node)
-					  {
-						  return node && node->fn_ref == a.callee;
-					  });
-				  const auto size_b = std::count_if(nodes.begin(), nodes.end(),
-					  [&](const auto& node)
-					  {
-						  return node && node->fn_ref == b.callee;
-					  });
+				  const uint32_t scc_a = ipa_results.scc_of.at(a.caller);
+				  const uint32_t scc_b = ipa_results.scc_of.at(b.caller);
+				  if (scc_a != scc_b)
+					  return scc_a < scc_b;
+
+				  const auto size_a = function_size(a.callee, graph);
+				  const auto size_b = function_size(b.callee, graph);
 
 				  if (size_a != size_b)
 					  return size_a > size_b;
@@ -136,7 +218,7 @@ namespace sprk
 			  });
 	}
 
-	bool IPAPass::is_pure_node(const SproutNode<> *node) const
+	bool IPAPass::is_pure_node(const NodeType type) const
 	{
 		/* note: maybe make this constexpr */
 		static const std::unordered_set pure_types = {
@@ -149,17 +231,13 @@ namespace sprk
 			NodeType::CMP
 		};
 
-		return pure_types.count(node->type) > 0;
+		return pure_types.count(type) > 0;
 	}
 
-	uint16_t IPAPass::compute_inlining_benefit(const NodeRef callee, const std::vector<std::unique_ptr<SproutNode<> > > &nodes) const
+	uint32_t IPAPass::compute_inlining_benefit(const NodeRef callee, const SproutGraph &graph) const
 	{
 		auto benefit = 0;
-		auto size = std::count_if(nodes.begin(), nodes.end(),
-			[callee](const auto& node)
-			{
-				return node && node->fn_ref == callee;
-			});
+		auto size = function_size(callee, graph);
 
 		if (size > 50)
 			return 0;
@@ -221,6 +299,18 @@ namespace sprk
 			std::cout << std::endl;
 		}
 
+		/* dump components, bottom-up */
+		std::cout << blue << "\ncall graph SCCs (bottom-up):" << reset << std::endl;
+		for (size_t i = 0; i < ipa_results.sccs.size(); i++)
+		{
+			std::cout << "  scc " << i << ": ";
+			for (const NodeRef fn : ipa_results.sccs[i])
+				std::cout << fn << " ";
+			if (ipa_results.recursive_fns.count(ipa_results.sccs[i][0]))
+				std::cout << "[RECURSIVE]";
+			std::cout << std::endl;
+		}
+
 		/* dump pure functions */
 		std::cout << blue << "\npure fns:" << reset << std::endl;
 		for (NodeRef pure_fn : ipa_results.pure_fns)
@@ -237,14 +327,25 @@ namespace sprk
 
 		/* inlining opp */
 		std::cout << blue << "\ninlining opportunities:" << reset << std::endl;
-		for (const auto&[caller, callee, call_site, benefit, is_recursive] : ipa_results.inline_opps)
+		for (const auto&[caller, callee, call_site, benefit, count, growth, is_recursive] : ipa_results.inline_opps)
 		{
 			std::cout << "  inline function #" << callee
 					  << " into function #" << caller
 					  << " at call site #" << call_site
-					  << " (benefit: " << benefit << ")"
+					  << " (benefit: " << benefit << ", growth: " << growth;
+			if (profile && !profile->empty())
+				std::cout << ", count: " << count;
+			std::cout << ")"
 					  << (is_recursive ? " [RECURSIVE]" : "")
 					  << std::endl;
 		}
+
+		/* records that counted nothing; they come from a different build of the module */
+		if (!ipa_results.stale_records.empty())
+		{
+			std::cout << blue << "\nstale profile records:" << reset << std::endl;
+			for (const std::string &record : ipa_results.stale_records)
+				std::cout << "  " << record << std::endl;
+		}
 	}
 }
@@ -1,27 +1,28 @@
+#include <algorithm>
+#include <sparkle/sprout/passes/dce.hpp>
+#include <sparkle/sprout/passes/gvn.hpp>
 #include <sparkle/sprout/passes/ipo.hpp>
+#include <sparkle/sprout/passes/pre.hpp>
+#include <sparkle/sprout/passes/sccp.hpp>
 #include <sparkle/sprout/utils/dump.hpp>
 #include <sparkle/sprout/utils/irutils.hpp>
 
 namespace sprk
 {
-	void IPOPass::run(const std::shared_ptr<SproutRegion> &root, std::vector<std::unique_ptr<SproutNode<> > > &nodes)
+	void IPOPass::run(const RegionRef root, SproutGraph &graph)
 	{
 		ipo_results = {};
+		functions_to_remove.clear();
+		dirty_nodes.clear();
 
-		next_node_id = 0;
-		for (size_t i = 0; i < nodes.size(); i++)
-		{
-			if (nodes[i])
-				next_node_id = std::max(next_node_id, static_cast<NodeRef>(i + 1));
-		}
-
-		prop_constant(nodes);
-		perform_inlining(root, nodes);
+		/* an inlined call takes its constant arguments along; the calls left get them after */
+		perform_inlining(graph);
+		prop_constant(graph);
 		if (!functions_to_remove.empty())
-			remove_dead_functions(root, nodes);
+			remove_dead_functions(root, graph);
 	}
 
-	void IPOPass::prop_constant(const std::vector<std::unique_ptr<SproutNode<> > > &nodes)
+	void IPOPass::prop_constant(SproutGraph &graph)
 	{
 		const auto &const_opps = ipa_pass->get_results().const_opps;
 		for (const auto &opp: const_opps)
@@ -29,256 +30,318 @@ namespace sprk
 			NodeRef param = opp.param;
 			NodeRef const_val = opp.const_val;
 
-			if (param >= nodes.size() || !nodes[param] ||
-			    const_val >= nodes.size() || !nodes[const_val])
+			if (!graph.contains(param) || !graph.contains(const_val))
 			{
 				continue;
 			}
 
-			/* cpy users of the parameter to replace */
-			std::vector<NodeRef> users;
-			users.reserve(nodes[param]->user_count);
-			for (uint8_t i = 0; i < nodes[param]->user_count; i++)
-				users.push_back(nodes[param]->users[i]);
+			/* each use slot of the parameter counts as one replacement */
+			ipo_results.const_replaced += graph.users(param).size();
+			graph.replace_all_uses(param, const_val);
+
+			/* record */
+			ipo_results.const_props.emplace_back(param, const_val);
+		}
+	}
+
+	void IPOPass::perform_inlining(SproutGraph &graph)
+	{
+		const IPAResult &ipa_results = ipa_pass->get_results();
+		const auto &inline_opps = ipa_results.inline_opps;
+
+		const std::unordered_set<size_t> selected = select_inlines(graph);
 
-			for (const NodeRef user: users)
+		/* a component is cleaned up when something is inlined into it or it is about to be cloned */
+		std::unordered_set<NodeRef> cloned;
+		for (const size_t i: selected)
+			cloned.insert(inline_opps[i].callee);
+
+		/* the opportunities come sorted by the component of their caller, callees first */
+		size_t next = 0;
+		for (uint32_t scc = 0; scc < ipa_results.sccs.size(); scc++)
+		{
+			bool changed = false;
+			for (; next < inline_opps.size() && ipa_results.scc_of.at(inline_opps[next].caller) == scc; next++)
 			{
-				if (user >= nodes.size() || !nodes[user])
+				const auto &opp = inline_opps[next];
+				if (opp.is_recursive)
+				{
+					/* cloning a body that calls itself back only moves the call; keep it */
+					ipo_results.recursive_calls.push_back(opp.call_site);
 					continue;
+				}
+
+				if (!selected.count(next) || !can_inline(opp, graph))
+					continue;
+
+				/* the callee may have grown or shrunk since it was costed */
+				const int32_t growth = inlining_growth(opp.call_site, graph);
+				if (growth > 0 && ipo_results.growth + growth > ipo_results.budget)
+				{
+					ipo_results.over_budget_calls.push_back(opp.call_site);
+					continue;
+				}
+				ipo_results.growth += growth;
 
-				for (uint8_t i = 0; i < nodes[user]->input_count; i++)
+				NodeRef caller_fn = opp.caller;
+				NodeRef callee_fn = opp.callee;
+				const NodeRef call_site = opp.call_site;
+				const RegionRef callee_region = find_function_region(callee_fn, graph);
+				const RegionRef call_region = find_node_region(call_site, graph);
+
+				/* map parameter to args */
+				std::map<NodeRef, NodeRef> param_to_arg;
+				map_params_to_args(callee_fn, call_site, graph, param_to_arg);
+				const NodeRef returned = graph.inputs(collect_function_returns(callee_fn, graph)[0])[0];
+
+				/* inline all nodes */
+				inline_function_body(callee_region, call_region, graph);
+
+				/* connect & replace all */
+				connect_inlined_nodes(graph);
+				for (const auto &[orig, clone]: orig_to_clone)
+					graph.set_fn_ref(clone, caller_fn);
+
+				for (const auto &[param, arg]: param_to_arg)
 				{
-					if (nodes[user]->inputs[i] == param)
+					if (orig_to_clone.find(param) != orig_to_clone.end())
 					{
-						nodes[user]->inputs[i] = const_val;
-						auto already_user = false;
-						for (uint8_t j = 0; j < nodes[const_val]->user_count; j++)
-						{
-							if (nodes[const_val]->users[j] == user)
-							{
-								already_user = true;
-								break;
-							}
-						}
-
-						if (!already_user && nodes[const_val]->user_count < 4) /* max users */
-							nodes[const_val]->users[nodes[const_val]->user_count++] = user;
-
-						ipo_results.const_replaced++;
+						graph.replace_all_uses(orig_to_clone[param], arg);
+						dirty_nodes.push_back(orig_to_clone[param]);
 					}
 				}
+
+				/* the returned value may be an argument, a clone, or a node the callee only reads */
+				NodeRef inlined_ret_val = returned;
+				if (const auto arg = param_to_arg.find(returned); arg != param_to_arg.end())
+					inlined_ret_val = arg->second;
+				else if (const auto clone = orig_to_clone.find(returned); clone != orig_to_clone.end())
+					inlined_ret_val = clone->second;
+
+				replace_call_with_inlined(call_site, inlined_ret_val, graph);
+				ipo_results.removed_calls++;
+
+				/* record */
+				ipo_results.inlined_functions.emplace_back(caller_fn, callee_fn);
+				changed = true;
 			}
 
-			/* record */
-			ipo_results.const_props.emplace_back(param, const_val);
+			const std::vector<NodeRef> &functions = ipa_results.sccs[scc];
+			if (changed || std::any_of(functions.begin(), functions.end(),
+			                           [&](const NodeRef fn) { return cloned.count(fn) > 0; }))
+			{
+				simplify_component(functions, graph);
+			}
 		}
 	}
 
-	void IPOPass::perform_inlining(const std::shared_ptr<SproutRegion> &root,
-	                               std::vector<std::unique_ptr<SproutNode<> > > &nodes)
+	std::unordered_set<size_t> IPOPass::select_inlines(const SproutGraph &graph)
 	{
 		const auto &inline_opps = ipa_pass->get_results().inline_opps;
-		//std::cout << "total inlining opportunities: " << inline_opps.size() << std::endl;
-		for (const auto &opp: inline_opps)
+
+		int64_t module_size = 0;
+		for (NodeRef i = 0; i < graph.size(); i++)
+			module_size += graph.contains(i);
+		ipo_results.budget = std::max<int64_t>(module_size * growth_percent / 100, min_growth);
+
+		std::vector<size_t> order;
+		for (size_t i = 0; i < inline_opps.size(); i++)
+		{
+			if (!inline_opps[i].is_recursive && can_inline(inline_opps[i], graph))
+				order.push_back(i);
+		}
+
+		/* sites that shrink first, then benefit per node of growth; ties keep the IPA's order */
+		std::stable_sort(order.begin(), order.end(), [&](const size_t a, const size_t b)
 		{
-			// std::cout << "considering inlining function #" << opp.callee
-			// 	  << " into function #" << opp.caller
-			// 	  << " at call site #" << opp.call_site
-			// 	  << " (benefit: " << opp.benefit
-			// 	  << ", recursive: " << opp.is_recursive << ")" << std::endl;
-			if (opp.is_recursive)
-				continue; /* note: do tailcall or mark here probably */
-
-			NodeRef caller_fn = opp.caller;
-			NodeRef callee_fn = opp.callee;
-			const NodeRef call_site = opp.call_site;
-
-			if (caller_fn >= nodes.size() || !nodes[caller_fn] ||
-			    callee_fn >= nodes.size() || !nodes[callee_fn] ||
-			    call_site >= nodes.size() || !nodes[call_site])
+			const IPAResult::InlineOpp &lhs = inline_opps[a];
+			const IPAResult::InlineOpp &rhs = inline_opps[b];
+			if ((lhs.growth <= 0) != (rhs.growth <= 0))
+				return lhs.growth <= 0;
+			if (lhs.growth <= 0)
+				return false;
+
+			return static_cast<uint64_t>(lhs.benefit) * rhs.growth > static_cast<uint64_t>(rhs.benefit) * lhs.growth;
+		});
+
+		std::unordered_set<size_t> selected;
+		int64_t planned = 0;
+		for (const size_t i: order)
+		{
+			const IPAResult::InlineOpp &opp = inline_opps[i];
+			if (opp.growth <= 0)
 			{
+				selected.insert(i);
 				continue;
 			}
 
-			const auto caller_region = find_function_region(caller_fn, root);
-			const auto callee_region = find_function_region(callee_fn, root);
-			auto call_region = find_node_region(call_site, root);
-			if (!caller_region || !callee_region || !call_region)
+			if (opp.benefit == 0)
+			{
+				ipo_results.unprofitable_calls.push_back(opp.call_site);
 				continue;
+			}
 
-			/* map parameter to args */
-			std::map<NodeRef, NodeRef> param_to_arg;
-			map_params_to_args(callee_fn, call_site, nodes, param_to_arg);
+			if (planned + opp.growth > ipo_results.budget)
+			{
+				ipo_results.over_budget_calls.push_back(opp.call_site);
+				continue;
+			}
 
-			/* inline all nodes */
-			std::vector<NodeRef> inlined_nodes = inline_function_body(callee_region, call_region, nodes);
+			planned += opp.growth;
+			selected.insert(i);
+		}
 
-			/* connect & replace all */
-			connect_inlined_nodes(nodes);
-			for (const auto &[param, arg]: param_to_arg)
-			{
-				if (orig_to_clone.find(param) != orig_to_clone.end())
-				{
-					const NodeRef cloned_param = orig_to_clone[param];
-					std::vector<NodeRef> users;
-					users.reserve(nodes[cloned_param]->user_count);
-					for (uint8_t i = 0; i < nodes[cloned_param]->user_count; i++)
-						users.push_back(nodes[cloned_param]->users[i]);
+		return selected;
+	}
 
-					for (const NodeRef user: users)
-					{
-						if (user >= nodes.size() || !nodes[user])
-							continue;
-
-						for (uint8_t i = 0; i < nodes[user]->input_count; i++)
-						{
-							if (nodes[user]->inputs[i] == cloned_param)
-							{
-								nodes[user]->inputs[i] = arg;
-								if (nodes[arg]->user_count < 4)
-									nodes[arg]->users[nodes[arg]->user_count++] = user;
-							}
-						}
-					}
-				}
-			}
+	void IPOPass::simplify_component(const std::vector<NodeRef> &functions, SproutGraph &graph)
+	{
+		/* calls and stores are roots here, so only values nothing reads go */
+		DCEPass dce(DCEMode::AGGRESSIVE);
+		const auto sweep = [&]
+		{
+			ipo_results.simplified_nodes += dce.remove_dead_from(dirty_nodes, graph).size();
+			dirty_nodes.clear();
+		};
 
-			/* find return value and replace call */
-			if (auto returns = collect_function_returns(callee_fn, nodes);
-				!returns.empty())
-			{
-				if (const NodeRef original_ret = returns[0];
-					original_ret < nodes.size() && nodes[original_ret] &&
-				                                      nodes[original_ret]->input_count > 0)
-				{
-					if (NodeRef ret_val = nodes[original_ret]->inputs[0];
-						orig_to_clone.find(ret_val) != orig_to_clone.end())
-					{
-						const NodeRef inlined_ret_val = orig_to_clone[ret_val];
-						replace_call_with_inlined(call_site, inlined_ret_val, nodes);
-						ipo_results.removed_calls++;
-					}
-				}
-			}
+		/* leftovers of the calls inlined into this component first, so the passes below skip them */
+		sweep();
+		for (const NodeRef fn: functions)
+		{
+			const RegionRef region = find_function_region(fn, graph);
+			if (region == NULL_REGION)
+				continue;
 
-			/* record */
-			ipo_results.inlined_functions.emplace_back(caller_fn, callee_fn);
+			SCCPPass sccp;
+			sccp.run(region, graph);
+			dirty_nodes.insert(dirty_nodes.end(), sccp.get_dirty_nodes().begin(), sccp.get_dirty_nodes().end());
+
+			/* dominated duplicates fold first, so PRE only places what has no dominating copy */
+			GVNPass gvn;
+			gvn.run(region, graph);
+
+			PREPass pre;
+			pre.run(region, graph);
+			dirty_nodes.insert(dirty_nodes.end(), pre.get_dirty_nodes().begin(), pre.get_dirty_nodes().end());
 		}
+		sweep();
 	}
 
-	std::shared_ptr<SproutRegion> IPOPass::clone_region(const std::shared_ptr<SproutRegion> &src_region,
-	                                                    const std::shared_ptr<SproutRegion> &dest_parent,
-	                                                    std::vector<std::unique_ptr<SproutNode<> > > &nodes)
+	bool IPOPass::can_inline(const IPAResult::InlineOpp &opp, const SproutGraph &graph) const
 	{
-		if (!src_region || !dest_parent)
-			return nullptr;
+		if (!graph.contains(opp.caller) || !graph.contains(opp.callee) || !graph.contains(opp.call_site))
+			return false;
+
+		const RegionRef callee_region = find_function_region(opp.callee, graph);
+		if (callee_region == NULL_REGION || find_function_region(opp.caller, graph) == NULL_REGION ||
+		    find_node_region(opp.call_site, graph) == NULL_REGION)
+			return false;
+
+		/* the body lands in the call's region as one block, so nested control flow would be lost */
+		if (!graph.region(callee_region).get_children().empty())
+			return false;
 
-		std::string new_name = src_region->get_name() + "_inlined";
-		auto cloned_region = std::make_shared<SproutRegion>(new_name);
+		const std::vector<NodeRef> returns = collect_function_returns(opp.callee, graph);
+		return returns.size() == 1 && !graph.inputs(returns[0]).empty();
+	}
+
+	RegionRef IPOPass::clone_region(const RegionRef src_region,
+	                                const RegionRef dest_parent,
+	                                SproutGraph &graph)
+	{
+		if (src_region == NULL_REGION || dest_parent == NULL_REGION)
+			return NULL_REGION;
 
-		cloned_region->set_type(src_region->get_type(), src_region->get_type_id());
+		const RegionRef cloned_region = graph.create_region(graph.region(src_region).get_name() + "_inlined",
+		                                                    graph.region(src_region).get_type(),
+		                                                    graph.region(src_region).get_type_id());
 
-		dest_parent->add_child(cloned_region);
-		for (NodeRef node_ref: src_region->get_nodes())
+		graph.add_child(dest_parent, cloned_region);
+		for (NodeRef node_ref: graph.region(src_region).get_nodes())
 		{
-			if (node_ref >= nodes.size() || !nodes[node_ref])
+			if (!graph.contains(node_ref))
 				continue;
 
 			/* skip the boundary IR */
-			if (nodes[node_ref]->type == NodeType::ENTRY ||
-			    nodes[node_ref]->type == NodeType::EXIT ||
-			    nodes[node_ref]->type == NodeType::FUNCTION)
+			if (graph.type(node_ref) == NodeType::ENTRY ||
+			    graph.type(node_ref) == NodeType::EXIT ||
+			    graph.type(node_ref) == NodeType::FUNCTION)
 			{
 				continue;
 			}
 
-			NodeRef cloned_ref = clone_node(node_ref, nodes, next_node_id);
+			NodeRef cloned_ref = clone_node(node_ref, graph);
 			if (cloned_ref == NULL_REF)
 				continue;
 
 			/* save the map */
 			orig_to_clone[node_ref] = cloned_ref;
-			cloned_region->add_node(cloned_ref);
+			graph.add_node(cloned_region, cloned_ref);
 		}
 
-		for (const auto &child: src_region->get_children())
-			clone_region(child, cloned_region, nodes);
+		/* cpy; cloning a child grows the region table */
+		const std::vector<RegionRef> children = graph.region(src_region).get_children();
+		for (const RegionRef child: children)
+			clone_region(child, cloned_region, graph);
 
 		return cloned_region;
 	}
 
-	void IPOPass::connect_inlined_nodes(std::vector<std::unique_ptr<SproutNode<> > > &nodes)
+	void IPOPass::connect_inlined_nodes(SproutGraph &graph)
 	{
 		for (const auto &[orig, clone]: orig_to_clone)
 		{
-			if (orig >= nodes.size() || !nodes[orig] ||
-			    clone >= nodes.size() || !nodes[clone])
+			if (!graph.contains(orig) || !graph.contains(clone))
 			{
 				continue;
 			}
 
-			for (uint8_t i = 0; i < nodes[orig]->input_count; i++)
+			/* cpy; appending to the clone may move the input pool */
+			const NodeSpan span = graph.inputs(orig);
+			const std::vector<NodeRef> inputs(span.begin(), span.end());
+			for (const NodeRef input: inputs)
 			{
-				NodeRef input = nodes[orig]->inputs[i];
 				if (orig_to_clone.find(input) != orig_to_clone.end())
-				{
-					nodes[clone]->inputs[i] = orig_to_clone[input];
-					NodeRef input_clone = orig_to_clone[input];
-					if (input_clone < nodes.size() && nodes[input_clone])
-					{
-						if (nodes[input_clone]->user_count < 4)
-							nodes[input_clone]->users[nodes[input_clone]->user_count++] = clone;
-					}
-				}
+					graph.add_input(clone, orig_to_clone[input]);
 				else
-				{
-					nodes[clone]->inputs[i] = input;
-					if (input < nodes.size() && nodes[input])
-					{
-						if (nodes[input]->user_count < 4)
-							nodes[input]->users[nodes[input]->user_count++] = clone;
-					}
-				}
+					graph.add_input(clone, input);
 			}
-
-			nodes[clone]->input_count = nodes[orig]->input_count;
 		}
 	}
 
 	void IPOPass::map_params_to_args(const NodeRef callee, const NodeRef call_site,
-	                                 const std::vector<std::unique_ptr<SproutNode<> > > &nodes,
+	                                 const SproutGraph &graph,
 	                                 std::map<NodeRef, NodeRef> &param_to_arg)
 	{
-		if (callee >= nodes.size() || !nodes[callee] ||
-		    call_site >= nodes.size() || !nodes[call_site])
+		if (!graph.contains(callee) || !graph.contains(call_site))
 		{
 			return;
 		}
 
 		/* get all params for this fn */
-		std::vector<NodeRef> callee_params = collect_function_params(callee, nodes);
-		for (uint8_t i = 0; i < nodes[call_site]->input_count; i++)
+		std::vector<NodeRef> callee_params = collect_function_params(callee, graph);
+		for (uint32_t i = 0; i < graph.inputs(call_site).size(); i++)
 		{
-			const NodeRef input = nodes[call_site]->inputs[i];
-			if (input >= nodes.size() || !nodes[input])
+			const NodeRef input = graph.inputs(call_site)[i];
+			if (!graph.contains(input))
 				continue;
 
 			/* if this is a call parameter */
-			if (nodes[input]->type == NodeType::CALL_PARAM && nodes[input]->input_count >= 2)
+			if (graph.type(input) == NodeType::CALL_PARAM && graph.inputs(input).size() >= 2)
 			{
-				NodeRef index_node = nodes[input]->inputs[0];
-				if (index_node >= nodes.size() || !nodes[index_node] ||
-				    nodes[index_node]->type != NodeType::CONST)
+				NodeRef index_node = graph.inputs(input)[0];
+				if (!graph.contains(index_node) ||
+				    graph.type(index_node) != NodeType::CONST)
 				{
 					continue;
 				}
 
 				int64_t param_index = 0;
-				if (std::holds_alternative<int64_t>(nodes[index_node]->value))
-					param_index = std::get<int64_t>(nodes[index_node]->value);
+				if (std::holds_alternative<int64_t>(graph.value(index_node)))
+					param_index = std::get<int64_t>(graph.value(index_node));
 
 				/* get & map */
-				NodeRef arg_value = nodes[input]->inputs[1];
+				NodeRef arg_value = graph.inputs(input)[1];
 				if (param_index < static_cast<int64_t>(callee_params.size()))
 					param_to_arg[callee_params[param_index]] = arg_value;
 			}
@@ -286,125 +349,82 @@ namespace sprk
 	}
 
 	void IPOPass::replace_call_with_inlined(NodeRef call_site, NodeRef inlined_return,
-	                                        std::vector<std::unique_ptr<SproutNode<> > > &nodes)
+	                                        SproutGraph &graph)
 	{
-		if (call_site >= nodes.size() || !nodes[call_site] ||
-		    inlined_return >= nodes.size() || !nodes[inlined_return])
+		if (!graph.contains(call_site) || !graph.contains(inlined_return))
 		{
 			return;
 		}
 
-		nodes_to_remove.insert(call_site);
 		NodeRef called_function = NULL_REF;
-		if (nodes[call_site]->input_count > 0)
-			called_function = nodes[call_site]->inputs[0];
+		if (graph.inputs(call_site).size() > 0)
+			called_function = graph.inputs(call_site)[0];
 
-		/* get all users from the call site */
-		std::vector<NodeRef> call_users;
-		call_users.reserve(nodes[call_site]->user_count);
-		for (uint8_t i = 0; i < nodes[call_site]->user_count; i++)
-			call_users.push_back(nodes[call_site]->users[i]);
+		/* every user of the call site now reads the inlined return value */
+		graph.replace_all_uses(call_site, inlined_return);
 
-		for (const NodeRef user: call_users)
-		{
-			if (user >= nodes.size() || !nodes[user])
-				continue;
-
-			for (uint8_t i = 0; i < nodes[user]->input_count; i++)
-			{
-				if (nodes[user]->inputs[i] == call_site)
-				{
-					nodes[user]->inputs[i] = inlined_return;
-					if (nodes[inlined_return]->user_count < 4)
-						nodes[inlined_return]->users[nodes[inlined_return]->user_count++] = user;
-				}
-			}
-		}
+		/* cpy; remove releases the input list. the call parameters die with it in the cleanup */
+		const NodeSpan span = graph.inputs(call_site);
+		const std::vector<NodeRef> inputs(span.begin(), span.end());
+		const RegionRef region = graph.region_of(call_site);
+		graph.remove(call_site);
 
-		if (called_function != NULL_REF && called_function < nodes.size() && nodes[called_function])
+		std::vector<NodeRef> live_nodes;
+		for (const NodeRef node_ref: graph.region(region).get_nodes())
 		{
-			for (uint8_t i = 0; i < nodes[called_function]->user_count; i++)
-			{
-				if (nodes[called_function]->users[i] == call_site)
-				{
-					if (i < nodes[called_function]->user_count - 1)
-					{
-						for (uint8_t j = i; j < nodes[called_function]->user_count - 1; j++)
-							nodes[called_function]->users[j] = nodes[called_function]->users[j + 1];
-					}
-					nodes[called_function]->user_count--;
-					break;
-				}
-			}
-
-			if (nodes[called_function]->user_count == 0)
-				functions_to_remove.insert(called_function);
+			if (graph.contains(node_ref))
+				live_nodes.push_back(node_ref);
 		}
+		graph.replace_nodes(region, std::move(live_nodes));
 
-		for (uint8_t i = 0; i < nodes[call_site]->input_count; i++)
+		for (const NodeRef input: inputs)
 		{
-			NodeRef input = nodes[call_site]->inputs[i];
-			if (input >= nodes.size() || !nodes[input])
-				continue;
-
-			if (nodes[input]->type == NodeType::CALL_PARAM)
-			{
-				nodes_to_remove.insert(input);
-				for (uint8_t j = 0; j < nodes[input]->input_count; j++)
-				{
-					NodeRef param_input = nodes[input]->inputs[j];
-					if (param_input >= nodes.size() || !nodes[param_input])
-						continue;
-
-					if (nodes[param_input]->type == NodeType::CONST &&
-						nodes[param_input]->user_count == 1)
-					{
-						nodes_to_remove.insert(param_input);
-					}
-				}
-			}
+			if (input != called_function)
+				dirty_nodes.push_back(input);
 		}
 
-		/* the call node is now effectively dead; DCE will remove this and all of its input */
+		if (called_function != NULL_REF && graph.contains(called_function) && graph.users(called_function).empty())
+			functions_to_remove.insert(called_function);
 	}
 
 	std::vector<NodeRef> IPOPass::inline_function_body(
-		const std::shared_ptr<SproutRegion> &callee_region,
-		const std::shared_ptr<SproutRegion> &caller_region,
-		std::vector<std::unique_ptr<SproutNode<> > > &nodes)
+		const RegionRef callee_region,
+		const RegionRef caller_region,
+		SproutGraph &graph)
 	{
-		if (!callee_region || !caller_region)
+		if (callee_region == NULL_REGION || caller_region == NULL_REGION)
 			return {};
 
 		std::vector<NodeRef> inlined_nodes;
 		orig_to_clone.clear();
 
-		for (NodeRef node_ref: callee_region->get_nodes())
+		for (NodeRef node_ref: graph.region(callee_region).get_nodes())
 		{
-			if (node_ref >= nodes.size() || !nodes[node_ref])
+			if (!graph.contains(node_ref))
 				continue;
 
-			/* skip boundary nodes */
-			if (nodes[node_ref]->type == NodeType::ENTRY ||
-			    nodes[node_ref]->type == NodeType::EXIT ||
-			    nodes[node_ref]->type == NodeType::FUNCTION)
+			/* skip boundary nodes; the call site takes the returned value instead of a RET */
+			if (graph.type(node_ref) == NodeType::ENTRY ||
+			    graph.type(node_ref) == NodeType::EXIT ||
+			    graph.type(node_ref) == NodeType::FUNCTION ||
+			    graph.type(node_ref) == NodeType::RET)
 			{
 				continue;
 			}
 
-			NodeRef cloned_ref = clone_node(node_ref, nodes, next_node_id);
+			NodeRef cloned_ref = clone_node(node_ref, graph);
 			if (cloned_ref == NULL_REF)
 				continue;
 
 			/* save to do direct call later */
 			orig_to_clone[node_ref] = cloned_ref;
-			caller_region->add_node(cloned_ref);
+			graph.add_node(caller_region, cloned_ref);
 			inlined_nodes.push_back(cloned_ref);
 		}
 
-		for (const auto &child: callee_region->get_children())
+		for (const RegionRef child: graph.region(callee_region).get_children())
 		{
-			auto child_nodes = inline_function_body(child, caller_region, nodes);
+			auto child_nodes = inline_function_body(child, caller_region, graph);
 			inlined_nodes.insert(inlined_nodes.end(), child_nodes.begin(), child_nodes.end());
 		}
 
@@ -429,8 +449,25 @@ namespace sprk
 			for (const auto &[caller, callee]: ipo_results.inlined_functions)
 				std::cout << "  function #" << callee << " inlined into #" << caller << std::endl;
 			std::cout << "  total calls eliminated: " << ipo_results.removed_calls << std::endl;
+			std::cout << "  nodes removed by cleanup: " << ipo_results.simplified_nodes << std::endl;
 		}
 
+		std::cout << "  growth: " << ipo_results.growth << " of " << ipo_results.budget << " nodes" << std::endl;
+
+		const auto dump_calls = [&](const char *title, const std::vector<NodeRef> &calls)
+		{
+			if (calls.empty())
+				return;
+
+			std::cout << green << title << reset << std::endl;
+			for (const NodeRef call_site: calls)
+				std::cout << "  call site #" << call_site << std::endl;
+		};
+
+		dump_calls("recursive calls kept:", ipo_results.recursive_calls);
+		dump_calls("unprofitable calls kept:", ipo_results.unprofitable_calls);
+		dump_calls("calls kept over budget:", ipo_results.over_budget_calls);
+
 		std::cout << green << "constant propagation:" << reset << std::endl;
 		if (ipo_results.const_props.empty())
 		{
@@ -444,23 +481,23 @@ namespace sprk
 		}
 	}
 
-	void IPOPass::remove_dead_functions(const std::shared_ptr<SproutRegion> &root,
-	                                    std::vector<std::unique_ptr<SproutNode<> > > &nodes)
+	void IPOPass::remove_dead_functions(const RegionRef root,
+	                                    SproutGraph &graph)
 	{
-		std::vector<std::shared_ptr<SproutRegion> > regions_to_remove;
+		std::vector<RegionRef> regions_to_remove;
 
-		std::function<void(const std::shared_ptr<SproutRegion> &)> find_function_regions =
-				[&](const std::shared_ptr<SproutRegion> &region)
+		std::function<void(RegionRef)> find_function_regions =
+				[&](const RegionRef region)
 		{
-			if (!region)
+			if (region == NULL_REGION)
 				return;
 
-			if (region->get_type() == RegionType::FUNCTION)
+			if (graph.region(region).get_type() == RegionType::FUNCTION)
 			{
-				for (NodeRef node_ref: region->get_nodes())
+				for (NodeRef node_ref: graph.region(region).get_nodes())
 				{
-					if (node_ref < nodes.size() && nodes[node_ref] &&
-					    nodes[node_ref]->type == NodeType::FUNCTION &&
+					if (graph.contains(node_ref) &&
+					    graph.type(node_ref) == NodeType::FUNCTION &&
 					    functions_to_remove.find(node_ref) != functions_to_remove.end())
 					{
 						regions_to_remove.push_back(region);
@@ -469,23 +506,20 @@ namespace sprk
 				}
 			}
 
-			for (const auto &child: region->get_children())
+			for (const RegionRef child: graph.region(region).get_children())
 				find_function_regions(child);
 		};
 
 		find_function_regions(root);
-		for (const auto &region: regions_to_remove)
+		for (const RegionRef region: regions_to_remove)
 		{
-			std::shared_ptr<SproutRegion> parent = region->get_parent();
-			if (!parent)
+			const RegionRef parent = graph.region(region).get_parent();
+			if (parent == NULL_REGION)
 				continue;
 
-			parent->remove_child(region);
-			for (NodeRef node_ref: region->get_nodes())
-			{
-				if (node_ref < nodes.size() && nodes[node_ref])
-					nodes[node_ref].reset();
-			}
+			graph.remove_child(parent, region);
+			for (NodeRef node_ref: graph.region(region).get_nodes())
+				graph.remove(node_ref);
 		}
 	}
 }
@@ -0,0 +1,319 @@
+#include <functional>
+#include <iostream>
+#include <unordered_map>
+#include <sparkle/sprout/passes/licm.hpp>
+#include <sparkle/sprout/utils/dump.hpp>
+#include <sparkle/sprout/utils/irutils.hpp>
+
+namespace sprk
+{
+	namespace
+	{
+		bool is_hoist_candidate(const NodeType type)
+		{
+			return type == NodeType::CONST ||
+			       type == NodeType::ADD ||
+			       type == NodeType::SUB ||
+			       type == NodeType::MUL ||
+			       type == NodeType::DIV ||
+			       type == NodeType::CMP ||
+			       type == NodeType::ADDR_OF ||
+			       type == NodeType::PTR_ADD ||
+			       type == NodeType::REINTERPRET_CAST;
+		}
+
+		bool is_load(const NodeType type)
+		{
+			return type == NodeType::LOAD || type == NodeType::PTR_LOAD;
+		}
+
+		bool is_store(const NodeType type)
+		{
+			return type == NodeType::STORE || type == NodeType::PTR_STORE;
+		}
+
+		/* the address a memory operation works on; NULL_REF reads as "anything" to the alias analysis */
+		NodeRef pointer_of(const SproutGraph &graph, const NodeRef node)
+		{
+			const NodeSpan inputs = graph.inputs(node);
+			return inputs.empty() ? NULL_REF : inputs[0];
+		}
+
+		/* a division hoisted out of a loop that never runs must not trap */
+		bool has_safe_divisor(const SproutGraph &graph, const NodeRef node)
+		{
+			const NodeSpan inputs = graph.inputs(node);
+			if (inputs.size() < 2 || !graph.contains(inputs[1]) || graph.type(inputs[1]) != NodeType::CONST)
+				return false;
+
+			const NodeValue &value = graph.value(inputs[1]);
+			if (const auto *i = std::get_if<int64_t>(&value))
+				return *i != 0 && *i != -1;
+			if (const auto *d = std::get_if<double>(&value))
+				return *d != 0.0;
+			return false;
+		}
+	}
+
+	void LICMPass::begin(const SproutGraph &graph, const size_t unit_count)
+	{
+		hoisted.clear();
+		sunk.clear();
+		units.assign(unit_count, {});
+	}
+
+	void LICMPass::run_function(const FunctionUnit &unit,
+	                            const SproutGraph &graph,
+	                            WorkerScratch &scratch,
+	                            FunctionEdits &edits)
+	{
+		if (unit.region == NULL_REGION)
+			return;
+
+		UnitResult &result = units[unit.index];
+
+		/* preorder intervals of the function's regions, and its loops innermost first */
+		std::unordered_map<RegionRef, std::pair<uint32_t, uint32_t> > preorder;
+		std::vector<RegionRef> loops;
+		uint32_t next_preorder = 0;
+		std::function<void(RegionRef)> visit = [&](const RegionRef region)
+		{
+			const uint32_t first = next_preorder++;
+			for (const RegionRef child: graph.region(region).get_children())
+				visit(child);
+
+			preorder[region] = { first, next_preorder - 1 };
+			if (graph.region(region).get_type() == RegionType::LOOP_BODY)
+				loops.push_back(region);
+		};
+		visit(unit.region);
+
+		if (loops.empty())
+			return;
+
+		/* where a node sits once the moves staged so far are applied */
+		std::unordered_map<NodeRef, RegionRef> placed;
+		std::unordered_map<RegionRef, RegionRef> staged_parent; /* exit regions are children of the loop's parent */
+
+		const auto region_now = [&](const NodeRef node)
+		{
+			const auto it = placed.find(node);
+			return it == placed.end() ? graph.region_of(node) : it->second;
+		};
+
+		/* true if `region` is `outer` or sits below it */
+		const auto inside = [&](RegionRef region, const RegionRef outer)
+		{
+			if (FunctionEdits::is_staged_region(region))
+				region = staged_parent.at(region);
+
+			const auto it = preorder.find(region);
+			if (it == preorder.end())
+				return false;
+
+			const auto &[first, last] = preorder.at(outer);
+			return it->second.first >= first && it->second.first <= last;
+		};
+
+		const auto &aa = *aa_pass;
+		for (const RegionRef loop: loops)
+		{
+			const SproutRegion &body = graph.region(loop);
+			const RegionRef preheader = body.get_imm_dom() != NULL_REGION ? body.get_imm_dom() : body.get_parent();
+			if (preheader == NULL_REGION)
+				continue;
+
+			/* a value can be read in the preheader if it is defined there or above it */
+			const auto available = [&](const NodeRef input)
+			{
+				if (!graph.contains(input))
+					return false;
+
+				RegionRef region = region_now(input);
+				if (FunctionEdits::is_staged_region(region))
+					region = staged_parent.at(region);
+				if (region == NULL_REGION || !preorder.count(region))
+					return true;
+
+				return !inside(region, loop) &&
+				       (inside(preheader, region) || graph.dominates(region, preheader));
+			};
+
+			const auto operands_available = [&](const NodeRef node)
+			{
+				for (const NodeRef input: graph.inputs(node))
+				{
+					if (!available(input))
+						return false;
+				}
+				return true;
+			};
+
+			std::vector<NodeRef> members;
+			std::vector<NodeRef> memory_ops;
+			std::vector<NodeRef> writers;
+			bool has_call = false;
+			for (const NodeRef node: unit.nodes)
+			{
+				if (!graph.contains(node) || !inside(region_now(node), loop))
+					continue;
+
+				members.push_back(node);
+				const NodeType type = graph.type(node);
+				has_call |= type == NodeType::CALL;
+				if (is_load(type) || is_store(type) || type == NodeType::FREE)
+					memory_ops.push_back(node);
+				if (is_store(type) || type == NodeType::FREE)
+					writers.push_back(node);
+			}
+
+			const auto may_conflict = [&](const NodeRef node, const std::vector<NodeRef> &ops)
+			{
+				const NodeRef pointer = pointer_of(graph, node);
+				for (const NodeRef op: ops)
+				{
+					if (op == node)
+						continue;
+
+					/* scalar accesses conflict per field; a free takes the whole object */
+					const NodeRef other = pointer_of(graph, op);
+					if (graph.type(op) == NodeType::FREE ? aa.points_to_same_memory(pointer, other)
+					                                     : aa.may_alias(pointer, other))
+						return true;
+				}
+				return false;
+			};
+
+			const auto hoistable = [&](const NodeRef node)
+			{
+				const NodeType type = graph.type(node);
+				if (is_hoist_candidate(type))
+					return (type != NodeType::DIV || has_safe_divisor(graph, node)) && operands_available(node);
+
+				/* the load now runs even if the loop does not, so it must read a known allocation */
+				if (is_load(type))
+				{
+					return !has_call && operands_available(node) &&
+					       !aa.get_points_to_set(pointer_of(graph, node)).empty() &&
+					       !may_conflict(node, writers);
+				}
+
+				return false;
+			};
+
+			/* hoisting one node can make its users invariant; members are in ref order, not def order */
+			bool changed = true;
+			while (changed)
+			{
+				changed = false;
+				for (const NodeRef node: members)
+				{
+					const RegionRef from = region_now(node);
+					if (!inside(from, loop) || !hoistable(node))
+						continue;
+
+					placed[node] = preheader;
+					edits.move(node, preheader);
+					result.hoisted.push_back({ node, from, preheader });
+					changed = true;
+				}
+			}
+
+			/*
+			 * a store of invariant operands in the body itself, that nothing
+			 * else in the loop may observe, writes the same value every trip,
+			 * so writing it once after the loop is enough if the loop ran. a
+			 * control defined outside the loop says so; a counted loop's
+			 * CMP(i, bound) is recomputed each trip and false on exit, so its
+			 * entry test CMP(init, bound) goes in the preheader instead
+			 */
+			const NodeRef control = body.get_ctrl_dep();
+			const bool entered = control != NULL_REF && available(control);
+			InductionLoop shape;
+			if (!entered && (!match_induction_loop(loop, graph, shape) ||
+			                 !available(shape.init) || !available(shape.bound)))
+				continue;
+
+			RegionRef exit = NULL_REGION;
+			for (const NodeRef node: members)
+			{
+				const RegionRef from = region_now(node);
+				if (!is_store(graph.type(node)) || from != loop || has_call ||
+				    !operands_available(node) || may_conflict(node, memory_ops))
+				{
+					continue;
+				}
+
+				bool observed = false;
+				for (const NodeRef user: graph.users(node))
+					observed |= inside(region_now(user), loop);
+				if (observed)
+					continue;
+
+				if (exit == NULL_REGION)
+				{
+					NodeRef guard = control;
+					if (!entered)
+					{
+						const NodeRef fn = graph.fn_ref(shape.compare);
+						const NodeRef test = edits.create(NodeType::CMP, fn, preheader, body.get_name() + "_entered");
+						edits.add_input(test, shape.init);
+						edits.add_input(test, shape.bound);
+						guard = edits.create(NodeType::CONTROL, fn, preheader, body.get_name() + "_entry_control");
+						edits.add_input(guard, test);
+					}
+
+					exit = edits.create_region(body.get_name() + "_exit", RegionType::BRANCH_THEN,
+					                           body.get_parent(), loop, guard);
+					staged_parent[exit] = body.get_parent();
+				}
+
+				placed[node] = exit;
+				edits.move(node, exit);
+				result.sunk.push_back({ node, from, exit });
+			}
+		}
+	}
+
+	void LICMPass::finish(const RegionRef root,
+	                      SproutGraph &graph,
+	                      const std::vector<FunctionEdits> &edits)
+	{
+		for (size_t i = 0; i < units.size(); i++)
+		{
+			hoisted.insert(hoisted.end(), units[i].hoisted.begin(), units[i].hoisted.end());
+			for (LICMMove move: units[i].sunk)
+			{
+				move.to = edits[i].resolve_region(move.to);
+				sunk.push_back(move);
+			}
+		}
+
+		units.clear();
+	}
+
+	void LICMPass::dump_results(const SproutGraph &graph, const bool colorize) const
+	{
+		const char *header_color = colorize ? BLUE : "";
+		const char *move_color = colorize ? GREEN : "";
+		const char *reset = colorize ? RESET : "";
+
+		const auto print = [&](const LICMMove &move)
+		{
+			std::cout << "  " << move_color << "node #" << move.node;
+			if (graph.contains(move.node))
+				std::cout << " (" << nttostr(graph.type(move.node)) << " " << graph.name(move.node) << ")";
+			std::cout << reset << ": " << graph.region(move.from).get_name() << " -> "
+					<< graph.region(move.to).get_name() << "\n";
+		};
+
+		std::cout << header_color << "\nLICM results" << reset << "\n";
+		std::cout << "hoisted " << hoisted.size() << " nodes:\n";
+		for (const LICMMove &move: hoisted)
+			print(move);
+
+		std::cout << "sunk " << sunk.size() << " stores:\n";
+		for (const LICMMove &move: sunk)
+			print(move);
+	}
+}
@@ -0,0 +1,69 @@
+#include <sparkle/sprout/passes/manager.hpp>
+
+namespace sprk
+{
+	PassManager::PassManager(const unsigned threads) : ipa_pass(std::make_shared<IPAPass>()),
+	                                                   aa_pass(std::make_shared<AliasAnalysisPass>()),
+	                                                   driver(threads) {}
+
+	void PassManager::add(std::shared_ptr<SproutPass> pass)
+	{
+		passes.push_back(std::move(pass));
+	}
+
+	void PassManager::run(const RegionRef root, SproutGraph &graph)
+	{
+		for (const auto &pass: passes)
+		{
+			compute(pass->required_analyses(), root, graph);
+			if (auto *function_pass = dynamic_cast<FunctionPass *>(pass.get()))
+				driver.run(*function_pass, root, graph);
+			else
+				pass->run(root, graph);
+
+			/* an analysis scheduled explicitly is as good as a computed one */
+			valid = (valid & pass->preserved_analyses()) | provided_by(pass.get());
+		}
+	}
+
+	void PassManager::compute(const AnalysisSet analyses, const RegionRef root, SproutGraph &graph)
+	{
+		const AnalysisSet stale = analyses & ~valid;
+
+		if (stale & analysis_bit(AnalysisKind::IPA))
+		{
+			ipa_pass->run(root, graph);
+			compute_counts[static_cast<size_t>(AnalysisKind::IPA)]++;
+		}
+
+		if (stale & analysis_bit(AnalysisKind::ALIAS))
+		{
+			aa_pass->run(root, graph);
+			compute_counts[static_cast<size_t>(AnalysisKind::ALIAS)]++;
+		}
+
+		if (stale & analysis_bit(AnalysisKind::DOMINATORS))
+		{
+			/* rebuilds only if a region edit made the graph's tree stale */
+			static_cast<void>(graph.dominator_tree());
+			compute_counts[static_cast<size_t>(AnalysisKind::DOMINATORS)]++;
+		}
+
+		valid |= stale;
+	}
+
+	void PassManager::invalidate(const AnalysisSet analyses)
+	{
+		valid &= ~analyses;
+	}
+
+	AnalysisSet PassManager::provided_by(const SproutPass *pass) const
+	{
+		if (pass == ipa_pass.get())
+			return analysis_bit(AnalysisKind::IPA);
+		if (pass == aa_pass.get())
+			return analysis_bit(AnalysisKind::ALIAS);
+
+		return NO_ANALYSES;
+	}
+}
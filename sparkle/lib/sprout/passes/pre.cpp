@@ -1,129 +1,791 @@
 #include <algorithm>
 #include <iostream>
+#include <tuple>
+#include <unordered_map>
 #include <sparkle/sprout/passes/pre.hpp>
+#include <sparkle/sprout/utils/bitset.hpp>
 #include <sparkle/sprout/utils/dump.hpp>
 
 namespace sprk
 {
-    std::string PREResult::to_string() const
+    namespace
+    {
+        bool is_pre_candidate(const NodeType type)
+        {
+            return type == NodeType::ADD ||
+                   type == NodeType::SUB ||
+                   type == NodeType::MUL ||
+                   type == NodeType::DIV ||
+                   type == NodeType::CMP;
+        }
+
+        /* what makes two computations the same expression; the hash alone can collide */
+        struct ExprKey
+        {
+            NodeType type;
+            uint32_t result;
+            NodeValue value;
+            std::vector<NodeRef> operands;
+
+            bool operator<(const ExprKey& other) const
+            {
+                return std::tie(type, result, value, operands) <
+                       std::tie(other.type, other.result, other.value, other.operands);
+            }
+
+            bool operator==(const ExprKey& other) const
+            {
+                return std::tie(type, result, value, operands) ==
+                       std::tie(other.type, other.result, other.value, other.operands);
+            }
+        };
+
+        ExprKey make_expr_key(const SproutGraph& graph, const NodeRef node)
+        {
+            ExprKey key { graph.type(node), graph.result(node), graph.value(node), {} };
+            for (const NodeRef input : graph.inputs(node))
+                key.operands.push_back(input);
+
+            if (key.type == NodeType::ADD || key.type == NodeType::MUL)
+                std::sort(key.operands.begin(), key.operands.end());
+            return key;
+        }
+
+        constexpr uint32_t NO_BLOCK = UINT32_MAX;
+
+        struct FlowEdge
+        {
+            uint32_t from;
+            uint32_t to;
+        };
+
+        struct FlowBlock
+        {
+            RegionRef region = NULL_REGION;   /* region a node placed here lands in; NULL_REGION if none */
+            RegionRef split_of = NULL_REGION; /* set on the empty arm beside a lone branch region */
+            std::vector<uint32_t> in_edges;
+            std::vector<uint32_t> out_edges;
+        };
+
+        /*
+         * control flow between one function's regions, as blocks LCM can reason
+         * about. a region gets an entry block holding its own nodes and an exit
+         * block for those that read a child's value; the children run in order
+         * in between, each followed by a join block of the parent. a BRANCH_THEN
+         * directly followed by a BRANCH_ELSE is a diamond; a lone branch or
+         * EXCEPTION region gets an empty arm beside it; a LOOP_BODY runs zero or
+         * more times behind a header that holds nothing. every edge then has a
+         * target with one predecessor or a source with one successor, so an
+         * insertion on it always lands in a block
+         */
+        class RegionFlowGraph
+        {
+        public:
+            std::vector<FlowBlock> blocks;
+            std::vector<FlowEdge> edges;
+            std::unordered_map<RegionRef, uint32_t> entry_of;
+            std::unordered_map<RegionRef, uint32_t> exit_of;
+
+            RegionFlowGraph(const SproutGraph& graph, const RegionRef function) : graph(graph)
+            {
+                build(function, NO_BLOCK);
+            }
+
+            [[nodiscard]] bool contains(const RegionRef region) const
+            {
+                return preorder.count(region) != 0;
+            }
+
+            /* true if `inner` sits somewhere below `outer` */
+            [[nodiscard]] bool strictly_inside(const RegionRef inner, const RegionRef outer) const
+            {
+                const auto& [first, last] = preorder.at(outer);
+                const uint32_t at = preorder.at(inner).first;
+                return at > first && at <= last;
+            }
+
+        private:
+            const SproutGraph& graph;
+            std::unordered_map<RegionRef, std::pair<uint32_t, uint32_t>> preorder; /* subtree interval */
+            uint32_t next_preorder = 0;
+
+            uint32_t add_block(const RegionRef region, const RegionRef split_of = NULL_REGION)
+            {
+                FlowBlock block;
+                block.region = region;
+                block.split_of = split_of;
+                blocks.push_back(std::move(block));
+                return static_cast<uint32_t>(blocks.size() - 1);
+            }
+
+            void add_edge(const uint32_t from, const uint32_t to)
+            {
+                blocks[from].out_edges.push_back(static_cast<uint32_t>(edges.size()));
+                blocks[to].in_edges.push_back(static_cast<uint32_t>(edges.size()));
+                edges.push_back({ from, to });
+            }
+
+            /* returns the region's exit block */
+            uint32_t build(const RegionRef region, const uint32_t pred)
+            {
+                const uint32_t entry = add_block(region);
+                if (pred != NO_BLOCK)
+                    add_edge(pred, entry);
+                entry_of[region] = entry;
+                const uint32_t first = next_preorder++;
+
+                uint32_t current = add_block(region);
+                add_edge(entry, current);
+
+                const std::vector<RegionRef> children = graph.region(region).get_children();
+                for (size_t i = 0; i < children.size(); i++)
+                {
+                    const RegionType type = graph.region(children[i]).get_type();
+                    const uint32_t join = [&]
+                    {
+                        if (type == RegionType::BRANCH_THEN && i + 1 < children.size() &&
+                            graph.region(children[i + 1]).get_type() == RegionType::BRANCH_ELSE)
+                        {
+                            const uint32_t then_exit = build(children[i], current);
+                            const uint32_t else_exit = build(children[++i], current);
+                            const uint32_t block = add_block(region);
+                            add_edge(then_exit, block);
+                            add_edge(else_exit, block);
+                            return block;
+                        }
+
+                        if (type == RegionType::BRANCH_THEN || type == RegionType::BRANCH_ELSE ||
+                            type == RegionType::EXCEPTION)
+                        {
+                            const uint32_t taken_exit = build(children[i], current);
+                            const uint32_t skipped = add_block(NULL_REGION, children[i]);
+                            add_edge(current, skipped);
+                            const uint32_t block = add_block(region);
+                            add_edge(taken_exit, block);
+                            add_edge(skipped, block);
+                            return block;
+                        }
+
+                        if (type == RegionType::LOOP_BODY)
+                        {
+                            const uint32_t header = add_block(NULL_REGION);
+                            add_edge(current, header);
+                            const uint32_t body_exit = build(children[i], header);
+                            add_edge(body_exit, header);
+                            const uint32_t block = add_block(region);
+                            add_edge(header, block);
+                            return block;
+                        }
+
+                        /* blocks are numbered in flow order, so the join comes after the child */
+                        const uint32_t child_exit = build(children[i], current);
+                        const uint32_t block = add_block(region);
+                        add_edge(child_exit, block);
+                        return block;
+                    }();
+                    current = join;
+                }
+
+                const uint32_t exit = add_block(region);
+                add_edge(current, exit);
+                exit_of[region] = exit;
+                preorder[region] = { first, next_preorder - 1 };
+                return exit;
+            }
+        };
+
+        /* a definition of an expression's value that later computations may reuse */
+        struct ValueDef
+        {
+            enum class Kind : uint8_t { ORIGINAL, INSERTED, PHI } kind;
+            NodeRef node = NULL_REF; /* ORIGINAL: the computation; otherwise the staged node */
+            uint32_t block = NO_BLOCK;
+            bool used = false;
+        };
+
+        constexpr int32_t VALUE_UNKNOWN = -2; /* not reached yet */
+        constexpr int32_t VALUE_NONE = -1;    /* not available on every path */
+    }
+
+    std::string PREResult::to_string(const SproutGraph& graph) const
     {
         std::stringstream ss;
         ss << "PRE: Original #" << original_node 
            << " hoisted to #" << hoisted_node 
-           << " in region " << target_region->get_name()
+           << " in region " << graph.region(target_region).get_name()
            << ". removed " << instances_removed << " redundant instances.";
         return ss.str();
     }
     
-    void PREPass::run(const std::shared_ptr<SproutRegion>& root,
-                     std::vector<std::unique_ptr<SproutNode<>>>& nodes)
+    void PREPass::begin(const SproutGraph& graph, const size_t unit_count)
     {
         pre_results.clear();
-        auto rdd_exprs = find_redundant_expressions(nodes);
-        
-        for (const auto& [hash, node_refs] : rdd_exprs)
+        dirty_nodes.clear();
+        unit_results.assign(unit_count, {});
+        unit_dirty.assign(unit_count, {});
+    }
+
+    void PREPass::run_function(const FunctionUnit& unit,
+                               const SproutGraph& graph,
+                               WorkerScratch& scratch,
+                               FunctionEdits& edits)
+    {
+        if (mode == PREMode::LAZY_CODE_MOTION)
+            lazy_code_motion(unit, graph, edits);
+        else
+            hoist(unit, graph, edits);
+    }
+
+    void PREPass::hoist(const FunctionUnit& unit,
+                        const SproutGraph& graph,
+                        FunctionEdits& edits)
+    {
+        std::map<ExprHash, std::vector<NodeRef>> expressions;
+        for (const NodeRef i : unit.nodes)
+        {
+            if (is_pre_candidate(graph.type(i)))
+                expressions[compute_expr_hash(graph, i)].push_back(i);
+        }
+
+        /* split each bucket into truly equal expressions, keeping first-seen order */
+        std::vector<std::vector<NodeRef>> groups;
+        for (const auto& [hash, bucket] : expressions)
+        {
+            std::vector<ExprKey> keys;
+            const size_t first_group = groups.size();
+            for (const NodeRef node_ref : bucket)
+            {
+                ExprKey key = make_expr_key(graph, node_ref);
+                const auto at = std::find(keys.begin(), keys.end(), key);
+                if (at == keys.end())
+                {
+                    keys.push_back(std::move(key));
+                    groups.push_back({ node_ref });
+                }
+                else
+                {
+                    groups[first_group + (at - keys.begin())].push_back(node_ref);
+                }
+            }
+        }
+
+        for (const std::vector<NodeRef>& node_refs : groups)
         {
             if (node_refs.size() <= 1)
                 continue;
 
             /* find common dominator */
-            std::shared_ptr<SproutRegion> common_dom = find_common_dominator(node_refs, nodes, root);
-            if (!common_dom)
+            const RegionRef common_dom = find_common_dominator(node_refs, graph);
+            if (common_dom == NULL_REGION)
                 continue;
-                
+
             /* get the first node to use as a template for the hoisted computation */
             const NodeRef first_node_ref = node_refs[0];
-            const SproutNode<>* first_node = first_node_ref < nodes.size() ? nodes[first_node_ref].get() : nullptr;
-            if (!first_node)
+            std::string name;
+            if (graph.string_id(first_node_ref) != NULL_STRING)
+                name = std::string(graph.name(first_node_ref)) + "_hoisted";
+
+            const NodeRef hoisted_ref = edits.create(graph.type(first_node_ref),
+                                                     graph.fn_ref(first_node_ref),
+                                                     common_dom,
+                                                     std::move(name));
+            for (const NodeRef input : graph.inputs(first_node_ref))
+            {
+                if (graph.contains(input))
+                    edits.add_input(hoisted_ref, input);
+            }
+
+            PREResult result;
+            result.original_node = first_node_ref;
+            result.hoisted_node = hoisted_ref;
+            result.target_region = common_dom;
+            for (const NodeRef node_ref : node_refs)
+            {
+                edits.replace_all_uses(node_ref, hoisted_ref);
+                unit_dirty[unit.index].push_back(node_ref);
+                result.instances_removed++;
+            }
+
+            unit_results[unit.index].push_back(result);
+        }
+    }
+
+    void PREPass::lazy_code_motion(const FunctionUnit& unit,
+                                   const SproutGraph& graph,
+                                   FunctionEdits& edits)
+    {
+        if (unit.region == NULL_REGION)
+            return;
+
+        const RegionFlowGraph flow(graph, unit.region);
+        const auto block_count = static_cast<uint32_t>(flow.blocks.size());
+        const uint32_t entry = flow.entry_of.at(unit.region);
+
+        /* place every node; reading a child region's value pushes it to its region's exit block */
+        std::unordered_map<NodeRef, uint32_t> block_of;
+        std::vector<NodeRef> worklist;
+        for (const NodeRef node : unit.nodes)
+        {
+            const RegionRef region = graph.region_of(node);
+            if (!flow.contains(region))
                 continue;
 
-            const auto hoisted_ref = static_cast<NodeRef>(nodes.size());
-            auto hoisted_node = std::make_unique<SproutNode<>>();
+            block_of[node] = flow.entry_of.at(region);
+            for (const NodeRef input : graph.inputs(node))
+            {
+                if (!graph.contains(input) || !flow.contains(graph.region_of(input)) ||
+                    !flow.strictly_inside(graph.region_of(input), region))
+                    continue;
+
+                worklist.push_back(node);
+                break;
+            }
+        }
+
+        while (!worklist.empty())
+        {
+            const NodeRef node = worklist.back();
+            worklist.pop_back();
+
+            const RegionRef region = graph.region_of(node);
+            uint32_t& block = block_of[node];
+            if (block == flow.exit_of.at(region))
+                continue;
+
+            block = flow.exit_of.at(region);
+            for (const NodeRef user : graph.users(node))
+            {
+                if (graph.region_of(user) == region)
+                    worklist.push_back(user);
+            }
+        }
+
+        /* expressions computed more than once; a single computation has nothing to share */
+        std::map<ExprKey, std::vector<NodeRef>> groups;
+        for (const NodeRef node : unit.nodes)
+        {
+            if (is_pre_candidate(graph.type(node)) && block_of.count(node))
+                groups[make_expr_key(graph, node)].push_back(node);
+        }
+
+        std::vector<std::vector<NodeRef>> computations;
+        for (auto& [key, nodes] : groups)
+        {
+            if (nodes.size() > 1)
+                computations.push_back(std::move(nodes));
+        }
+
+        const size_t expr_count = computations.size();
+        if (expr_count == 0)
+            return;
+
+        /* local properties; a block defining an operand kills the expression */
+        std::vector<BitVector> comp(block_count), kill(block_count), antloc(block_count);
+        for (uint32_t b = 0; b < block_count; b++)
+        {
+            comp[b].resize(expr_count);
+            kill[b].resize(expr_count);
+        }
+
+        for (size_t e = 0; e < expr_count; e++)
+        {
+            for (const NodeRef node : computations[e])
+                comp[block_of[node]].set(e);
 
-            hoisted_node->type = first_node->type;
-            hoisted_node->id = hoisted_ref;
-            if (first_node->string_id)
+            for (const NodeRef operand : graph.inputs(computations[e][0]))
             {
-                std::string orig_name = reinterpret_cast<const char*>(first_node->string_id);
-                std::string new_name = orig_name + "_hoisted";
-                char* str_id = new char[new_name.size() + 1];
-                std::strcpy(str_id, new_name.c_str());
-                hoisted_node->string_id = reinterpret_cast<uint64_t>(str_id);
+                if (const auto it = block_of.find(operand); it != block_of.end())
+                    kill[it->second].set(e);
             }
+        }
+
+        for (uint32_t b = 0; b < block_count; b++)
+        {
+            antloc[b] = comp[b];
+            antloc[b].subtract(kill[b]);
+        }
 
-            hoisted_node->fn_ref = first_node->fn_ref;
-            for (uint8_t i = 0; i < first_node->input_count && i < 4; i++)
+        BitVector all_set;
+        all_set.resize(expr_count);
+        all_set.set_all();
+
+        /* availability, forward: computed on every path and not killed since */
+        std::vector<BitVector> avout(block_count, all_set);
+        for (bool changed = true; changed;)
+        {
+            changed = false;
+            for (uint32_t b = 0; b < block_count; b++)
             {
-                NodeRef input = first_node->inputs[i];
-                if (input < nodes.size() && nodes[input])
+                BitVector in = all_set;
+                if (b == entry || flow.blocks[b].in_edges.empty())
+                    in.clear();
+                for (const uint32_t k : flow.blocks[b].in_edges)
+                    in &= avout[flow.edges[k].from];
+
+                in.subtract(kill[b]);
+                in |= comp[b];
+                if (in != avout[b])
                 {
-                    hoisted_node->inputs[hoisted_node->input_count++] = input;
-                    if (nodes[input]->user_count < 4)
-                        nodes[input]->users[nodes[input]->user_count++] = hoisted_ref;
+                    avout[b] = std::move(in);
+                    changed = true;
                 }
             }
+        }
 
-            common_dom->add_node(hoisted_ref);
-            nodes.push_back(std::move(hoisted_node));
+        /* anticipability, backward: computed on every path ahead before any kill */
+        std::vector<BitVector> antin(block_count, all_set), antout(block_count, all_set);
+        for (bool changed = true; changed;)
+        {
+            changed = false;
+            for (uint32_t b = block_count; b-- > 0;)
+            {
+                BitVector out = all_set;
+                if (flow.blocks[b].out_edges.empty())
+                    out.clear();
+                for (const uint32_t k : flow.blocks[b].out_edges)
+                    out &= antin[flow.edges[k].to];
 
-            PREResult result;
-            result.original_node = first_node_ref;
-            result.hoisted_node = hoisted_ref;
-            result.target_region = common_dom;
-            for (const NodeRef node_ref : node_refs)
+                BitVector in = out;
+                in.subtract(kill[b]);
+                in |= antloc[b];
+                antout[b] = std::move(out);
+                if (in != antin[b])
+                {
+                    antin[b] = std::move(in);
+                    changed = true;
+                }
+            }
+        }
+
+        /* earliest edges: anticipated at the target, and the source neither has it nor could pass it through */
+        std::vector<BitVector> earliest(flow.edges.size());
+        for (size_t k = 0; k < flow.edges.size(); k++)
+        {
+            const auto [from, to] = flow.edges[k];
+            BitVector through = antout[from];
+            through.subtract(kill[from]);
+
+            earliest[k] = antin[to];
+            earliest[k].subtract(avout[from]);
+            earliest[k].subtract(through);
+        }
+
+        /* later: how far down a computation can sink from its earliest edge without passing a use */
+        std::vector<BitVector> later(flow.edges.size(), all_set), laterin(block_count, all_set);
+        for (bool changed = true; changed;)
+        {
+            changed = false;
+            for (uint32_t b = 0; b < block_count; b++)
             {
-                if (node_ref == hoisted_ref)
-                    continue;
-                    
-                SproutNode<>* node = node_ref < nodes.size() ? nodes[node_ref].get() : nullptr;
-                if (!node)
+                BitVector in = all_set;
+                if (b == entry)
+                    in = antin[entry]; /* the edge into the function is the earliest point of all */
+                for (const uint32_t k : flow.blocks[b].in_edges)
+                    in &= later[k];
+
+                if (in != laterin[b])
+                {
+                    laterin[b] = in;
+                    changed = true;
+                }
+
+                in.subtract(antloc[b]);
+                for (const uint32_t k : flow.blocks[b].out_edges)
+                {
+                    BitVector edge = in;
+                    edge |= earliest[k];
+                    if (edge != later[k])
+                    {
+                        later[k] = std::move(edge);
+                        changed = true;
+                    }
+                }
+            }
+        }
+
+        std::unordered_map<RegionRef, RegionRef> split_regions; /* lone branch -> staged empty arm */
+        for (size_t e = 0; e < expr_count; e++)
+        {
+            const std::vector<NodeRef>& nodes = computations[e];
+            const NodeRef leader = nodes[0];
+
+            /*
+             * insert(edge) = later(edge) - laterin(target). each insertion goes
+             * to the end of a one-successor source or the start of a
+             * one-predecessor target; the empty arm of a lone branch is one
+             */
+            std::vector<int32_t> start_def(block_count, -1), end_def(block_count, -1);
+            std::vector<ValueDef> defs;
+            bool placeable = true;
+            for (size_t k = 0; k < flow.edges.size() && placeable; k++)
+            {
+                const auto [from, to] = flow.edges[k];
+                if (!later[k].test(e) || laterin[to].test(e))
                     continue;
 
-                std::vector<NodeRef> users;
-                users.reserve(node->user_count);
-                for (uint8_t i = 0; i < node->user_count; i++)
-                    users.push_back(node->users[i]);
+                const auto holds_nodes = [](const FlowBlock& block)
+                {
+                    return block.region != NULL_REGION || block.split_of != NULL_REGION;
+                };
+
+                const FlowBlock& target = flow.blocks[to];
+                const FlowBlock& source = flow.blocks[from];
+                if (target.in_edges.size() == 1 && holds_nodes(target))
+                {
+                    start_def[to] = static_cast<int32_t>(defs.size());
+                    defs.push_back({ ValueDef::Kind::INSERTED, NULL_REF, to });
+                }
+                else if (source.out_edges.size() == 1 && holds_nodes(source))
+                {
+                    end_def[from] = static_cast<int32_t>(defs.size());
+                    defs.push_back({ ValueDef::Kind::INSERTED, NULL_REF, from });
+                }
+                else
+                {
+                    placeable = false;
+                }
+            }
+
+            if (!placeable)
+                continue;
 
-                for (NodeRef user : users)
+            std::vector<std::vector<NodeRef>> computed_in(block_count);
+            for (const NodeRef node : nodes)
+                computed_in[block_of[node]].push_back(node);
+
+            /*
+             * which definition reaches each block. the computations the dataflow
+             * left redundant are exactly those reached by one, and diamond joins
+             * merge differing arms through a phi. like availability this starts
+             * optimistic: a back edge not seen yet does not block a loop header
+             */
+            std::unordered_map<NodeRef, int32_t> original_def;
+            std::vector<int32_t> phi_def(block_count, -1);
+            std::vector<int32_t> out(block_count, VALUE_UNKNOWN);
+            std::vector<std::pair<NodeRef, int32_t>> rewrites;
+
+            const auto reaching = [&](const uint32_t b)
+            {
+                if (b == entry)
+                    return VALUE_NONE;
+
+                int32_t same = VALUE_UNKNOWN;
+                bool differ = false;
+                for (const uint32_t k : flow.blocks[b].in_edges)
                 {
-                    if (user >= nodes.size() || !nodes[user])
+                    const int32_t value = out[flow.edges[k].from];
+                    if (value == VALUE_NONE)
+                        return VALUE_NONE;
+                    if (value == VALUE_UNKNOWN)
                         continue;
 
-                    SproutNode<>* user_node = nodes[user].get();
-                    for (uint8_t i = 0; i < user_node->input_count; i++)
+                    differ |= same != VALUE_UNKNOWN && same != value;
+                    same = value;
+                }
+
+                if (!differ)
+                    return same;
+                if (flow.blocks[b].region == NULL_REGION)
+                    return VALUE_NONE;
+
+                if (phi_def[b] < 0)
+                {
+                    phi_def[b] = static_cast<int32_t>(defs.size());
+                    defs.push_back({ ValueDef::Kind::PHI, NULL_REF, b });
+                }
+                return phi_def[b];
+            };
+
+            const auto sweep = [&](const bool record)
+            {
+                bool changed = false;
+                for (uint32_t b = 0; b < block_count; b++)
+                {
+                    int32_t value = reaching(b);
+                    if (start_def[b] >= 0)
+                        value = start_def[b];
+
+                    for (const NodeRef node : computed_in[b])
                     {
-                        if (user_node->inputs[i] == node_ref)
+                        if (value >= 0)
                         {
-                            user_node->inputs[i] = hoisted_ref;
-                            if (nodes[hoisted_ref]->user_count < 4)
-                                nodes[hoisted_ref]->users[nodes[hoisted_ref]->user_count++] = user;
+                            if (record)
+                                rewrites.emplace_back(node, value);
+                            continue;
                         }
+
+                        auto [it, fresh] = original_def.try_emplace(node, static_cast<int32_t>(defs.size()));
+                        if (fresh)
+                            defs.push_back({ ValueDef::Kind::ORIGINAL, node, b });
+                        value = it->second;
                     }
+
+                    if (end_def[b] >= 0)
+                        value = end_def[b];
+
+                    changed |= out[b] != value;
+                    out[b] = value;
                 }
-                
+                return changed;
+            };
+
+            for (uint32_t round = 0; round <= block_count && sweep(false); round++)
+                ;
+            sweep(true);
+
+            if (rewrites.empty())
+                continue;
+
+            /* materialise only what a deleted computation ends up reading */
+            std::vector<int32_t> pending;
+            for (const auto& [node, def] : rewrites)
+                pending.push_back(def);
+
+            bool complete = true;
+            while (!pending.empty())
+            {
+                ValueDef& def = defs[pending.back()];
+                pending.pop_back();
+                if (def.used)
+                    continue;
+
+                def.used = true;
+                if (def.kind != ValueDef::Kind::PHI)
+                    continue;
+
+                for (const uint32_t k : flow.blocks[def.block].in_edges)
+                {
+                    const int32_t input = out[flow.edges[k].from];
+                    complete &= input >= 0;
+                    if (input >= 0)
+                        pending.push_back(input);
+                }
+            }
+
+            if (!complete)
+                continue;
+
+            std::string name;
+            if (graph.string_id(leader) != NULL_STRING)
+                name = std::string(graph.name(leader));
+
+            PREResult result;
+            result.original_node = leader;
+            result.hoisted_node = NULL_REF;
+            for (ValueDef& def : defs)
+            {
+                if (!def.used || def.kind == ValueDef::Kind::ORIGINAL)
+                    continue;
+
+                const FlowBlock& block = flow.blocks[def.block];
+                if (def.kind == ValueDef::Kind::PHI)
+                {
+                    def.node = edits.create(NodeType::PHI, graph.fn_ref(leader), block.region,
+                                            name.empty() ? name : name + "_phi");
+                    edits.set_result(def.node, graph.result(leader));
+                    continue;
+                }
+
+                RegionRef region = block.region;
+                if (region == NULL_REGION)
+                {
+                    /* the empty arm of a lone branch becomes a real one */
+                    const SproutRegion& taken = graph.region(block.split_of);
+                    auto [it, fresh] = split_regions.try_emplace(block.split_of, NULL_REGION);
+                    if (fresh)
+                    {
+                        it->second = edits.create_region(taken.get_name() + "_else",
+                                                         taken.get_type() == RegionType::BRANCH_THEN
+                                                             ? RegionType::BRANCH_ELSE
+                                                             : RegionType::BRANCH_THEN,
+                                                         taken.get_parent(),
+                                                         block.split_of,
+                                                         taken.get_ctrl_dep());
+                    }
+                    region = it->second;
+                }
+
+                def.node = edits.create(graph.type(leader), graph.fn_ref(leader), region,
+                                        name.empty() ? name : name + "_lcm");
+                edits.set_value(def.node, graph.value(leader));
+                edits.set_result(def.node, graph.result(leader));
+                for (const NodeRef input : graph.inputs(leader))
+                {
+                    if (graph.contains(input))
+                        edits.add_input(def.node, input);
+                }
+
+                if (result.hoisted_node == NULL_REF)
+                    result.hoisted_node = def.node;
+                result.instances_inserted++;
+            }
+
+            /* phi inputs follow the join's predecessors, then the branch control like a source-level phi */
+            for (const ValueDef& def : defs)
+            {
+                if (!def.used || def.kind != ValueDef::Kind::PHI)
+                    continue;
+
+                const FlowBlock& block = flow.blocks[def.block];
+                for (const uint32_t k : block.in_edges)
+                    edits.add_input(def.node, defs[out[flow.edges[k].from]].node);
+
+                const FlowBlock& first_arm = flow.blocks[flow.edges[block.in_edges[0]].from];
+                if (first_arm.region != NULL_REGION)
+                {
+                    if (const NodeRef control = graph.region(first_arm.region).get_ctrl_dep(); control != NULL_REF)
+                        edits.add_input(def.node, control);
+                }
+            }
+
+            for (const auto& [node, def] : rewrites)
+            {
+                edits.replace_all_uses(node, defs[def].node);
+                edits.remove(node);
+                for (const NodeRef input : graph.inputs(node))
+                    unit_dirty[unit.index].push_back(input);
                 result.instances_removed++;
             }
-            
-            pre_results.push_back(result);
+
+            if (result.hoisted_node == NULL_REF)
+                result.hoisted_node = defs[rewrites[0].second].node;
+            unit_results[unit.index].push_back(result);
         }
     }
-    
+
+    void PREPass::finish(const RegionRef root,
+                         SproutGraph& graph,
+                         const std::vector<FunctionEdits>& edits)
+    {
+        for (size_t i = 0; i < unit_results.size(); i++)
+        {
+            for (PREResult& result : unit_results[i])
+            {
+                result.hoisted_node = edits[i].resolve(result.hoisted_node);
+                if (mode == PREMode::LAZY_CODE_MOTION)
+                    result.target_region = graph.region_of(result.hoisted_node);
+                pre_results.push_back(result);
+            }
+
+            dirty_nodes.insert(dirty_nodes.end(), unit_dirty[i].begin(), unit_dirty[i].end());
+        }
+
+        unit_results.clear();
+        unit_dirty.clear();
+    }
+
     std::map<ExprHash, std::vector<NodeRef>> PREPass::find_redundant_expressions(
-        const std::vector<std::unique_ptr<SproutNode<>>>& nodes)
+        const SproutGraph& graph)
     {
         std::map<ExprHash, std::vector<NodeRef>> expressions;
-        for (size_t i = 0; i < nodes.size(); i++)
+        for (NodeRef i = 0; i < graph.size(); i++)
         {
-            if (!nodes[i])
+            if (!graph.contains(i))
                 continue;
 
-            if (nodes[i]->type == NodeType::ADD ||
-                nodes[i]->type == NodeType::SUB ||
-                nodes[i]->type == NodeType::MUL ||
-                nodes[i]->type == NodeType::DIV ||
-                nodes[i]->type == NodeType::CMP)
+            if (is_pre_candidate(graph.type(i)))
             {
-                ExprHash hash = compute_expr_hash(nodes[i].get());
+                ExprHash hash = compute_expr_hash(graph, i);
                 expressions[hash].push_back(i);
             }
         }
@@ -139,26 +801,26 @@ namespace sprk
         return rdd_exprs;
     }
     
-    ExprHash PREPass::compute_expr_hash(const SproutNode<>* node) const
+    ExprHash PREPass::compute_expr_hash(const SproutGraph& graph, const NodeRef node) const
     {
-        if (!node)
+        if (!graph.contains(node))
             return 0;
 
         /* dumn hash algorithm but should work */
-        auto hash = static_cast<ExprHash>(node->type);
-        if (node->type == NodeType::CONST)
+        auto hash = static_cast<ExprHash>(graph.type(node));
+        if (graph.type(node) == NodeType::CONST)
         {
-            if (std::holds_alternative<int64_t>(node->value))
-                hash = hash * 31 + static_cast<ExprHash>(std::get<int64_t>(node->value));
+            if (std::holds_alternative<int64_t>(graph.value(node)))
+                hash = hash * 31 + static_cast<ExprHash>(std::get<int64_t>(graph.value(node)));
         }
         
         /* hash the inputs for operations */
         /* sort the inputs first for commutatives */
-        if (node->type == NodeType::ADD || node->type == NodeType::MUL)
+        if (graph.type(node) == NodeType::ADD || graph.type(node) == NodeType::MUL)
         {
             std::vector<NodeRef> input_refs;
-            for (uint8_t i = 0; i < node->input_count; i++)
-                input_refs.push_back(node->inputs[i]);
+            for (const NodeRef input : graph.inputs(node))
+                input_refs.push_back(input);
             std::sort(input_refs.begin(), input_refs.end());
 
             for (const NodeRef input_ref : input_refs)
@@ -167,93 +829,61 @@ namespace sprk
         else
         {
             /* for non-commutative operations, hash in order */
-            for (uint8_t i = 0; i < node->input_count; i++)
-                hash = hash * 31 + node->inputs[i];
+            for (const NodeRef input : graph.inputs(node))
+                hash = hash * 31 + input;
         }
         
         return hash;
     }
     
-    std::shared_ptr<SproutRegion> PREPass::find_common_dominator(
+    RegionRef PREPass::find_common_dominator(
         const std::vector<NodeRef>& nodes,
-        const std::vector<std::unique_ptr<SproutNode<>>>& node_vec,
-        const std::shared_ptr<SproutRegion>& root)
+        const SproutGraph& graph)
     {
         if (nodes.empty())
-            return nullptr;
+            return NULL_REGION;
             
         /* find the region containing each node */
-        std::vector<std::shared_ptr<SproutRegion>> node_regions;
+        std::vector<RegionRef> node_regions;
         for (NodeRef node_ref : nodes)
         {
-            if (std::shared_ptr<SproutRegion> region = find_node_region(node_ref, root))
+            if (const RegionRef region = graph.region_of(node_ref); region != NULL_REGION)
                 node_regions.push_back(region);
         }
         
         if (node_regions.empty())
-            return nullptr;
+            return NULL_REGION;
             
         if (node_regions.size() == 1)
             return node_regions[0];
 
-        std::shared_ptr<SproutRegion> common = node_regions[0];
+        RegionRef common = node_regions[0];
         for (size_t i = 1; i < node_regions.size(); i++)
-            common = find_common_dominator(common, node_regions[i]);
+            common = find_common_dominator(graph, common, node_regions[i]);
         
         return common;
     }
     
-    std::shared_ptr<SproutRegion> PREPass::find_node_region(
-        const NodeRef node_ref,
-        const std::shared_ptr<SproutRegion>& root)
+    RegionRef PREPass::find_common_dominator(
+        const SproutGraph& graph,
+        const RegionRef r1,
+        const RegionRef r2)
     {
-        if (!root)
-            return nullptr;
-
-        for (NodeRef n : root->get_nodes())
-        {
-            if (n == node_ref)
-                return root;
-        }
-
-        for (const auto& child : root->get_children())
-        {
-            if (auto result = find_node_region(node_ref, child))
-                return result;
-        }
-        
-        return nullptr;
-    }
-    
-    std::shared_ptr<SproutRegion> PREPass::find_common_dominator(
-        std::shared_ptr<SproutRegion> r1,
-        std::shared_ptr<SproutRegion> r2)
-    {
-        if (!r1)
+        if (r1 == NULL_REGION)
             return r2;
             
-        if (!r2)
-            return r1;
-            
-        /* return the dominator if one dominates the other */
-        if (r1->dominates(r2))
+        if (r2 == NULL_REGION)
             return r1;
             
-        if (r2->dominates(r1))
-            return r2;
-            
-        /* check the immediate dominator of each otherwise */
-        auto idom1 = r1->get_imm_dom();
-        auto idom2 = r2->get_imm_dom();
-        
-        /* then walk up the dominator tree until a common ancestor is found */
-        while (r1 && !r1->dominates(r2))
-            r1 = r1->get_imm_dom();
+        /* walk up r1's dominator chain until it covers r2 */
+        if (const RegionRef common = graph.find_common_dominator(r1, r2); common != NULL_REGION)
+            return common;
 
-        return r1 ? r1 : r2->get_imm_dom();
+        return graph.region(r2).get_imm_dom();
     }
     
     void PREPass::dump_results(
+        const SproutGraph& graph,
         const bool colorize) const
     {
         const char* green = colorize ? GREEN : "";
@@ -267,7 +897,7 @@ namespace sprk
         else
         {
             for (const auto& result : pre_results)
-                std::cout << green << "  " << result.to_string() << reset << std::endl;
+                std::cout << green << "  " << result.to_string(graph) << reset << std::endl;
             
             /* print total statistics */
             int total_removed = 0;
@@ -276,6 +906,16 @@ namespace sprk
             
             std::cout << yellow << "Total redundant computations eliminated: "
                      << total_removed << reset << std::endl;
+
+            if (mode == PREMode::LAZY_CODE_MOTION)
+            {
+                int total_inserted = 0;
+                for (const auto& result : pre_results)
+                    total_inserted += result.instances_inserted;
+
+                std::cout << yellow << "Computations inserted on paths that lacked them: "
+                         << total_inserted << reset << std::endl;
+            }
         }
     }
 }
\ No newline at end of file
@@ -0,0 +1,533 @@
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <unordered_map>
+#include <unordered_set>
+#include <sparkle/sprout/passes/sccp.hpp>
+#include <sparkle/sprout/utils/dump.hpp>
+
+namespace sprk
+{
+	namespace
+	{
+		struct Lattice
+		{
+			enum class State : uint8_t
+			{
+				UNKNOWN, /* not evaluated yet, or only reachable through code that never runs */
+				CONSTANT,
+				VARYING
+			};
+
+			State state = State::UNKNOWN;
+			NodeValue value;
+
+			[[nodiscard]] bool is_constant() const
+			{
+				return state == State::CONSTANT;
+			}
+
+			static Lattice constant(NodeValue value)
+			{
+				return { State::CONSTANT, std::move(value) };
+			}
+
+			static Lattice varying()
+			{
+				return { State::VARYING, {} };
+			}
+		};
+
+		/* doubles compare by bits so a NaN constant stays equal to itself */
+		bool same_constant(const NodeValue &a, const NodeValue &b)
+		{
+			if (a.index() != b.index())
+				return false;
+
+			if (const auto *d = std::get_if<double>(&a))
+				return std::memcmp(d, &std::get<double>(b), sizeof(double)) == 0;
+			return a == b;
+		}
+
+		bool operator==(const Lattice &a, const Lattice &b)
+		{
+			return a.state == b.state && (a.state != Lattice::State::CONSTANT || same_constant(a.value, b.value));
+		}
+
+		Lattice meet(const Lattice &a, const Lattice &b)
+		{
+			if (a.state == Lattice::State::UNKNOWN)
+				return b;
+			if (b.state == Lattice::State::UNKNOWN)
+				return a;
+			if (a.state == Lattice::State::VARYING || b.state == Lattice::State::VARYING)
+				return Lattice::varying();
+			return same_constant(a.value, b.value) ? a : Lattice::varying();
+		}
+
+		bool is_foldable(const NodeType type)
+		{
+			switch (type)
+			{
+				case NodeType::ADD:
+				case NodeType::SUB:
+				case NodeType::MUL:
+				case NodeType::DIV:
+				case NodeType::CMP:
+				case NodeType::PHI:
+					return true;
+				default:
+					return false;
+			}
+		}
+
+		/* the literal a CONST carries, if SCCP can compute with it */
+		Lattice literal(const NodeValue &value)
+		{
+			if (std::holds_alternative<int64_t>(value) || std::holds_alternative<double>(value))
+				return Lattice::constant(value);
+			return Lattice::varying();
+		}
+
+		/* folds one binary operation; integers wrap, and a trapping division stays varying */
+		Lattice fold(const NodeType type, const NodeValue &lhs, const NodeValue &rhs)
+		{
+			if (lhs.index() != rhs.index())
+				return Lattice::varying();
+
+			if (const auto *l = std::get_if<int64_t>(&lhs))
+			{
+				const auto a = static_cast<uint64_t>(*l);
+				const auto b = static_cast<uint64_t>(std::get<int64_t>(rhs));
+				switch (type)
+				{
+					case NodeType::ADD:
+						return Lattice::constant(static_cast<int64_t>(a + b));
+					case NodeType::SUB:
+						return Lattice::constant(static_cast<int64_t>(a - b));
+					case NodeType::MUL:
+						return Lattice::constant(static_cast<int64_t>(a * b));
+					case NodeType::DIV:
+					{
+						const int64_t divisor = std::get<int64_t>(rhs);
+						if (divisor == 0 || (*l == std::numeric_limits<int64_t>::min() && divisor == -1))
+							return Lattice::varying();
+						return Lattice::constant(*l / divisor);
+					}
+					case NodeType::CMP:
+						return Lattice::constant(static_cast<int64_t>(*l < std::get<int64_t>(rhs)));
+					default:
+						return Lattice::varying();
+				}
+			}
+
+			const double a = std::get<double>(lhs);
+			const double b = std::get<double>(rhs);
+			switch (type)
+			{
+				case NodeType::ADD:
+					return Lattice::constant(a + b);
+				case NodeType::SUB:
+					return Lattice::constant(a - b);
+				case NodeType::MUL:
+					return Lattice::constant(a * b);
+				case NodeType::DIV:
+					return Lattice::constant(a / b);
+				case NodeType::CMP:
+					return Lattice::constant(static_cast<int64_t>(a < b));
+				default:
+					return Lattice::varying();
+			}
+		}
+
+		/* a constant control is false when it is zero */
+		bool is_zero(const NodeValue &value)
+		{
+			if (const auto *i = std::get_if<int64_t>(&value))
+				return *i == 0;
+			return std::get<double>(value) == 0.0;
+		}
+	}
+
+	void SCCPPass::begin(const SproutGraph &graph, const size_t unit_count)
+	{
+		folds.clear();
+		forwarded_phis.clear();
+		pruned_regions.clear();
+		dirty_nodes.clear();
+		units.assign(unit_count, {});
+	}
+
+	void SCCPPass::run_function(const FunctionUnit &unit,
+	                            const SproutGraph &graph,
+	                            WorkerScratch &scratch,
+	                            FunctionEdits &edits)
+	{
+		if (unit.region == NULL_REGION)
+			return;
+
+		UnitResult &result = units[unit.index];
+
+		/* the function's regions, and which of them each control node decides */
+		std::unordered_set<RegionRef> unit_regions;
+		std::unordered_map<NodeRef, std::vector<RegionRef> > controlled;
+		std::vector<RegionRef> stack = { unit.region };
+		while (!stack.empty())
+		{
+			const RegionRef region = stack.back();
+			stack.pop_back();
+			unit_regions.insert(region);
+
+			if (const NodeRef control = graph.region(region).get_ctrl_dep(); control != NULL_REF)
+				controlled[control].push_back(region);
+
+			const auto &children = graph.region(region).get_children();
+			stack.insert(stack.end(), children.begin(), children.end());
+		}
+
+		std::unordered_map<NodeRef, Lattice> values;
+		std::unordered_set<RegionRef> executable;
+
+		const auto value_of = [&](const NodeRef ref) -> Lattice
+		{
+			if (!graph.contains(ref))
+				return Lattice::varying();
+
+			/* a node of another function is only known if it is a literal */
+			if (!unit_regions.count(graph.region_of(ref)))
+				return graph.type(ref) == NodeType::CONST ? literal(graph.value(ref)) : Lattice::varying();
+
+			const auto it = values.find(ref);
+			return it == values.end() ? Lattice {} : it->second;
+		};
+
+		/* an input from a region of this function that never runs carries no value */
+		const auto is_dead_input = [&](const NodeRef ref)
+		{
+			const RegionRef region = graph.contains(ref) ? graph.region_of(ref) : NULL_REGION;
+			return unit_regions.count(region) && !executable.count(region);
+		};
+
+		const auto evaluate = [&](const NodeRef node) -> Lattice
+		{
+			const NodeSpan inputs = graph.inputs(node);
+			switch (graph.type(node))
+			{
+				case NodeType::CONST:
+					return literal(graph.value(node));
+				case NodeType::ADD:
+				case NodeType::SUB:
+				case NodeType::MUL:
+				case NodeType::DIV:
+				case NodeType::CMP:
+				{
+					if (inputs.size() != 2)
+						return Lattice::varying();
+
+					const Lattice lhs = value_of(inputs[0]);
+					const Lattice rhs = value_of(inputs[1]);
+					if (lhs.state == Lattice::State::VARYING || rhs.state == Lattice::State::VARYING)
+						return Lattice::varying();
+					if (!lhs.is_constant() || !rhs.is_constant())
+						return {};
+					return fold(graph.type(node), lhs.value, rhs.value);
+				}
+				case NodeType::PHI:
+				{
+					/* the control input names the branch; it is not an arm */
+					Lattice merged;
+					for (const NodeRef input: inputs)
+					{
+						if (graph.contains(input) && graph.type(input) != NodeType::CONTROL && !is_dead_input(input))
+							merged = meet(merged, value_of(input));
+					}
+					return merged;
+				}
+				case NodeType::CONTROL:
+					return inputs.empty() ? Lattice::varying() : value_of(inputs[0]);
+				default:
+					return Lattice::varying();
+			}
+		};
+
+		/* whether a child of a running region can run, given what its control is known to be */
+		const auto can_run = [&](const RegionRef region)
+		{
+			const SproutRegion &r = graph.region(region);
+			const RegionType type = r.get_type();
+			if (r.get_ctrl_dep() == NULL_REF ||
+			    (type != RegionType::BRANCH_THEN && type != RegionType::BRANCH_ELSE && type != RegionType::LOOP_BODY))
+				return true;
+
+			/*
+			 * a counted loop tests CMP(i, bound) inside its own body, which is
+			 * only evaluated once the body runs; such a loop may always run
+			 */
+			if (type == RegionType::LOOP_BODY && graph.contains(r.get_ctrl_dep()))
+			{
+				for (RegionRef at = graph.region_of(r.get_ctrl_dep()); at != NULL_REGION; at = graph.region(at).get_parent())
+				{
+					if (at == region)
+						return true;
+				}
+			}
+
+			const Lattice control = value_of(r.get_ctrl_dep());
+			if (control.state == Lattice::State::UNKNOWN)
+				return false;
+			if (control.state == Lattice::State::VARYING)
+				return true;
+			return type == RegionType::BRANCH_ELSE ? is_zero(control.value) : !is_zero(control.value);
+		};
+
+		std::vector<NodeRef> worklist;
+		std::vector<RegionRef> region_worklist = { unit.region };
+		executable.insert(unit.region);
+
+		const auto try_run = [&](const RegionRef region)
+		{
+			const RegionRef parent = graph.region(region).get_parent();
+			if (!executable.count(region) && executable.count(parent) && can_run(region))
+			{
+				executable.insert(region);
+				region_worklist.push_back(region);
+			}
+		};
+
+		while (!worklist.empty() || !region_worklist.empty())
+		{
+			if (!region_worklist.empty())
+			{
+				const RegionRef region = region_worklist.back();
+				region_worklist.pop_back();
+
+				for (const NodeRef node: graph.region(region).get_nodes())
+				{
+					if (graph.contains(node))
+						worklist.push_back(node);
+				}
+
+				for (const RegionRef child: graph.region(region).get_children())
+					try_run(child);
+				continue;
+			}
+
+			const NodeRef node = worklist.back();
+			worklist.pop_back();
+
+			Lattice &current = values[node];
+			const Lattice next = meet(current, evaluate(node));
+			if (next == current)
+				continue;
+
+			current = next;
+			for (const NodeRef user: graph.users(node))
+			{
+				if (executable.count(graph.region_of(user)))
+					worklist.push_back(user);
+			}
+
+			if (const auto it = controlled.find(node); it != controlled.end())
+			{
+				for (const RegionRef region: it->second)
+					try_run(region);
+			}
+		}
+
+		/* constants become CONST nodes; a phi with one live arm becomes that arm */
+		std::unordered_set<NodeRef> going;
+		for (const NodeRef node: unit.nodes)
+		{
+			const NodeType type = graph.type(node);
+			if (!is_foldable(type) || !executable.count(graph.region_of(node)))
+				continue;
+
+			const Lattice &value = values[node];
+			if (value.is_constant())
+			{
+				const NodeRef constant = edits.create(NodeType::CONST, graph.fn_ref(node), graph.region_of(node),
+				                                      std::string(graph.name(node)));
+				edits.set_value(constant, value.value);
+				edits.set_result(constant, graph.result(node));
+				edits.replace_all_uses(node, constant);
+				edits.remove(node);
+
+				going.insert(node);
+				result.folds.push_back({ node, constant, value.value });
+				for (const NodeRef input: graph.inputs(node))
+					result.dirty_nodes.push_back(input);
+				continue;
+			}
+
+			if (type != NodeType::PHI || (graph.flags(node) & NODE_PINNED))
+				continue;
+
+			NodeRef live = NULL_REF;
+			uint32_t arms = 0;
+			uint32_t live_arms = 0;
+			for (const NodeRef input: graph.inputs(node))
+			{
+				if (!graph.contains(input) || graph.type(input) == NodeType::CONTROL)
+					continue;
+
+				arms++;
+				if (!is_dead_input(input))
+				{
+					live = input;
+					live_arms++;
+				}
+			}
+
+			if (live_arms != 1 || arms == 1)
+				continue;
+
+			edits.replace_all_uses(node, live);
+			edits.remove(node);
+
+			going.insert(node);
+			result.forwarded_phis.push_back(node);
+			for (const NodeRef input: graph.inputs(node))
+			{
+				if (input != live)
+					result.dirty_nodes.push_back(input);
+			}
+		}
+
+		/*
+		 * a region that never runs goes with its subtree, unless something that
+		 * stays reads one of its nodes or a pinned node is referenced from
+		 * outside the edge lists by anything but the subtree's own regions
+		 */
+		std::function<void(RegionRef)> find_dead = [&](const RegionRef region)
+		{
+			for (const RegionRef child: graph.region(region).get_children())
+			{
+				if (executable.count(child))
+				{
+					find_dead(child);
+					continue;
+				}
+
+				std::unordered_set<NodeRef> subtree;
+				std::unordered_set<NodeRef> controls;
+				std::vector<RegionRef> pending = { child };
+				while (!pending.empty())
+				{
+					const SproutRegion &r = graph.region(pending.back());
+					pending.pop_back();
+					for (const NodeRef node: r.get_nodes())
+					{
+						if (graph.contains(node))
+							subtree.insert(node);
+					}
+
+					if (r.get_ctrl_dep() != NULL_REF)
+						controls.insert(r.get_ctrl_dep());
+					pending.insert(pending.end(), r.get_children().begin(), r.get_children().end());
+				}
+
+				bool removable = true;
+				for (const NodeRef node: subtree)
+				{
+					if ((graph.flags(node) & NODE_PINNED) && !controls.count(node))
+						removable = false;
+
+					for (const NodeRef user: graph.users(node))
+					{
+						if (!subtree.count(user) && !going.count(user))
+							removable = false;
+					}
+				}
+
+				if (!removable)
+					continue;
+
+				result.dead_regions.push_back(child);
+				for (const NodeRef node: subtree)
+				{
+					for (const NodeRef input: graph.inputs(node))
+					{
+						if (!subtree.count(input))
+							result.dirty_nodes.push_back(input);
+					}
+				}
+			}
+		};
+
+		find_dead(unit.region);
+	}
+
+	void SCCPPass::finish(const RegionRef root,
+	                      SproutGraph &graph,
+	                      const std::vector<FunctionEdits> &edits)
+	{
+		std::function<void(RegionRef)> remove_subtree = [&](const RegionRef region)
+		{
+			/* copy; removing a child edits the list */
+			const std::vector<RegionRef> children = graph.region(region).get_children();
+			for (const RegionRef child: children)
+				remove_subtree(child);
+
+			for (const NodeRef node: graph.region(region).get_nodes())
+				graph.remove(node);
+			graph.remove_region(region);
+		};
+
+		for (size_t i = 0; i < units.size(); i++)
+		{
+			/* a constant whose users were folded as well is dead on arrival */
+			for (SCCPFold &fold: units[i].folds)
+			{
+				fold.constant = edits[i].resolve(fold.constant);
+				dirty_nodes.push_back(fold.constant);
+				folds.push_back(std::move(fold));
+			}
+
+			for (const RegionRef region: units[i].dead_regions)
+			{
+				remove_subtree(region);
+				pruned_regions.push_back(region);
+			}
+
+			forwarded_phis.insert(forwarded_phis.end(), units[i].forwarded_phis.begin(), units[i].forwarded_phis.end());
+			for (const NodeRef node: units[i].dirty_nodes)
+			{
+				if (graph.contains(node))
+					dirty_nodes.push_back(node);
+			}
+		}
+
+		units.clear();
+	}
+
+	void SCCPPass::dump_results(const bool colorize) const
+	{
+		const char *header_color = colorize ? BLUE : "";
+		const char *fold_color = colorize ? GREEN : "";
+		const char *prune_color = colorize ? YELLOW : "";
+		const char *reset = colorize ? RESET : "";
+
+		std::cout << header_color << "\nSCCP results" << reset << "\n";
+		std::cout << "folded " << folds.size() << " nodes:" << "\n";
+		for (const SCCPFold &fold: folds)
+		{
+			std::cout << "  " << fold_color << "node #" << fold.node << " -> #" << fold.constant << " = ";
+			if (const auto *i = std::get_if<int64_t>(&fold.value))
+				std::cout << *i;
+			else
+				std::cout << std::get<double>(fold.value);
+			std::cout << reset << "\n";
+		}
+
+		std::cout << "forwarded " << forwarded_phis.size() << " phis:";
+		for (const NodeRef phi: forwarded_phis)
+			std::cout << " #" << phi;
+		std::cout << "\n";
+
+		std::cout << "pruned " << pruned_regions.size() << " unreachable regions:";
+		for (const RegionRef region: pruned_regions)
+			std::cout << " " << prune_color << region << reset;
+		std::cout << "\n";
+	}
+}
@@ -0,0 +1,465 @@
+#include <algorithm>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <optional>
+#include <unordered_map>
+#include <unordered_set>
+#include <sparkle/sprout/passes/slp.hpp>
+#include <sparkle/sprout/utils/dump.hpp>
+
+namespace sprk
+{
+	namespace
+	{
+		/* bytes per lane */
+		constexpr int64_t ELEMENT_SIZE = 4;
+
+		std::optional<int64_t> int_constant(const SproutGraph &graph, const NodeRef ref)
+		{
+			if (!graph.contains(ref) || graph.type(ref) != NodeType::CONST)
+				return std::nullopt;
+
+			if (const auto *value = std::get_if<int64_t>(&graph.value(ref)))
+				return *value;
+			return std::nullopt;
+		}
+
+		/* a pointer as base + constant offset */
+		struct Address
+		{
+			NodeRef base;
+			int64_t offset;
+		};
+
+		Address address_of(const SproutGraph &graph, const NodeRef ptr)
+		{
+			if (graph.type(ptr) == NodeType::PTR_ADD && graph.inputs(ptr).size() == 2)
+			{
+				if (const std::optional<int64_t> offset = int_constant(graph, graph.inputs(ptr)[1]))
+					return { graph.inputs(ptr)[0], *offset };
+			}
+			return { ptr, 0 };
+		}
+
+		/* reads or writes memory; CALL and FREE may touch anything */
+		bool touches_memory(const NodeType type)
+		{
+			switch (type)
+			{
+				case NodeType::LOAD:
+				case NodeType::STORE:
+				case NodeType::PTR_LOAD:
+				case NodeType::PTR_STORE:
+				case NodeType::VECTOR_LOAD:
+				case NodeType::VECTOR_STORE:
+				case NodeType::CALL:
+				case NodeType::FREE:
+					return true;
+				default:
+					return false;
+			}
+		}
+
+		bool writes_memory(const NodeType type)
+		{
+			return touches_memory(type) &&
+			       type != NodeType::LOAD &&
+			       type != NodeType::PTR_LOAD &&
+			       type != NodeType::VECTOR_LOAD;
+		}
+	}
+
+	void SLPVectorizePass::begin(const SproutGraph &graph, const size_t unit_count)
+	{
+		results.clear();
+		unit_results.assign(unit_count, {});
+		units.assign(unit_count, {});
+	}
+
+	void SLPVectorizePass::run_function(const FunctionUnit &unit,
+	                                    const SproutGraph &graph,
+	                                    WorkerScratch &scratch,
+	                                    FunctionEdits &edits)
+	{
+		if (unit.region == NULL_REGION)
+			return;
+
+		const auto &aa = *aa_pass;
+
+		/* bytes `node` reads or writes, or nullopt if it may touch anything */
+		const auto footprint = [&](const NodeRef node) -> std::optional<std::pair<Address, int64_t> >
+		{
+			const NodeType type = graph.type(node);
+			if (type == NodeType::CALL || type == NodeType::FREE || graph.inputs(node).empty())
+				return std::nullopt;
+
+			const bool vector = type == NodeType::VECTOR_LOAD || type == NodeType::VECTOR_STORE;
+			return std::make_pair(address_of(graph, graph.inputs(node)[0]), vector ? ELEMENT_SIZE * LANES : ELEMENT_SIZE);
+		};
+
+		const auto may_conflict = [&](const NodeRef lhs, const NodeRef rhs)
+		{
+			const auto a = footprint(lhs);
+			const auto b = footprint(rhs);
+			if (!a || !b)
+				return true;
+
+			if (a->first.base == b->first.base)
+				return a->first.offset < b->first.offset + b->second && b->first.offset < a->first.offset + a->second;
+
+			return aa.get_points_to_set(a->first.base).empty() ||
+			       aa.get_points_to_set(b->first.base).empty() ||
+			       aa.points_to_same_memory(a->first.base, b->first.base);
+		};
+
+		const auto process = [&](const RegionRef block)
+		{
+			std::vector<NodeRef> nodes;
+			std::unordered_map<NodeRef, size_t> position;
+			for (const NodeRef node: graph.region(block).get_nodes())
+			{
+				if (!graph.contains(node))
+					continue;
+				position[node] = nodes.size();
+				nodes.push_back(node);
+			}
+
+			/* stores by base, in the order the bases first show up */
+			std::vector<NodeRef> bases;
+			std::unordered_map<NodeRef, std::vector<std::pair<int64_t, NodeRef> > > stores;
+			for (const NodeRef node: nodes)
+			{
+				if (graph.type(node) != NodeType::PTR_STORE || graph.inputs(node).size() != 2)
+					continue;
+
+				const auto [base, offset] = address_of(graph, graph.inputs(node)[0]);
+				if (!stores.contains(base))
+					bases.push_back(base);
+				stores[base].emplace_back(offset, node);
+			}
+
+			std::unordered_set<NodeRef> claimed; /* nodes of trees already taken in this block */
+			const auto build = [&](const std::array<NodeRef, LANES> &seeds, Tree &tree)
+			{
+				std::map<std::array<NodeRef, LANES>, int> memo;
+				std::unordered_map<NodeRef, int> owner;
+
+				std::function<int(const std::array<NodeRef, LANES> &)> pack = [&](const std::array<NodeRef, LANES> &lanes)
+				{
+					if (const auto it = memo.find(lanes); it != memo.end())
+						return it->second;
+
+					const auto add = [&](Pack packed)
+					{
+						const int index = static_cast<int>(tree.packs.size());
+						tree.packs.push_back(packed);
+						memo[lanes] = index;
+						if (packed.type != NodeType::VECTOR_SPLAT)
+						{
+							for (const NodeRef lane: lanes)
+								owner[lane] = index;
+						}
+						return index;
+					};
+
+					if (std::all_of(lanes.begin(), lanes.end(), [&](const NodeRef lane) { return lane == lanes[0]; }))
+						return add({ NodeType::VECTOR_SPLAT, lanes });
+
+					const NodeType type = graph.type(lanes[0]);
+					for (size_t k = 0; k < LANES; k++)
+					{
+						const NodeRef lane = lanes[k];
+						if (graph.region_of(lane) != block || graph.type(lane) != type || claimed.contains(lane) ||
+						    owner.contains(lane) || std::find(lanes.begin(), lanes.begin() + k, lane) != lanes.begin() + k)
+						{
+							return -1;
+						}
+					}
+
+					if (type == NodeType::PTR_LOAD)
+					{
+						const Address first = address_of(graph, graph.inputs(lanes[0])[0]);
+						for (size_t k = 0; k < LANES; k++)
+						{
+							const Address at = address_of(graph, graph.inputs(lanes[k])[0]);
+							if (at.base != first.base || at.offset != first.offset + static_cast<int64_t>(k) * ELEMENT_SIZE)
+								return -1;
+						}
+						return add({ NodeType::VECTOR_LOAD, lanes });
+					}
+
+					if (type != NodeType::ADD && type != NodeType::MUL)
+						return -1;
+
+					const auto operands = [&](const bool swap_mismatched)
+					{
+						std::array<std::array<NodeRef, LANES>, 2> sides;
+						const NodeType first = graph.type(graph.inputs(lanes[0])[0]);
+						for (size_t k = 0; k < LANES; k++)
+						{
+							const NodeSpan inputs = graph.inputs(lanes[k]);
+							const bool swap = swap_mismatched && graph.type(inputs[0]) != first;
+							sides[0][k] = inputs[swap ? 1 : 0];
+							sides[1][k] = inputs[swap ? 0 : 1];
+						}
+						return sides;
+					};
+
+					for (size_t k = 0; k < LANES; k++)
+					{
+						if (graph.inputs(lanes[k]).size() != 2)
+							return -1;
+					}
+
+					/* both ADD and MUL commute; swap lanes whose operands come in the other order */
+					for (const bool swap: { false, true })
+					{
+						const size_t packs_before = tree.packs.size();
+						const auto memo_before = memo;
+						const auto owner_before = owner;
+
+						const auto sides = operands(swap);
+						const int lhs = pack(sides[0]);
+						const int rhs = lhs < 0 ? -1 : pack(sides[1]);
+						if (rhs >= 0)
+						{
+							Pack packed { type == NodeType::ADD ? NodeType::VECTOR_ADD : NodeType::VECTOR_MUL, lanes };
+							packed.operands[0] = lhs;
+							packed.operands[1] = rhs;
+							return add(packed);
+						}
+
+						tree.packs.resize(packs_before);
+						memo = memo_before;
+						owner = owner_before;
+					}
+					return -1;
+				};
+
+				std::array<NodeRef, LANES> values {};
+				for (size_t k = 0; k < LANES; k++)
+					values[k] = graph.inputs(seeds[k])[1];
+
+				const int value = pack(values);
+				if (value < 0)
+					return false;
+
+				Pack store { NodeType::VECTOR_STORE, seeds };
+				store.operands[0] = value;
+				tree.packs.push_back(store);
+
+				tree.anchor = *std::max_element(seeds.begin(), seeds.end(), [&](const NodeRef lhs, const NodeRef rhs)
+				{
+					return position[lhs] < position[rhs];
+				});
+
+				/*
+				 * the loads move down to the anchor, and the stores with them: no
+				 * other write may sit between a load and the anchor, and nothing
+				 * else may touch a store's memory between it and the anchor
+				 */
+				const std::unordered_set<NodeRef> seed_set(seeds.begin(), seeds.end());
+				const size_t anchor = position[tree.anchor];
+				for (const Pack &packed: tree.packs)
+				{
+					if (packed.type != NodeType::VECTOR_LOAD && packed.type != NodeType::VECTOR_STORE)
+						continue;
+
+					const bool loads = packed.type == NodeType::VECTOR_LOAD;
+					for (const NodeRef lane: packed.lanes)
+					{
+						for (size_t at = position[lane] + 1; at < anchor; at++)
+						{
+							const NodeRef other = nodes[at];
+							const NodeType type = graph.type(other);
+							if (seed_set.contains(other) || (loads ? !writes_memory(type) : !touches_memory(type)))
+								continue;
+							if (may_conflict(lane, other))
+								return false;
+						}
+					}
+				}
+
+				/* scalars the tree still needs for a reader outside it stay */
+				std::unordered_set<NodeRef> removed;
+				for (auto it = tree.packs.rbegin(); it != tree.packs.rend(); ++it)
+				{
+					if (it->type == NodeType::VECTOR_SPLAT)
+						continue;
+
+					const auto remove_if_unread = [&](const NodeRef node)
+					{
+						const NodeSpan users = graph.users(node);
+						if (!std::all_of(users.begin(), users.end(), [&](const NodeRef user) { return removed.contains(user); }))
+							return false;
+
+						removed.insert(node);
+						tree.removed.push_back(node);
+						return true;
+					};
+
+					const bool memory = it->type == NodeType::VECTOR_LOAD || it->type == NodeType::VECTOR_STORE;
+					for (size_t k = 0; k < LANES; k++)
+					{
+						/* the vector node keeps lane 0's address; the others may go with their lanes */
+						const NodeRef lane = it->lanes[k];
+						if (remove_if_unread(lane) && memory && k > 0)
+						{
+							const NodeRef address = graph.inputs(lane)[0];
+							if (graph.type(address) == NodeType::PTR_ADD && graph.region_of(address) == block &&
+							    !removed.contains(address))
+							{
+								remove_if_unread(address);
+							}
+						}
+					}
+				}
+				return true;
+			};
+
+			for (const NodeRef base: bases)
+			{
+				auto &group = stores[base];
+				std::stable_sort(group.begin(), group.end(), [](const auto &lhs, const auto &rhs)
+				{
+					return lhs.first < rhs.first;
+				});
+
+				for (size_t first = 0; first + LANES <= group.size();)
+				{
+					bool adjacent = true;
+					std::array<NodeRef, LANES> seeds {};
+					for (size_t k = 0; k < LANES; k++)
+					{
+						adjacent &= group[first + k].first == group[first].first + static_cast<int64_t>(k) * ELEMENT_SIZE;
+						seeds[k] = group[first + k].second;
+					}
+
+					Tree tree { block, NULL_REF, {}, {} };
+					if (!adjacent || std::any_of(seeds.begin(), seeds.end(), [&](const NodeRef seed) { return claimed.contains(seed); }) ||
+					    !build(seeds, tree))
+					{
+						first++;
+						continue;
+					}
+
+					SLPResult result;
+					result.block = block;
+					result.store = seeds[0];
+					result.scalar_cost = static_cast<uint32_t>(tree.removed.size());
+					result.vector_cost = static_cast<uint32_t>(tree.packs.size());
+					result.packed = result.scalar_cost >= result.vector_cost + min_savings;
+					unit_results[unit.index].push_back(result);
+
+					if (result.packed)
+					{
+						for (const Pack &packed: tree.packs)
+						{
+							if (packed.type != NodeType::VECTOR_SPLAT)
+								claimed.insert(packed.lanes.begin(), packed.lanes.end());
+						}
+						units[unit.index].push_back(std::move(tree));
+						first += LANES;
+					}
+					else
+					{
+						first++;
+					}
+				}
+			}
+		};
+
+		std::function<void(RegionRef)> visit = [&](const RegionRef region)
+		{
+			if (graph.region(region).get_type() == RegionType::BASIC_BLOCK)
+				process(region);
+			for (const RegionRef child: graph.region(region).get_children())
+				visit(child);
+		};
+		visit(unit.region);
+	}
+
+	void SLPVectorizePass::finish(const RegionRef root,
+	                              SproutGraph &graph,
+	                              const std::vector<FunctionEdits> &edits)
+	{
+		for (const std::vector<SLPResult> &unit: unit_results)
+			results.insert(results.end(), unit.begin(), unit.end());
+
+		for (const std::vector<Tree> &trees: units)
+		{
+			for (const Tree &tree: trees)
+			{
+				const NodeRef fn = graph.fn_ref(tree.anchor);
+				std::vector<NodeRef> made(tree.packs.size());
+				for (size_t k = 0; k < tree.packs.size(); k++)
+				{
+					const Pack &packed = tree.packs[k];
+					const NodeRef lane = packed.lanes[0];
+					const NodeRef ref = graph.create(packed.type);
+					graph.set_name(ref, std::string(graph.name(lane)) + "_slp");
+					graph.set_fn_ref(ref, fn);
+					graph.set_value(ref, static_cast<int64_t>(LANES));
+
+					switch (packed.type)
+					{
+						case NodeType::VECTOR_SPLAT:
+							graph.add_input(ref, lane);
+							break;
+						case NodeType::VECTOR_LOAD:
+							graph.add_input(ref, graph.inputs(lane)[0]);
+							break;
+						case NodeType::VECTOR_STORE:
+							graph.add_input(ref, graph.inputs(lane)[0]);
+							graph.add_input(ref, made[packed.operands[0]]);
+							break;
+						default:
+							graph.add_input(ref, made[packed.operands[0]]);
+							graph.add_input(ref, made[packed.operands[1]]);
+							break;
+					}
+
+					if (const NodeRef obj = graph.mem_obj(lane); obj != NULL_REF)
+						graph.set_mem_obj(ref, obj);
+					made[k] = ref;
+				}
+
+				/* the vector nodes take the anchor's place; the scalars they replace go */
+				const std::unordered_set<NodeRef> removed(tree.removed.begin(), tree.removed.end());
+				std::vector<NodeRef> order;
+				for (const NodeRef node: graph.region(tree.block).get_nodes())
+				{
+					if (node == tree.anchor)
+						order.insert(order.end(), made.begin(), made.end());
+					if (graph.contains(node) && !removed.contains(node))
+						order.push_back(node);
+				}
+				graph.replace_nodes(tree.block, std::move(order));
+
+				/* users first */
+				for (const NodeRef node: tree.removed)
+					graph.remove(node);
+			}
+		}
+
+		units.clear();
+		unit_results.clear();
+	}
+
+	void SLPVectorizePass::dump_results(const SproutGraph &graph, const bool colorize) const
+	{
+		const char *header_color = colorize ? BLUE : "";
+		const char *node_color = colorize ? GREEN : "";
+		const char *reset = colorize ? RESET : "";
+
+		std::cout << header_color << "\nSLP results" << reset << "\n";
+		std::cout << "costed " << results.size() << " store groups:\n";
+		for (const SLPResult &result: results)
+		{
+			std::cout << "  " << graph.region(result.block).get_name() << ": stores from #" << node_color
+					<< result.store << reset << ", " << result.scalar_cost << " scalar vs " << result.vector_cost
+					<< " vector nodes, " << (result.packed ? "packed" : "kept scalar") << "\n";
+		}
+	}
+}
@@ -0,0 +1,662 @@
+#include <algorithm>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <set>
+#include <sparkle/sprout/passes/sroa.hpp>
+#include <sparkle/sprout/utils/dump.hpp>
+
+namespace sprk
+{
+	namespace
+	{
+		bool is_load(const NodeType type)
+		{
+			return type == NodeType::LOAD || type == NodeType::PTR_LOAD;
+		}
+
+		bool is_store(const NodeType type)
+		{
+			return type == NodeType::STORE || type == NodeType::PTR_STORE;
+		}
+
+		/* the byte offset a PTR_ADD moves by, if it is a constant */
+		bool constant_offset(const SproutGraph &graph, const NodeRef ptr_add, int64_t &offset)
+		{
+			const NodeRef step = graph.inputs(ptr_add)[1];
+			if (!graph.contains(step) || graph.type(step) != NodeType::CONST ||
+			    !std::holds_alternative<int64_t>(graph.value(step)))
+				return false;
+
+			offset = std::get<int64_t>(graph.value(step));
+			return true;
+		}
+
+		/*
+		 * the value of every slot at the current point of the walk, with an
+		 * undo log so a branch arm can be walked, rolled back and met with
+		 * the other; the same scheme the alias analysis uses for memory states
+		 */
+		template<typename T>
+		class SlotStates
+		{
+		public:
+			explicit SlotStates(std::vector<T> initial) : states(std::move(initial)) {}
+
+			[[nodiscard]] T get(const uint32_t slot) const
+			{
+				return states[slot];
+			}
+
+			void set(const uint32_t slot, const T value)
+			{
+				if (states[slot] == value)
+					return;
+
+				undo.emplace_back(slot, states[slot]);
+				states[slot] = value;
+			}
+
+			[[nodiscard]] size_t mark() const
+			{
+				return undo.size();
+			}
+
+			/* each slot changed since `from`, with its value at that point */
+			[[nodiscard]] std::vector<std::pair<uint32_t, T> > changes(const size_t from) const
+			{
+				std::vector<std::pair<uint32_t, T> > result;
+				std::set<uint32_t> seen;
+				for (size_t i = from; i < undo.size(); i++)
+				{
+					if (seen.insert(undo[i].first).second)
+						result.push_back(undo[i]);
+				}
+				return result;
+			}
+
+			void rollback(const size_t to)
+			{
+				while (undo.size() > to)
+				{
+					states[undo.back().first] = undo.back().second;
+					undo.pop_back();
+				}
+			}
+
+		private:
+			std::vector<T> states;
+			std::vector<std::pair<uint32_t, T> > undo;
+		};
+
+		/*
+		 * walks a region's own nodes, then its children. `meet` gets the
+		 * then and else values of a slot either arm changed, with NULL_REGION
+		 * for an arm that is missing; `enter` and `leave` bracket a LOOP_BODY
+		 */
+		template<typename T, typename Visit, typename Meet, typename Enter, typename Leave>
+		void walk_regions(const SproutGraph &graph, const RegionRef region, SlotStates<T> &states,
+		                  Visit &visit, Meet &meet, Enter &enter, Leave &leave)
+		{
+			const auto walk = [&](const RegionRef child)
+			{
+				walk_regions(graph, child, states, visit, meet, enter, leave);
+			};
+
+			for (const NodeRef node: graph.region(region).get_nodes())
+				visit(node);
+
+			/* copied; the walk may add nodes, not regions, but stay safe */
+			const std::vector<RegionRef> children = graph.region(region).get_children();
+			for (size_t i = 0; i < children.size(); i++)
+			{
+				const RegionRef child = children[i];
+				const RegionType type = graph.region(child).get_type();
+				if (type == RegionType::BRANCH_THEN && i + 1 < children.size() &&
+				    graph.region(children[i + 1]).get_type() == RegionType::BRANCH_ELSE)
+				{
+					const RegionRef other = children[++i];
+					const size_t mark = states.mark();
+					walk(child);
+
+					std::vector<std::pair<uint32_t, T> > then_values = states.changes(mark);
+					for (auto &[slot, value]: then_values)
+						value = states.get(slot);
+					states.rollback(mark);
+
+					walk(other);
+
+					/* a slot one arm left alone keeps its value from before the branch on that side */
+					std::vector<std::pair<uint32_t, std::pair<T, T> > > met;
+					std::set<uint32_t> changed;
+					for (const auto &[slot, value]: then_values)
+					{
+						met.push_back({ slot, { value, states.get(slot) } });
+						changed.insert(slot);
+					}
+					for (const auto &[slot, before]: states.changes(mark))
+					{
+						if (!changed.count(slot))
+							met.push_back({ slot, { before, states.get(slot) } });
+					}
+
+					for (const auto &[slot, values]: met)
+						states.set(slot, meet(slot, child, other, values.first, values.second));
+				}
+				else if (type == RegionType::BRANCH_THEN || type == RegionType::BRANCH_ELSE)
+				{
+					const size_t mark = states.mark();
+					walk(child);
+					for (const auto &[slot, before]: states.changes(mark))
+					{
+						const T after = states.get(slot);
+						states.set(slot, type == RegionType::BRANCH_THEN
+							                 ? meet(slot, child, NULL_REGION, after, before)
+							                 : meet(slot, NULL_REGION, child, before, after));
+					}
+				}
+				else if (type == RegionType::LOOP_BODY)
+				{
+					const size_t mark = states.mark();
+					enter(child);
+					walk(child);
+					leave(child, mark);
+				}
+				else
+				{
+					walk(child);
+				}
+			}
+		}
+	}
+
+	void SROAPass::begin(const SproutGraph &graph, const size_t unit_count)
+	{
+		results.clear();
+		forwarded.clear();
+		units.assign(unit_count, {});
+	}
+
+	void SROAPass::run_function(const FunctionUnit &unit,
+	                            const SproutGraph &graph,
+	                            WorkerScratch &scratch,
+	                            FunctionEdits &edits)
+	{
+		if (unit.region == NULL_REGION)
+			return;
+
+		UnitResult &result = units[unit.index];
+
+		/* accesses under regions the walk cannot merge keep their object in memory */
+		const auto walkable = [&](RegionRef region)
+		{
+			for (; region != unit.region; region = graph.region(region).get_parent())
+			{
+				if (region == NULL_REGION)
+					return false;
+
+				const SproutRegion &r = graph.region(region);
+				if (r.get_type() == RegionType::EXCEPTION ||
+				    ((r.get_type() == RegionType::BRANCH_THEN || r.get_type() == RegionType::BRANCH_ELSE) &&
+				     r.get_ctrl_dep() == NULL_REF))
+					return false;
+			}
+			return true;
+		};
+
+		/* every slot of an object whose pointer is only used as an address */
+		std::vector<Slot> slots;
+		std::unordered_map<NodeRef, uint32_t> access_slot;
+		std::vector<std::pair<NodeRef, std::vector<NodeRef> > > object_addresses;
+		std::vector<std::pair<NodeRef, int64_t> > pending;
+		std::vector<std::pair<NodeRef, int64_t> > accesses;
+		std::vector<NodeRef> addresses;
+		for (const NodeRef object: unit.nodes)
+		{
+			if (!graph.contains(object))
+				continue;
+
+			const NodeType type = graph.type(object);
+			if (type != NodeType::MALLOC && type != NodeType::STACK_ALLOC && type != NodeType::ADDR_OF)
+				continue;
+
+			/* two ADDR_OFs of one value are two pointers to the same memory */
+			if (type == NodeType::ADDR_OF)
+			{
+				if (graph.inputs(object).empty())
+					continue;
+
+				const NodeRef value = graph.inputs(object)[0];
+				const auto users = graph.users(value);
+				if (std::any_of(users.begin(), users.end(), [&](const NodeRef user)
+				{
+					return user != object && graph.type(user) == NodeType::ADDR_OF;
+				}))
+					continue;
+			}
+
+			bool fits = true;
+			accesses.clear();
+			addresses.clear();
+			pending = { { object, 0 } };
+			scratch.mark(object);
+			while (!pending.empty() && fits)
+			{
+				const auto [pointer, offset] = pending.back();
+				pending.pop_back();
+
+				for (const NodeRef user: graph.users(pointer))
+				{
+					if (!scratch.mark(user))
+						continue;
+
+					const NodeType user_type = graph.type(user);
+					const NodeSpan inputs = graph.inputs(user);
+					int64_t step = 0;
+					if (is_load(user_type) && inputs.size() == 1 && walkable(graph.region_of(user)))
+					{
+						accesses.emplace_back(user, offset);
+					}
+					else if (is_store(user_type) && inputs.size() == 2 && inputs[0] == pointer &&
+					         inputs[1] != pointer && walkable(graph.region_of(user)))
+					{
+						accesses.emplace_back(user, offset);
+					}
+					else if (user_type == NodeType::PTR_ADD && inputs.size() == 2 && inputs[0] == pointer &&
+					         inputs[1] != pointer && constant_offset(graph, user, step))
+					{
+						addresses.push_back(user);
+						pending.emplace_back(user, offset + step);
+					}
+					else if (user_type != NodeType::FREE || type != NodeType::MALLOC)
+					{
+						fits = false;
+						break;
+					}
+				}
+			}
+
+			pending.clear();
+			scratch.reset();
+			if (!fits || accesses.empty())
+				continue;
+
+			/* one slot per offset, in offset order; an ADDR_OF's field 0 holds what it points at */
+			std::map<int64_t, uint32_t> fields;
+			for (const auto &[access, offset]: accesses)
+				fields.emplace(offset, 0);
+			for (auto &[offset, slot]: fields)
+			{
+				slot = static_cast<uint32_t>(slots.size());
+				slots.push_back({ object, offset, type == NodeType::ADDR_OF && offset == 0 ? graph.inputs(object)[0] : NULL_REF });
+			}
+
+			for (const auto &[access, offset]: accesses)
+				access_slot[access] = fields[offset];
+			object_addresses.emplace_back(object, addresses);
+		}
+
+		/* a field is promoted when no load of it may read it before a store */
+		std::vector<bool> rejected(slots.size());
+		std::vector<uint8_t> initial(slots.size());
+		for (size_t i = 0; i < slots.size(); i++)
+			initial[i] = slots[i].initial != NULL_REF;
+
+		SlotStates<uint8_t> defined(std::move(initial));
+		const auto visit = [&](const NodeRef node)
+		{
+			const auto it = access_slot.find(node);
+			if (it == access_slot.end())
+				return;
+
+			if (is_store(graph.type(node)))
+				defined.set(it->second, 1);
+			else if (!defined.get(it->second))
+				rejected[it->second] = true;
+		};
+		const auto meet = [](uint32_t, RegionRef, RegionRef, const uint8_t a, const uint8_t b)
+		{
+			return static_cast<uint8_t>(a && b);
+		};
+		const auto enter = [](RegionRef) {};
+
+		/* the loop's PHI holds what was there before on the first trip; stores only add */
+		const auto leave = [&](RegionRef, const size_t mark) { defined.rollback(mark); };
+		walk_regions(graph, unit.region, defined, visit, meet, enter, leave);
+
+		std::vector<uint32_t> renumbered(slots.size(), UINT32_MAX);
+		std::set<NodeRef> promoted_objects;
+		for (uint32_t i = 0; i < slots.size(); i++)
+		{
+			if (rejected[i])
+				continue;
+
+			renumbered[i] = static_cast<uint32_t>(result.slots.size());
+			result.slots.push_back(slots[i]);
+			promoted_objects.insert(slots[i].object);
+		}
+
+		for (const auto &[access, slot]: access_slot)
+		{
+			if (renumbered[slot] != UINT32_MAX)
+				result.accesses.emplace(access, renumbered[slot]);
+		}
+
+		result.region = unit.region;
+		for (const auto &[object, list]: object_addresses)
+		{
+			if (promoted_objects.count(object))
+				result.addresses.insert(result.addresses.end(), list.begin(), list.end());
+		}
+
+		/*
+		 * store-to-load forwarding in each region, over the memory that
+		 * stays. the alias analysis only drops entries a store may clobber;
+		 * one location for both pointers means one allocation site, which a
+		 * MALLOC in a loop reuses for a new object each trip, so the address
+		 * itself has to match: the same value, or the same base moved by the
+		 * same constant
+		 */
+		const AliasAnalysisPass &aa = *aa_pass;
+		std::function<bool(NodeRef, NodeRef)> same_address = [&](const NodeRef a, const NodeRef b)
+		{
+			if (a == b)
+				return true;
+
+			if (!graph.contains(a) || !graph.contains(b) ||
+			    graph.type(a) != NodeType::PTR_ADD || graph.type(b) != NodeType::PTR_ADD ||
+			    graph.inputs(a).size() != 2 || graph.inputs(b).size() != 2)
+				return false;
+
+			int64_t lhs = 0;
+			int64_t rhs = 0;
+			return constant_offset(graph, a, lhs) && constant_offset(graph, b, rhs) && lhs == rhs &&
+			       same_address(graph.inputs(a)[0], graph.inputs(b)[0]);
+		};
+
+		struct Available
+		{
+			NodeRef address;
+			NodeRef value;
+			NodeRef store;
+		};
+
+		std::unordered_map<NodeRef, NodeRef> replaced;
+		const auto resolve = [&](const NodeRef value)
+		{
+			const auto it = replaced.find(value);
+			return it == replaced.end() ? value : it->second;
+		};
+
+		std::vector<RegionRef> stack = { unit.region };
+		std::vector<Available> available;
+		while (!stack.empty())
+		{
+			const RegionRef region = stack.back();
+			stack.pop_back();
+
+			const auto &children = graph.region(region).get_children();
+			stack.insert(stack.end(), children.rbegin(), children.rend());
+
+			available.clear();
+			for (const NodeRef node: graph.region(region).get_nodes())
+			{
+				if (!graph.contains(node) || result.accesses.count(node))
+					continue;
+
+				const NodeType type = graph.type(node);
+				const NodeSpan inputs = graph.inputs(node);
+				if (is_load(type) && !inputs.empty())
+				{
+					for (auto it = available.rbegin(); it != available.rend(); ++it)
+					{
+						if (!same_address(it->address, inputs[0]))
+							continue;
+
+						edits.replace_all_uses(node, it->value);
+						edits.remove(node);
+						replaced[node] = it->value;
+						result.forwarded.push_back({ node, it->store });
+						break;
+					}
+				}
+				else if (is_store(type) && inputs.size() == 2)
+				{
+					available.erase(std::remove_if(available.begin(), available.end(), [&](const Available &entry)
+					{
+						return aa.may_alias(entry.address, inputs[0]);
+					}), available.end());
+					available.push_back({ inputs[0], resolve(inputs[1]), node });
+				}
+				else if ((type == NodeType::VECTOR_STORE || type == NodeType::FREE) && !inputs.empty())
+				{
+					available.erase(std::remove_if(available.begin(), available.end(), [&](const Available &entry)
+					{
+						return aa.points_to_same_memory(entry.address, inputs[0]);
+					}), available.end());
+				}
+				else if (type == NodeType::CALL || is_store(type))
+				{
+					available.clear();
+				}
+			}
+		}
+	}
+
+	void SROAPass::promote(const UnitResult &unit, SproutGraph &graph)
+	{
+		const RegionRef function = unit.region;
+		std::map<NodeRef, SROAResult> objects;
+		std::vector<NodeRef> initial(unit.slots.size());
+		for (uint32_t i = 0; i < unit.slots.size(); i++)
+		{
+			initial[i] = unit.slots[i].initial;
+			SROAResult &result = objects[unit.slots[i].object];
+			result.object = unit.slots[i].object;
+			result.fields++;
+		}
+
+		/* slots stored in each loop, innermost loops included; sorted so PHIs are made in a fixed order */
+		std::vector<std::pair<NodeRef, uint32_t> > sorted(unit.accesses.begin(), unit.accesses.end());
+		std::sort(sorted.begin(), sorted.end());
+
+		std::map<RegionRef, std::set<uint32_t> > loop_slots;
+		for (const auto &[access, slot]: sorted)
+		{
+			if (!is_store(graph.type(access)))
+				continue;
+
+			for (RegionRef r = graph.region_of(access); r != function && r != NULL_REGION; r = graph.region(r).get_parent())
+			{
+				if (graph.region(r).get_type() == RegionType::LOOP_BODY)
+					loop_slots[r].insert(slot);
+			}
+		}
+
+		std::set<RegionRef> touched;
+		std::map<RegionRef, std::vector<NodeRef> > headers;
+		const auto remove = [&](const NodeRef node)
+		{
+			touched.insert(graph.region_of(node));
+			graph.remove(node);
+		};
+
+		const auto make_phi = [&](const uint32_t slot, const RegionRef region, const std::vector<NodeRef> &inputs)
+		{
+			const Slot &s = unit.slots[slot];
+			const NodeRef phi = graph.create(NodeType::PHI);
+			graph.set_name(phi, std::string(graph.name(s.object)) + "+" + std::to_string(s.offset));
+			graph.set_fn_ref(phi, graph.fn_ref(s.object));
+			graph.add_node(region, phi);
+			for (const NodeRef input: inputs)
+				graph.add_input(phi, input);
+
+			objects[s.object].phis++;
+			return phi;
+		};
+
+		SlotStates<NodeRef> values(std::move(initial));
+		const auto visit = [&](const NodeRef node)
+		{
+			const auto it = unit.accesses.find(node);
+			if (it == unit.accesses.end() || !graph.contains(node))
+				return;
+
+			SROAResult &result = objects[unit.slots[it->second].object];
+			if (is_store(graph.type(node)))
+			{
+				values.set(it->second, graph.inputs(node)[1]);
+				result.stores++;
+			}
+			else
+			{
+				graph.replace_all_uses(node, values.get(it->second));
+				result.loads++;
+			}
+			remove(node);
+		};
+
+		const auto meet = [&](const uint32_t slot, const RegionRef then_region, const RegionRef else_region,
+		                      const NodeRef a, const NodeRef b)
+		{
+			if (a == b || a == NULL_REF || b == NULL_REF)
+				return a == b ? a : NULL_REF;
+
+			const RegionRef branch = then_region != NULL_REGION ? then_region : else_region;
+			return make_phi(slot, graph.region(branch).get_parent(), { a, b, graph.region(branch).get_ctrl_dep() });
+		};
+
+		/* one PHI(init, next) per slot the loop stores; a slot with no value yet is never read there */
+		struct LoopPhi
+		{
+			uint32_t slot;
+			NodeRef phi;
+			NodeRef init;
+		};
+
+		std::vector<std::vector<LoopPhi> > loops;
+		const auto enter = [&](const RegionRef loop)
+		{
+			std::vector<LoopPhi> &phis = loops.emplace_back();
+			if (const auto it = loop_slots.find(loop); it != loop_slots.end())
+			{
+				for (const uint32_t slot: it->second)
+				{
+					const NodeRef init = values.get(slot);
+					const NodeRef phi = init == NULL_REF ? NULL_REF : make_phi(slot, loop, { init });
+					if (phi != NULL_REF)
+						headers[loop].push_back(phi);
+
+					phis.push_back({ slot, phi, init });
+					values.set(slot, phi);
+				}
+			}
+		};
+
+		const auto leave = [&](RegionRef, size_t)
+		{
+			for (const auto &[slot, phi, init]: loops.back())
+			{
+				const NodeRef next = values.get(slot);
+				if (phi == NULL_REF)
+					continue;
+
+				/* nothing in the loop changed it after all */
+				if (next == phi)
+				{
+					graph.replace_all_uses(phi, init);
+					objects[unit.slots[slot].object].phis--;
+					remove(phi);
+					values.set(slot, init);
+					continue;
+				}
+
+				graph.add_input(phi, next);
+				values.set(slot, phi);
+			}
+			loops.pop_back();
+		};
+
+		walk_regions(graph, function, values, visit, meet, enter, leave);
+
+		/* addresses before objects; later PTR_ADDs build on earlier ones */
+		for (auto it = unit.addresses.rbegin(); it != unit.addresses.rend(); ++it)
+		{
+			if (graph.contains(*it) && graph.users(*it).empty())
+				remove(*it);
+		}
+
+		for (const auto &[object, result]: objects)
+		{
+			if (graph.contains(object) && graph.users(object).empty() && graph.type(object) != NodeType::MALLOC)
+				remove(object);
+		}
+
+		/* loop PHIs go first in their loop; removed nodes leave their region lists */
+		for (const auto &[loop, phis]: headers)
+			touched.insert(loop);
+
+		for (const RegionRef region: touched)
+		{
+			if (region == NULL_REGION)
+				continue;
+
+			std::vector<NodeRef> live;
+			const auto header = headers.find(region);
+			if (header != headers.end())
+			{
+				for (const NodeRef phi: header->second)
+				{
+					if (graph.contains(phi))
+						live.push_back(phi);
+				}
+			}
+
+			for (const NodeRef node: graph.region(region).get_nodes())
+			{
+				if (graph.contains(node) && std::find(live.begin(), live.end(), node) == live.end())
+					live.push_back(node);
+			}
+			graph.replace_nodes(region, std::move(live));
+		}
+
+		for (const auto &[object, result]: objects)
+			results.push_back(result);
+	}
+
+	void SROAPass::finish(const RegionRef root,
+	                      SproutGraph &graph,
+	                      const std::vector<FunctionEdits> &edits)
+	{
+		/* the forwarded loads are gone; functions are rewritten one after another */
+		for (const UnitResult &unit: units)
+		{
+			forwarded.insert(forwarded.end(), unit.forwarded.begin(), unit.forwarded.end());
+			if (!unit.slots.empty())
+				promote(unit, graph);
+		}
+		units.clear();
+	}
+
+	void SROAPass::dump_results(const SproutGraph &graph, const bool colorize) const
+	{
+		const char *header_color = colorize ? BLUE : "";
+		const char *node_color = colorize ? GREEN : "";
+		const char *reset = colorize ? RESET : "";
+
+		std::cout << header_color << "\nSROA results" << reset << "\n";
+		std::cout << "promoted " << results.size() << " objects:\n";
+		for (const SROAResult &result: results)
+		{
+			std::cout << "  " << node_color << "node #" << result.object;
+			if (graph.contains(result.object))
+				std::cout << " (" << nttostr(graph.type(result.object)) << " " << graph.name(result.object) << ")";
+			std::cout << reset << ": " << result.fields << " fields, " << result.loads << " loads, "
+					<< result.stores << " stores, " << result.phis << " phis\n";
+		}
+
+		std::cout << "forwarded " << forwarded.size() << " loads:\n";
+		for (const ForwardedLoad &load: forwarded)
+			std::cout << "  " << node_color << "node #" << load.load << reset << " <- store #" << load.store << "\n";
+	}
+}
@@ -0,0 +1,551 @@
+#include <algorithm>
+#include <functional>
+#include <iostream>
+#include <optional>
+#include <unordered_map>
+#include <unordered_set>
+#include <sparkle/sprout/passes/unroll.hpp>
+#include <sparkle/sprout/utils/dump.hpp>
+#include <sparkle/sprout/utils/irutils.hpp>
+
+namespace sprk
+{
+	namespace
+	{
+		using ValueMap = std::unordered_map<NodeRef, NodeRef>;
+
+		std::optional<int64_t> int_constant(const SproutGraph &graph, const NodeRef ref)
+		{
+			if (!graph.contains(ref) || graph.type(ref) != NodeType::CONST)
+				return std::nullopt;
+
+			if (const auto *value = std::get_if<int64_t>(&graph.value(ref)))
+				return *value;
+			return std::nullopt;
+		}
+
+		/* nodes a trip copy cannot duplicate, or whose duplicate would mean something else */
+		bool blocks_unrolling(const NodeType type)
+		{
+			return type == NodeType::CALL ||
+			       type == NodeType::CALL_PARAM ||
+			       type == NodeType::CALL_RESULT ||
+			       type == NodeType::RET ||
+			       type == NodeType::FUNCTION ||
+			       type == NodeType::ENTRY ||
+			       type == NodeType::EXIT ||
+			       type == NodeType::PARAM ||
+			       type == NodeType::CONTROL;
+		}
+
+		/* true if a value defined in `region` can be read in `target` */
+		bool visible_from(const SproutGraph &graph, const RegionRef region, const RegionRef target)
+		{
+			if (region == NULL_REGION)
+				return true;
+
+			for (RegionRef at = target; at != NULL_REGION; at = graph.region(at).get_parent())
+			{
+				if (at == region)
+					return true;
+			}
+
+			return graph.dominates(region, target);
+		}
+
+		/* int64 arithmetic wraps, like the folded code would */
+		int64_t wrapping_mul(const int64_t lhs, const int64_t rhs)
+		{
+			return static_cast<int64_t>(static_cast<uint64_t>(lhs) * static_cast<uint64_t>(rhs));
+		}
+
+		int64_t wrapping_add(const int64_t lhs, const int64_t rhs)
+		{
+			return static_cast<int64_t>(static_cast<uint64_t>(lhs) + static_cast<uint64_t>(rhs));
+		}
+
+		NodeRef make_node(SproutGraph &graph,
+		                  const NodeType type,
+		                  const NodeRef fn,
+		                  const RegionRef region,
+		                  const std::string &name,
+		                  const std::vector<NodeRef> &inputs = {})
+		{
+			const NodeRef ref = graph.create(type);
+			graph.set_name(ref, name);
+			graph.set_fn_ref(ref, fn);
+			for (const NodeRef input: inputs)
+				graph.add_input(ref, input);
+			graph.add_node(region, ref);
+			return ref;
+		}
+
+		NodeRef make_constant(SproutGraph &graph,
+		                      const NodeRef fn,
+		                      const RegionRef region,
+		                      const std::string &name,
+		                      const int64_t value)
+		{
+			const NodeRef ref = make_node(graph, NodeType::CONST, fn, region, name);
+			graph.set_value(ref, value);
+			return ref;
+		}
+
+		/* drops removed nodes from a region's list */
+		void prune_region(SproutGraph &graph, const RegionRef region)
+		{
+			std::vector<NodeRef> live;
+			for (const NodeRef node: graph.region(region).get_nodes())
+			{
+				if (graph.contains(node))
+					live.push_back(node);
+			}
+			graph.replace_nodes(region, std::move(live));
+		}
+	}
+
+	void LoopUnrollPass::begin(const SproutGraph &graph, const size_t unit_count)
+	{
+		results.clear();
+		units.assign(unit_count, {});
+	}
+
+	void LoopUnrollPass::run_function(const FunctionUnit &unit,
+	                                  const SproutGraph &graph,
+	                                  WorkerScratch &scratch,
+	                                  FunctionEdits &edits)
+	{
+		if (unit.region == NULL_REGION)
+			return;
+
+		std::vector<CountedLoop> &found = units[unit.index];
+		std::function<void(RegionRef)> visit = [&](const RegionRef loop)
+		{
+			const SproutRegion &body = graph.region(loop);
+			for (const RegionRef child: body.get_children())
+				visit(child);
+
+			InductionLoop shape;
+			if (!body.get_children().empty() || !match_induction_loop(loop, graph, shape))
+				return;
+
+			const auto in_loop = [&](const NodeRef ref)
+			{
+				return graph.contains(ref) && graph.region_of(ref) == loop;
+			};
+
+			const std::optional<int64_t> step = int_constant(graph, shape.step);
+			if (!step || *step <= 0)
+				return;
+
+			const NodeRef control = shape.control;
+			const NodeRef compare = shape.compare;
+			const NodeRef induction = shape.induction;
+			CountedLoop counted { loop, induction, compare, *step, -1, true, {} };
+
+			/* trips while init + k * step < bound; counts past uint32_t are not worth unrolling anyway */
+			const std::optional<int64_t> first = int_constant(graph, shape.init);
+			const std::optional<int64_t> bound = int_constant(graph, shape.bound);
+			if (first && bound)
+			{
+				uint64_t trips = 0;
+				if (*first < *bound)
+					trips = (static_cast<uint64_t>(*bound) - static_cast<uint64_t>(*first) - 1) / *step + 1;
+				if (trips <= UINT32_MAX)
+					counted.trip_count = static_cast<int64_t>(trips);
+			}
+
+			for (const NodeRef node: body.get_nodes())
+			{
+				if (node == control || node == compare || !graph.contains(node))
+					continue;
+
+				const NodeType type = graph.type(node);
+				const NodeSpan inputs = graph.inputs(node);
+				if (blocks_unrolling(type) || (type == NodeType::PHI && (inputs.size() != 2 || in_loop(inputs[0]))))
+					counted.unrollable = false;
+
+				if (type == NodeType::MUL && inputs.size() == 2 && (inputs[0] == induction) != (inputs[1] == induction))
+				{
+					const NodeRef factor_ref = inputs[0] == induction ? inputs[1] : inputs[0];
+					if (graph.contains(factor_ref) && !in_loop(factor_ref))
+						counted.reducible.push_back(node);
+				}
+			}
+
+			found.push_back(std::move(counted));
+		};
+		/* only leaf loops are taken, so children-first order is still region order */
+		visit(unit.region);
+	}
+
+	void LoopUnrollPass::finish(const RegionRef root,
+	                            SproutGraph &graph,
+	                            const std::vector<FunctionEdits> &edits)
+	{
+		for (const std::vector<CountedLoop> &loops: units)
+		{
+			for (const CountedLoop &counted: loops)
+			{
+				const SproutRegion &body = graph.region(counted.loop);
+				const RegionRef preheader = body.get_imm_dom() != NULL_REGION ? body.get_imm_dom() : body.get_parent();
+				if (preheader == NULL_REGION)
+					continue;
+
+				LoopUnrollResult result;
+				result.loop = counted.loop;
+				result.induction = counted.induction;
+				result.trip_count = counted.trip_count;
+				result.reduced = reduce(counted, preheader, graph);
+				if (counted.unrollable && counted.trip_count > 0)
+					unroll(counted, preheader, graph, result);
+
+				results.push_back(result);
+			}
+		}
+
+		units.clear();
+	}
+
+	uint32_t LoopUnrollPass::reduce(const CountedLoop &counted, const RegionRef preheader, SproutGraph &graph) const
+	{
+		const RegionRef loop = counted.loop;
+		const NodeRef induction = counted.induction;
+		const NodeRef init = graph.inputs(induction)[0];
+		const NodeRef fn = graph.fn_ref(induction);
+		if (!visible_from(graph, graph.region_of(init), preheader))
+			return 0;
+
+		const auto used_outside = [&](const NodeRef node)
+		{
+			for (const NodeRef user: graph.users(node))
+			{
+				if (graph.region_of(user) != loop)
+					return true;
+			}
+			return false;
+		};
+
+		uint32_t reduced = 0;
+		for (const NodeRef mul: counted.reducible)
+		{
+			if (!graph.contains(mul))
+				continue;
+
+			/*
+			 * after the loop the new PHI holds the value for the trip that did
+			 * not run, one increment past what the MUL last computed, so a
+			 * product read outside the loop keeps its MUL
+			 */
+			const NodeRef factor_ref = graph.inputs(mul)[0] == induction ? graph.inputs(mul)[1] : graph.inputs(mul)[0];
+			if (!visible_from(graph, graph.region_of(factor_ref), preheader) || used_outside(mul))
+				continue;
+
+			/* i * c starts at init * c and grows by step * c */
+			const std::string name(graph.name(mul));
+			const std::optional<int64_t> first = int_constant(graph, init);
+			const std::optional<int64_t> scale = int_constant(graph, factor_ref);
+			NodeRef start;
+			if (first && (scale || *first == 0))
+				start = make_constant(graph, fn, preheader, name + "_start", scale ? wrapping_mul(*first, *scale) : 0);
+			else
+				start = make_node(graph, NodeType::MUL, fn, preheader, name + "_start", { init, factor_ref });
+
+			NodeRef increment;
+			if (scale)
+			{
+				increment = make_constant(graph, fn, preheader, name + "_step", wrapping_mul(counted.step, *scale));
+			}
+			else if (counted.step == 1)
+			{
+				increment = factor_ref;
+			}
+			else
+			{
+				const NodeRef step = make_constant(graph, fn, preheader, name + "_stride", counted.step);
+				increment = make_node(graph, NodeType::MUL, fn, preheader, name + "_step", { step, factor_ref });
+			}
+
+			/* base + i * c walks the address itself */
+			std::vector<NodeRef> addresses;
+			for (const NodeRef user: graph.users(mul))
+			{
+				const NodeSpan inputs = graph.inputs(user);
+				if (graph.type(user) == NodeType::PTR_ADD && graph.region_of(user) == loop && inputs.size() == 2 &&
+				    inputs[1] == mul && inputs[0] != mul && graph.region_of(inputs[0]) != loop &&
+				    visible_from(graph, graph.region_of(inputs[0]), preheader) && !used_outside(user) &&
+				    std::find(addresses.begin(), addresses.end(), user) == addresses.end())
+				{
+					addresses.push_back(user);
+				}
+			}
+
+			for (const NodeRef address: addresses)
+			{
+				const std::string address_name(graph.name(address));
+				const NodeRef base_start = make_node(graph, NodeType::PTR_ADD, fn, preheader, address_name + "_start",
+				                                     { graph.inputs(address)[0], start });
+				const NodeRef pointer = make_node(graph, NodeType::PHI, fn, loop, address_name + "_iv", { base_start });
+				const NodeRef advanced = make_node(graph, NodeType::PTR_ADD, fn, loop, address_name + "_next",
+				                                   { pointer, increment });
+				graph.add_input(pointer, advanced);
+				graph.set_result(pointer, graph.result(address));
+				graph.set_result(advanced, graph.result(address));
+
+				graph.replace_all_uses(address, pointer);
+				graph.remove(address);
+			}
+
+			if (!graph.users(mul).empty())
+			{
+				const NodeRef value = make_node(graph, NodeType::PHI, fn, loop, name + "_iv", { start });
+				const NodeRef advanced = make_node(graph, NodeType::ADD, fn, loop, name + "_next", { value, increment });
+				graph.add_input(value, advanced);
+				graph.set_result(value, graph.result(mul));
+				graph.set_result(advanced, graph.result(mul));
+				graph.replace_all_uses(mul, value);
+			}
+
+			graph.remove(mul);
+			reduced++;
+		}
+
+		if (reduced)
+			prune_region(graph, loop);
+		return reduced;
+	}
+
+	void LoopUnrollPass::unroll(const CountedLoop &counted,
+	                            const RegionRef preheader,
+	                            SproutGraph &graph,
+	                            LoopUnrollResult &result) const
+	{
+		const RegionRef loop = counted.loop;
+		const auto trips = static_cast<uint64_t>(counted.trip_count);
+		const bool full = trips <= full_limit;
+		if (!full && (factor < 2 || trips < factor))
+			return;
+
+		const SproutRegion &body = graph.region(loop);
+		const std::string loop_name = body.get_name();
+		const RegionRef parent = body.get_parent();
+		const NodeRef control = body.get_ctrl_dep();
+		const NodeRef fn = graph.fn_ref(counted.induction);
+
+		/* phis carry values between trips; the rest is copied in def-before-use order */
+		std::vector<NodeRef> phis;
+		std::vector<NodeRef> carried; /* each phi's value from the previous trip, before the back edges move */
+		std::vector<NodeRef> operations;
+		std::unordered_set<NodeRef> pending;
+		for (const NodeRef node: body.get_nodes())
+		{
+			if (node == control || node == counted.compare)
+				continue;
+
+			if (graph.type(node) == NodeType::PHI)
+			{
+				phis.push_back(node);
+				carried.push_back(graph.inputs(node)[1]);
+			}
+			else
+				pending.insert(node);
+		}
+
+		std::function<void(NodeRef)> order = [&](const NodeRef node)
+		{
+			if (!pending.erase(node))
+				return;
+
+			for (const NodeRef input: graph.inputs(node))
+				order(input);
+			operations.push_back(node);
+		};
+
+		for (const NodeRef node: body.get_nodes())
+			order(node);
+
+		/* uses outside the loop, taken before any copy adds uses of its own */
+		struct OutsideUse
+		{
+			NodeRef user;
+			uint32_t slot;
+			NodeRef value;
+		};
+
+		std::vector<OutsideUse> outside;
+		for (const std::vector<NodeRef> *group: { &phis, &operations })
+		{
+			for (const NodeRef value: *group)
+			{
+				std::vector<NodeRef> users(graph.users(value).begin(), graph.users(value).end());
+				std::sort(users.begin(), users.end());
+				users.erase(std::unique(users.begin(), users.end()), users.end());
+				for (const NodeRef user: users)
+				{
+					if (graph.region_of(user) == loop)
+						continue;
+
+					const NodeSpan inputs = graph.inputs(user);
+					for (uint32_t slot = 0; slot < inputs.size(); slot++)
+					{
+						if (inputs[slot] == value)
+							outside.push_back({ user, slot, value });
+					}
+				}
+			}
+		}
+
+		const auto value_in = [](const ValueMap &map, const NodeRef ref)
+		{
+			const auto it = map.find(ref);
+			return it == map.end() ? ref : it->second;
+		};
+
+		/* one copy of the body reading `trip`, which holds the phi values on entry */
+		const auto copy_trip = [&](ValueMap &trip, const RegionRef region, const std::string &suffix)
+		{
+			for (const NodeRef node: operations)
+			{
+				const NodeRef copy = graph.create(graph.type(node));
+				graph.set_name(copy, std::string(graph.name(node)) + suffix);
+				graph.set_fn_ref(copy, graph.fn_ref(node));
+				if (graph.value(node).index() != 0)
+					graph.set_value(copy, NodeValue(graph.value(node)));
+				graph.set_result(copy, graph.result(node));
+
+				const std::vector<NodeRef> inputs(graph.inputs(node).begin(), graph.inputs(node).end());
+				for (const NodeRef input: inputs)
+					graph.add_input(copy, value_in(trip, input));
+				if (const NodeRef obj = graph.mem_obj(node); obj != NULL_REF)
+					graph.set_mem_obj(copy, value_in(trip, obj));
+
+				graph.add_node(region, copy);
+				trip[node] = copy;
+			}
+		};
+
+		/* phi values on entry to the trip after `trip` */
+		const auto next_trip = [&](const ValueMap &trip)
+		{
+			ValueMap next;
+			for (size_t p = 0; p < phis.size(); p++)
+				next[phis[p]] = value_in(trip, carried[p]);
+			return next;
+		};
+
+		/* a straight-line block right after the loop */
+		const auto add_block = [&](const std::string &name)
+		{
+			const RegionRef block = graph.create_region(name, RegionType::BASIC_BLOCK);
+			const auto &children = graph.region(parent).get_children();
+			const auto at = std::find(children.begin(), children.end(), loop);
+			graph.insert_child(parent, block, at - children.begin() + 1);
+			graph.set_imm_dominator(block, preheader);
+			return block;
+		};
+
+		/* runs `count` trips straight through; returns the values seen after the last one */
+		const auto peel = [&](ValueMap entry, const uint64_t count, const RegionRef block, const std::string &tag)
+		{
+			ValueMap last;
+			for (uint64_t k = 0; k < count; k++)
+			{
+				copy_trip(entry, block, tag + std::to_string(k));
+				last = entry;
+				entry = next_trip(entry);
+			}
+
+			for (const NodeRef phi: phis)
+				last[phi] = entry[phi];
+			return last;
+		};
+
+		ValueMap exit;
+		if (full)
+		{
+			ValueMap entry;
+			for (const NodeRef phi: phis)
+				entry[phi] = graph.inputs(phi)[0];
+			exit = peel(entry, trips, add_block(loop_name + "_unrolled"), "_");
+
+			result.full = true;
+			result.factor = static_cast<uint32_t>(trips);
+		}
+		else
+		{
+			/* copy k of the body reads what copy k - 1 produced; the back edges take the last copy */
+			ValueMap last;
+			for (uint32_t k = 1; k < factor; k++)
+			{
+				ValueMap trip = next_trip(last);
+				copy_trip(trip, loop, "_" + std::to_string(k));
+				last = std::move(trip);
+			}
+
+			const ValueMap back = next_trip(last);
+			for (const NodeRef phi: phis)
+				graph.set_input(phi, 1, back.at(phi));
+
+			for (const NodeRef node: operations)
+				exit[node] = value_in(last, node);
+
+			/* the loop stops a multiple of the factor in; the rest runs after it */
+			const uint64_t remainder = trips % factor;
+			if (remainder)
+			{
+				const int64_t init = *int_constant(graph, graph.inputs(counted.induction)[0]);
+				const int64_t bound = wrapping_add(init, wrapping_mul(static_cast<int64_t>(trips - remainder), counted.step));
+				const NodeRef bound_ref = make_constant(graph, fn, preheader, loop_name + "_bound", bound);
+				graph.set_input(counted.compare, 1, bound_ref);
+
+				ValueMap entry;
+				for (const NodeRef phi: phis)
+					entry[phi] = phi;
+				exit = peel(entry, remainder, add_block(loop_name + "_remainder"), "_r");
+			}
+
+			result.factor = factor;
+			result.remainder = static_cast<uint32_t>(remainder);
+		}
+
+		for (const OutsideUse &use: outside)
+			graph.set_input(use.user, use.slot, value_in(exit, use.value));
+
+		if (full)
+		{
+			/* copy; removing nodes leaves the list alone but the region goes with it */
+			const std::vector<NodeRef> nodes = graph.region(loop).get_nodes();
+			for (const NodeRef node: nodes)
+				graph.remove(node);
+			graph.remove_region(loop);
+		}
+	}
+
+	void LoopUnrollPass::dump_results(const SproutGraph &graph, const bool colorize) const
+	{
+		const char *header_color = colorize ? BLUE : "";
+		const char *loop_color = colorize ? GREEN : "";
+		const char *reset = colorize ? RESET : "";
+
+		std::cout << header_color << "\nloop unroll results" << reset << "\n";
+		std::cout << "recognised " << results.size() << " loops:\n";
+		for (const LoopUnrollResult &result: results)
+		{
+			std::cout << "  " << loop_color << graph.region(result.loop).get_name() << reset
+					<< " (induction #" << result.induction << "): ";
+			if (result.trip_count < 0)
+				std::cout << "unknown trip count";
+			else
+				std::cout << result.trip_count << " trips";
+			std::cout << ", " << result.reduced << " multiplications reduced, ";
+
+			if (result.full)
+				std::cout << "fully unrolled";
+			else if (result.factor > 1)
+				std::cout << "unrolled by " << result.factor << " with " << result.remainder << " trips peeled";
+			else
+				std::cout << "kept";
+			std::cout << "\n";
+		}
+	}
+}
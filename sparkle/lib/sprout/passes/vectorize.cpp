@@ -0,0 +1,422 @@
+#include <algorithm>
+#include <functional>
+#include <iostream>
+#include <optional>
+#include <unordered_map>
+#include <unordered_set>
+#include <sparkle/sprout/passes/vectorize.hpp>
+#include <sparkle/sprout/utils/dump.hpp>
+#include <sparkle/sprout/utils/irutils.hpp>
+
+namespace sprk
+{
+	namespace
+	{
+		/* bytes per lane; offsets must be i * ELEMENT_SIZE */
+		constexpr int64_t ELEMENT_SIZE = 4;
+
+		/* lanes of a 128-bit NEON register */
+		constexpr int64_t NEON_LANES = 4;
+
+		std::optional<int64_t> int_constant(const SproutGraph &graph, const NodeRef ref)
+		{
+			if (!graph.contains(ref) || graph.type(ref) != NodeType::CONST)
+				return std::nullopt;
+
+			if (const auto *value = std::get_if<int64_t>(&graph.value(ref)))
+				return *value;
+			return std::nullopt;
+		}
+
+		NodeRef make_node(SproutGraph &graph,
+		                  const NodeType type,
+		                  const NodeRef fn,
+		                  const RegionRef region,
+		                  const std::string &name,
+		                  const std::vector<NodeRef> &inputs = {})
+		{
+			const NodeRef ref = graph.create(type);
+			graph.set_name(ref, name);
+			graph.set_fn_ref(ref, fn);
+			for (const NodeRef input: inputs)
+				graph.add_input(ref, input);
+			graph.add_node(region, ref);
+			return ref;
+		}
+
+		NodeRef make_constant(SproutGraph &graph,
+		                      const NodeRef fn,
+		                      const RegionRef region,
+		                      const std::string &name,
+		                      const int64_t value)
+		{
+			const NodeRef ref = make_node(graph, NodeType::CONST, fn, region, name);
+			graph.set_value(ref, value);
+			return ref;
+		}
+
+		/* what a body node turns into, lane by lane */
+		enum class Role : uint8_t
+		{
+			OFFSET,  /* i * ELEMENT_SIZE */
+			ADDRESS, /* base + offset */
+			LANE     /* one element's value: a load or arithmetic on one */
+		};
+	}
+
+	void VectorizePass::begin(const SproutGraph &graph, const size_t unit_count)
+	{
+		results.clear();
+		units.assign(unit_count, {});
+	}
+
+	void VectorizePass::run_function(const FunctionUnit &unit,
+	                                 const SproutGraph &graph,
+	                                 WorkerScratch &scratch,
+	                                 FunctionEdits &edits)
+	{
+		if (unit.region == NULL_REGION)
+			return;
+
+		const auto &aa = *aa_pass;
+		std::vector<VectorLoop> &found = units[unit.index];
+		std::function<void(RegionRef)> visit = [&](const RegionRef loop)
+		{
+			const SproutRegion &body = graph.region(loop);
+			for (const RegionRef child: body.get_children())
+				visit(child);
+
+			InductionLoop shape;
+			if (!body.get_children().empty() || !match_induction_loop(loop, graph, shape))
+				return;
+
+			const auto in_loop = [&](const NodeRef ref)
+			{
+				return graph.contains(ref) && graph.region_of(ref) == loop;
+			};
+
+			/* the vector loop steps by its lane count, so the scalar one has to step by 1 */
+			if (in_loop(shape.step) || int_constant(graph, shape.step) != 1 || in_loop(shape.bound) ||
+			    graph.users(shape.next).size() != 1)
+			{
+				return;
+			}
+
+			/* an invariant scalar, splatted into every lane */
+			const auto invariant = [&](const NodeRef ref)
+			{
+				return graph.contains(ref) && !in_loop(ref);
+			};
+
+			std::unordered_map<NodeRef, Role> roles;
+			const auto has_role = [&](const NodeRef ref, const Role role)
+			{
+				const auto it = roles.find(ref);
+				return it != roles.end() && it->second == role;
+			};
+
+			VectorLoop vector { loop, shape.induction, shape.compare, {} };
+			std::vector<NodeRef> loaded;  /* bases read */
+			std::vector<NodeRef> stored;  /* bases written */
+			for (const NodeRef node: body.get_nodes())
+			{
+				if (node == shape.control || node == shape.compare || node == shape.induction || node == shape.next ||
+				    !graph.contains(node))
+				{
+					continue;
+				}
+
+				const NodeSpan inputs = graph.inputs(node);
+				switch (graph.type(node))
+				{
+					case NodeType::MUL:
+					{
+						if (inputs.size() != 2)
+							return;
+
+						if ((inputs[0] == shape.induction || inputs[1] == shape.induction) && inputs[0] != inputs[1])
+						{
+							const NodeRef scale = inputs[0] == shape.induction ? inputs[1] : inputs[0];
+							if (!invariant(scale) || int_constant(graph, scale) != ELEMENT_SIZE)
+								return;
+							roles[node] = Role::OFFSET;
+							break;
+						}
+						[[fallthrough]];
+					}
+					case NodeType::ADD:
+					{
+						/* one element's arithmetic; two invariants would be loop-invariant code, not a lane */
+						if (inputs.size() != 2 || (!has_role(inputs[0], Role::LANE) && !has_role(inputs[1], Role::LANE)))
+							return;
+						for (const NodeRef input: inputs)
+						{
+							if (!has_role(input, Role::LANE) && !invariant(input))
+								return;
+						}
+						roles[node] = Role::LANE;
+						break;
+					}
+					case NodeType::PTR_ADD:
+					{
+						if (inputs.size() != 2 || !invariant(inputs[0]) || !has_role(inputs[1], Role::OFFSET))
+							return;
+						roles[node] = Role::ADDRESS;
+						break;
+					}
+					case NodeType::PTR_LOAD:
+					{
+						if (inputs.size() != 1 || !has_role(inputs[0], Role::ADDRESS))
+							return;
+						loaded.push_back(graph.inputs(inputs[0])[0]);
+						roles[node] = Role::LANE;
+						break;
+					}
+					case NodeType::PTR_STORE:
+					{
+						if (inputs.size() != 2 || !has_role(inputs[0], Role::ADDRESS) ||
+						    (!has_role(inputs[1], Role::LANE) && !invariant(inputs[1])))
+						{
+							return;
+						}
+						stored.push_back(graph.inputs(inputs[0])[0]);
+						break;
+					}
+					default:
+						return;
+				}
+
+				vector.body.push_back(node);
+			}
+
+			/* a lane value is one element's; nothing after the loop may read it */
+			for (const NodeRef node: vector.body)
+			{
+				for (const NodeRef user: graph.users(node))
+				{
+					if (!in_loop(user))
+						return;
+				}
+			}
+
+			/*
+			 * every access uses the same index, so a store only conflicts with
+			 * accesses through another base that may point at its memory. a
+			 * base the analysis knows nothing about may point anywhere
+			 */
+			for (const std::vector<NodeRef> *bases: { &loaded, &stored })
+			{
+				for (const NodeRef base: *bases)
+				{
+					if (aa.get_points_to_set(base).empty())
+						return;
+				}
+			}
+
+			for (const NodeRef store: stored)
+			{
+				for (const std::vector<NodeRef> *bases: { &loaded, &stored })
+				{
+					for (const NodeRef base: *bases)
+					{
+						if (base != store && aa.points_to_same_memory(store, base))
+							return;
+					}
+				}
+			}
+
+			if (stored.empty())
+				return;
+
+			found.push_back(std::move(vector));
+		};
+		/* only leaf loops are taken, so children-first order is still region order */
+		visit(unit.region);
+	}
+
+	void VectorizePass::finish(const RegionRef root,
+	                           SproutGraph &graph,
+	                           const std::vector<FunctionEdits> &edits)
+	{
+		const bool neon = target == VectorTarget::NEON;
+		const int64_t lanes = neon ? NEON_LANES : 0;
+		for (const std::vector<VectorLoop> &loops: units)
+		{
+			for (const VectorLoop &vector: loops)
+			{
+				const RegionRef loop = vector.loop;
+				const RegionRef parent = graph.region(loop).get_parent();
+				const RegionRef preheader = graph.region(loop).get_imm_dom() != NULL_REGION
+					                            ? graph.region(loop).get_imm_dom()
+					                            : parent;
+				if (parent == NULL_REGION || preheader == NULL_REGION)
+					continue;
+
+				const std::string loop_name = graph.region(loop).get_name();
+				const NodeRef fn = graph.fn_ref(vector.induction);
+				const NodeRef init = graph.inputs(vector.induction)[0];
+				const NodeRef bound = graph.inputs(vector.compare)[1];
+
+				/* the vector loop runs first, from the same preheader */
+				const RegionRef vector_loop = graph.create_region(loop_name + "_vector", RegionType::LOOP_BODY);
+				const auto &children = graph.region(parent).get_children();
+				const auto at = std::find(children.begin(), children.end(), loop);
+				graph.insert_child(parent, vector_loop, at - children.begin());
+				graph.set_imm_dominator(vector_loop, preheader);
+
+				VectorizeResult result;
+				result.loop = loop;
+				result.vector_loop = vector_loop;
+				result.lanes = static_cast<uint32_t>(lanes);
+
+				const auto make_vector = [&](const NodeType type,
+				                             const RegionRef region,
+				                             const std::string &name,
+				                             const std::vector<NodeRef> &inputs)
+				{
+					const NodeRef ref = make_node(graph, type, fn, region, name, inputs);
+					graph.set_value(ref, lanes);
+					result.operations++;
+					return ref;
+				};
+
+				const NodeRef index = make_node(graph, NodeType::PHI, fn, vector_loop, loop_name + "_v", { init });
+				NodeRef next;
+				NodeRef limit;
+				RegionRef splat_region;
+				if (neon)
+				{
+					/* four lanes fit while v + 3 < bound */
+					const NodeRef step = make_constant(graph, fn, preheader, loop_name + "_lanes", lanes);
+					next = make_node(graph, NodeType::ADD, fn, vector_loop, loop_name + "_v + lanes", { index, step });
+					if (const std::optional<int64_t> constant = int_constant(graph, bound))
+					{
+						limit = make_constant(graph, fn, preheader, loop_name + "_vector_bound", *constant - (lanes - 1));
+					}
+					else
+					{
+						const NodeRef slack = make_constant(graph, fn, preheader, loop_name + "_slack", lanes - 1);
+						limit = make_node(graph, NodeType::SUB, fn, preheader, loop_name + "_vector_bound",
+						                  { bound, slack });
+					}
+					splat_region = preheader;
+				}
+				else
+				{
+					/* each trip takes the lanes VECTOR_SETVL grants for what is left */
+					const NodeRef remaining = make_node(graph, NodeType::SUB, fn, vector_loop, loop_name + "_remaining",
+					                                    { bound, index });
+					const NodeRef granted = make_vector(NodeType::VECTOR_SETVL, vector_loop, loop_name + "_vl",
+					                                    { remaining });
+					next = make_node(graph, NodeType::ADD, fn, vector_loop, loop_name + "_v + vl", { index, granted });
+					limit = bound;
+					splat_region = vector_loop;
+				}
+				graph.add_input(index, next);
+
+				const NodeRef compare = make_node(graph, NodeType::CMP, fn, vector_loop, loop_name + "_v < bound",
+				                                  { index, limit });
+				const NodeRef control = make_node(graph, NodeType::CONTROL, fn, vector_loop, loop_name + "_vector_control",
+				                                  { compare });
+				graph.set_ctrl_deps(vector_loop, control);
+
+				/* one splat per invariant scalar */
+				std::unordered_map<NodeRef, NodeRef> copies;
+				const auto lane_value = [&](const NodeRef ref)
+				{
+					if (const auto it = copies.find(ref); it != copies.end())
+						return it->second;
+
+					const std::string name = std::string(graph.name(ref)) + "_splat";
+					const NodeRef splat = make_vector(NodeType::VECTOR_SPLAT, splat_region, name, { ref });
+					copies[ref] = splat;
+					return splat;
+				};
+
+				for (const NodeRef node: vector.body)
+				{
+					const std::string name(graph.name(node));
+					const std::vector<NodeRef> inputs(graph.inputs(node).begin(), graph.inputs(node).end());
+					const NodeType type = graph.type(node);
+					const bool offset = type == NodeType::MUL &&
+					                    (inputs[0] == vector.induction || inputs[1] == vector.induction);
+
+					NodeRef copy;
+					if (offset)
+					{
+						const NodeRef scale = inputs[0] == vector.induction ? inputs[1] : inputs[0];
+						copy = make_node(graph, NodeType::MUL, fn, vector_loop, name, { index, scale });
+					}
+					else if (type == NodeType::PTR_ADD)
+					{
+						copy = make_node(graph, NodeType::PTR_ADD, fn, vector_loop, name, { inputs[0], copies.at(inputs[1]) });
+					}
+					else if (type == NodeType::PTR_LOAD)
+					{
+						copy = make_vector(NodeType::VECTOR_LOAD, vector_loop, name, { copies.at(inputs[0]) });
+					}
+					else if (type == NodeType::PTR_STORE)
+					{
+						copy = make_vector(NodeType::VECTOR_STORE, vector_loop, name,
+						                   { copies.at(inputs[0]), lane_value(inputs[1]) });
+					}
+					else
+					{
+						const NodeType op = type == NodeType::ADD ? NodeType::VECTOR_ADD : NodeType::VECTOR_MUL;
+						copy = make_vector(op, vector_loop, name, { lane_value(inputs[0]), lane_value(inputs[1]) });
+					}
+
+					if (const NodeRef obj = graph.mem_obj(node); obj != NULL_REF)
+						graph.set_mem_obj(copy, obj);
+					copies[node] = copy;
+				}
+
+				if (neon)
+				{
+					/* the scalar loop picks up where the vector one stopped */
+					graph.set_input(vector.induction, 0, index);
+					graph.set_imm_dominator(loop, vector_loop);
+					result.epilogue = loop;
+				}
+				else
+				{
+					/* the strip-mined loop covers every trip; after it, v is where i would have ended */
+					graph.replace_all_uses(vector.induction, index);
+					const std::vector<NodeRef> nodes = graph.region(loop).get_nodes();
+					for (const NodeRef node: nodes)
+					{
+						if (graph.contains(node))
+							graph.remove(node);
+					}
+					graph.remove_region(loop);
+				}
+
+				results.push_back(result);
+			}
+		}
+
+		units.clear();
+	}
+
+	void VectorizePass::dump_results(const SproutGraph &graph, const bool colorize) const
+	{
+		const char *header_color = colorize ? BLUE : "";
+		const char *loop_color = colorize ? GREEN : "";
+		const char *reset = colorize ? RESET : "";
+
+		std::cout << header_color << "\nvectorize results" << reset << "\n";
+		std::cout << "vectorized " << results.size() << " loops:\n";
+		for (const VectorizeResult &result: results)
+		{
+			std::cout << "  " << loop_color << graph.region(result.vector_loop).get_name() << reset << ": ";
+			if (result.lanes)
+				std::cout << result.lanes << " lanes";
+			else
+				std::cout << "strip-mined";
+			std::cout << ", " << result.operations << " vector operations";
+			if (result.epilogue != NULL_REGION)
+				std::cout << ", scalar epilogue " << graph.region(result.epilogue).get_name();
+			std::cout << "\n";
+		}
+	}
+}
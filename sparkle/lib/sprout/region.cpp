@@ -1,87 +1,126 @@
-#include <sparkle/sprout/region.hpp>
+#include <algorithm>
+#include <sparkle/sprout/graph.hpp>
 
 namespace sprk
 {
-	void SproutRegion::add_node(const NodeRef node)
+	RegionRef SproutGraph::create_region(std::string name, const RegionType type, const uint32_t type_id)
 	{
-		nodes.push_back(node);
+		const auto ref = static_cast<RegionRef>(regions.size());
+		regions.emplace_back(std::move(name));
+		regions.back().type = type;
+		regions.back().type_id = type_id;
+		dom_stale = true;
+		return ref;
 	}
 
-	void SproutRegion::add_child(const std::shared_ptr<SproutRegion>& child)
+	void SproutGraph::add_node(const RegionRef region, const NodeRef node)
 	{
-		children.push_back(child);
-		child->parent = std::weak_ptr(shared_from_this());
-		child->region_depth = region_depth + 1;
+		regions[region].nodes.push_back(node);
+		node_regions[node] = region;
 	}
 
-	void SproutRegion::remove_child(const std::shared_ptr<SproutRegion> &child)
+	void SproutGraph::replace_nodes(const RegionRef region, std::vector<NodeRef> nodes)
 	{
-		auto it = std::find(children.begin(), children.end(), child);
-		if (it != children.end())
-			children.erase(it);
-	}
+		/* nodes dropped from the list no longer have an owner */
+		for (const NodeRef node: regions[region].nodes)
+		{
+			if (node_regions[node] == region)
+				node_regions[node] = NULL_REGION;
+		}
 
-	void SproutRegion::replace_nodes(std::vector<NodeRef> new_nodes)
-	{
-		nodes = std::move(new_nodes);
+		for (const NodeRef node: nodes)
+			node_regions[node] = region;
+
+		regions[region].nodes = std::move(nodes);
 	}
 
-	void SproutRegion::set_ctrl_deps(const NodeRef control)
+	void SproutGraph::add_child(const RegionRef parent, const RegionRef child)
 	{
-		ctrl_dep = control;
+		insert_child(parent, child, regions[parent].children.size());
 	}
 
-	void SproutRegion::set_imm_dominator(const std::shared_ptr<SproutRegion>& dom)
+	void SproutGraph::insert_child(const RegionRef parent, const RegionRef child, const size_t index)
 	{
-		imm_dom = dom;
-		if (dom)
-			dom->dom_regions.push_back(shared_from_this());
+		auto &children = regions[parent].children;
+		children.insert(children.begin() + static_cast<std::ptrdiff_t>(std::min(index, children.size())), child);
+		regions[child].parent = parent;
+		regions[child].region_depth = regions[parent].region_depth + 1;
 	}
 
-	void SproutRegion::set_type(const RegionType t, const uint32_t id)
+	void SproutGraph::remove_child(const RegionRef parent, const RegionRef child)
 	{
-		type = t;
-		type_id = id;
+		auto &children = regions[parent].children;
+		if (const auto it = std::find(children.begin(), children.end(), child); it != children.end())
+		{
+			children.erase(it);
+			regions[child].parent = NULL_REGION;
+		}
 	}
 
-	bool SproutRegion::dominates(const std::shared_ptr<const SproutRegion> &other) const
+	void SproutGraph::remove_region(const RegionRef region)
 	{
-		if (!other)
-			return false;
+		SproutRegion &target = regions[region];
+		if (target.removed)
+			return;
 
-		if (other.get() == this)
-			return true; /* shouldn't be cyclic reference */
+		if (target.parent != NULL_REGION)
+			remove_child(target.parent, region);
 
-		std::shared_ptr<SproutRegion> curr = other->imm_dom.lock();
-		while (curr)
+		for (const NodeRef node: target.nodes)
 		{
-			if (curr.get() == this)
-				return true;
-			curr = curr->imm_dom.lock();
+			if (node_regions[node] == region)
+				node_regions[node] = NULL_REGION;
 		}
-		return false;
+
+		for (const RegionRef child: target.children)
+			regions[child].parent = NULL_REGION;
+
+		/* copy; set_imm_dominator edits this region's dom list */
+		const std::vector<RegionRef> dominated = target.dom_regions;
+		for (const RegionRef dom: dominated)
+			set_imm_dominator(dom, target.imm_dom);
+		set_imm_dominator(region, NULL_REGION);
+
+		target.nodes.clear();
+		target.children.clear();
+		target.ctrl_dep = NULL_REF;
+		target.removed = true;
 	}
 
-	std::shared_ptr<const SproutRegion> SproutRegion::find_common_dominator(const std::shared_ptr<SproutRegion> &other) const
+	void SproutGraph::set_ctrl_deps(const RegionRef region, const NodeRef control)
 	{
-		if (!other)
-			return shared_from_this();
+		regions[region].ctrl_dep = control;
+		pin(control);
+	}
+
+	void SproutGraph::set_imm_dominator(const RegionRef region, const RegionRef dom)
+	{
+		if (const RegionRef old = regions[region].imm_dom; old != NULL_REGION)
+		{
+			auto &list = regions[old].dom_regions;
+			list.erase(std::remove(list.begin(), list.end(), region), list.end());
+		}
 
-		if (dominates(other))
-			return shared_from_this();
+		regions[region].imm_dom = dom;
+		if (dom != NULL_REGION)
+			regions[dom].dom_regions.push_back(region);
+		dom_stale = true;
+	}
 
-		if (other->dominates(shared_from_this()))
-			return other;
+	void SproutGraph::set_region_type(const RegionRef region, const RegionType type, const uint32_t type_id)
+	{
+		regions[region].type = type;
+		regions[region].type_id = type_id;
+	}
 
-		std::shared_ptr<SproutRegion> curr = other->imm_dom.lock();
-		while (curr)
+	const DominatorTree &SproutGraph::dominator_tree() const
+	{
+		if (dom_stale)
 		{
-			if (curr->dominates(other))
-				return curr;
-			curr = curr->imm_dom.lock();
+			dom_tree.build(*this);
+			dom_stale = false;
 		}
 
-		/* root region should dominate everything */
-		return nullptr;
+		return dom_tree;
 	}
 }
@@ -0,0 +1,71 @@
+#include <algorithm>
+#include <sparkle/sprout/strings.hpp>
+
+namespace sprk
+{
+	namespace
+	{
+		/* fnv-1a */
+		uint32_t hash_string(const std::string_view str)
+		{
+			uint32_t hash = 2166136261u;
+			for (const char c: str)
+			{
+				hash ^= static_cast<uint8_t>(c);
+				hash *= 16777619u;
+			}
+
+			return hash;
+		}
+	}
+
+	StringTable::StringTable()
+	{
+		offsets.push_back(0);
+		index.assign(64, EMPTY_SLOT);
+		intern({});
+	}
+
+	StringId StringTable::intern(const std::string_view str)
+	{
+		const uint32_t hash = hash_string(str);
+		const size_t mask = index.size() - 1;
+
+		size_t slot = hash & mask;
+		while (index[slot] != EMPTY_SLOT)
+		{
+			const uint32_t id = index[slot];
+			if (hashes[id] == hash && view(static_cast<StringId>(id)) == str)
+				return static_cast<StringId>(id);
+
+			slot = (slot + 1) & mask;
+		}
+
+		const auto id = static_cast<uint32_t>(hashes.size());
+		pool.insert(pool.end(), str.begin(), str.end());
+		offsets.push_back(static_cast<uint32_t>(pool.size()));
+		hashes.push_back(hash);
+		index[slot] = id;
+
+		/* keep the load factor under one half */
+		if (hashes.size() * 2 > index.size())
+			grow_index();
+
+		return static_cast<StringId>(id);
+	}
+
+	void StringTable::grow_index()
+	{
+		std::vector<uint32_t> grown(index.size() * 2, EMPTY_SLOT);
+		const size_t mask = grown.size() - 1;
+		for (uint32_t id = 0; id < hashes.size(); id++)
+		{
+			size_t slot = hashes[id] & mask;
+			while (grown[slot] != EMPTY_SLOT)
+				slot = (slot + 1) & mask;
+			grown[slot] = id;
+		}
+
+		index = std::move(grown);
+	}
+}
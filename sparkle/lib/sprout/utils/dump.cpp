@@ -40,6 +40,8 @@ namespace sprk
 				return "CALL_RESULT";
 			case NodeType::MALLOC:
 				return "MALLOC";
+			case NodeType::STACK_ALLOC:
+				return "STACK_ALLOC";
 			case NodeType::FREE:
 				return "FREE";
 			case NodeType::LOAD:
@@ -56,6 +58,18 @@ namespace sprk
 				return "PTR_ADD";
 			case NodeType::REINTERPRET_CAST:
 				return "REINTERPRET_CAST";
+			case NodeType::VECTOR_LOAD:
+				return "VECTOR_LOAD";
+			case NodeType::VECTOR_STORE:
+				return "VECTOR_STORE";
+			case NodeType::VECTOR_ADD:
+				return "VECTOR_ADD";
+			case NodeType::VECTOR_MUL:
+				return "VECTOR_MUL";
+			case NodeType::VECTOR_SPLAT:
+				return "VECTOR_SPLAT";
+			case NodeType::VECTOR_SETVL:
+				return "VECTOR_SETVL";
 			default:
 				return "<unknown node type>";
 		}
@@ -84,9 +98,9 @@ namespace sprk
 		}
 	}
 
-	const char *get_color_for_node(const SproutNode<> &node)
+	const char *get_color_for_node(const NodeType type)
 	{
-		switch (node.type)
+		switch (type)
 		{
 			case NodeType::ENTRY:
 			case NodeType::EXIT:
@@ -99,6 +113,7 @@ namespace sprk
 			case NodeType::CALL_RESULT:
 				return GREEN;
 			case NodeType::MALLOC:
+			case NodeType::STACK_ALLOC:
 			case NodeType::FREE:
 			case NodeType::LOAD:
 			case NodeType::STORE:
@@ -112,36 +127,94 @@ namespace sprk
 		}
 	}
 
-	void dump_region(const std::shared_ptr<SproutRegion> &region,
-	                 const std::vector<std::unique_ptr<SproutNode<> > > &nodes, int indent, bool colorize)
+	std::string format_node(const SproutGraph &graph, const NodeRef ref, const bool colorize)
+	{
+		std::stringstream ss;
+
+		const char *color = colorize ? get_color_for_node(graph.type(ref)) : "";
+		const char *reset = colorize ? RESET : "";
+		ss << color << "node #" << ref << ": " << nttostr(graph.type(ref));
+
+		if (graph.string_id(ref) != NULL_STRING)
+			ss << " (name: " << graph.name(ref) << ")";
+
+		if (graph.type(ref) == NodeType::CONST)
+		{
+			const NodeValue &value = graph.value(ref);
+			if (std::holds_alternative<int64_t>(value))
+				ss << " = " << std::get<int64_t>(value);
+			else if (std::holds_alternative<double>(value))
+				ss << " = " << std::get<double>(value);
+			else if (std::holds_alternative<StringId>(value))
+				ss << " = \"" << graph.strings().view(std::get<StringId>(value)) << "\"";
+		}
+
+		if (graph.fn_ref(ref) != NULL_REF)
+			ss << " [fn: " << graph.fn_ref(ref) << "]";
+
+		if (graph.mem_obj(ref) != NULL_REF)
+			ss << " [mem: " << graph.mem_obj(ref) << "]";
+
+		if (const NodeSpan inputs = graph.inputs(ref); !inputs.empty())
+		{
+			ss << "\n  inputs: ";
+			for (uint32_t i = 0; i < inputs.size(); ++i)
+			{
+				if (i > 0)
+					ss << ", ";
+				ss << inputs[i];
+			}
+		}
+
+		if (const NodeSpan users = graph.users(ref); !users.empty())
+		{
+			ss << "\n  users: ";
+			for (uint32_t i = 0; i < users.size(); ++i)
+			{
+				if (i > 0)
+					ss << ", ";
+				ss << users[i];
+			}
+		}
+
+		ss << reset;
+		return ss.str();
+	}
+
+	void dump_node(const SproutGraph &graph, const NodeRef ref, const bool colorize)
 	{
-		if (!region)
+		std::cout << format_node(graph, ref, colorize) << "\n";
+	}
+
+	void dump_region(const RegionRef region,
+	                 const SproutGraph &graph, int indent, bool colorize)
+	{
+		if (region == NULL_REGION)
 			return;
 
 		std::string indentation(indent * 2, ' ');
 		const char *region_color = colorize ? YELLOW : "";
 		const char *reset = colorize ? RESET : "";
 
-		std::cout << indentation << region_color << "region: " << region->get_name()
-				<< " (" << rttostr(region->get_type());
+		std::cout << indentation << region_color << "region: " << graph.region(region).get_name()
+				<< " (" << rttostr(graph.region(region).get_type());
 
-		if (region->get_type_id() != 0)
-			std::cout << ", id: " << region->get_type_id();
+		if (graph.region(region).get_type_id() != 0)
+			std::cout << ", id: " << graph.region(region).get_type_id();
 
 		std::cout << ")" << reset << "\n";
 
-		for (NodeRef node_ref: region->get_nodes())
+		for (NodeRef node_ref: graph.region(region).get_nodes())
 		{
-			if (node_ref >= nodes.size() || !nodes[node_ref])
+			if (!graph.contains(node_ref))
 			{
 				std::cout << indentation << "  " << (colorize ? RED : "")
 						<< "invalid node reference: " << node_ref << reset << "\n";
 				continue;
 			}
 
-			const auto &node = nodes[node_ref];
 			std::stringstream ss;
-			ss << format_node(*node, colorize);
+			ss << format_node(graph, node_ref, colorize);
 
 			/* split & indent */
 			std::string line;
@@ -150,28 +223,20 @@ namespace sprk
 				std::cout << indentation << "  " << line << "\n";
 		}
 
-		for (const auto &child: region->get_children())
-			dump_region(child, nodes, indent + 1, colorize);
+		for (const RegionRef child: graph.region(region).get_children())
+			dump_region(child, graph, indent + 1, colorize);
 	}
 
-	void dump_ir(const std::shared_ptr<SproutRegion> &root_region,
-	             const std::vector<std::unique_ptr<SproutNode<> > > &nodes, const bool colorize)
+	void dump_ir(const RegionRef root_region,
+	             const SproutGraph &graph, const bool colorize)
 	{
 		const char *header_color = colorize ? BLUE : "";
 		const char *reset = colorize ? RESET : "";
 
-		/* get the size; nulls do not count */
-		uint32_t c = 0;
-		for (auto& n : nodes)
-		{
-			if (n == nullptr)
-				continue;
-			c++;
-		}
-
+		/* tombstones do not count */
 		std::cout << header_color << "Sprout IR dump:" << reset << "\n";
-		std::cout << header_color << "-> nodes: " << c << reset << "\n";
+		std::cout << header_color << "-> nodes: " << graph.live_size() << reset << "\n";
 
-		dump_region(root_region, nodes, 0, colorize);
+		dump_region(root_region, graph, 0, colorize);
 	}
 }
@@ -2,104 +2,180 @@
 
 namespace sprk
 {
-	std::shared_ptr<SproutRegion> find_function_region(NodeRef func_node, const std::shared_ptr<SproutRegion> &root)
+	bool match_induction_loop(const RegionRef loop, const SproutGraph &graph, InductionLoop &out)
 	{
-		if (!root)
-			return nullptr;
+		const auto in_loop = [&](const NodeRef ref)
+		{
+			return graph.contains(ref) && graph.region_of(ref) == loop;
+		};
+
+		if (graph.region(loop).get_type() != RegionType::LOOP_BODY)
+			return false;
 
-		if (root->get_type() == RegionType::FUNCTION)
+		const NodeRef control = graph.region(loop).get_ctrl_dep();
+		if (!in_loop(control) || graph.type(control) != NodeType::CONTROL ||
+		    graph.inputs(control).size() != 1 || !graph.users(control).empty())
 		{
-			for (const NodeRef node : root->get_nodes())
-			{
-				if (node == func_node)
-					return root;
-			}
+			return false;
 		}
 
-		for (const auto& child : root->get_children())
+		const NodeRef compare = graph.inputs(control)[0];
+		if (!in_loop(compare) || graph.type(compare) != NodeType::CMP ||
+		    graph.inputs(compare).size() != 2 || graph.users(compare).size() != 1)
 		{
-			if (auto result = find_function_region(func_node, child))
-				return result;
+			return false;
 		}
 
-		return nullptr;
+		const NodeRef induction = graph.inputs(compare)[0];
+		if (!in_loop(induction) || graph.type(induction) != NodeType::PHI || graph.inputs(induction).size() != 2)
+			return false;
+
+		const NodeRef init = graph.inputs(induction)[0];
+		const NodeRef next = graph.inputs(induction)[1];
+		if (in_loop(init) || !in_loop(next) || graph.type(next) != NodeType::ADD || graph.inputs(next).size() != 2)
+			return false;
+
+		const NodeSpan next_inputs = graph.inputs(next);
+		if (next_inputs[0] != induction && next_inputs[1] != induction)
+			return false;
+
+		out.control = control;
+		out.compare = compare;
+		out.induction = induction;
+		out.init = init;
+		out.next = next;
+		out.step = next_inputs[0] == induction ? next_inputs[1] : next_inputs[0];
+		out.bound = graph.inputs(compare)[1];
+		return true;
 	}
 
-	std::shared_ptr<SproutRegion> find_node_region(NodeRef node_ref, const std::shared_ptr<SproutRegion> &root)
+	RegionRef find_function_region(const NodeRef func_node, const SproutGraph &graph)
 	{
-		if (!root)
-			return nullptr;
+		if (!graph.contains(func_node))
+			return NULL_REGION;
 
-		for (NodeRef n : root->get_nodes())
-		{
-			if (n == node_ref)
-				return root;
-		}
+		const RegionRef region = graph.region_of(func_node);
+		if (region == NULL_REGION || graph.region(region).get_type() != RegionType::FUNCTION)
+			return NULL_REGION;
 
-		for (const auto& child : root->get_children())
-		{
-			if (auto result = find_node_region(node_ref, child))
-				return result;
-		}
+		return region;
+	}
 
-		return nullptr;
+	RegionRef find_node_region(const NodeRef node_ref, const SproutGraph &graph)
+	{
+		if (!graph.contains(node_ref))
+			return NULL_REGION;
+
+		return graph.region_of(node_ref);
 	}
 
-	std::vector<NodeRef> collect_function_params(NodeRef func_node, const std::vector<std::unique_ptr<SproutNode<> > > &nodes)
+	std::vector<NodeRef> collect_function_params(NodeRef func_node, const SproutGraph &graph)
 	{
 		std::vector<NodeRef> params;
-		for (size_t i = 0; i < nodes.size(); i++)
+		for (NodeRef i = 0; i < graph.size(); i++)
 		{
-			if (!nodes[i])
+			if (!graph.contains(i))
 				continue;
 
-			if (nodes[i]->type == NodeType::PARAM && nodes[i]->fn_ref == func_node)
+			if (graph.type(i) == NodeType::PARAM && graph.fn_ref(i) == func_node)
 				params.emplace_back(i);
 		}
 
 		return params;
 	}
 
-	std::vector<NodeRef> collect_function_returns(NodeRef func_node, const std::vector<std::unique_ptr<SproutNode<> > > &nodes)
+	std::vector<NodeRef> collect_function_returns(NodeRef func_node, const SproutGraph &graph)
 	{
 		std::vector<NodeRef> returns;
-		for (size_t i = 0; i < nodes.size(); i++)
+		for (NodeRef i = 0; i < graph.size(); i++)
 		{
-			if (!nodes[i])
+			if (!graph.contains(i))
 				continue;
-			if (nodes[i]->type == NodeType::RET && nodes[i]->fn_ref == func_node)
+			if (graph.type(i) == NodeType::RET && graph.fn_ref(i) == func_node)
 				returns.emplace_back(i);
 		}
 
 		return returns;
 	}
 
-	NodeRef clone_node(NodeRef orig_node,
-							std::vector<std::unique_ptr<SproutNode<>>> &nodes,
-							NodeRef &next_id,
-							const std::string &suffix)
+	size_t function_size(NodeRef func_node, const SproutGraph &graph)
 	{
-		if (orig_node >= nodes.size() || !nodes[orig_node])
-			return NULL_REF;
+		size_t size = 0;
+		for (NodeRef i = 0; i < graph.size(); i++)
+		{
+			if (graph.contains(i) && graph.fn_ref(i) == func_node)
+				size++;
+		}
+
+		return size;
+	}
 
-		const NodeRef new_id = next_id++;
-		if (new_id >= nodes.size())
-			nodes.resize(new_id + 1);
+	int32_t inlining_growth(const NodeRef call_site, const SproutGraph &graph)
+	{
+		if (!graph.contains(call_site) || graph.inputs(call_site).empty())
+			return 0;
 
-		nodes[new_id] = std::make_unique<SproutNode<>>();
-		nodes[new_id]->type = nodes[orig_node]->type;
-		nodes[new_id]->value = nodes[orig_node]->value;
-		nodes[new_id]->id = new_id;
+		int32_t growth = 0;
+		std::vector<RegionRef> pending;
+		if (const RegionRef region = find_function_region(graph.inputs(call_site)[0], graph); region != NULL_REGION)
+			pending.push_back(region);
 
-		if (nodes[orig_node]->string_id)
+		while (!pending.empty())
 		{
-			const std::string orig_name = reinterpret_cast<const char*>(nodes[orig_node]->string_id);
-			const std::string new_name = orig_name + suffix;
-			auto str_id = new char[new_name.size() + 1];
-			std::strcpy(str_id, new_name.c_str());
-			nodes[new_id]->string_id = reinterpret_cast<uint64_t>(str_id);
+			const SproutRegion &region = graph.region(pending.back());
+			pending.pop_back();
+			for (const NodeRef node: region.get_nodes())
+			{
+				if (!graph.contains(node))
+					continue;
+
+				switch (graph.type(node))
+				{
+					case NodeType::FUNCTION:
+					case NodeType::ENTRY:
+					case NodeType::EXIT:
+					case NodeType::RET:
+					case NodeType::PARAM:
+						break;
+					default:
+						growth++;
+				}
+			}
+			pending.insert(pending.end(), region.get_children().begin(), region.get_children().end());
+		}
+
+		growth--; /* the call */
+		for (const NodeRef input: graph.inputs(call_site))
+		{
+			if (!graph.contains(input) || graph.type(input) != NodeType::CALL_PARAM)
+				continue;
+
+			growth--;
+			if (const NodeSpan param = graph.inputs(input);
+				!param.empty() && graph.contains(param[0]) && graph.type(param[0]) == NodeType::CONST &&
+				graph.users(param[0]).size() == 1)
+			{
+				growth--;
+			}
 		}
 
+		return growth;
+	}
+
+	NodeRef clone_node(NodeRef orig_node,
+							SproutGraph &graph,
+							const std::string &suffix)
+	{
+		if (!graph.contains(orig_node))
+			return NULL_REF;
+
+		const NodeRef new_id = graph.create(graph.type(orig_node));
+		graph.set_value(new_id, graph.value(orig_node));
+
+		/* cpy the name out first; interning may move the pool it points into */
+		if (graph.string_id(orig_node) != NULL_STRING)
+			graph.set_name(new_id, std::string(graph.name(orig_node)) + suffix);
+
 		return new_id;
 	}
-}
\ No newline at end of file
+}
@@ -0,0 +1,234 @@
+#include <fstream>
+#include <functional>
+#include <set>
+#include <sstream>
+#include <sparkle/sprout/utils/profile.hpp>
+
+namespace sprk
+{
+	namespace
+	{
+		/* the name of the FUNCTION node in a FUNCTION region; empty if it holds none */
+		std::string function_name(const SproutGraph &graph, const RegionRef region)
+		{
+			for (const NodeRef node: graph.region(region).get_nodes())
+			{
+				if (graph.contains(node) && graph.type(node) == NodeType::FUNCTION)
+					return std::string(graph.name(node));
+			}
+			return {};
+		}
+
+		RegionRef function_region(const SproutGraph &graph, RegionRef region)
+		{
+			while (region != NULL_REGION && graph.region(region).get_type() != RegionType::FUNCTION)
+				region = graph.region(region).get_parent();
+			return region;
+		}
+
+		/* a function's regions in preorder and its CALLs in region order; their indices are the ordinals */
+		void number(const SproutGraph &graph,
+		            const RegionRef region,
+		            std::vector<RegionRef> &regions,
+		            std::vector<NodeRef> &calls)
+		{
+			regions.push_back(region);
+			for (const NodeRef node: graph.region(region).get_nodes())
+			{
+				if (graph.contains(node) && graph.type(node) == NodeType::CALL)
+					calls.push_back(node);
+			}
+
+			for (const RegionRef child: graph.region(region).get_children())
+				number(graph, child, regions, calls);
+		}
+
+		std::string record(const char *kind, const std::pair<std::string, uint32_t> &key, const uint64_t count)
+		{
+			std::ostringstream out;
+			out << kind << " " << key.second << " " << count << " " << key.first;
+			return out.str();
+		}
+	}
+
+	uint64_t ProfileCounts::call_count(const NodeRef call_site, const SproutGraph &graph) const
+	{
+		if (!graph.contains(call_site) || graph.type(call_site) != NodeType::CALL)
+			return 0;
+
+		if (const auto it = call_counts.find(call_site); it != call_counts.end())
+			return it->second;
+
+		/* a block's count is how often each of its nodes ran */
+		for (RegionRef region = graph.region_of(call_site);
+		     region != NULL_REGION;
+		     region = graph.region(region).get_parent())
+		{
+			if (const auto it = region_counts.find(region); it != region_counts.end())
+				return it->second;
+		}
+
+		return 0;
+	}
+
+	bool ProfileData::add_call(const SproutGraph &graph, const NodeRef call_site, const uint64_t count)
+	{
+		if (!graph.contains(call_site) || graph.type(call_site) != NodeType::CALL)
+			return false;
+
+		const RegionRef function = function_region(graph, graph.region_of(call_site));
+		if (function == NULL_REGION)
+			return false;
+
+		std::vector<RegionRef> regions;
+		std::vector<NodeRef> calls;
+		number(graph, function, regions, calls);
+		for (uint32_t site = 0; site < calls.size(); site++)
+		{
+			if (calls[site] == call_site)
+			{
+				add_call(function_name(graph, function), site, count);
+				return true;
+			}
+		}
+		return false;
+	}
+
+	bool ProfileData::add_region(const SproutGraph &graph, const RegionRef region, const uint64_t count)
+	{
+		const RegionRef function = function_region(graph, region);
+		if (function == NULL_REGION)
+			return false;
+
+		std::vector<RegionRef> regions;
+		std::vector<NodeRef> calls;
+		number(graph, function, regions, calls);
+		for (uint32_t index = 0; index < regions.size(); index++)
+		{
+			if (regions[index] == region)
+			{
+				add_region(function_name(graph, function), index, count);
+				return true;
+			}
+		}
+		return false;
+	}
+
+	ProfileCounts ProfileData::bind(const RegionRef root, const SproutGraph &graph) const
+	{
+		/* every FUNCTION region by name; a name given twice matches neither */
+		std::map<std::string, RegionRef> functions;
+		std::set<std::string> ambiguous;
+		std::function<void(RegionRef)> find = [&](const RegionRef region)
+		{
+			if (graph.region(region).get_type() == RegionType::FUNCTION)
+			{
+				const std::string name = function_name(graph, region);
+				if (!functions.emplace(name, region).second)
+					ambiguous.insert(name);
+				return;
+			}
+
+			for (const RegionRef child: graph.region(region).get_children())
+				find(child);
+		};
+		find(root);
+		for (const std::string &name: ambiguous)
+			functions.erase(name);
+
+		std::map<std::string, std::pair<std::vector<RegionRef>, std::vector<NodeRef> > > numbered;
+		const auto lookup = [&](const std::string &name) -> const std::pair<std::vector<RegionRef>, std::vector<NodeRef> > *
+		{
+			const auto fn = functions.find(name);
+			if (fn == functions.end())
+				return nullptr;
+
+			auto [it, fresh] = numbered.try_emplace(name);
+			if (fresh)
+				number(graph, fn->second, it->second.first, it->second.second);
+			return &it->second;
+		};
+
+		ProfileCounts counts;
+		for (const auto &[key, count]: call_counts)
+		{
+			const auto *refs = lookup(key.first);
+			if (refs && key.second < refs->second.size())
+				counts.call_counts[refs->second[key.second]] += count;
+			else
+				counts.stale.push_back(record("call", key, count));
+		}
+
+		for (const auto &[key, count]: region_counts)
+		{
+			const auto *refs = lookup(key.first);
+			if (refs && key.second < refs->first.size())
+				counts.region_counts[refs->first[key.second]] += count;
+			else
+				counts.stale.push_back(record("region", key, count));
+		}
+
+		return counts;
+	}
+
+	bool ProfileData::read(std::istream &in)
+	{
+		std::string line;
+		while (std::getline(in, line))
+		{
+			if (const size_t comment = line.find('#'); comment != std::string::npos)
+				line.erase(comment);
+
+			std::istringstream fields(line);
+			std::string kind;
+			if (!(fields >> kind))
+				continue; /* blank */
+
+			uint64_t ordinal = 0;
+			uint64_t count = 0;
+			if (!(fields >> ordinal >> count) || ordinal > UINT32_MAX)
+				return false;
+
+			/* the name is the rest of the line, trimmed */
+			std::string function;
+			std::getline(fields >> std::ws, function);
+			function.erase(function.find_last_not_of(" \t\r") + 1);
+			if (function.empty())
+				return false;
+
+			if (kind == "call")
+				add_call(function, static_cast<uint32_t>(ordinal), count);
+			else if (kind == "region")
+				add_region(function, static_cast<uint32_t>(ordinal), count);
+			else
+				return false;
+		}
+
+		return true;
+	}
+
+	void ProfileData::write(std::ostream &out) const
+	{
+		/* the maps are ordered, so the same profile always writes the same file */
+		for (const auto &[key, count]: call_counts)
+			out << record("call", key, count) << "\n";
+		for (const auto &[key, count]: region_counts)
+			out << record("region", key, count) << "\n";
+	}
+
+	bool ProfileData::load(const std::string &path)
+	{
+		std::ifstream in(path);
+		return in && read(in);
+	}
+
+	bool ProfileData::save(const std::string &path) const
+	{
+		std::ofstream out(path);
+		if (!out)
+			return false;
+
+		write(out);
+		return static_cast<bool>(out);
+	}
+}
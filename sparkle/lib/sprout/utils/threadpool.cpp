@@ -0,0 +1,122 @@
+#include <algorithm>
+#include <sparkle/sprout/utils/threadpool.hpp>
+
+namespace sprk
+{
+	WorkStealingPool::WorkStealingPool(unsigned workers)
+	{
+		if (workers == 0)
+			workers = std::max(1u, std::thread::hardware_concurrency());
+
+		for (unsigned w = 0; w < workers; w++)
+			queues.push_back(std::make_unique<TaskQueue>());
+
+		for (unsigned w = 1; w < workers; w++)
+			threads.emplace_back([this, w] { worker_loop(w); });
+	}
+
+	WorkStealingPool::~WorkStealingPool()
+	{
+		{
+			std::lock_guard guard(lock);
+			stopping = true;
+		}
+		wake.notify_all();
+
+		for (std::thread &thread: threads)
+			thread.join();
+	}
+
+	void WorkStealingPool::run(const size_t count, const std::function<void(size_t, unsigned)> &fn)
+	{
+		const size_t workers = queues.size();
+		for (size_t w = 0; w < workers; w++)
+		{
+			std::lock_guard guard(queues[w]->lock);
+			for (size_t task = count * w / workers; task < count * (w + 1) / workers; task++)
+				queues[w]->tasks.push_back(task);
+		}
+
+		if (threads.empty())
+		{
+			job = &fn;
+			drain(0);
+			job = nullptr;
+			return;
+		}
+
+		{
+			std::lock_guard guard(lock);
+			job = &fn;
+			busy = static_cast<unsigned>(threads.size());
+			generation++;
+		}
+		wake.notify_all();
+
+		drain(0);
+
+		/* the queues are empty, but stolen tasks may still be running */
+		std::unique_lock guard(lock);
+		done.wait(guard, [this] { return busy == 0; });
+		job = nullptr;
+	}
+
+	void WorkStealingPool::worker_loop(const unsigned worker)
+	{
+		uint64_t seen = 0;
+		while (true)
+		{
+			{
+				std::unique_lock guard(lock);
+				wake.wait(guard, [&] { return stopping || generation != seen; });
+				if (stopping)
+					return;
+				seen = generation;
+			}
+
+			drain(worker);
+
+			std::lock_guard guard(lock);
+			if (--busy == 0)
+				done.notify_one();
+		}
+	}
+
+	void WorkStealingPool::drain(const unsigned worker)
+	{
+		size_t task;
+		while (next_task(worker, task))
+			(*job)(task, worker);
+	}
+
+	bool WorkStealingPool::next_task(const unsigned worker, size_t &task)
+	{
+		/* own queue first, newest task; it is the one most likely still in cache */
+		{
+			TaskQueue &own = *queues[worker];
+			std::lock_guard guard(own.lock);
+			if (!own.tasks.empty())
+			{
+				task = own.tasks.back();
+				own.tasks.pop_back();
+				return true;
+			}
+		}
+
+		/* then steal the oldest task of the next worker that has one */
+		const size_t workers = queues.size();
+		for (size_t i = 1; i < workers; i++)
+		{
+			TaskQueue &victim = *queues[(worker + i) % workers];
+			std::lock_guard guard(victim.lock);
+			if (!victim.tasks.empty())
+			{
+				task = victim.tasks.front();
+				victim.tasks.pop_front();
+				return true;
+			}
+		}
+
+		return false;
+	}
+}
@@ -477,4 +477,60 @@ namespace sprk::aarch64
                (rn << 5) |             /* source register */
                rd;                     /* destination register */
     }
+
+    /* LD1/ST1 (multiple structures), one register, no offset */
+    static uint32_t encode_ld1_st1(int rt, int rn, uint32_t arrangement, bool load)
+    {
+        uint32_t Q = 0;     /* Q=0 for 8B/4H/2S, Q=1 for 16B/8H/4S/2D */
+        uint32_t size;      /* 00=8-bit, 01=16-bit, 10=32-bit, 11=64-bit */
+
+        switch (arrangement)
+        {
+            case SIMD_8B:
+                size = 0;
+                break;
+            case SIMD_16B:
+                Q = 1;
+                size = 0;
+                break;
+            case SIMD_4H:
+                size = 1;
+                break;
+            case SIMD_8H:
+                Q = 1;
+                size = 1;
+                break;
+            case SIMD_2S:
+                size = 2;
+                break;
+            case SIMD_4S:
+                Q = 1;
+                size = 2;
+                break;
+            case SIMD_2D:
+                Q = 1;
+                size = 3;
+                break;
+            default:
+                return 0; /* error: invalid arrangement */
+        }
+
+        return (Q << 30) |             /* Q bit for vector length */
+               (0b0011000 << 23) |     /* opcode fixed pattern */
+               ((load ? 1 : 0) << 22) | /* L bit: 1 for load */
+               (0b0111 << 12) |        /* opcode: one register */
+               (size << 10) |          /* element size */
+               (rn << 5) |             /* base register */
+               rt;                     /* vector register */
+    }
+
+    uint32_t encode_ld1(int rt, int rn, uint32_t arrangement)
+    {
+        return encode_ld1_st1(rt, rn, arrangement, true);
+    }
+
+    uint32_t encode_st1(int rt, int rn, uint32_t arrangement)
+    {
+        return encode_ld1_st1(rt, rn, arrangement, false);
+    }
 }
\ No newline at end of file
@@ -0,0 +1,432 @@
+#include <algorithm>
+#include <optional>
+#include <unordered_set>
+#include <sparkle/target/aarch64/common.hpp>
+#include <sparkle/target/aarch64/lowering.hpp>
+#include <sparkle/target/aarch64/encoding/arith.hpp>
+#include <sparkle/target/aarch64/encoding/branch.hpp>
+#include <sparkle/target/aarch64/encoding/cmp.hpp>
+#include <sparkle/target/aarch64/encoding/data.hpp>
+#include <sparkle/target/aarch64/encoding/memory.hpp>
+#include <sparkle/target/aarch64/encoding/mul.hpp>
+#include <sparkle/target/aarch64/encoding/simd.hpp>
+
+namespace sprk::aarch64
+{
+    namespace
+    {
+        constexpr int ARGUMENT_REGISTERS = 8;
+
+        std::optional<int64_t> int_constant(const SproutGraph &graph, const NodeRef ref)
+        {
+            if (!graph.contains(ref) || graph.type(ref) != NodeType::CONST)
+                return std::nullopt;
+
+            if (const auto *value = std::get_if<int64_t>(&graph.value(ref)))
+                return *value;
+            return std::nullopt;
+        }
+
+        /* fits the unsigned 12-bit immediate of ADD, SUB and CMP */
+        bool is_imm12(const std::optional<int64_t> &value)
+        {
+            return value && *value >= 0 && *value <= 0xFFF;
+        }
+
+        /* log2 of a power-of-two constant */
+        std::optional<uint32_t> shift_of(const std::optional<int64_t> &value)
+        {
+            if (!value || *value <= 0 || *value > 1 << 12 || (*value & (*value - 1)) != 0)
+                return std::nullopt;
+            return static_cast<uint32_t>(__builtin_ctzll(static_cast<uint64_t>(*value)));
+        }
+
+        class Lowering
+        {
+        public:
+            Lowering(const SproutGraph &graph, LoweredCode &out) : graph(graph), out(out) {}
+
+            bool lower(const std::vector<LoweringPlan> &plans)
+            {
+                for (const LoweringPlan &plan: plans)
+                {
+                    for (const NodeRef node: graph.region(plan.region).get_nodes())
+                        lowered.insert(node);
+                }
+
+                for (const LoweringPlan &plan: plans)
+                {
+                    if (plan.compare != NULL_REF)
+                        lower_loop(plan);
+                    else
+                        lower_body(plan);
+                }
+
+                if (!ok)
+                    return false;
+
+                out.words = std::move(prologue);
+                out.words.insert(out.words.end(), code.begin(), code.end());
+                return true;
+            }
+
+        private:
+            const SproutGraph &graph;
+            LoweredCode &out;
+            std::vector<uint32_t> prologue; /* live-ins computed once, ahead of the loops */
+            std::vector<uint32_t> code;
+            std::unordered_set<NodeRef> lowered; /* nodes of the loops; anything else is a live-in */
+            std::unordered_map<NodeRef, int> scalars;
+            std::unordered_map<NodeRef, int> vectors;
+            std::unordered_map<NodeRef, std::pair<NodeRef, uint32_t> > shifted; /* MUL by 2^k folded into its PTR_ADDs */
+            RegisterPool scratch { { 9, 10, 11, 12, 13, 14, 15, 16, 17 } };
+            RegisterPool vector_pool { [] {
+                std::vector<int> all(32);
+                for (int v = 0; v < 32; v++)
+                    all[v] = v;
+                return all;
+            }() };
+            int arguments = 0;
+            bool ok = true;
+
+            void emit(std::vector<uint32_t> &to, const uint32_t word)
+            {
+                /* the encoders return 0 for operands they cannot encode */
+                if (word == 0)
+                    ok = false;
+                to.push_back(word);
+            }
+
+            /* live-ins are computed ahead of the loops, so they need a register no loop has used */
+            int take(RegisterPool &pool, const bool live_in = false)
+            {
+                const int reg = live_in ? pool.take_untouched() : pool.take();
+                if (reg < 0)
+                    ok = false;
+                return reg < 0 ? 0 : reg;
+            }
+
+            /* the register holding `ref`, computing a live-in in the prologue the first time */
+            int scalar(const NodeRef ref)
+            {
+                if (const auto it = scalars.find(ref); it != scalars.end())
+                    return it->second;
+
+                if (lowered.contains(ref))
+                {
+                    /* read before it is defined; a back edge the plan did not expect */
+                    ok = false;
+                    return 0;
+                }
+
+                const NodeType type = graph.type(ref);
+                int reg;
+                if (const std::optional<int64_t> value = int_constant(graph, ref))
+                {
+                    reg = take(scratch, true);
+                    emit(prologue, encode_mov_imm(reg, static_cast<uint64_t>(*value), true));
+                }
+                else if ((type == NodeType::ADD || type == NodeType::SUB || type == NodeType::MUL) &&
+                         graph.inputs(ref).size() == 2)
+                {
+                    reg = arithmetic(prologue, ref, false);
+                }
+                else if (arguments < ARGUMENT_REGISTERS)
+                {
+                    reg = arguments++;
+                    out.live_ins.emplace_back(ref, reg);
+                }
+                else
+                {
+                    ok = false;
+                    return 0;
+                }
+
+                scalars[ref] = reg;
+                return reg;
+            }
+
+            int vector(const NodeRef ref)
+            {
+                if (const auto it = vectors.find(ref); it != vectors.end())
+                    return it->second;
+
+                /* only splats are hoisted out of the vector loop */
+                if (lowered.contains(ref) || graph.type(ref) != NodeType::VECTOR_SPLAT)
+                {
+                    ok = false;
+                    return 0;
+                }
+
+                const int reg = take(vector_pool, true);
+                emit(prologue, encode_dup_gen(reg, scalar(graph.inputs(ref)[0]), SIMD_4S));
+                vectors[ref] = reg;
+                return reg;
+            }
+
+            /* ADD, SUB or MUL; 32-bit on elements, 64-bit on indices and addresses */
+            int arithmetic(std::vector<uint32_t> &to, const NodeRef node, const bool element)
+            {
+                const NodeRef lhs = graph.inputs(node)[0];
+                const NodeRef rhs = graph.inputs(node)[1];
+                const std::optional<int64_t> lhs_value = int_constant(graph, lhs);
+                const std::optional<int64_t> rhs_value = int_constant(graph, rhs);
+                const bool wide = !element;
+
+                if (graph.type(node) == NodeType::MUL)
+                {
+                    const int rn = scalar(lhs);
+                    const int rm = scalar(rhs);
+                    const int rd = take(scratch, &to == &prologue);
+                    emit(to, encode_mul(rd, rn, rm, wide));
+                    return rd;
+                }
+
+                const bool add = graph.type(node) == NodeType::ADD;
+                if (is_imm12(rhs_value) || (add && is_imm12(lhs_value)))
+                {
+                    const bool swap = !is_imm12(rhs_value);
+                    const int rn = scalar(swap ? rhs : lhs);
+                    const int imm = static_cast<int>(swap ? *lhs_value : *rhs_value);
+                    const int rd = take(scratch, &to == &prologue);
+                    emit(to, add ? encode_add_imm(rd, rn, imm, wide, false) : encode_sub_imm(rd, rn, imm, wide, false));
+                    return rd;
+                }
+
+                const int rn = scalar(lhs);
+                const int rm = scalar(rhs);
+                const int rd = take(scratch, &to == &prologue);
+                emit(to, add
+                             ? encode_add_reg(rd, rn, rm, SHIFT_LSL, 0, wide, false)
+                             : encode_sub_reg(rd, rn, rm, SHIFT_LSL, 0, wide, false));
+                return rd;
+            }
+
+            void free_register(const NodeRef node)
+            {
+                if (const auto it = scalars.find(node); it != scalars.end())
+                {
+                    scratch.give(it->second);
+                    scalars.erase(it);
+                }
+                else if (const auto vit = vectors.find(node); vit != vectors.end())
+                {
+                    vector_pool.give(vit->second);
+                    vectors.erase(vit);
+                }
+            }
+
+            /* releases whatever `node` read for the last time, and `node` itself if nothing reads it */
+            void release(const LoweringPlan &loop, const NodeRef node, const size_t index)
+            {
+                if (!loop.last_use.contains(node) && graph.type(node) != NodeType::PHI)
+                    free_register(node);
+
+                for (const NodeRef input: graph.inputs(node))
+                {
+                    /* phis carry their register around the loop */
+                    const auto last = loop.last_use.find(input);
+                    if (last == loop.last_use.end() || last->second != index || graph.region_of(input) != loop.region ||
+                        graph.type(input) == NodeType::PHI)
+                    {
+                        continue;
+                    }
+
+                    free_register(input);
+                }
+            }
+
+            void lower_node(const NodeRef node)
+            {
+                const NodeSpan inputs = graph.inputs(node);
+                switch (graph.type(node))
+                {
+                    case NodeType::MUL:
+                    {
+                        /* i * 2^k only feeding addresses becomes the shift of an ADD */
+                        const bool scale_first = int_constant(graph, inputs[0]).has_value();
+                        const std::optional<uint32_t> shift = shift_of(int_constant(graph, inputs[scale_first ? 0 : 1]));
+                        const NodeRef source = inputs[scale_first ? 1 : 0];
+                        const auto users = graph.users(node);
+                        const bool addresses = std::all_of(users.begin(), users.end(), [&](const NodeRef user)
+                        {
+                            return graph.type(user) == NodeType::PTR_ADD && graph.inputs(user)[1] == node;
+                        });
+                        const bool available = graph.type(source) == NodeType::PHI
+                                                   ? scalars.contains(source)
+                                                   : !lowered.contains(source);
+                        if (shift && addresses && available && !is_element(graph, node))
+                        {
+                            shifted[node] = { source, *shift };
+                            return;
+                        }
+                        [[fallthrough]];
+                    }
+                    case NodeType::ADD:
+                    case NodeType::SUB:
+                        scalars[node] = arithmetic(code, node, is_element(graph, node));
+                        return;
+
+                    case NodeType::PTR_ADD:
+                    {
+                        const int base = scalar(inputs[0]);
+                        const int rd = take(scratch);
+                        if (const std::optional<int64_t> offset = int_constant(graph, inputs[1]); is_imm12(offset))
+                            emit(code, encode_add_imm(rd, base, static_cast<int>(*offset), true, false));
+                        else if (const auto it = shifted.find(inputs[1]); it != shifted.end())
+                            emit(code, encode_add_reg(rd, base, scalar(it->second.first), SHIFT_LSL, it->second.second, true, false));
+                        else
+                            emit(code, encode_add_reg(rd, base, scalar(inputs[1]), SHIFT_LSL, 0, true, false));
+                        scalars[node] = rd;
+                        return;
+                    }
+
+                    case NodeType::PTR_LOAD:
+                    {
+                        const int address = scalar(inputs[0]);
+                        const int rt = take(scratch);
+                        emit(code, encode_ldr_imm(rt, address, 0, SIZE_WORD));
+                        scalars[node] = rt;
+                        return;
+                    }
+
+                    case NodeType::PTR_STORE:
+                    {
+                        const int address = scalar(inputs[0]);
+                        const int rt = scalar(inputs[1]);
+                        emit(code, encode_str_imm(rt, address, 0, SIZE_WORD));
+                        return;
+                    }
+
+                    case NodeType::VECTOR_LOAD:
+                    {
+                        const int address = scalar(inputs[0]);
+                        const int rt = take(vector_pool);
+                        emit(code, encode_ld1(rt, address, SIMD_4S));
+                        vectors[node] = rt;
+                        return;
+                    }
+
+                    case NodeType::VECTOR_STORE:
+                    {
+                        const int address = scalar(inputs[0]);
+                        const int rt = vector(inputs[1]);
+                        emit(code, encode_st1(rt, address, SIMD_4S));
+                        return;
+                    }
+
+                    case NodeType::VECTOR_ADD:
+                    case NodeType::VECTOR_MUL:
+                    {
+                        const int rn = vector(inputs[0]);
+                        const int rm = vector(inputs[1]);
+                        const int rd = take(vector_pool);
+                        emit(code, graph.type(node) == NodeType::VECTOR_ADD
+                                       ? encode_add_simd(rd, rn, rm, SIMD_4S)
+                                       : encode_mul_simd(rd, rn, rm, SIMD_4S));
+                        vectors[node] = rd;
+                        return;
+                    }
+
+                    case NodeType::VECTOR_SPLAT:
+                    {
+                        const int rn = scalar(inputs[0]);
+                        const int rd = take(vector_pool);
+                        emit(code, encode_dup_gen(rd, rn, SIMD_4S));
+                        vectors[node] = rd;
+                        return;
+                    }
+
+                    case NodeType::CONTROL:
+                        return;
+
+                    default:
+                        /* VECTOR_SETVL has no NEON form; the loop should have been vectorized for NEON */
+                        ok = false;
+                }
+            }
+
+            void lower_body(const LoweringPlan &plan)
+            {
+                for (size_t k = 0; k < plan.body.size(); k++)
+                {
+                    lower_node(plan.body[k]);
+                    release(plan, plan.body[k], k);
+                }
+            }
+
+            /*
+             *      mov   phi, init
+             *  top:
+             *      cmp   i, limit
+             *      b.ge  exit
+             *      body
+             *      mov   phi, next
+             *      b     top
+             *  exit:
+             */
+            void lower_loop(const LoweringPlan &loop)
+            {
+                for (const NodeRef phi: loop.phis)
+                {
+                    const NodeRef init = graph.inputs(phi)[0];
+                    const int reg = take(scratch);
+                    if (const std::optional<int64_t> value = int_constant(graph, init))
+                        emit(code, encode_mov_imm(reg, static_cast<uint64_t>(*value), true));
+                    else
+                        emit(code, encode_mov_reg(reg, scalar(init), true));
+                    scalars[phi] = reg;
+                }
+
+                const size_t top = code.size();
+                const NodeRef index = graph.inputs(loop.compare)[0];
+                const NodeRef limit = graph.inputs(loop.compare)[1];
+                const int rn = scalar(index);
+                if (const std::optional<int64_t> value = int_constant(graph, limit); is_imm12(value))
+                {
+                    emit(code, encode_cmp_imm(rn, static_cast<int>(*value), true));
+                }
+                else
+                {
+                    const int rm = scalar(limit);
+                    emit(code, encode_cmp_reg(rn, rm, SHIFT_LSL, 0, true));
+                }
+
+                const size_t exit_branch = code.size();
+                code.push_back(0);
+                lower_body(loop);
+
+                for (const NodeRef phi: loop.phis)
+                    emit(code, encode_mov_reg(scalars.at(phi), scalar(graph.inputs(phi)[1]), true));
+
+                const auto offset = [&](const size_t from, const size_t to)
+                {
+                    return (static_cast<int64_t>(to) - static_cast<int64_t>(from)) * 4;
+                };
+                emit(code, encode_b(offset(code.size(), top)));
+                code[exit_branch] = encode_b_cond(COND_GE, offset(exit_branch, code.size()));
+            }
+        };
+    }
+
+    bool lower_loops(const SproutGraph &graph, const std::vector<RegionRef> &loops, LoweredCode &out)
+    {
+        out = LoweredCode {};
+        std::vector<LoweringPlan> plans(loops.size());
+        for (size_t k = 0; k < loops.size(); k++)
+        {
+            if (!plan_loop(graph, loops[k], plans[k]))
+                return false;
+        }
+        return Lowering(graph, out).lower(plans);
+    }
+
+    bool lower_block(const SproutGraph &graph, const RegionRef block, LoweredCode &out)
+    {
+        out = LoweredCode {};
+        std::vector<LoweringPlan> plans(1);
+        if (!plan_block(graph, block, plans[0]))
+            return false;
+        return Lowering(graph, out).lower(plans);
+    }
+}
@@ -0,0 +1,108 @@
+#include <algorithm>
+#include <sparkle/target/lowering.hpp>
+
+namespace sprk
+{
+    namespace
+    {
+        /* body index of each node's last read; body.size() for the back edge and readers outside */
+        void compute_last_use(const SproutGraph &graph, LoweringPlan &out)
+        {
+            for (size_t k = 0; k < out.body.size(); k++)
+            {
+                for (const NodeRef input: graph.inputs(out.body[k]))
+                    out.last_use[input] = k;
+            }
+
+            /* the compare runs at the top of every trip, the back edge at the bottom */
+            if (out.compare != NULL_REF)
+            {
+                for (const NodeRef input: graph.inputs(out.compare))
+                    out.last_use[input] = out.body.size();
+            }
+            for (const NodeRef phi: out.phis)
+                out.last_use[graph.inputs(phi)[1]] = out.body.size();
+
+            for (const NodeRef node: out.body)
+            {
+                const auto users = graph.users(node);
+                if (std::any_of(users.begin(), users.end(), [&](const NodeRef user) { return graph.region_of(user) != out.region; }))
+                    out.last_use[node] = out.body.size();
+            }
+        }
+    }
+
+    bool plan_loop(const SproutGraph &graph, const RegionRef loop, LoweringPlan &out)
+    {
+        const SproutRegion &region = graph.region(loop);
+        if (region.get_type() != RegionType::LOOP_BODY || !region.get_children().empty())
+            return false;
+
+        const NodeRef control = region.get_ctrl_dep();
+        if (!graph.contains(control) || graph.type(control) != NodeType::CONTROL || graph.inputs(control).size() != 1)
+            return false;
+
+        const NodeRef compare = graph.inputs(control)[0];
+        if (graph.type(compare) != NodeType::CMP || graph.inputs(compare).size() != 2)
+            return false;
+
+        out = LoweringPlan {};
+        out.region = loop;
+        out.compare = compare;
+        for (const NodeRef node: region.get_nodes())
+        {
+            if (!graph.contains(node) || node == control || node == compare)
+                continue;
+
+            if (graph.type(node) == NodeType::PHI)
+            {
+                if (graph.inputs(node).size() != 2)
+                    return false;
+                out.phis.push_back(node);
+            }
+            else
+            {
+                out.body.push_back(node);
+            }
+        }
+
+        compute_last_use(graph, out);
+        return true;
+    }
+
+    bool plan_block(const SproutGraph &graph, const RegionRef block, LoweringPlan &out)
+    {
+        const SproutRegion &region = graph.region(block);
+        if (region.get_type() != RegionType::BASIC_BLOCK || !region.get_children().empty())
+            return false;
+
+        out = LoweringPlan {};
+        out.region = block;
+        for (const NodeRef node: region.get_nodes())
+        {
+            if (graph.contains(node))
+                out.body.push_back(node);
+        }
+
+        compute_last_use(graph, out);
+        return true;
+    }
+
+    bool is_element(const SproutGraph &graph, const NodeRef ref)
+    {
+        switch (graph.type(ref))
+        {
+            case NodeType::PTR_LOAD:
+                return true;
+            case NodeType::ADD:
+            case NodeType::SUB:
+            case NodeType::MUL:
+            {
+                const auto inputs = graph.inputs(ref);
+                return std::any_of(inputs.begin(), inputs.end(), [&](const NodeRef input) { return is_element(graph, input); });
+            }
+            default:
+                return false;
+        }
+    }
+}
@@ -15,11 +15,11 @@ namespace sprk::riscv
     /* Vector Load Element, 32-bit */
     uint32_t encode_vle32_v(int vd, int rs1, bool mask_used)
     {
-        return (0b000 << 29) |      /* mop = unit-stride */
-               (mask_used ? (1 << 25) : 0) | /* mask policy */
-               (0b000 << 23) |      /* element width = 32-bit */
+        return (0b000 << 29) |      /* nf = one field */
+               (0b00 << 26) |       /* mop = unit-stride */
+               (mask_used ? 0 : (1 << 25)) | /* vm; set when unmasked */
                (rs1 << 15) |        /* base address register */
-               (0b101 << 12) |      /* funct3 = vector load */
+               (0b110 << 12) |      /* width = 32-bit */
                (vd << 7) |          /* destination vector register */
                0b0000111;           /* opcode (Vector Load) */
     }
@@ -27,11 +27,11 @@ namespace sprk::riscv
     /* Vector Store Element, 32-bit */
     uint32_t encode_vse32_v(int vs3, int rs1, bool mask_used)
     {
-        return (0b000 << 29) |      /* mop = unit-stride */
-               (mask_used ? (1 << 25) : 0) | /* mask policy */
-               (0b000 << 23) |      /* element width = 32-bit */
+        return (0b000 << 29) |      /* nf = one field */
+               (0b00 << 26) |       /* mop = unit-stride */
+               (mask_used ? 0 : (1 << 25)) | /* vm; set when unmasked */
                (rs1 << 15) |        /* base address register */
-               (0b101 << 12) |      /* funct3 = vector store */
+               (0b110 << 12) |      /* width = 32-bit */
                (vs3 << 7) |         /* source vector register */
                0b0100111;           /* opcode (Vector Store) */
     }
@@ -40,9 +40,10 @@ namespace sprk::riscv
     uint32_t encode_vadd_vv(int vd, int vs1, int vs2, bool mask_used)
     {
         return (0b000000 << 26) |   /* funct6 = add */
+               (mask_used ? 0 : (1 << 25)) | /* vm; set when unmasked */
                (vs2 << 20) |        /* vs2 */
                (vs1 << 15) |        /* vs1 */
-               (0b000 << 12) |      /* funct3 = vector-vector */
+               (0b000 << 12) |      /* funct3 = OPIVV */
                (vd << 7) |          /* destination vector register */
                0b1010111;           /* opcode (Vector) */
     }
@@ -51,9 +52,10 @@ namespace sprk::riscv
     uint32_t encode_vmul_vv(int vd, int vs1, int vs2, bool mask_used)
     {
         return (0b100101 << 26) |   /* funct6 = multiply */
+               (mask_used ? 0 : (1 << 25)) | /* vm; set when unmasked */
                (vs2 << 20) |        /* vs2 */
                (vs1 << 15) |        /* vs1 */
-               (0b000 << 12) |      /* funct3 = vector-vector */
+               (0b010 << 12) |      /* funct3 = OPMVV */
                (vd << 7) |          /* destination vector register */
                0b1010111;           /* opcode (Vector) */
     }
@@ -62,10 +64,23 @@ namespace sprk::riscv
     uint32_t encode_vfadd_vv(int vd, int vs1, int vs2, bool mask_used)
     {
         return (0b000000 << 26) |   /* funct6 = float add */
+               (mask_used ? 0 : (1 << 25)) | /* vm; set when unmasked */
                (vs2 << 20) |        /* vs2 */
                (vs1 << 15) |        /* vs1 */
                (0b001 << 12) |      /* funct3 = vector-vector floating-point */
                (vd << 7) |          /* destination vector register */
                0b1010111;           /* opcode (Vector) */
     }
+
+    /* Vector Integer Move, scalar to every element */
+    uint32_t encode_vmv_v_x(int vd, int rs1)
+    {
+        return (0b010111 << 26) |   /* funct6 = merge/move */
+               (1 << 25) |          /* vm = 1; vmv is the unmasked form of vmerge */
+               (0 << 20) |          /* vs2 = v0 */
+               (rs1 << 15) |        /* scalar source */
+               (0b100 << 12) |      /* funct3 = OPIVX */
+               (vd << 7) |          /* destination vector register */
+               0b1010111;           /* opcode (Vector) */
+    }
 }
\ No newline at end of file
@@ -0,0 +1,424 @@
+#include <algorithm>
+#include <optional>
+#include <unordered_set>
+#include <sparkle/target/risc-v/lowering.hpp>
+#include <sparkle/target/risc-v/encoding/arith.hpp>
+#include <sparkle/target/risc-v/encoding/branch.hpp>
+#include <sparkle/target/risc-v/encoding/data.hpp>
+#include <sparkle/target/risc-v/encoding/memory.hpp>
+#include <sparkle/target/risc-v/encoding/mul.hpp>
+#include <sparkle/target/risc-v/encoding/shift.hpp>
+#include <sparkle/target/risc-v/encoding/simd.hpp>
+
+namespace sprk::riscv
+{
+    namespace
+    {
+        constexpr int ZERO = 0;
+        constexpr int FIRST_ARGUMENT = 10; /* a0 */
+        constexpr int ARGUMENT_REGISTERS = 8;
+
+        /* vsetvli vtype: e32, m1, tail and mask agnostic */
+        constexpr int VTYPE_E32_M1 = 0b11010000;
+
+        std::optional<int64_t> int_constant(const SproutGraph &graph, const NodeRef ref)
+        {
+            if (!graph.contains(ref) || graph.type(ref) != NodeType::CONST)
+                return std::nullopt;
+
+            if (const auto *value = std::get_if<int64_t>(&graph.value(ref)))
+                return *value;
+            return std::nullopt;
+        }
+
+        /* fits the signed 12-bit immediate of ADDI */
+        bool is_imm12(const std::optional<int64_t> &value)
+        {
+            return value && *value >= -2048 && *value <= 2047;
+        }
+
+        /* log2 of a power-of-two constant */
+        std::optional<int> shift_of(const std::optional<int64_t> &value)
+        {
+            if (!value || *value <= 0 || (*value & (*value - 1)) != 0)
+                return std::nullopt;
+            return __builtin_ctzll(static_cast<uint64_t>(*value));
+        }
+
+        class Lowering
+        {
+        public:
+            Lowering(const SproutGraph &graph, LoweredCode &out) : graph(graph), out(out) {}
+
+            bool lower(const std::vector<RegionRef> &loops)
+            {
+                std::vector<LoweringPlan> plans(loops.size());
+                for (size_t k = 0; k < loops.size(); k++)
+                {
+                    if (!plan_loop(graph, loops[k], plans[k]))
+                        return false;
+                    for (const NodeRef node: graph.region(loops[k]).get_nodes())
+                        lowered.insert(node);
+                }
+
+                for (const LoweringPlan &loop: plans)
+                    lower_loop(loop);
+
+                if (!ok)
+                    return false;
+
+                out.words = std::move(prologue);
+                out.words.insert(out.words.end(), code.begin(), code.end());
+                return true;
+            }
+
+        private:
+            const SproutGraph &graph;
+            LoweredCode &out;
+            std::vector<uint32_t> prologue; /* live-ins computed once, ahead of the loops */
+            std::vector<uint32_t> code;
+            std::unordered_set<NodeRef> lowered; /* nodes of the loops; anything else is a live-in */
+            std::unordered_map<NodeRef, int> scalars;
+            std::unordered_map<NodeRef, int> vectors;
+            RegisterPool scratch { { 5, 6, 7, 28, 29, 30, 31 } }; /* t0-t6 */
+            RegisterPool vector_pool { [] {
+                /* v0 is the mask register */
+                std::vector<int> all(31);
+                for (int v = 0; v < 31; v++)
+                    all[v] = v + 1;
+                return all;
+            }() };
+            int arguments = 0;
+            bool ok = true;
+
+            /* live-ins are computed ahead of the loops, so they need a register no loop has used */
+            int take(RegisterPool &pool, const bool live_in = false)
+            {
+                const int reg = live_in ? pool.take_untouched() : pool.take();
+                if (reg < 0)
+                    ok = false;
+                return reg < 0 ? 0 : reg;
+            }
+
+            /* li; constants past 32 bits are not lowered */
+            void load_immediate(std::vector<uint32_t> &to, const int rd, const int64_t value)
+            {
+                if (is_imm12(value))
+                {
+                    to.push_back(encode_addi(rd, ZERO, static_cast<int>(value)));
+                    return;
+                }
+
+                if (value < INT32_MIN || value > INT32_MAX)
+                {
+                    ok = false;
+                    return;
+                }
+
+                /* addiw sign-extends its low 12 bits, so round the upper part up when they are negative */
+                const auto low = static_cast<int32_t>(static_cast<uint32_t>(value) << 20) >> 20;
+                const auto high = static_cast<int32_t>(static_cast<uint32_t>(value) - static_cast<uint32_t>(low));
+                to.push_back(encode_lui(rd, high));
+                if (low)
+                    to.push_back(encode_addiw(rd, rd, low));
+            }
+
+            /* the register holding `ref`, computing a live-in in the prologue the first time */
+            int scalar(const NodeRef ref)
+            {
+                if (const auto it = scalars.find(ref); it != scalars.end())
+                    return it->second;
+
+                if (lowered.contains(ref))
+                {
+                    /* read before it is defined; a back edge the plan did not expect */
+                    ok = false;
+                    return ZERO;
+                }
+
+                const NodeType type = graph.type(ref);
+                int reg;
+                if (const std::optional<int64_t> value = int_constant(graph, ref))
+                {
+                    if (*value == 0)
+                        return ZERO;
+                    reg = take(scratch, true);
+                    load_immediate(prologue, reg, *value);
+                }
+                else if ((type == NodeType::ADD || type == NodeType::SUB || type == NodeType::MUL) &&
+                         graph.inputs(ref).size() == 2)
+                {
+                    reg = arithmetic(prologue, ref, false);
+                }
+                else if (arguments < ARGUMENT_REGISTERS)
+                {
+                    reg = FIRST_ARGUMENT + arguments++;
+                    out.live_ins.emplace_back(ref, reg);
+                }
+                else
+                {
+                    ok = false;
+                    return ZERO;
+                }
+
+                scalars[ref] = reg;
+                return reg;
+            }
+
+            int vector(const NodeRef ref)
+            {
+                /* splats need vl, so the vectorizer leaves them in the strip-mined loop */
+                if (const auto it = vectors.find(ref); it != vectors.end())
+                    return it->second;
+
+                ok = false;
+                return 0;
+            }
+
+            /* ADD, SUB or MUL; the W forms on elements, 64-bit on indices and addresses */
+            int arithmetic(std::vector<uint32_t> &to, const NodeRef node, const bool element)
+            {
+                const NodeRef lhs = graph.inputs(node)[0];
+                const NodeRef rhs = graph.inputs(node)[1];
+                const std::optional<int64_t> lhs_value = int_constant(graph, lhs);
+                const std::optional<int64_t> rhs_value = int_constant(graph, rhs);
+                const NodeType type = graph.type(node);
+
+                if (type == NodeType::MUL && !element)
+                {
+                    /* scaling an index by the element size */
+                    const std::optional<int> shift = shift_of(rhs_value) ? shift_of(rhs_value) : shift_of(lhs_value);
+                    if (shift)
+                    {
+                        const int rs1 = scalar(shift_of(rhs_value) ? lhs : rhs);
+                        const int rd = take(scratch, &to == &prologue);
+                        to.push_back(encode_slli(rd, rs1, *shift));
+                        return rd;
+                    }
+                }
+
+                if (type != NodeType::MUL)
+                {
+                    /* x + c, c + x and x - c */
+                    const bool add = type == NodeType::ADD;
+                    std::optional<int64_t> imm;
+                    NodeRef source = lhs;
+                    if (add && is_imm12(lhs_value) && !is_imm12(rhs_value))
+                    {
+                        imm = lhs_value;
+                        source = rhs;
+                    }
+                    else if (rhs_value && is_imm12(add ? *rhs_value : -*rhs_value))
+                    {
+                        imm = add ? *rhs_value : -*rhs_value;
+                    }
+
+                    if (imm)
+                    {
+                        const int rs1 = scalar(source);
+                        const int rd = take(scratch, &to == &prologue);
+                        const int value = static_cast<int>(*imm);
+                        to.push_back(element ? encode_addiw(rd, rs1, value) : encode_addi(rd, rs1, value));
+                        return rd;
+                    }
+                }
+
+                const int rs1 = scalar(lhs);
+                const int rs2 = scalar(rhs);
+                const int rd = take(scratch, &to == &prologue);
+                switch (type)
+                {
+                    case NodeType::ADD:
+                        to.push_back(element ? encode_addw(rd, rs1, rs2) : encode_add(rd, rs1, rs2));
+                        break;
+                    case NodeType::SUB:
+                        to.push_back(element ? encode_subw(rd, rs1, rs2) : encode_sub(rd, rs1, rs2));
+                        break;
+                    default:
+                        to.push_back(element ? encode_mulw(rd, rs1, rs2) : encode_mul(rd, rs1, rs2));
+                        break;
+                }
+                return rd;
+            }
+
+            void free_register(const NodeRef node)
+            {
+                if (const auto it = scalars.find(node); it != scalars.end())
+                {
+                    if (it->second != ZERO)
+                        scratch.give(it->second);
+                    scalars.erase(it);
+                }
+                else if (const auto vit = vectors.find(node); vit != vectors.end())
+                {
+                    vector_pool.give(vit->second);
+                    vectors.erase(vit);
+                }
+            }
+
+            /* releases whatever `node` read for the last time, and `node` itself if nothing reads it */
+            void release(const LoweringPlan &loop, const NodeRef node, const size_t index)
+            {
+                if (!loop.last_use.contains(node) && graph.type(node) != NodeType::PHI)
+                    free_register(node);
+
+                for (const NodeRef input: graph.inputs(node))
+                {
+                    /* phis carry their register around the loop */
+                    const auto last = loop.last_use.find(input);
+                    if (last == loop.last_use.end() || last->second != index || graph.region_of(input) != loop.region ||
+                        graph.type(input) == NodeType::PHI)
+                    {
+                        continue;
+                    }
+
+                    free_register(input);
+                }
+            }
+
+            void lower_node(const NodeRef node)
+            {
+                const NodeSpan inputs = graph.inputs(node);
+                switch (graph.type(node))
+                {
+                    case NodeType::ADD:
+                    case NodeType::SUB:
+                    case NodeType::MUL:
+                        scalars[node] = arithmetic(code, node, is_element(graph, node));
+                        return;
+
+                    case NodeType::PTR_ADD:
+                    {
+                        const int base = scalar(inputs[0]);
+                        const int offset = scalar(inputs[1]);
+                        const int rd = take(scratch);
+                        code.push_back(encode_add(rd, base, offset));
+                        scalars[node] = rd;
+                        return;
+                    }
+
+                    case NodeType::PTR_LOAD:
+                    {
+                        const int address = scalar(inputs[0]);
+                        const int rd = take(scratch);
+                        code.push_back(encode_lw(rd, address, 0));
+                        scalars[node] = rd;
+                        return;
+                    }
+
+                    case NodeType::PTR_STORE:
+                    {
+                        const int address = scalar(inputs[0]);
+                        const int rs2 = scalar(inputs[1]);
+                        code.push_back(encode_sw(rs2, address, 0));
+                        return;
+                    }
+
+                    case NodeType::VECTOR_SETVL:
+                    {
+                        const int remaining = scalar(inputs[0]);
+                        const int rd = take(scratch);
+                        code.push_back(encode_vsetvli(rd, remaining, VTYPE_E32_M1));
+                        scalars[node] = rd;
+                        return;
+                    }
+
+                    case NodeType::VECTOR_LOAD:
+                    {
+                        const int address = scalar(inputs[0]);
+                        const int vd = take(vector_pool);
+                        code.push_back(encode_vle32_v(vd, address, false));
+                        vectors[node] = vd;
+                        return;
+                    }
+
+                    case NodeType::VECTOR_STORE:
+                    {
+                        const int address = scalar(inputs[0]);
+                        const int vs3 = vector(inputs[1]);
+                        code.push_back(encode_vse32_v(vs3, address, false));
+                        return;
+                    }
+
+                    case NodeType::VECTOR_ADD:
+                    case NodeType::VECTOR_MUL:
+                    {
+                        const int vs2 = vector(inputs[0]);
+                        const int vs1 = vector(inputs[1]);
+                        const int vd = take(vector_pool);
+                        code.push_back(graph.type(node) == NodeType::VECTOR_ADD
+                                           ? encode_vadd_vv(vd, vs1, vs2, false)
+                                           : encode_vmul_vv(vd, vs1, vs2, false));
+                        vectors[node] = vd;
+                        return;
+                    }
+
+                    case NodeType::VECTOR_SPLAT:
+                    {
+                        const int rs1 = scalar(inputs[0]);
+                        const int vd = take(vector_pool);
+                        code.push_back(encode_vmv_v_x(vd, rs1));
+                        vectors[node] = vd;
+                        return;
+                    }
+
+                    case NodeType::CONTROL:
+                        return;
+
+                    default:
+                        ok = false;
+                }
+            }
+
+            /*
+             *      mv    phi, init
+             *  top:
+             *      bge   i, limit, exit
+             *      body
+             *      mv    phi, next
+             *      j     top
+             *  exit:
+             */
+            void lower_loop(const LoweringPlan &loop)
+            {
+                for (const NodeRef phi: loop.phis)
+                {
+                    const int reg = take(scratch);
+                    if (const std::optional<int64_t> value = int_constant(graph, graph.inputs(phi)[0]))
+                        load_immediate(code, reg, *value);
+                    else
+                        code.push_back(encode_mv(reg, scalar(graph.inputs(phi)[0])));
+                    scalars[phi] = reg;
+                }
+
+                const size_t top = code.size();
+                const int index = scalar(graph.inputs(loop.compare)[0]);
+                const int limit = scalar(graph.inputs(loop.compare)[1]);
+                const size_t exit_branch = code.size();
+                code.push_back(0);
+
+                for (size_t k = 0; k < loop.body.size(); k++)
+                {
+                    lower_node(loop.body[k]);
+                    release(loop, loop.body[k], k);
+                }
+
+                for (const NodeRef phi: loop.phis)
+                    code.push_back(encode_mv(scalars.at(phi), scalar(graph.inputs(phi)[1])));
+
+                const auto offset = [&](const size_t from, const size_t to)
+                {
+                    return static_cast<int>((static_cast<int64_t>(to) - static_cast<int64_t>(from)) * 4);
+                };
+                code.push_back(encode_jal(ZERO, offset(code.size(), top)));
+                code[exit_branch] = encode_bge(index, limit, offset(exit_branch, code.size()));
+            }
+        };
+    }
+
+    bool lower_loops(const SproutGraph &graph, const std::vector<RegionRef> &loops, LoweredCode &out)
+    {
+        out = LoweredCode {};
+        return Lowering(graph, out).lower(loops);
+    }
+}
@@ -0,0 +1,157 @@
+#include <chrono>
+#include <iostream>
+#include <queue>
+#include <random>
+#include <set>
+#include <vector>
+#include <sparkle/sprout/passes/dce.hpp>
+
+using namespace sprk;
+
+constexpr NodeRef NODE_COUNT = 1'000'000;
+constexpr int ROUNDS = 5;
+
+/*
+ * every node reads its predecessor and one random earlier node; the RET
+ * reads the node three quarters in, so the tail of the graph is dead
+ */
+void build_graph(SproutGraph &graph)
+{
+	std::mt19937 rng(42);
+	graph.reserve(NODE_COUNT + 1);
+
+	const RegionRef root = graph.create_region("root", RegionType::ROOT);
+	const RegionRef fn = graph.create_region("fn", RegionType::FUNCTION);
+	graph.add_child(root, fn);
+
+	for (NodeRef i = 0; i < NODE_COUNT; i++)
+	{
+		const NodeRef id = graph.create((i % 8 == 0) ? NodeType::CONST : NodeType::ADD);
+		if (i > 0)
+		{
+			std::uniform_int_distribution<NodeRef> dist(0, i - 1);
+			graph.add_input(id, i - 1);
+			graph.add_input(id, dist(rng));
+		}
+		graph.add_node(fn, id);
+	}
+
+	const NodeRef ret = graph.create(NodeType::RET);
+	graph.add_input(ret, NODE_COUNT * 3 / 4);
+	graph.add_node(fn, ret);
+}
+
+/* the std::set mark DCEPass used before, kept as the comparison baseline */
+struct LegacyDCE
+{
+	std::set<NodeRef> alive_nodes;
+	std::set<NodeRef> dead_nodes;
+
+	void run(const SproutGraph &graph)
+	{
+		alive_nodes.clear();
+		dead_nodes.clear();
+
+		std::queue<NodeRef> worklist;
+		for (NodeRef i = 0; i < graph.size(); i++)
+		{
+			if (graph.contains(i) && (graph.type(i) == NodeType::RET || graph.type(i) == NodeType::EXIT))
+			{
+				worklist.push(i);
+				alive_nodes.insert(i);
+			}
+		}
+
+		while (!worklist.empty())
+		{
+			const NodeRef curr = worklist.front();
+			worklist.pop();
+
+			for (const NodeRef input: graph.inputs(curr))
+			{
+				if (graph.contains(input) && alive_nodes.find(input) == alive_nodes.end())
+				{
+					alive_nodes.insert(input);
+					worklist.push(input);
+				}
+			}
+		}
+
+		for (NodeRef i = 0; i < graph.size(); ++i)
+		{
+			if (graph.contains(i) && alive_nodes.find(i) == alive_nodes.end())
+				dead_nodes.insert(i);
+		}
+	}
+
+	/* returned by value, as before */
+	[[nodiscard]] std::set<NodeRef> get_dead_nodes() const
+	{
+		return dead_nodes;
+	}
+};
+
+template<typename Fn>
+double best_ms(Fn &&fn)
+{
+	double best = 1e30;
+	for (int r = 0; r < ROUNDS; r++)
+	{
+		const auto start = std::chrono::steady_clock::now();
+		fn();
+		const auto end = std::chrono::steady_clock::now();
+		best = std::min(best, std::chrono::duration<double, std::milli>(end - start).count());
+	}
+
+	return best;
+}
+
+void report(const char *name, const double legacy_ms, const double bitset_ms)
+{
+	std::cout << "  " << name << ": std::set " << legacy_ms << " ms, bitset "
+			<< bitset_ms << " ms (" << legacy_ms / bitset_ms << "x)\n";
+}
+
+int main()
+{
+	SproutGraph graph;
+	build_graph(graph);
+	const RegionRef root = 0;
+
+	std::cout << "dce over " << graph.size() << " nodes (best of " << ROUNDS << "):\n";
+
+	size_t sink = 0;
+	LegacyDCE legacy;
+	DCEPass dce;
+
+	const double legacy_mark = best_ms([&] { legacy.run(graph); });
+	const double bitset_mark = best_ms([&] { dce.run(root, graph); });
+	report("mark", legacy_mark, bitset_mark);
+
+	if (legacy.dead_nodes.size() != dce.get_dead_nodes().size() ||
+	    !std::equal(legacy.dead_nodes.begin(), legacy.dead_nodes.end(), dce.get_dead_nodes().begin()))
+	{
+		std::cout << "  dead sets differ!\n";
+		return 1;
+	}
+
+	/* what a caller pays to look at the result */
+	const double legacy_query = best_ms([&] { sink += legacy.get_dead_nodes().size(); });
+	const double bitset_query = best_ms([&] { sink += dce.get_dead_nodes().size(); });
+	report("get_dead_nodes", legacy_query, bitset_query);
+
+	const double legacy_lookup = best_ms([&]
+	{
+		for (NodeRef i = 0; i < graph.size(); i++)
+			sink += legacy.dead_nodes.count(i);
+	});
+	const double bitset_lookup = best_ms([&]
+	{
+		for (NodeRef i = 0; i < graph.size(); i++)
+			sink += dce.is_dead(i);
+	});
+	report("membership per node", legacy_lookup, bitset_lookup);
+
+	std::cout << "  dead: " << dce.get_dead_nodes().size() << " (checksum " << sink << ")\n";
+	return 0;
+}
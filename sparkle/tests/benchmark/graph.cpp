@@ -0,0 +1,184 @@
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <vector>
+#include <sparkle/sprout/graph.hpp>
+
+using namespace sprk;
+
+constexpr NodeRef NODE_COUNT = 1'000'000;
+constexpr int ROUNDS = 5;
+
+/* the original per-node heap object, kept here as the comparison baseline */
+struct LegacyNode
+{
+	NodeRef id = 0;
+	NodeType type = NodeType::ENTRY;
+	NodeRef inputs[4] = {};
+	NodeRef users[4] = {};
+	uint8_t input_count = 0;
+	uint8_t user_count = 0;
+	uint32_t flags = 0;
+	NodeRef fn_ref = NULL_REF;
+	NodeRef mem_obj = NULL_REF;
+	NodeValue value;
+	uint64_t string_id = 0;
+	uint32_t result = 0;
+};
+
+using LegacyNodes = std::vector<std::unique_ptr<LegacyNode> >;
+
+/* every node reads its predecessor and one random earlier node */
+std::vector<std::pair<NodeRef, NodeRef> > make_edges()
+{
+	std::mt19937 rng(42);
+	std::vector<std::pair<NodeRef, NodeRef> > edges(NODE_COUNT, { NULL_REF, NULL_REF });
+	for (NodeRef i = 1; i < NODE_COUNT; i++)
+	{
+		std::uniform_int_distribution<NodeRef> dist(0, i - 1);
+		edges[i] = { i - 1, dist(rng) };
+	}
+
+	return edges;
+}
+
+void link(LegacyNode &node, const NodeRef id, const NodeRef input, LegacyNode &input_node)
+{
+	node.inputs[node.input_count++] = input;
+	if (input_node.user_count < 4)
+		input_node.users[input_node.user_count++] = id;
+}
+
+void build_legacy(LegacyNodes &nodes, const std::vector<std::pair<NodeRef, NodeRef> > &edges)
+{
+	for (NodeRef i = 0; i < NODE_COUNT; i++)
+	{
+		auto node = std::make_unique<LegacyNode>();
+		node->id = i;
+		node->type = (i % 8 == 0) ? NodeType::CONST : NodeType::ADD;
+		node->string_id = reinterpret_cast<uint64_t>(strdup("node")); /* per-node heap name, as before the string table */
+
+		if (edges[i].first != NULL_REF)
+		{
+			link(*node, i, edges[i].first, *nodes[edges[i].first]);
+			link(*node, i, edges[i].second, *nodes[edges[i].second]);
+		}
+		nodes.push_back(std::move(node));
+	}
+}
+
+void build_graph(SproutGraph &graph, const std::vector<std::pair<NodeRef, NodeRef> > &edges)
+{
+	graph.reserve(NODE_COUNT);
+	for (NodeRef i = 0; i < NODE_COUNT; i++)
+	{
+		const NodeRef id = graph.create((i % 8 == 0) ? NodeType::CONST : NodeType::ADD);
+		graph.set_name(id, "node");
+
+		if (edges[i].first != NULL_REF)
+		{
+			graph.add_input(id, edges[i].first);
+			graph.add_input(id, edges[i].second);
+		}
+	}
+}
+
+/* DCE-style mark: walk inputs from the last node */
+template<typename Inputs>
+size_t mark(Inputs &&inputs_of)
+{
+	std::vector<uint8_t> seen(NODE_COUNT, 0);
+	std::vector<NodeRef> worklist = { NODE_COUNT - 1 };
+	seen[NODE_COUNT - 1] = 1;
+
+	size_t reached = 0;
+	while (!worklist.empty())
+	{
+		const NodeRef curr = worklist.back();
+		worklist.pop_back();
+		reached++;
+
+		for (const NodeRef input: inputs_of(curr))
+		{
+			if (!seen[input])
+			{
+				seen[input] = 1;
+				worklist.push_back(input);
+			}
+		}
+	}
+
+	return reached;
+}
+
+/* pass-style linear scan over every slot */
+template<typename Type, typename UserCount>
+size_t scan(Type &&type_of, UserCount &&user_count_of)
+{
+	size_t users = 0;
+	for (NodeRef i = 0; i < NODE_COUNT; i++)
+	{
+		if (type_of(i) == NodeType::ADD)
+			users += user_count_of(i);
+	}
+
+	return users;
+}
+
+template<typename Fn>
+double best_ms(Fn &&fn)
+{
+	double best = 1e30;
+	for (int r = 0; r < ROUNDS; r++)
+	{
+		const auto start = std::chrono::steady_clock::now();
+		fn();
+		const auto end = std::chrono::steady_clock::now();
+		best = std::min(best, std::chrono::duration<double, std::milli>(end - start).count());
+	}
+
+	return best;
+}
+
+void report(const char *name, const double legacy_ms, const double graph_ms)
+{
+	std::cout << "  " << name << ": unique_ptr " << legacy_ms << " ms, SproutGraph "
+			<< graph_ms << " ms (" << legacy_ms / graph_ms << "x)\n";
+}
+
+int main()
+{
+	const auto edges = make_edges();
+
+	LegacyNodes nodes;
+	SproutGraph graph;
+	build_legacy(nodes, edges);
+	build_graph(graph, edges);
+
+	std::cout << "traversal over " << NODE_COUNT << " nodes (best of " << ROUNDS << "):\n";
+
+	size_t sink = 0;
+	const double legacy_mark = best_ms([&]
+	{
+		sink += mark([&](const NodeRef r) { return NodeSpan { nodes[r]->inputs, nodes[r]->input_count }; });
+	});
+	const double graph_mark = best_ms([&] { sink += mark([&](const NodeRef r) { return graph.inputs(r); }); });
+	report("mark", legacy_mark, graph_mark);
+
+	const double legacy_scan = best_ms([&]
+	{
+		sink += scan([&](const NodeRef r) { return nodes[r]->type; },
+		             [&](const NodeRef r) { return nodes[r]->user_count; });
+	});
+	const double graph_scan = best_ms([&]
+	{
+		sink += scan([&](const NodeRef r) { return graph.type(r); },
+		             [&](const NodeRef r) { return graph.users(r).size(); });
+	});
+	report("scan", legacy_scan, graph_scan);
+
+	std::cout << "  (checksum " << sink << ")\n";
+	return 0;
+}
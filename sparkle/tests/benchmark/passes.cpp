@@ -0,0 +1,186 @@
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <thread>
+#include <vector>
+#include <sparkle/sprout/passes/dce.hpp>
+#include <sparkle/sprout/passes/gvn.hpp>
+#include <sparkle/sprout/passes/pre.hpp>
+
+using namespace sprk;
+
+constexpr NodeRef FUNCTION_COUNT = 10'000;
+constexpr NodeRef FUNCTION_SIZE = 100;
+constexpr int ROUNDS = 5;
+
+NodeRef make_node(SproutGraph &graph, const NodeType type, const NodeRef fn,
+                  const std::vector<NodeRef> &inputs = {})
+{
+	const NodeRef id = graph.create(type);
+	graph.set_fn_ref(id, fn);
+	graph.set_name(id, "node");
+
+	for (const NodeRef input: inputs)
+		graph.add_input(id, input);
+
+	return id;
+}
+
+/* many small functions with a mix of live, dead and repeated arithmetic */
+void build_module(SproutGraph &graph, const RegionRef root)
+{
+	static constexpr NodeType ops[] = { NodeType::ADD, NodeType::SUB, NodeType::MUL, NodeType::CMP };
+	std::mt19937 rng(42);
+
+	graph.reserve(FUNCTION_COUNT * FUNCTION_SIZE);
+	for (NodeRef f = 0; f < FUNCTION_COUNT; f++)
+	{
+		const RegionRef region = graph.create_region("fn", RegionType::FUNCTION);
+		graph.add_child(root, region);
+
+		const NodeRef fn = make_node(graph, NodeType::FUNCTION, NULL_REF);
+		const NodeRef entry = make_node(graph, NodeType::ENTRY, fn);
+		std::vector<NodeRef> values = {
+			make_node(graph, NodeType::PARAM, fn, { entry }),
+			make_node(graph, NodeType::PARAM, fn, { entry }),
+			make_node(graph, NodeType::CONST, fn),
+			make_node(graph, NodeType::CONST, fn),
+		};
+		graph.set_value(values[2], static_cast<int64_t>(f));
+		graph.set_value(values[3], static_cast<int64_t>(2));
+
+		while (graph.size() - fn < FUNCTION_SIZE - 1)
+		{
+			/* small operand window so identical expressions show up */
+			std::uniform_int_distribution<size_t> pick(values.size() > 6 ? values.size() - 6 : 0, values.size() - 1);
+			const NodeRef lhs = values[pick(rng)];
+			const NodeRef rhs = values[pick(rng)];
+			values.push_back(make_node(graph, ops[rng() % 4], fn, { lhs, rhs }));
+		}
+
+		make_node(graph, NodeType::RET, fn, { values[values.size() / 2] });
+		for (NodeRef n = fn; n < graph.size(); n++)
+			graph.add_node(region, n);
+	}
+}
+
+template<typename Fn>
+double best_ms(Fn &&fn)
+{
+	double best = 1e30;
+	for (int r = 0; r < ROUNDS; r++)
+	{
+		const auto start = std::chrono::steady_clock::now();
+		fn();
+		const auto end = std::chrono::steady_clock::now();
+		best = std::min(best, std::chrono::duration<double, std::milli>(end - start).count());
+	}
+
+	return best;
+}
+
+int main()
+{
+	SproutGraph graph;
+	const RegionRef root = graph.create_region("root", RegionType::ROOT);
+	build_module(graph, root);
+
+	std::cout << "passes over " << graph.size() << " nodes (best of " << ROUNDS << "):\n";
+
+	size_t sink = 0;
+	DCEPass dce;
+	const double dce_ms = best_ms([&]
+	{
+		dce.run(root, graph);
+		sink += dce.get_dead_nodes().size();
+	});
+	std::cout << "  DCEPass::run: " << dce_ms << " ms\n";
+
+	PREPass pre;
+	const double pre_ms = best_ms([&] { sink += pre.find_redundant_expressions(graph).size(); });
+	std::cout << "  PREPass::find_redundant_expressions: " << pre_ms << " ms\n";
+
+	/* hoisting mutates the module, so time one run on a fresh copy */
+	SproutGraph fresh;
+	const RegionRef fresh_root = fresh.create_region("root", RegionType::ROOT);
+	build_module(fresh, fresh_root);
+
+	const auto start = std::chrono::steady_clock::now();
+	pre.run(fresh_root, fresh);
+	const auto end = std::chrono::steady_clock::now();
+	sink += pre.get_results().size();
+	std::cout << "  PREPass::run (single): " << std::chrono::duration<double, std::milli>(end - start).count()
+			<< " ms, " << pre.get_results().size() << " hoists\n";
+
+	/* the same passes through the function driver on every hardware thread */
+	const unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+	FunctionPassDriver driver(threads);
+
+	const double dce_parallel_ms = best_ms([&]
+	{
+		driver.run(dce, root, graph);
+		sink += dce.get_dead_nodes().size();
+	});
+	std::cout << "  DCEPass on " << threads << " threads: " << dce_parallel_ms << " ms\n";
+
+	SproutGraph fresh_parallel;
+	const RegionRef fresh_parallel_root = fresh_parallel.create_region("root", RegionType::ROOT);
+	build_module(fresh_parallel, fresh_parallel_root);
+
+	const auto parallel_start = std::chrono::steady_clock::now();
+	driver.run(pre, fresh_parallel_root, fresh_parallel);
+	const auto parallel_end = std::chrono::steady_clock::now();
+	sink += pre.get_results().size();
+	std::cout << "  PREPass on " << threads << " threads (single): "
+			<< std::chrono::duration<double, std::milli>(parallel_end - parallel_start).count() << " ms\n";
+
+	/* GVN folds the dominated duplicates first, so PRE scans and hoists less */
+	SproutGraph numbered;
+	const RegionRef numbered_root = numbered.create_region("root", RegionType::ROOT);
+	build_module(numbered, numbered_root);
+
+	GVNPass gvn;
+	const auto gvn_start = std::chrono::steady_clock::now();
+	gvn.run(numbered_root, numbered);
+	const auto gvn_end = std::chrono::steady_clock::now();
+	pre.run(numbered_root, numbered);
+	const auto gvn_pre_end = std::chrono::steady_clock::now();
+	std::cout << "  GVNPass::run (single): " << std::chrono::duration<double, std::milli>(gvn_end - gvn_start).count()
+			<< " ms, folded " << gvn.get_results().size() << "; PRE after it: "
+			<< std::chrono::duration<double, std::milli>(gvn_pre_end - gvn_end).count() << " ms, "
+			<< pre.get_results().size() << " hoists\n";
+
+	/* one round of the optimize loop: a clean module, a PRE rewrite, then DCE */
+	const auto cleaned_after_pre = [&](SproutGraph &module, const RegionRef module_root)
+	{
+		build_module(module, module_root);
+		DCEPass cleanup;
+		cleanup.run(module_root, module);
+		cleanup.remove_dead_nodes(module_root, module);
+		pre.run(module_root, module);
+	};
+
+	SproutGraph round_full, round_incremental;
+	const RegionRef round_full_root = round_full.create_region("root", RegionType::ROOT);
+	const RegionRef round_incremental_root = round_incremental.create_region("root", RegionType::ROOT);
+	cleaned_after_pre(round_full, round_full_root);
+	cleaned_after_pre(round_incremental, round_incremental_root);
+
+	const auto full_start = std::chrono::steady_clock::now();
+	dce.run(round_full_root, round_full);
+	dce.remove_dead_nodes(round_full_root, round_full);
+	const auto full_end = std::chrono::steady_clock::now();
+	std::cout << "  DCE round after PRE, full: "
+			<< std::chrono::duration<double, std::milli>(full_end - full_start).count() << " ms ("
+			<< dce.get_dead_nodes().size() << " removed)\n";
+
+	const auto incremental_start = std::chrono::steady_clock::now();
+	const size_t removed = dce.remove_dead_from(pre.get_dirty_nodes(), round_incremental).size();
+	const auto incremental_end = std::chrono::steady_clock::now();
+	std::cout << "  DCE round after PRE, incremental: "
+			<< std::chrono::duration<double, std::milli>(incremental_end - incremental_start).count() << " ms ("
+			<< removed << " removed)\n";
+
+	std::cout << "  (checksum " << sink << ")\n";
+	return 0;
+}
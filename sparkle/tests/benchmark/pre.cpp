@@ -0,0 +1,237 @@
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <vector>
+#include <sparkle/sprout/passes/dce.hpp>
+#include <sparkle/sprout/passes/pre.hpp>
+
+using namespace sprk;
+
+constexpr int FUNCTION_COUNT = 2'000;
+constexpr int SAMPLES = 16; /* executions simulated per function */
+constexpr int MAX_DEPTH = 2;
+
+struct ModuleBuilder
+{
+	SproutGraph &graph;
+	std::mt19937 rng { 42 };
+	NodeRef fn = NULL_REF;
+	std::vector<NodeRef> base; /* values every region may read */
+
+	NodeRef make(const NodeType type, const RegionRef region, const std::vector<NodeRef> &inputs = {})
+	{
+		const NodeRef id = graph.create(type);
+		graph.set_fn_ref(id, fn);
+		graph.set_name(id, "node");
+		for (const NodeRef input: inputs)
+			graph.add_input(id, input);
+		graph.add_node(region, id);
+		return id;
+	}
+
+	RegionRef child(const RegionRef parent, const RegionType type, const NodeRef control = NULL_REF)
+	{
+		const RegionRef region = graph.create_region("r", type);
+		graph.add_child(parent, region);
+		graph.set_imm_dominator(region, parent);
+		if (control != NULL_REF)
+			graph.set_ctrl_deps(region, control);
+		return region;
+	}
+
+	/* a few operations over the shared values, stored so they stay live, then nested statements */
+	void fill(const RegionRef region, const int depth)
+	{
+		static constexpr NodeType ops[] = { NodeType::ADD, NodeType::SUB, NodeType::MUL, NodeType::CMP };
+
+		std::vector<NodeRef> local = base;
+		NodeRef last = NULL_REF;
+		for (int i = 0; i < 3; i++)
+		{
+			const NodeRef lhs = local[rng() % local.size()];
+			const NodeRef rhs = local[rng() % local.size()];
+			last = make(ops[rng() % 4], region, { lhs, rhs });
+			local.push_back(last);
+		}
+		make(NodeType::STORE, region, { last });
+
+		if (depth >= MAX_DEPTH)
+			return;
+
+		const NodeRef control = make(NodeType::CONTROL, region, { last });
+		const int statements = 1 + static_cast<int>(rng() % 3);
+		for (int s = 0; s < statements; s++)
+		{
+			switch (rng() % 4)
+			{
+				case 0:
+					fill(child(region, RegionType::BRANCH_THEN, control), depth + 1);
+					fill(child(region, RegionType::BRANCH_ELSE, control), depth + 1);
+					break;
+				case 1:
+					fill(child(region, RegionType::BRANCH_THEN, control), depth + 1);
+					break;
+				case 2:
+					fill(child(region, RegionType::LOOP_BODY), depth + 1);
+					break;
+				default:
+					fill(child(region, RegionType::BASIC_BLOCK), depth + 1);
+					break;
+			}
+		}
+	}
+};
+
+/* functions of nested branches and loops sharing a handful of parameters, so expressions repeat across paths */
+void build_module(SproutGraph &graph, const RegionRef root)
+{
+	ModuleBuilder builder { graph };
+	for (int f = 0; f < FUNCTION_COUNT; f++)
+	{
+		const RegionRef region = builder.child(root, RegionType::FUNCTION);
+		builder.fn = NULL_REF;
+		builder.fn = builder.make(NodeType::FUNCTION, region);
+
+		const NodeRef entry = builder.make(NodeType::ENTRY, region);
+		builder.base = {
+			builder.make(NodeType::PARAM, region, { entry }),
+			builder.make(NodeType::PARAM, region, { entry }),
+			builder.make(NodeType::PARAM, region, { entry }),
+		};
+		builder.fill(region, 0);
+		builder.make(NodeType::RET, region, { builder.base[0] });
+	}
+}
+
+bool is_operation(const NodeType type)
+{
+	return type == NodeType::ADD || type == NodeType::SUB || type == NodeType::MUL ||
+	       type == NodeType::DIV || type == NodeType::CMP;
+}
+
+/*
+ * walks one execution of a region: its operations run once, then each child
+ * statement. a branch pair or lone branch takes one draw, a loop runs zero to
+ * three times. the draws only depend on the statement order, which PRE keeps,
+ * so every variant of the module replays the same paths
+ */
+uint64_t execute(const SproutGraph &graph, const RegionRef region, std::mt19937 &rng)
+{
+	uint64_t executed = 0;
+	for (const NodeRef node: graph.region(region).get_nodes())
+		executed += is_operation(graph.type(node));
+
+	const auto &children = graph.region(region).get_children();
+	for (size_t i = 0; i < children.size(); i++)
+	{
+		const RegionType type = graph.region(children[i]).get_type();
+		if (type == RegionType::BRANCH_THEN || type == RegionType::BRANCH_ELSE)
+		{
+			const bool paired = type == RegionType::BRANCH_THEN && i + 1 < children.size() &&
+			                    graph.region(children[i + 1]).get_type() == RegionType::BRANCH_ELSE;
+			const bool taken = rng() & 1;
+			if (taken)
+				executed += execute(graph, children[i], rng);
+			else if (paired)
+				executed += execute(graph, children[i + 1], rng);
+			i += paired;
+		}
+		else if (type == RegionType::LOOP_BODY)
+		{
+			for (uint32_t trips = rng() % 4; trips > 0; trips--)
+				executed += execute(graph, children[i], rng);
+		}
+		else
+		{
+			executed += execute(graph, children[i], rng);
+		}
+	}
+
+	return executed;
+}
+
+/* operations executed along every simulated path, function by function */
+std::vector<uint64_t> dynamic_operations(const SproutGraph &graph, const RegionRef root)
+{
+	std::vector<uint64_t> paths;
+	for (const RegionRef function: graph.region(root).get_children())
+	{
+		for (int sample = 0; sample < SAMPLES; sample++)
+		{
+			std::mt19937 rng(static_cast<uint32_t>(sample));
+			paths.push_back(execute(graph, function, rng));
+		}
+	}
+
+	return paths;
+}
+
+/* operations left in the module; a static count next to the dynamic one */
+size_t static_operations(const SproutGraph &graph)
+{
+	size_t count = 0;
+	for (NodeRef i = 0; i < graph.size(); i++)
+		count += graph.contains(i) && is_operation(graph.type(i));
+	return count;
+}
+
+/*
+ * builds a clean module, runs `mode` and cleans up again, then prints the cost
+ * it leaves behind and how many paths now execute more than in `baseline`.
+ * stores are DCE roots in aggressive mode, so only what nothing reads goes
+ */
+std::vector<uint64_t> measure(const char *name, const PREMode *mode, const std::vector<uint64_t> &baseline = {})
+{
+	SproutGraph graph;
+	const RegionRef root = graph.create_region("root", RegionType::ROOT);
+	build_module(graph, root);
+
+	DCEPass dce(DCEMode::AGGRESSIVE);
+	dce.run(root, graph);
+
+	double pre_ms = 0;
+	size_t rewritten = 0;
+	if (mode)
+	{
+		PREPass pre(*mode);
+		const auto start = std::chrono::steady_clock::now();
+		pre.run(root, graph);
+		const auto end = std::chrono::steady_clock::now();
+		pre_ms = std::chrono::duration<double, std::milli>(end - start).count();
+		for (const PREResult &result: pre.get_results())
+			rewritten += result.instances_removed;
+	}
+
+	dce.run(root, graph);
+
+	const std::vector<uint64_t> paths = dynamic_operations(graph, root);
+	uint64_t executed = 0;
+	size_t slower = 0;
+	for (size_t p = 0; p < paths.size(); p++)
+	{
+		executed += paths[p];
+		slower += !baseline.empty() && paths[p] > baseline[p];
+	}
+
+	std::cout << "  " << name << ": " << executed << " dynamic ops, " << static_operations(graph) << " static ops";
+	if (mode)
+	{
+		std::cout << ", " << slower << " of " << paths.size() << " paths slower (" << pre_ms << " ms, "
+				<< rewritten << " computations redirected)";
+	}
+	std::cout << "\n";
+	return paths;
+}
+
+int main()
+{
+	std::cout << "dynamically executed operations over " << FUNCTION_COUNT << " functions, "
+			<< SAMPLES << " paths each:\n";
+
+	constexpr PREMode hoist = PREMode::HOIST;
+	constexpr PREMode lazy = PREMode::LAZY_CODE_MOTION;
+	const std::vector<uint64_t> baseline = measure("before PRE", nullptr);
+	measure("hoisting PRE", &hoist, baseline);
+	measure("lazy code motion", &lazy, baseline);
+	return 0;
+}
@@ -4,151 +4,270 @@
 
 using namespace sprk;
 
-NodeRef make_node(std::vector<std::unique_ptr<SproutNode<> > > &nodes,
+NodeRef make_node(SproutGraph &graph,
                   const NodeType type,
                   const std::string &name = "",
                   const std::vector<NodeRef> &inputs = {})
 {
-	const auto id = static_cast<NodeRef>(nodes.size());
-	auto node = std::make_unique<SproutNode<> >();
-
-	node->id = id;
-	node->type = type;
-	node->input_count = 0;
-	node->user_count = 0;
+	const NodeRef id = graph.create(type);
 
 	if (!name.empty())
-		node->string_id = reinterpret_cast<uint64_t>(strdup(name.c_str()));
+		graph.set_name(id, name);
 
 	for (const NodeRef input: inputs)
 	{
-		if (input < nodes.size() && nodes[input] && node->input_count < 4)
-		{
-			node->inputs[node->input_count++] = input;
-			if (nodes[input]->user_count < 4)
-				nodes[input]->users[nodes[input]->user_count++] = id;
-		}
+		if (graph.contains(input))
+			graph.add_input(id, input);
 	}
 
-	nodes.push_back(std::move(node));
 	return id;
 }
 
-void set_const(const std::vector<std::unique_ptr<SproutNode<> > > &nodes,
+void set_const(SproutGraph &graph,
                const NodeRef node_ref,
                int64_t value)
 {
-	if (node_ref < nodes.size() && nodes[node_ref])
-		nodes[node_ref]->value = value;
+	if (graph.contains(node_ref))
+		graph.set_value(node_ref, value);
 }
 
-void set_mem_obj(const std::vector<std::unique_ptr<SproutNode<> > > &nodes,
+void set_mem_obj(SproutGraph &graph,
                  const NodeRef node_ref,
                  const NodeRef mem_obj)
 {
-	if (node_ref < nodes.size() && nodes[node_ref])
-		nodes[node_ref]->mem_obj = mem_obj;
+	if (graph.contains(node_ref))
+		graph.set_mem_obj(node_ref, mem_obj);
 }
 
-void create_memory_test_ir(std::vector<std::unique_ptr<SproutNode<> > > &nodes,
-                           const std::shared_ptr<SproutRegion> &root_region)
+void create_memory_test_ir(SproutGraph &graph,
+                           const RegionRef root_region)
 {
-	const auto fn_reg = std::make_shared<SproutRegion>("memtest");
-	fn_reg->set_type(RegionType::FUNCTION);
+	const RegionRef fn_reg = graph.create_region("memtest", RegionType::FUNCTION);
 
-	const auto entry_reg = std::make_shared<SproutRegion>("entry");
-	entry_reg->set_type(RegionType::BASIC_BLOCK);
+	const RegionRef entry_reg = graph.create_region("entry", RegionType::BASIC_BLOCK);
 
-	const auto body_reg = std::make_shared<SproutRegion>("body");
-	body_reg->set_type(RegionType::BASIC_BLOCK);
+	const RegionRef body_reg = graph.create_region("body", RegionType::BASIC_BLOCK);
 
-	const auto exit_reg = std::make_shared<SproutRegion>("exit");
-	exit_reg->set_type(RegionType::BASIC_BLOCK);
+	const RegionRef exit_reg = graph.create_region("exit", RegionType::BASIC_BLOCK);
 
-	root_region->add_child(fn_reg);
-	fn_reg->add_child(entry_reg);
-	fn_reg->add_child(body_reg);
-	fn_reg->add_child(exit_reg);
+	graph.add_child(root_region, fn_reg);
+	graph.add_child(fn_reg, entry_reg);
+	graph.add_child(fn_reg, body_reg);
+	graph.add_child(fn_reg, exit_reg);
 
-	NodeRef entry = make_node(nodes, NodeType::ENTRY, "entry");
-	entry_reg->add_node(entry);
+	NodeRef entry = make_node(graph, NodeType::ENTRY, "entry");
+	graph.add_node(entry_reg, entry);
 
-	NodeRef local_var = make_node(nodes, NodeType::PARAM, "local_var");
-	entry_reg->add_node(local_var);
+	NodeRef local_var = make_node(graph, NodeType::PARAM, "local_var");
+	graph.add_node(entry_reg, local_var);
 
 	/* take address of local variable (creates a stack pointer) */
-	NodeRef addr_of_local = make_node(nodes, NodeType::ADDR_OF, "ptr_to_local", { local_var });
-	entry_reg->add_node(addr_of_local);
+	NodeRef addr_of_local = make_node(graph, NodeType::ADDR_OF, "ptr_to_local", { local_var });
+	graph.add_node(entry_reg, addr_of_local);
 
 	/* issue 1: uninit read */
-	const NodeRef uninit_read = make_node(nodes, NodeType::LOAD, "uninitialized_read", { addr_of_local });
-	set_mem_obj(nodes, uninit_read, addr_of_local);
-	body_reg->add_node(uninit_read);
+	const NodeRef uninit_read = make_node(graph, NodeType::LOAD, "uninitialized_read", { addr_of_local });
+	set_mem_obj(graph, uninit_read, addr_of_local);
+	graph.add_node(body_reg, uninit_read);
 
-	NodeRef const42 = make_node(nodes, NodeType::CONST, "const42");
-	set_const(nodes, const42, 42);
-	entry_reg->add_node(const42);
+	NodeRef const42 = make_node(graph, NodeType::CONST, "const42");
+	set_const(graph, const42, 42);
+	graph.add_node(entry_reg, const42);
 
-	const NodeRef store_local = make_node(nodes, NodeType::STORE, "initialize_local", { addr_of_local, const42 });
-	set_mem_obj(nodes, store_local, addr_of_local);
-	body_reg->add_node(store_local);
+	const NodeRef store_local = make_node(graph, NodeType::STORE, "initialize_local", { addr_of_local, const42 });
+	set_mem_obj(graph, store_local, addr_of_local);
+	graph.add_node(body_reg, store_local);
 
-	NodeRef heap_alloc = make_node(nodes, NodeType::MALLOC, "heap_ptr");
-	body_reg->add_node(heap_alloc);
+	NodeRef heap_alloc = make_node(graph, NodeType::MALLOC, "heap_ptr");
+	graph.add_node(body_reg, heap_alloc);
 
-	const NodeRef store_heap = make_node(nodes, NodeType::STORE, "store_to_heap", { heap_alloc, const42 });
-	set_mem_obj(nodes, store_heap, heap_alloc);
-	body_reg->add_node(store_heap);
+	const NodeRef store_heap = make_node(graph, NodeType::STORE, "store_to_heap", { heap_alloc, const42 });
+	set_mem_obj(graph, store_heap, heap_alloc);
+	graph.add_node(body_reg, store_heap);
 
 	/* issue 2: double free */
-	const NodeRef free1 = make_node(nodes, NodeType::FREE, "free_heap_1", { heap_alloc });
-	set_mem_obj(nodes, free1, heap_alloc);
-	body_reg->add_node(free1);
+	const NodeRef free1 = make_node(graph, NodeType::FREE, "free_heap_1", { heap_alloc });
+	set_mem_obj(graph, free1, heap_alloc);
+	graph.add_node(body_reg, free1);
 
-	const NodeRef free2 = make_node(nodes, NodeType::FREE, "free_heap_2", { heap_alloc });
-	set_mem_obj(nodes, free2, heap_alloc);
-	body_reg->add_node(free2);
+	const NodeRef free2 = make_node(graph, NodeType::FREE, "free_heap_2", { heap_alloc });
+	set_mem_obj(graph, free2, heap_alloc);
+	graph.add_node(body_reg, free2);
 
-	NodeRef heap_alloc2 = make_node(nodes, NodeType::MALLOC, "heap_ptr2");
-	body_reg->add_node(heap_alloc2);
+	NodeRef heap_alloc2 = make_node(graph, NodeType::MALLOC, "heap_ptr2");
+	graph.add_node(body_reg, heap_alloc2);
 
 	/* store to second heap alloc */
-	const NodeRef store_heap2 = make_node(nodes, NodeType::STORE, "store_to_heap2", { heap_alloc2, const42 });
-	set_mem_obj(nodes, store_heap2, heap_alloc2);
-	body_reg->add_node(store_heap2);
+	const NodeRef store_heap2 = make_node(graph, NodeType::STORE, "store_to_heap2", { heap_alloc2, const42 });
+	set_mem_obj(graph, store_heap2, heap_alloc2);
+	graph.add_node(body_reg, store_heap2);
 
 	/* free second */
-	const NodeRef free_heap2 = make_node(nodes, NodeType::FREE, "free_heap2", { heap_alloc2 });
-	set_mem_obj(nodes, free_heap2, heap_alloc2);
-	body_reg->add_node(free_heap2);
+	const NodeRef free_heap2 = make_node(graph, NodeType::FREE, "free_heap2", { heap_alloc2 });
+	set_mem_obj(graph, free_heap2, heap_alloc2);
+	graph.add_node(body_reg, free_heap2);
 
 	/* issue 3: use after free */
-	NodeRef use_after_free = make_node(nodes, NodeType::LOAD, "use_after_free", { heap_alloc2 });
-	set_mem_obj(nodes, use_after_free, heap_alloc2);
-	body_reg->add_node(use_after_free);
+	NodeRef use_after_free = make_node(graph, NodeType::LOAD, "use_after_free", { heap_alloc2 });
+	set_mem_obj(graph, use_after_free, heap_alloc2);
+	graph.add_node(body_reg, use_after_free);
 
-	NodeRef ret = make_node(nodes, NodeType::RET, "return", { use_after_free });
-	exit_reg->add_node(ret);
+	NodeRef ret = make_node(graph, NodeType::RET, "return", { use_after_free });
+	graph.add_node(exit_reg, ret);
 
-	const NodeRef exit = make_node(nodes, NodeType::EXIT, "exit", { ret });
-	exit_reg->add_node(exit);
+	const NodeRef exit = make_node(graph, NodeType::EXIT, "exit", { ret });
+	graph.add_node(exit_reg, exit);
+}
+
+/*
+ *  $(ROOT)
+ *		-> paths     p, q = malloc
+ *			-> then      *p = 42; free(q)
+ *			-> else      *p = 42
+ *			-> exit      *p is fine, *q may be freed; free(p); q may leak
+ */
+void create_path_test_ir(SproutGraph &graph, const RegionRef root_region)
+{
+	const RegionRef fn_reg = graph.create_region("paths", RegionType::FUNCTION);
+	const RegionRef then_reg = graph.create_region("then", RegionType::BRANCH_THEN);
+	const RegionRef else_reg = graph.create_region("else", RegionType::BRANCH_ELSE);
+	const RegionRef exit_reg = graph.create_region("exit", RegionType::BASIC_BLOCK);
+
+	graph.add_child(root_region, fn_reg);
+	graph.add_child(fn_reg, then_reg);
+	graph.add_child(fn_reg, else_reg);
+	graph.add_child(fn_reg, exit_reg);
+
+	const auto add = [&](const RegionRef region, const NodeType type, const std::string &name,
+	                     const std::vector<NodeRef> &inputs = {})
+	{
+		const NodeRef id = make_node(graph, type, name, inputs);
+		graph.add_node(region, id);
+		return id;
+	};
+
+	const NodeRef p = add(fn_reg, NodeType::MALLOC, "p");
+	const NodeRef q = add(fn_reg, NodeType::MALLOC, "q");
+	const NodeRef const42 = add(fn_reg, NodeType::CONST, "const42");
+	set_const(graph, const42, 42);
+
+	add(then_reg, NodeType::STORE, "then_store_p", { p, const42 });
+	add(then_reg, NodeType::FREE, "then_free_q", { q });
+	add(else_reg, NodeType::STORE, "else_store_p", { p, const42 });
+
+	add(exit_reg, NodeType::LOAD, "load_p", { p });
+	add(exit_reg, NodeType::LOAD, "load_q", { q });
+	add(exit_reg, NodeType::FREE, "free_p", { p });
+}
+
+struct FieldQueries
+{
+	std::vector<std::pair<NodeRef, NodeRef> > pairs;
+};
+
+/*
+ *  $(ROOT)
+ *		-> fields    s, q, e = malloc; i = param
+ *			   s.next = q            next at +16, y at +8
+ *			   n = s.next; n.y
+ *			   m = phi(s, q)         merges s and q for steensgaard only
+ *			   s[i]                  an unknown offset
+ *			   sink(e); *e           e escapes, what it holds is unknown
+ */
+FieldQueries create_field_test_ir(SproutGraph &graph, const RegionRef root_region)
+{
+	const RegionRef fn_reg = graph.create_region("fields", RegionType::FUNCTION);
+	graph.add_child(root_region, fn_reg);
+
+	const auto add = [&](const NodeType type, const std::string &name, const std::vector<NodeRef> &inputs = {})
+	{
+		const NodeRef id = make_node(graph, type, name, inputs);
+		graph.add_node(fn_reg, id);
+		return id;
+	};
+
+	const auto constant = [&](const std::string &name, const int64_t value)
+	{
+		const NodeRef id = add(NodeType::CONST, name);
+		set_const(graph, id, value);
+		return id;
+	};
+
+	const NodeRef entry = add(NodeType::ENTRY, "entry");
+	const NodeRef i = add(NodeType::PARAM, "i", { entry });
+	const NodeRef sink = add(NodeType::FUNCTION, "sink");
+	const NodeRef eight = constant("8", 8);
+	const NodeRef sixteen = constant("16", 16);
+
+	const NodeRef s = add(NodeType::MALLOC, "s");
+	const NodeRef q = add(NodeType::MALLOC, "q");
+	const NodeRef e = add(NodeType::MALLOC, "e");
+
+	const NodeRef s_y = add(NodeType::PTR_ADD, "&s.y", { s, eight });
+	const NodeRef s_next = add(NodeType::PTR_ADD, "&s.next", { s, sixteen });
+	add(NodeType::PTR_STORE, "s.next = q", { s_next, q });
+
+	const NodeRef n = add(NodeType::PTR_LOAD, "n", { s_next });
+	const NodeRef n_y = add(NodeType::PTR_ADD, "&n.y", { n, eight });
+
+	const NodeRef m = add(NodeType::PHI, "m", { s, q });
+	const NodeRef m_y = add(NodeType::PTR_ADD, "&m.y", { m, eight });
+
+	const NodeRef s_i = add(NodeType::PTR_ADD, "&s[i]", { s, i });
+
+	const NodeRef index = constant("param_idx_0", 0);
+	const NodeRef param = add(NodeType::CALL_PARAM, "param_0", { index, e });
+	add(NodeType::CALL, "sink(e)", { sink, param });
+	const NodeRef held = add(NodeType::PTR_LOAD, "*e", { e });
+
+	return { { { s, s_y }, { s_y, s_next }, { s_y, s_i }, { n, q }, { n_y, s_y }, { m_y, s_y }, { held, s } } };
 }
 
 int main()
 {
-	std::vector<std::unique_ptr<SproutNode<> > > nodes1;
-	const auto root1 = std::make_shared<SproutRegion>("root");
-	root1->set_type(RegionType::ROOT);
+	SproutGraph graph1;
+	const RegionRef root1 = graph1.create_region("root", RegionType::ROOT);
 
-	create_memory_test_ir(nodes1, root1);
+	create_memory_test_ir(graph1, root1);
 
 	std::cout << "before analysis result: \n";
-	dump_ir(root1, nodes1);
+	dump_ir(root1, graph1);
 	AliasAnalysisPass aa;
-	aa.run(root1, nodes1);
+	aa.run(root1, graph1);
 
 	std::cout << "alias analysis result: \n";
-	aa.dump_results(nodes1, root1);
+	aa.dump_results(graph1, root1);
+
+	/* memory states meet where the branch does */
+	SproutGraph graph3;
+	const RegionRef root3 = graph3.create_region("root", RegionType::ROOT);
+	create_path_test_ir(graph3, root3);
+
+	AliasAnalysisPass paths;
+	paths.run(root3, graph3);
+
+	std::cout << "\nissues across a branch:\n";
+	for (const MemoryIssue &issue: paths.get_issues())
+		std::cout << "  " << issue.to_string() << "\n";
+
+	/* the same struct code under both modes */
+	for (const AliasMode mode: { AliasMode::STEENSGAARD, AliasMode::ANDERSEN })
+	{
+		SproutGraph graph2;
+		const RegionRef root2 = graph2.create_region("root", RegionType::ROOT);
+		const FieldQueries queries = create_field_test_ir(graph2, root2);
+
+		AliasAnalysisPass fields(mode);
+		fields.run(root2, graph2);
+
+		std::cout << "\nfield queries (" << (mode == AliasMode::STEENSGAARD ? "steensgaard" : "andersen") << "):\n";
+		for (const auto &[a, b]: queries.pairs)
+		{
+			std::cout << "  " << graph2.name(a) << " vs " << graph2.name(b) << ": "
+			          << (fields.may_alias(a, b) ? "may alias" : "no alias") << "\n";
+		}
+		fields.dump_results(graph2, root2);
+	}
 
 	return 0;
 }
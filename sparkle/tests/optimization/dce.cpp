@@ -4,58 +4,43 @@
 
 using namespace sprk;
 
-NodeRef make_node(std::vector<std::unique_ptr<SproutNode<> > > &nodes,
+NodeRef make_node(SproutGraph &graph,
                   const NodeType type,
                   const std::string &name = "",
                   const std::vector<NodeRef> &inputs = {})
 {
-	const auto id = static_cast<NodeRef>(nodes.size());
-	auto node = std::make_unique<SproutNode<> >();
-
-	node->id = id;
-	node->type = type;
-	node->input_count = 0;
-	node->user_count = 0;
+	const NodeRef id = graph.create(type);
 
 	if (!name.empty())
-		node->string_id = reinterpret_cast<uint64_t>(strdup(name.c_str()));
+		graph.set_name(id, name);
 
 	for (const NodeRef input: inputs)
 	{
-		if (input < nodes.size() && nodes[input] && node->input_count < 4)
-		{
-			node->inputs[node->input_count++] = input;
-			if (nodes[input]->user_count < 4)
-				nodes[input]->users[nodes[input]->user_count++] = id;
-		}
+		if (graph.contains(input))
+			graph.add_input(id, input);
 	}
 
-	nodes.push_back(std::move(node));
 	return id;
 }
 
-void set_const(const std::vector<std::unique_ptr<SproutNode<> > > &nodes,
+void set_const(SproutGraph &graph,
                NodeRef node_ref,
                int64_t value)
 {
-	if (node_ref < nodes.size() && nodes[node_ref])
-		nodes[node_ref]->value = value;
+	if (graph.contains(node_ref))
+		graph.set_value(node_ref, value);
 }
 
-void create_test_ir(std::vector<std::unique_ptr<SproutNode<> > > &nodes,
-                    const std::shared_ptr<SproutRegion> &root_region)
+void create_test_ir(SproutGraph &graph,
+                    const RegionRef root_region)
 {
-	const auto fn_reg = std::make_shared<SproutRegion>("testfn");
-	fn_reg->set_type(RegionType::FUNCTION);
+	const RegionRef fn_reg = graph.create_region("testfn", RegionType::FUNCTION);
 
-	const auto entry_reg = std::make_shared<SproutRegion>("entry");
-	entry_reg->set_type(RegionType::BASIC_BLOCK);
+	const RegionRef entry_reg = graph.create_region("entry", RegionType::BASIC_BLOCK);
 
-	const auto body_reg = std::make_shared<SproutRegion>("body");
-	body_reg->set_type(RegionType::BASIC_BLOCK);
+	const RegionRef body_reg = graph.create_region("body", RegionType::BASIC_BLOCK);
 
-	const auto exit_region = std::make_shared<SproutRegion>("exit");
-	exit_region->set_type(RegionType::BASIC_BLOCK);
+	const RegionRef exit_region = graph.create_region("exit", RegionType::BASIC_BLOCK);
 
 	/*
 	 *  $(ROOT)
@@ -64,164 +49,319 @@ void create_test_ir(std::vector<std::unique_ptr<SproutNode<> > > &nodes,
 	 *			-> body
 	 *			-> exit
 	 */
-	root_region->add_child(fn_reg);
-	fn_reg->add_child(entry_reg);
-	fn_reg->add_child(body_reg);
-	fn_reg->add_child(exit_region);
+	graph.add_child(root_region, fn_reg);
+	graph.add_child(fn_reg, entry_reg);
+	graph.add_child(fn_reg, body_reg);
+	graph.add_child(fn_reg, exit_region);
 
-	NodeRef entry = make_node(nodes, NodeType::ENTRY, "entry");
-	entry_reg->add_node(entry);
+	NodeRef entry = make_node(graph, NodeType::ENTRY, "entry");
+	graph.add_node(entry_reg, entry);
 
 	/* fn param */
-	NodeRef param_a = make_node(nodes, NodeType::PARAM, "a", { entry });
-	NodeRef param_b = make_node(nodes, NodeType::PARAM, "b", { entry });
-	entry_reg->add_node(param_a);
-	entry_reg->add_node(param_b);
+	NodeRef param_a = make_node(graph, NodeType::PARAM, "a", { entry });
+	NodeRef param_b = make_node(graph, NodeType::PARAM, "b", { entry });
+	graph.add_node(entry_reg, param_a);
+	graph.add_node(entry_reg, param_b);
 
-	NodeRef const10 = make_node(nodes, NodeType::CONST, "const10");
-	set_const(nodes, const10, 10);
-	entry_reg->add_node(const10);
+	NodeRef const10 = make_node(graph, NodeType::CONST, "const10");
+	set_const(graph, const10, 10);
+	graph.add_node(entry_reg, const10);
 
-	NodeRef const20 = make_node(nodes, NodeType::CONST, "const20");
-	set_const(nodes, const20, 20);
-	entry_reg->add_node(const20);
+	NodeRef const20 = make_node(graph, NodeType::CONST, "const20");
+	set_const(graph, const20, 20);
+	graph.add_node(entry_reg, const20);
 
 	/* live: a + 10 */
-	NodeRef add = make_node(nodes, NodeType::ADD, "a_plus_10", { param_a, const10 });
-	body_reg->add_node(add);
+	NodeRef add = make_node(graph, NodeType::ADD, "a_plus_10", { param_a, const10 });
+	graph.add_node(body_reg, add);
 
 	/* dead: b + 20 */
-	NodeRef mul = make_node(nodes, NodeType::MUL, "b_times_20", { param_b, const20 });
-	body_reg->add_node(mul);
+	NodeRef mul = make_node(graph, NodeType::MUL, "b_times_20", { param_b, const20 });
+	graph.add_node(body_reg, mul);
 
 	/* dead: result + 20 */
-	const NodeRef dead_add = make_node(nodes, NodeType::ADD, "dead_add", { mul, const10 });
-	body_reg->add_node(dead_add);
+	const NodeRef dead_add = make_node(graph, NodeType::ADD, "dead_add", { mul, const10 });
+	graph.add_node(body_reg, dead_add);
 
 	/* return: use the live add as result */
-	NodeRef ret = make_node(nodes, NodeType::RET, "return", { add });
-	exit_region->add_node(ret);
+	NodeRef ret = make_node(graph, NodeType::RET, "return", { add });
+	graph.add_node(exit_region, ret);
 
-	const NodeRef exit = make_node(nodes, NodeType::EXIT, "exit", { ret });
-	exit_region->add_node(exit);
+	const NodeRef exit = make_node(graph, NodeType::EXIT, "exit", { ret });
+	graph.add_node(exit_region, exit);
 }
 
-void create_br_ir(std::vector<std::unique_ptr<SproutNode<> > > &nodes,
-                              const std::shared_ptr<SproutRegion> &root_region)
+void create_br_ir(SproutGraph &graph,
+                              const RegionRef root_region)
 {
-	const auto fn_reg = std::make_shared<SproutRegion>("brfn");
-	fn_reg->set_type(RegionType::FUNCTION);
+	const RegionRef fn_reg = graph.create_region("brfn", RegionType::FUNCTION);
 
-	const auto entry_reg = std::make_shared<SproutRegion>("entry");
-	entry_reg->set_type(RegionType::BASIC_BLOCK);
+	const RegionRef entry_reg = graph.create_region("entry", RegionType::BASIC_BLOCK);
 
-	const auto cond_reg = std::make_shared<SproutRegion>("condition");
-	cond_reg->set_type(RegionType::BASIC_BLOCK);
+	const RegionRef cond_reg = graph.create_region("condition", RegionType::BASIC_BLOCK);
 
-	const auto then_reg = std::make_shared<SproutRegion>("then_br");
-	then_reg->set_type(RegionType::BRANCH_THEN);
+	const RegionRef then_reg = graph.create_region("then_br", RegionType::BRANCH_THEN);
 
-	const auto else_reg = std::make_shared<SproutRegion>("else_br");
-	else_reg->set_type(RegionType::BRANCH_ELSE);
+	const RegionRef else_reg = graph.create_region("else_br", RegionType::BRANCH_ELSE);
 
-	const auto exit_reg = std::make_shared<SproutRegion>("exit");
-	exit_reg->set_type(RegionType::BASIC_BLOCK);
+	const RegionRef exit_reg = graph.create_region("exit", RegionType::BASIC_BLOCK);
 
-	root_region->add_child(fn_reg);
-	fn_reg->add_child(entry_reg);
-	fn_reg->add_child(cond_reg);
-	fn_reg->add_child(then_reg);
-	fn_reg->add_child(else_reg);
-	fn_reg->add_child(exit_reg);
+	graph.add_child(root_region, fn_reg);
+	graph.add_child(fn_reg, entry_reg);
+	graph.add_child(fn_reg, cond_reg);
+	graph.add_child(fn_reg, then_reg);
+	graph.add_child(fn_reg, else_reg);
+	graph.add_child(fn_reg, exit_reg);
 
-	NodeRef entry = make_node(nodes, NodeType::ENTRY, "entry");
-	entry_reg->add_node(entry);
+	NodeRef entry = make_node(graph, NodeType::ENTRY, "entry");
+	graph.add_node(entry_reg, entry);
 
-	NodeRef param_a = make_node(nodes, NodeType::PARAM, "a", { entry });
-	NodeRef param_b = make_node(nodes, NodeType::PARAM, "b", { entry });
-	entry_reg->add_node(param_a);
-	entry_reg->add_node(param_b);
+	NodeRef param_a = make_node(graph, NodeType::PARAM, "a", { entry });
+	NodeRef param_b = make_node(graph, NodeType::PARAM, "b", { entry });
+	graph.add_node(entry_reg, param_a);
+	graph.add_node(entry_reg, param_b);
 
 	/* lits */
-	NodeRef const10 = make_node(nodes, NodeType::CONST, "const10");
-	set_const(nodes, const10, 10);
-	NodeRef const20 = make_node(nodes, NodeType::CONST, "const20");
-	set_const(nodes, const20, 20);
-	NodeRef const30 = make_node(nodes, NodeType::CONST, "const30");
-	set_const(nodes, const30, 30);
-	entry_reg->add_node(const10);
-	entry_reg->add_node(const20);
-	entry_reg->add_node(const30);
+	NodeRef const10 = make_node(graph, NodeType::CONST, "const10");
+	set_const(graph, const10, 10);
+	NodeRef const20 = make_node(graph, NodeType::CONST, "const20");
+	set_const(graph, const20, 20);
+	NodeRef const30 = make_node(graph, NodeType::CONST, "const30");
+	set_const(graph, const30, 30);
+	graph.add_node(entry_reg, const10);
+	graph.add_node(entry_reg, const20);
+	graph.add_node(entry_reg, const30);
 
 	/* cond: a > b */
-	NodeRef condition = make_node(nodes, NodeType::CMP, "a_gt_b", { param_a, param_b });
-	cond_reg->add_node(condition);
+	NodeRef condition = make_node(graph, NodeType::CMP, "a_gt_b", { param_a, param_b });
+	graph.add_node(cond_reg, condition);
 
 	/* br */
-	NodeRef control = make_node(nodes, NodeType::CONTROL, "br_ctrl", { condition });
-	cond_reg->add_node(control);
+	NodeRef control = make_node(graph, NodeType::CONTROL, "br_ctrl", { condition });
+	graph.add_node(cond_reg, control);
 
 	/* live: then */
-	NodeRef then_add = make_node(nodes, NodeType::ADD, "a_plus_10", { param_a, const10 });
-	then_reg->add_node(then_add);
+	NodeRef then_add = make_node(graph, NodeType::ADD, "a_plus_10", { param_a, const10 });
+	graph.add_node(then_reg, then_add);
 
 	/* dead: then */
-	const NodeRef then_dead = make_node(nodes, NodeType::MUL, "dead_then_mul", { param_b, const20 });
-	then_reg->add_node(then_dead);
+	const NodeRef then_dead = make_node(graph, NodeType::MUL, "dead_then_mul", { param_b, const20 });
+	graph.add_node(then_reg, then_dead);
 
 	/* alive: else */
-	NodeRef else_mul = make_node(nodes, NodeType::MUL, "b_times_20", { param_b, const20 });
-	else_reg->add_node(else_mul);
+	NodeRef else_mul = make_node(graph, NodeType::MUL, "b_times_20", { param_b, const20 });
+	graph.add_node(else_reg, else_mul);
 
 	/* dead: else */
-	const NodeRef else_dead = make_node(nodes, NodeType::ADD, "dead_else_add", { param_a, const30 });
-	else_reg->add_node(else_dead);
+	const NodeRef else_dead = make_node(graph, NodeType::ADD, "dead_else_add", { param_a, const30 });
+	graph.add_node(else_reg, else_dead);
 
 	/* phi merge */
-	NodeRef phi = make_node(nodes, NodeType::PHI, "result_phi", { then_add, else_mul, control });
-	exit_reg->add_node(phi);
+	NodeRef phi = make_node(graph, NodeType::PHI, "result_phi", { then_add, else_mul, control });
+	graph.add_node(exit_reg, phi);
 
 	/* phi */
-	NodeRef ret = make_node(nodes, NodeType::RET, "return", { phi });
-	exit_reg->add_node(ret);
+	NodeRef ret = make_node(graph, NodeType::RET, "return", { phi });
+	graph.add_node(exit_reg, ret);
+
+	const NodeRef exit = make_node(graph, NodeType::EXIT, "exit", { ret });
+	graph.add_node(exit_reg, exit);
+}
+
+void create_fanout_ir(SproutGraph &graph,
+                      const RegionRef root_region)
+{
+	const RegionRef fn_reg = graph.create_region("fanout", RegionType::FUNCTION);
+	graph.add_child(root_region, fn_reg);
+
+	NodeRef entry = make_node(graph, NodeType::ENTRY, "entry");
+	graph.add_node(fn_reg, entry);
+
+	NodeRef param_a = make_node(graph, NodeType::PARAM, "a", { entry });
+	graph.add_node(fn_reg, param_a);
+
+	NodeRef const1 = make_node(graph, NodeType::CONST, "const1");
+	set_const(graph, const1, 1);
+	graph.add_node(fn_reg, const1);
+
+	/* 12 users of const1; every other one feeds the chain, the rest are dead */
+	NodeRef acc = param_a;
+	for (int i = 0; i < 12; i++)
+	{
+		const std::string name = (i % 2 ? "dead_" : "acc_") + std::to_string(i);
+		NodeRef add = make_node(graph, NodeType::ADD, name, { i % 2 ? param_a : acc, const1 });
+		graph.add_node(fn_reg, add);
+		if (i % 2 == 0)
+			acc = add;
+	}
 
-	const NodeRef exit = make_node(nodes, NodeType::EXIT, "exit", { ret });
-	exit_reg->add_node(exit);
+	NodeRef ret = make_node(graph, NodeType::RET, "return", { acc });
+	graph.add_node(fn_reg, ret);
+
+	const NodeRef exit = make_node(graph, NodeType::EXIT, "exit", { ret });
+	graph.add_node(fn_reg, exit);
+}
+
+/*
+ * side effects and control dependence; only the aggressive mode sees them
+ *
+ *  $(ROOT)
+ *		-> log      (FUNCTION)
+ *		-> effects  (FUNCTION)
+ *			-> then (ctrl_dep: cond) stores into buf
+ *			-> else (ctrl_dep: cond) dead add only
+ */
+void create_effects_ir(SproutGraph &graph,
+                       const RegionRef root_region)
+{
+	const RegionRef log_reg = graph.create_region("log", RegionType::FUNCTION);
+	const RegionRef fn_reg = graph.create_region("effects", RegionType::FUNCTION);
+	const RegionRef then_reg = graph.create_region("then", RegionType::BRANCH_THEN);
+	const RegionRef else_reg = graph.create_region("else", RegionType::BRANCH_ELSE);
+	graph.add_child(root_region, log_reg);
+	graph.add_child(root_region, fn_reg);
+	graph.add_child(fn_reg, then_reg);
+	graph.add_child(fn_reg, else_reg);
+
+	const NodeRef log_fn = make_node(graph, NodeType::FUNCTION, "log");
+	const NodeRef log_entry = make_node(graph, NodeType::ENTRY, "log_entry");
+	const NodeRef log_ret = make_node(graph, NodeType::RET, "log_return", { log_entry });
+	for (const NodeRef n: { log_fn, log_entry, log_ret })
+	{
+		graph.add_node(log_reg, n);
+		if (n != log_fn)
+			graph.set_fn_ref(n, log_fn);
+	}
+
+	const NodeRef fn = make_node(graph, NodeType::FUNCTION, "effects");
+	const NodeRef entry = make_node(graph, NodeType::ENTRY, "entry");
+	const NodeRef param_p = make_node(graph, NodeType::PARAM, "p", { entry });
+	const NodeRef const1 = make_node(graph, NodeType::CONST, "const1");
+	set_const(graph, const1, 1);
+	const NodeRef buf = make_node(graph, NodeType::MALLOC, "buf", { const1 });
+	const NodeRef store = make_node(graph, NodeType::STORE, "buf = p", { param_p });
+	graph.set_mem_obj(store, buf);
+	const NodeRef cond = make_node(graph, NodeType::CMP, "p == 1", { param_p, const1 });
+	const NodeRef call = make_node(graph, NodeType::CALL, "call_log", { log_fn });
+	const NodeRef dead_mul = make_node(graph, NodeType::MUL, "dead_mul", { param_p, param_p });
+	const NodeRef ret = make_node(graph, NodeType::RET, "return", { param_p });
+	for (const NodeRef n: { fn, entry, param_p, const1, buf, store, cond, call, dead_mul, ret })
+		graph.add_node(fn_reg, n);
+
+	const NodeRef then_store = make_node(graph, NodeType::STORE, "buf = 1", { const1 });
+	graph.set_mem_obj(then_store, buf);
+	graph.add_node(then_reg, then_store);
+	graph.set_ctrl_deps(then_reg, cond);
+
+	const NodeRef else_add = make_node(graph, NodeType::ADD, "dead_else_add", { param_p, const1 });
+	graph.add_node(else_reg, else_add);
+	graph.set_ctrl_deps(else_reg, cond);
+
+	for (const NodeRef n: { entry, param_p, const1, buf, store, cond, call, dead_mul, ret, then_store, else_add })
+		graph.set_fn_ref(n, fn);
 }
 
 int main()
 {
-	std::vector<std::unique_ptr<SproutNode<> > > nodes1;
-	const auto root1 = std::make_shared<SproutRegion>("root");
-	root1->set_type(RegionType::ROOT);
+	SproutGraph graph1;
+	const RegionRef root1 = graph1.create_region("root", RegionType::ROOT);
 
-	create_test_ir(nodes1, root1);
+	create_test_ir(graph1, root1);
 
 	std::cout << "before DCE optimization 1: \n";
-	dump_ir(root1, nodes1);
+	dump_ir(root1, graph1);
 
 	DCEPass dce1;
-	dce1.run(root1, nodes1);
+	dce1.run(root1, graph1);
 
 	std::cout << "after DCE optimization 1: \n";
-	dce1.dump_results(dce1.get_dead_nodes(), nodes1, root1);
+	dce1.dump_results(dce1.get_dead_nodes(), graph1, root1);
 
 	/********/
 
-	std::vector<std::unique_ptr<SproutNode<> > > nodes2;
-	const auto root2 = std::make_shared<SproutRegion>("root");
-	root2->set_type(RegionType::ROOT);
+	SproutGraph graph2;
+	const RegionRef root2 = graph2.create_region("root", RegionType::ROOT);
 
-	create_br_ir(nodes2, root2);
+	create_br_ir(graph2, root2);
 
 	std::cout << "before DCE optimization 1: \n";
-	dump_ir(root2, nodes2);
+	dump_ir(root2, graph2);
 
 	DCEPass dce2;
-	dce2.run(root2, nodes2);
+	dce2.run(root2, graph2);
 
 	std::cout << "after DCE optimization 1: \n";
-	dce2.dump_results(dce2.get_dead_nodes(), nodes2, root2);
+	dce2.dump_results(dce2.get_dead_nodes(), graph2, root2);
+
+	/********/
+
+	SproutGraph graph3;
+	const RegionRef root3 = graph3.create_region("root", RegionType::ROOT);
+
+	create_fanout_ir(graph3, root3);
+
+	std::cout << "before DCE optimization 3: \n";
+	dump_ir(root3, graph3);
+
+	DCEPass dce3;
+	dce3.run(root3, graph3);
+
+	std::cout << "after DCE optimization 3: \n";
+	dce3.dump_results(dce3.get_dead_nodes(), graph3, root3);
+
+	/********/
+
+	SproutGraph graph4;
+	const RegionRef root4 = graph4.create_region("root", RegionType::ROOT);
+
+	create_effects_ir(graph4, root4);
+
+	std::cout << "before DCE optimization 4: \n";
+	dump_ir(root4, graph4);
+
+	DCEPass mark4;
+	mark4.run(root4, graph4);
+
+	std::cout << "mark-only DCE 4 (stores, calls and ctrl deps count as dead): \n";
+	mark4.dump_results(mark4.get_dead_nodes(), graph4, root4);
+
+	DCEPass dce4(DCEMode::AGGRESSIVE);
+	dce4.run(root4, graph4);
+
+	std::cout << "after aggressive DCE optimization 4: \n";
+	std::cout << "removed " << dce4.get_dead_nodes().size() << " nodes and "
+			<< dce4.get_removed_regions() << " regions; " << graph4.live_size() << " of "
+			<< graph4.size() << " slots live\n";
+
+	std::cout << "remap:";
+	for (NodeRef old_ref = 0; old_ref < dce4.get_remap().nodes.size(); old_ref++)
+	{
+		if (const NodeRef new_ref = dce4.get_remap().node(old_ref); new_ref != old_ref)
+			std::cout << " " << old_ref << "->" << (new_ref == NULL_REF ? "x" : std::to_string(new_ref));
+	}
+	std::cout << "\n";
+	dump_ir(root4, graph4);
+
+	/********/
+
+	SproutGraph graph5;
+	const RegionRef root5 = graph5.create_region("root", RegionType::ROOT);
+
+	create_effects_ir(graph5, root5);
+
+	/* every node dirty; without users, the stores and the call still stay in mark mode */
+	std::vector<NodeRef> dirty5;
+	for (NodeRef ref = 0; ref < graph5.size(); ref++)
+		dirty5.push_back(ref);
+
+	DCEPass incremental5;
+	const std::vector<NodeRef> removed5 = incremental5.remove_dead_from(dirty5, graph5);
+
+	std::cout << "incremental DCE 5 removed:";
+	for (const NodeRef node: removed5)
+		std::cout << " #" << node;
+	std::cout << "\n";
+	dump_ir(root5, graph5);
 
 	return 0;
 }
@@ -0,0 +1,118 @@
+#include <iostream>
+#include <random>
+#include <sparkle/sprout/graph.hpp>
+#include <sparkle/sprout/utils/dump.hpp>
+
+using namespace sprk;
+
+/* reference answers: walk the imm_dom chain */
+bool naive_dominates(const SproutGraph &graph, const RegionRef a, const RegionRef b)
+{
+	for (RegionRef curr = b; curr != NULL_REGION; curr = graph.region(curr).get_imm_dom())
+	{
+		if (curr == a)
+			return true;
+	}
+
+	return false;
+}
+
+RegionRef naive_common(const SproutGraph &graph, const RegionRef a, const RegionRef b)
+{
+	for (RegionRef curr = a; curr != NULL_REGION; curr = graph.region(curr).get_imm_dom())
+	{
+		if (naive_dominates(graph, curr, b))
+			return curr;
+	}
+
+	return NULL_REGION;
+}
+
+/*
+ *	fn
+ *	 -> entry
+ *	     -> cond
+ *	         -> then
+ *	         -> else
+ *	         -> exit
+ */
+void diamond()
+{
+	SproutGraph graph;
+	const RegionRef fn = graph.create_region("fn", RegionType::FUNCTION);
+	const RegionRef entry = graph.create_region("entry", RegionType::BASIC_BLOCK);
+	const RegionRef cond = graph.create_region("cond", RegionType::BASIC_BLOCK);
+	const RegionRef then_reg = graph.create_region("then", RegionType::BRANCH_THEN);
+	const RegionRef else_reg = graph.create_region("else", RegionType::BRANCH_ELSE);
+	const RegionRef exit_reg = graph.create_region("exit", RegionType::BASIC_BLOCK);
+	for (const RegionRef r: { entry, cond, then_reg, else_reg, exit_reg })
+		graph.add_child(fn, r);
+
+	graph.set_imm_dominator(entry, fn);
+	graph.set_imm_dominator(cond, entry);
+	graph.set_imm_dominator(then_reg, cond);
+	graph.set_imm_dominator(else_reg, cond);
+	graph.set_imm_dominator(exit_reg, cond);
+
+	std::cout << "dominance (row dominates column):\n\t";
+	for (RegionRef b = 0; b < graph.region_count(); b++)
+		std::cout << graph.region(b).get_name().substr(0, 5) << "\t";
+	std::cout << "\n";
+
+	for (RegionRef a = 0; a < graph.region_count(); a++)
+	{
+		std::cout << graph.region(a).get_name().substr(0, 5) << "\t";
+		for (RegionRef b = 0; b < graph.region_count(); b++)
+			std::cout << (graph.dominates(a, b) ? "x" : ".") << "\t";
+		std::cout << "\n";
+	}
+
+	std::cout << "common(then, else) = " << graph.region(graph.find_common_dominator(then_reg, else_reg)).get_name() << "\n";
+	std::cout << "common(exit, entry) = " << graph.region(graph.find_common_dominator(exit_reg, entry)).get_name() << "\n";
+
+	/* rewiring a dominator invalidates the numbering */
+	graph.set_imm_dominator(exit_reg, else_reg);
+	std::cout << "after exit.idom = else:\n";
+	std::cout << "  else dominates exit: " << graph.dominates(else_reg, exit_reg) << "\n";
+	std::cout << "  common(then, exit) = " << graph.region(graph.find_common_dominator(then_reg, exit_reg)).get_name() << "\n";
+}
+
+/* random dominator forests checked against the chain walk */
+void random_forests()
+{
+	std::mt19937 rng(7);
+	size_t queries = 0;
+	size_t mismatches = 0;
+	for (int round = 0; round < 20; round++)
+	{
+		SproutGraph graph;
+		const RegionRef count = 200 + rng() % 300;
+		for (RegionRef r = 0; r < count; r++)
+		{
+			graph.create_region("r" + std::to_string(r), RegionType::BASIC_BLOCK);
+			if (r > 0 && rng() % 16 != 0) /* a few extra roots */
+				graph.set_imm_dominator(r, rng() % r);
+		}
+
+		for (int q = 0; q < 2000; q++)
+		{
+			const RegionRef a = rng() % count;
+			const RegionRef b = rng() % count;
+			queries++;
+			if (graph.dominates(a, b) != naive_dominates(graph, a, b) ||
+			    graph.find_common_dominator(a, b) != naive_common(graph, a, b))
+			{
+				mismatches++;
+			}
+		}
+	}
+
+	std::cout << "random forests: " << queries << " queries, " << mismatches << " mismatches\n";
+}
+
+int main()
+{
+	diamond();
+	random_forests();
+	return 0;
+}
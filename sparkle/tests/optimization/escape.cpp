@@ -0,0 +1,105 @@
+#include <iostream>
+#include <sparkle/sprout/passes/aa.hpp>
+#include <sparkle/sprout/passes/escape.hpp>
+#include <sparkle/sprout/utils/dump.hpp>
+
+using namespace sprk;
+
+NodeRef make_node(SproutGraph &graph,
+                  const NodeType type,
+                  const NodeRef fn,
+                  const RegionRef region,
+                  const std::string &name,
+                  const std::vector<NodeRef> &inputs = {})
+{
+	const NodeRef id = graph.create(type);
+	graph.set_name(id, name);
+	graph.set_fn_ref(id, fn);
+	graph.add_node(region, id);
+
+	for (const NodeRef input: inputs)
+		graph.add_input(id, input);
+
+	return id;
+}
+
+NodeRef make_const(SproutGraph &graph, const NodeRef fn, const RegionRef region, const std::string &name,
+                   const int64_t value)
+{
+	const NodeRef id = make_node(graph, NodeType::CONST, fn, region, name);
+	graph.set_value(id, value);
+	return id;
+}
+
+/*
+ *  $(ROOT)
+ *		-> fn      n = param; sixteen = 16
+ *			   tmp = malloc(16)        tmp.x = n; tmp.y = n; cur = phi(&tmp.x, &tmp.y); *cur; free(tmp)
+ *			   cell = malloc(16)       stored into box, so it escapes
+ *			   box = malloc(16)        only holds cell; stays local
+ *			   arg = malloc(16)        handed to sink
+ *			   out = malloc(16)        returned
+ *			   buf = malloc(n)         not a fixed size
+ */
+void build_ir(SproutGraph &graph, const RegionRef root)
+{
+	const RegionRef fn_reg = graph.create_region("fn", RegionType::FUNCTION);
+	graph.add_child(root, fn_reg);
+
+	const NodeRef sink = make_node(graph, NodeType::FUNCTION, NULL_REF, root, "sink");
+	const NodeRef fn = make_node(graph, NodeType::FUNCTION, NULL_REF, fn_reg, "fn");
+	const NodeRef entry = make_node(graph, NodeType::ENTRY, fn, fn_reg, "entry");
+	const NodeRef n = make_node(graph, NodeType::PARAM, fn, fn_reg, "n", { entry });
+	const NodeRef eight = make_const(graph, fn, fn_reg, "8", 8);
+	const NodeRef sixteen = make_const(graph, fn, fn_reg, "16", 16);
+
+	const NodeRef tmp = make_node(graph, NodeType::MALLOC, fn, fn_reg, "tmp", { sixteen });
+	const NodeRef tmp_y = make_node(graph, NodeType::PTR_ADD, fn, fn_reg, "&tmp.y", { tmp, eight });
+	make_node(graph, NodeType::PTR_STORE, fn, fn_reg, "tmp.x = n", { tmp, n });
+	make_node(graph, NodeType::PTR_STORE, fn, fn_reg, "tmp.y = n", { tmp_y, n });
+	const NodeRef cursor = make_node(graph, NodeType::PHI, fn, fn_reg, "cur", { tmp, tmp_y });
+	const NodeRef read = make_node(graph, NodeType::PTR_LOAD, fn, fn_reg, "*cur", { cursor });
+	make_node(graph, NodeType::FREE, fn, fn_reg, "free(tmp)", { tmp });
+
+	const NodeRef cell = make_node(graph, NodeType::MALLOC, fn, fn_reg, "cell", { sixteen });
+	const NodeRef box = make_node(graph, NodeType::MALLOC, fn, fn_reg, "box", { sixteen });
+	make_node(graph, NodeType::PTR_STORE, fn, fn_reg, "*box = cell", { box, cell });
+	make_node(graph, NodeType::FREE, fn, fn_reg, "free(box)", { box });
+
+	const NodeRef arg = make_node(graph, NodeType::MALLOC, fn, fn_reg, "arg", { sixteen });
+	const NodeRef index = make_const(graph, fn, fn_reg, "param_idx_0", 0);
+	const NodeRef param = make_node(graph, NodeType::CALL_PARAM, fn, fn_reg, "param_0", { index, arg });
+	make_node(graph, NodeType::CALL, fn, fn_reg, "sink(arg)", { sink, param });
+
+	const NodeRef buf = make_node(graph, NodeType::MALLOC, fn, fn_reg, "buf", { n });
+	make_node(graph, NodeType::PTR_STORE, fn, fn_reg, "*buf = n", { buf, n });
+	make_node(graph, NodeType::FREE, fn, fn_reg, "free(buf)", { buf });
+
+	const NodeRef out = make_node(graph, NodeType::MALLOC, fn, fn_reg, "out", { sixteen });
+	make_node(graph, NodeType::PTR_STORE, fn, fn_reg, "*out = *cur", { out, read });
+	make_node(graph, NodeType::RET, fn, fn_reg, "ret", { out });
+}
+
+int main()
+{
+	SproutGraph graph;
+	const RegionRef root = graph.create_region("root", RegionType::ROOT);
+	build_ir(graph, root);
+
+	std::cout << "before stack promotion:\n";
+	dump_ir(root, graph);
+
+	StackPromotionPass promotion;
+	promotion.run(root, graph);
+	promotion.dump_results(graph);
+
+	std::cout << "\nafter stack promotion:\n";
+	dump_ir(root, graph);
+
+	/* stack slots are objects like any other, and not leaks */
+	AliasAnalysisPass aa;
+	aa.run(root, graph);
+	aa.dump_results(graph, root);
+
+	return 0;
+}
@@ -0,0 +1,117 @@
+#include <iostream>
+#include <sparkle/sprout/passes/gvn.hpp>
+#include <sparkle/sprout/passes/pre.hpp>
+#include <sparkle/sprout/utils/dump.hpp>
+
+using namespace sprk;
+
+NodeRef make_node(SproutGraph &graph,
+                  const NodeType type,
+                  const NodeRef fn,
+                  const std::string &name,
+                  const std::vector<NodeRef> &inputs = {})
+{
+	const NodeRef id = graph.create(type);
+	graph.set_name(id, name);
+	graph.set_fn_ref(id, fn);
+
+	for (const NodeRef input: inputs)
+		graph.add_input(id, input);
+
+	return id;
+}
+
+NodeRef make_const(SproutGraph &graph, const NodeRef fn, const std::string &name, const NodeValue value)
+{
+	const NodeRef id = make_node(graph, NodeType::CONST, fn, name);
+	graph.set_value(id, value);
+	return id;
+}
+
+/*
+ *  $(ROOT)
+ *		-> fn
+ *			-> then   a + b again, a * c
+ *			-> else   a * c
+ */
+void build_ir(SproutGraph &graph, const RegionRef root)
+{
+	const RegionRef fn_reg = graph.create_region("fn", RegionType::FUNCTION);
+	const RegionRef then_reg = graph.create_region("then", RegionType::BRANCH_THEN);
+	const RegionRef else_reg = graph.create_region("else", RegionType::BRANCH_ELSE);
+	graph.add_child(root, fn_reg);
+	graph.add_child(fn_reg, then_reg);
+	graph.add_child(fn_reg, else_reg);
+	graph.set_imm_dominator(then_reg, fn_reg);
+	graph.set_imm_dominator(else_reg, fn_reg);
+
+	const NodeRef fn = make_node(graph, NodeType::FUNCTION, NULL_REF, "fn");
+	const NodeRef entry = make_node(graph, NodeType::ENTRY, fn, "entry");
+	const NodeRef a = make_node(graph, NodeType::PARAM, fn, "a", { entry });
+	const NodeRef b = make_node(graph, NodeType::PARAM, fn, "b", { entry });
+	const NodeRef c = make_node(graph, NodeType::PARAM, fn, "c", { entry });
+
+	/* equal literals fold; an equal int and double do not */
+	const NodeRef five = make_const(graph, fn, "five", static_cast<int64_t>(5));
+	const NodeRef five_again = make_const(graph, fn, "five_again", static_cast<int64_t>(5));
+	const NodeRef five_double = make_const(graph, fn, "five_double", 5.0);
+
+	/* commutative operands are sorted; SUB keeps its order */
+	const NodeRef ab = make_node(graph, NodeType::ADD, fn, "a + b", { a, b });
+	const NodeRef ba = make_node(graph, NodeType::ADD, fn, "b + a", { b, a });
+	const NodeRef a_sub_b = make_node(graph, NodeType::SUB, fn, "a - b", { a, b });
+	const NodeRef b_sub_a = make_node(graph, NodeType::SUB, fn, "b - a", { b, a });
+
+	/* operands are compared by leader, so folding chains through */
+	const NodeRef ab5 = make_node(graph, NodeType::MUL, fn, "(a + b) * five", { ab, five });
+	const NodeRef ba5 = make_node(graph, NodeType::MUL, fn, "(b + a) * five_again", { ba, five_again });
+	const NodeRef ab5d = make_node(graph, NodeType::MUL, fn, "(a + b) * five_double", { ab, five_double });
+
+	for (const NodeRef n: { fn, entry, a, b, c, five, five_again, five_double, ab, ba, a_sub_b, b_sub_a, ab5, ba5, ab5d })
+		graph.add_node(fn_reg, n);
+
+	/* the enclosing region's copy is available in the branch */
+	const NodeRef then_ab = make_node(graph, NodeType::ADD, fn, "a + b (then)", { a, b });
+	const NodeRef then_ac = make_node(graph, NodeType::MUL, fn, "a * c (then)", { a, c });
+	graph.add_node(then_reg, then_ab);
+	graph.add_node(then_reg, then_ac);
+
+	/* the sibling's copy is not; this pair is left for PRE */
+	const NodeRef else_ac = make_node(graph, NodeType::MUL, fn, "a * c (else)", { a, c });
+	graph.add_node(else_reg, else_ac);
+
+	const NodeRef sum1 = make_node(graph, NodeType::ADD, fn, "sum1", { ab5, ba5 });
+	const NodeRef sum2 = make_node(graph, NodeType::ADD, fn, "sum2", { a_sub_b, b_sub_a });
+	const NodeRef sum3 = make_node(graph, NodeType::ADD, fn, "sum3", { ab5d, then_ab });
+	const NodeRef sum4 = make_node(graph, NodeType::ADD, fn, "sum4", { then_ac, else_ac });
+	const NodeRef total = make_node(graph, NodeType::ADD, fn, "total", { sum1, sum2 });
+	const NodeRef total2 = make_node(graph, NodeType::ADD, fn, "total2", { sum3, sum4 });
+	const NodeRef ret = make_node(graph, NodeType::RET, fn, "return", { total, total2 });
+	for (const NodeRef n: { sum1, sum2, sum3, sum4, total, total2, ret })
+		graph.add_node(fn_reg, n);
+}
+
+int main()
+{
+	SproutGraph graph;
+	const RegionRef root = graph.create_region("root", RegionType::ROOT);
+	build_ir(graph, root);
+
+	std::cout << "before GVN:\n";
+	dump_ir(root, graph);
+
+	GVNPass gvn;
+	gvn.run(root, graph);
+	gvn.dump_results();
+
+	std::cout << "\nafter GVN:\n";
+	dump_ir(root, graph);
+
+	PREPass pre;
+	pre.run(root, graph);
+
+	std::cout << "\nPRE after GVN:\n";
+	pre.dump_results(graph);
+
+	return 0;
+}
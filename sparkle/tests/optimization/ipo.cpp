@@ -6,206 +6,331 @@
 
 using namespace sprk;
 
-NodeRef make_node(std::vector<std::unique_ptr<SproutNode<> > > &nodes,
+NodeRef make_node(SproutGraph &graph,
                   const NodeType type,
                   const std::string &name = "",
                   const std::vector<NodeRef> &inputs = {})
 {
-	const auto id = static_cast<NodeRef>(nodes.size());
-	auto node = std::make_unique<SproutNode<> >();
-
-	node->id = id;
-	node->type = type;
-	node->input_count = 0;
-	node->user_count = 0;
+	const NodeRef id = graph.create(type);
 
 	if (!name.empty())
-		node->string_id = reinterpret_cast<uint64_t>(strdup(name.c_str()));
+		graph.set_name(id, name);
 
 	for (const NodeRef input: inputs)
 	{
-		if (input < nodes.size() && nodes[input] && node->input_count < 4)
-		{
-			node->inputs[node->input_count++] = input;
-			if (nodes[input]->user_count < 4)
-				nodes[input]->users[nodes[input]->user_count++] = id;
-		}
+		if (graph.contains(input))
+			graph.add_input(id, input);
 	}
 
-	nodes.push_back(std::move(node));
 	return id;
 }
 
-void set_const(const std::vector<std::unique_ptr<SproutNode<> > > &nodes,
+void set_const(SproutGraph &graph,
                const NodeRef node_ref,
                int64_t value)
 {
-	if (node_ref < nodes.size() && nodes[node_ref])
-		nodes[node_ref]->value = value;
+	if (graph.contains(node_ref))
+		graph.set_value(node_ref, value);
 }
 
-void set_fn_ref(const std::vector<std::unique_ptr<SproutNode<> > > &nodes,
+void set_fn_ref(SproutGraph &graph,
                 const NodeRef node_ref,
                 const NodeRef fn_ref)
 {
-	if (node_ref < nodes.size() && nodes[node_ref])
-		nodes[node_ref]->fn_ref = fn_ref;
+	if (graph.contains(node_ref))
+		graph.set_fn_ref(node_ref, fn_ref);
 }
 
-NodeRef make_call_param(std::vector<std::unique_ptr<SproutNode<> > > &nodes,
+NodeRef make_call_param(SproutGraph &graph,
                         const NodeRef fn_ref,
                         int param_index,
                         const NodeRef value)
 {
-	NodeRef idx_const = make_node(nodes, NodeType::CONST, "param_idx_" + std::to_string(param_index));
-	set_const(nodes, idx_const, param_index);
+	NodeRef idx_const = make_node(graph, NodeType::CONST, "param_idx_" + std::to_string(param_index));
+	set_const(graph, idx_const, param_index);
 
-	const NodeRef call_param = make_node(nodes, NodeType::CALL_PARAM,
+	const NodeRef call_param = make_node(graph, NodeType::CALL_PARAM,
 	                                     "param_" + std::to_string(param_index),
 	                                     { idx_const, value });
-	set_fn_ref(nodes, call_param, fn_ref);
+	set_fn_ref(graph, call_param, fn_ref);
 
 	return call_param;
 }
 
-void interproc_test_ir(std::vector<std::unique_ptr<SproutNode<> > > &nodes,
-                       const std::shared_ptr<SproutRegion> &root_region)
+void interproc_test_ir(SproutGraph &graph,
+                       const RegionRef root_region)
 {
-	const auto main_fn_reg = std::make_shared<SproutRegion>("main_function");
-	main_fn_reg->set_type(RegionType::FUNCTION);
+	const RegionRef main_fn_reg = graph.create_region("main_function", RegionType::FUNCTION);
+
+	const RegionRef square_fn_reg = graph.create_region("square_function", RegionType::FUNCTION);
+
+	const RegionRef cube_fn_reg = graph.create_region("cube_function", RegionType::FUNCTION);
+
+	graph.add_child(root_region, main_fn_reg);
+	graph.add_child(root_region, square_fn_reg);
+	graph.add_child(root_region, cube_fn_reg);
+
+	NodeRef square_fn = make_node(graph, NodeType::FUNCTION, "square");
+	graph.add_node(square_fn_reg, square_fn);
+
+	NodeRef square_entry = make_node(graph, NodeType::ENTRY, "square_entry");
+	graph.add_node(square_fn_reg, square_entry);
+	set_fn_ref(graph, square_entry, square_fn);
+
+	NodeRef square_param = make_node(graph, NodeType::PARAM, "x", { square_entry });
+	graph.add_node(square_fn_reg, square_param);
+	set_fn_ref(graph, square_param, square_fn);
+
+	NodeRef square_mul = make_node(graph, NodeType::MUL, "x * x", { square_param, square_param });
+	graph.add_node(square_fn_reg, square_mul);
+	set_fn_ref(graph, square_mul, square_fn);
+
+	NodeRef square_ret = make_node(graph, NodeType::RET, "square_return", { square_mul });
+	graph.add_node(square_fn_reg, square_ret);
+	set_fn_ref(graph, square_ret, square_fn);
+
+	NodeRef cube_fn = make_node(graph, NodeType::FUNCTION, "cube");
+	graph.add_node(cube_fn_reg, cube_fn);
+
+	NodeRef cube_entry = make_node(graph, NodeType::ENTRY, "cube_entry");
+	graph.add_node(cube_fn_reg, cube_entry);
+	set_fn_ref(graph, cube_entry, cube_fn);
+
+	NodeRef cube_param = make_node(graph, NodeType::PARAM, "y", { cube_entry });
+	graph.add_node(cube_fn_reg, cube_param);
+	set_fn_ref(graph, cube_param, cube_fn);
+
+	NodeRef square_call_param = make_call_param(graph, cube_fn, 0, cube_param);
+	graph.add_node(cube_fn_reg, square_call_param);
+
+	NodeRef square_call = make_node(graph, NodeType::CALL, "call_square", { square_fn, square_call_param });
+	graph.add_node(cube_fn_reg, square_call);
+	set_fn_ref(graph, square_call, cube_fn);
+
+	NodeRef cube_mul = make_node(graph, NodeType::MUL, "square(y) * y", { square_call, cube_param });
+	graph.add_node(cube_fn_reg, cube_mul);
+	set_fn_ref(graph, cube_mul, cube_fn);
+
+	/* folds to 1 inside cube, before main clones it */
+	NodeRef cube_two = make_node(graph, NodeType::CONST, "two");
+	set_const(graph, cube_two, 2);
+	graph.add_node(cube_fn_reg, cube_two);
+	set_fn_ref(graph, cube_two, cube_fn);
+
+	NodeRef cube_one = make_node(graph, NodeType::CONST, "one");
+	set_const(graph, cube_one, 1);
+	graph.add_node(cube_fn_reg, cube_one);
+	set_fn_ref(graph, cube_one, cube_fn);
 
-	auto square_fn_reg = std::make_shared<SproutRegion>("square_function");
-	square_fn_reg->set_type(RegionType::FUNCTION);
+	NodeRef cube_scale = make_node(graph, NodeType::SUB, "two - one", { cube_two, cube_one });
+	graph.add_node(cube_fn_reg, cube_scale);
+	set_fn_ref(graph, cube_scale, cube_fn);
 
-	auto cube_fn_reg = std::make_shared<SproutRegion>("cube_function");
-	cube_fn_reg->set_type(RegionType::FUNCTION);
+	NodeRef cube_scaled = make_node(graph, NodeType::MUL, "cube * scale", { cube_mul, cube_scale });
+	graph.add_node(cube_fn_reg, cube_scaled);
+	set_fn_ref(graph, cube_scaled, cube_fn);
 
-	root_region->add_child(main_fn_reg);
-	root_region->add_child(square_fn_reg);
-	root_region->add_child(cube_fn_reg);
+	NodeRef cube_ret = make_node(graph, NodeType::RET, "cube_return", { cube_scaled });
+	graph.add_node(cube_fn_reg, cube_ret);
+	set_fn_ref(graph, cube_ret, cube_fn);
 
-	NodeRef square_fn = make_node(nodes, NodeType::FUNCTION, "square");
-	square_fn_reg->add_node(square_fn);
+	/* fact(n) = n * fact(n - 1); a call cycle of its own, kept as a call */
+	const RegionRef fact_fn_reg = graph.create_region("fact_function", RegionType::FUNCTION);
+	graph.add_child(root_region, fact_fn_reg);
 
-	NodeRef square_entry = make_node(nodes, NodeType::ENTRY, "square_entry");
-	square_fn_reg->add_node(square_entry);
-	set_fn_ref(nodes, square_entry, square_fn);
+	NodeRef fact_fn = make_node(graph, NodeType::FUNCTION, "fact");
+	graph.add_node(fact_fn_reg, fact_fn);
 
-	NodeRef square_param = make_node(nodes, NodeType::PARAM, "x", { square_entry });
-	square_fn_reg->add_node(square_param);
-	set_fn_ref(nodes, square_param, square_fn);
+	NodeRef fact_entry = make_node(graph, NodeType::ENTRY, "fact_entry");
+	graph.add_node(fact_fn_reg, fact_entry);
+	set_fn_ref(graph, fact_entry, fact_fn);
 
-	NodeRef square_mul = make_node(nodes, NodeType::MUL, "x * x", { square_param, square_param });
-	square_fn_reg->add_node(square_mul);
-	set_fn_ref(nodes, square_mul, square_fn);
+	NodeRef fact_param = make_node(graph, NodeType::PARAM, "n", { fact_entry });
+	graph.add_node(fact_fn_reg, fact_param);
+	set_fn_ref(graph, fact_param, fact_fn);
 
-	NodeRef square_ret = make_node(nodes, NodeType::RET, "square_return", { square_mul });
-	square_fn_reg->add_node(square_ret);
-	set_fn_ref(nodes, square_ret, square_fn);
+	NodeRef fact_one = make_node(graph, NodeType::CONST, "one");
+	set_const(graph, fact_one, 1);
+	graph.add_node(fact_fn_reg, fact_one);
+	set_fn_ref(graph, fact_one, fact_fn);
 
-	NodeRef cube_fn = make_node(nodes, NodeType::FUNCTION, "cube");
-	cube_fn_reg->add_node(cube_fn);
+	NodeRef fact_dec = make_node(graph, NodeType::SUB, "n - 1", { fact_param, fact_one });
+	graph.add_node(fact_fn_reg, fact_dec);
+	set_fn_ref(graph, fact_dec, fact_fn);
 
-	NodeRef cube_entry = make_node(nodes, NodeType::ENTRY, "cube_entry");
-	cube_fn_reg->add_node(cube_entry);
-	set_fn_ref(nodes, cube_entry, cube_fn);
+	NodeRef fact_call_param = make_call_param(graph, fact_fn, 0, fact_dec);
+	graph.add_node(fact_fn_reg, fact_call_param);
 
-	NodeRef cube_param = make_node(nodes, NodeType::PARAM, "y", { cube_entry });
-	cube_fn_reg->add_node(cube_param);
-	set_fn_ref(nodes, cube_param, cube_fn);
+	NodeRef fact_call = make_node(graph, NodeType::CALL, "call_fact", { fact_fn, fact_call_param });
+	graph.add_node(fact_fn_reg, fact_call);
+	set_fn_ref(graph, fact_call, fact_fn);
 
-	NodeRef square_call_param = make_call_param(nodes, cube_fn, 0, cube_param);
-	cube_fn_reg->add_node(square_call_param);
+	NodeRef fact_mul = make_node(graph, NodeType::MUL, "n * fact(n - 1)", { fact_param, fact_call });
+	graph.add_node(fact_fn_reg, fact_mul);
+	set_fn_ref(graph, fact_mul, fact_fn);
 
-	NodeRef square_call = make_node(nodes, NodeType::CALL, "call_square", { square_fn, square_call_param });
-	cube_fn_reg->add_node(square_call);
-	set_fn_ref(nodes, square_call, cube_fn);
+	NodeRef fact_ret = make_node(graph, NodeType::RET, "fact_return", { fact_mul });
+	graph.add_node(fact_fn_reg, fact_ret);
+	set_fn_ref(graph, fact_ret, fact_fn);
 
-	NodeRef cube_mul = make_node(nodes, NodeType::MUL, "square(y) * y", { square_call, cube_param });
-	cube_fn_reg->add_node(cube_mul);
-	set_fn_ref(nodes, cube_mul, cube_fn);
+	/* fill(p) stores 0..3 to p in a counted loop, its control in the body; SCCP must keep the loop */
+	const RegionRef fill_fn_reg = graph.create_region("fill_function", RegionType::FUNCTION);
+	graph.add_child(root_region, fill_fn_reg);
 
-	NodeRef cube_ret = make_node(nodes, NodeType::RET, "cube_return", { cube_mul });
-	cube_fn_reg->add_node(cube_ret);
-	set_fn_ref(nodes, cube_ret, cube_fn);
+	const RegionRef fill_loop = graph.create_region("fill_loop", RegionType::LOOP_BODY);
+	graph.add_child(fill_fn_reg, fill_loop);
+	graph.set_imm_dominator(fill_loop, fill_fn_reg);
+
+	NodeRef fill_fn = make_node(graph, NodeType::FUNCTION, "fill");
+	graph.add_node(fill_fn_reg, fill_fn);
+
+	NodeRef fill_entry = make_node(graph, NodeType::ENTRY, "fill_entry");
+	graph.add_node(fill_fn_reg, fill_entry);
+	set_fn_ref(graph, fill_entry, fill_fn);
+
+	NodeRef fill_param = make_node(graph, NodeType::PARAM, "p", { fill_entry });
+	graph.add_node(fill_fn_reg, fill_param);
+	set_fn_ref(graph, fill_param, fill_fn);
+
+	NodeRef fill_zero = make_node(graph, NodeType::CONST, "zero");
+	set_const(graph, fill_zero, 0);
+	graph.add_node(fill_fn_reg, fill_zero);
+	set_fn_ref(graph, fill_zero, fill_fn);
+
+	NodeRef fill_one = make_node(graph, NodeType::CONST, "one");
+	set_const(graph, fill_one, 1);
+	graph.add_node(fill_fn_reg, fill_one);
+	set_fn_ref(graph, fill_one, fill_fn);
+
+	NodeRef fill_four = make_node(graph, NodeType::CONST, "four");
+	set_const(graph, fill_four, 4);
+	graph.add_node(fill_fn_reg, fill_four);
+	set_fn_ref(graph, fill_four, fill_fn);
+
+	NodeRef fill_i = make_node(graph, NodeType::PHI, "i", { fill_zero });
+	graph.add_node(fill_loop, fill_i);
+	set_fn_ref(graph, fill_i, fill_fn);
+
+	NodeRef fill_next = make_node(graph, NodeType::ADD, "i + 1", { fill_i, fill_one });
+	graph.add_node(fill_loop, fill_next);
+	set_fn_ref(graph, fill_next, fill_fn);
+	graph.add_input(fill_i, fill_next);
+
+	NodeRef fill_cmp = make_node(graph, NodeType::CMP, "i < four", { fill_i, fill_four });
+	graph.add_node(fill_loop, fill_cmp);
+	set_fn_ref(graph, fill_cmp, fill_fn);
+
+	NodeRef fill_control = make_node(graph, NodeType::CONTROL, "fill_control", { fill_cmp });
+	graph.add_node(fill_loop, fill_control);
+	set_fn_ref(graph, fill_control, fill_fn);
+	graph.set_ctrl_deps(fill_loop, fill_control);
+
+	NodeRef fill_store = make_node(graph, NodeType::PTR_STORE, "*p = i", { fill_param, fill_i });
+	graph.add_node(fill_loop, fill_store);
+	set_fn_ref(graph, fill_store, fill_fn);
+
+	NodeRef fill_ret = make_node(graph, NodeType::RET, "fill_return", { fill_zero });
+	graph.add_node(fill_fn_reg, fill_ret);
+	set_fn_ref(graph, fill_ret, fill_fn);
 
 	// Main function
-	NodeRef main_fn = make_node(nodes, NodeType::FUNCTION, "main");
-	main_fn_reg->add_node(main_fn);
+	NodeRef main_fn = make_node(graph, NodeType::FUNCTION, "main");
+	graph.add_node(main_fn_reg, main_fn);
+
+	NodeRef main_entry = make_node(graph, NodeType::ENTRY, "main_entry");
+	graph.add_node(main_fn_reg, main_entry);
+	set_fn_ref(graph, main_entry, main_fn);
+
+	NodeRef const5 = make_node(graph, NodeType::CONST, "const5");
+	set_const(graph, const5, 5);
+	graph.add_node(main_fn_reg, const5);
+
+	NodeRef const10 = make_node(graph, NodeType::CONST, "const10");
+	set_const(graph, const10, 10);
+	graph.add_node(main_fn_reg, const10);
+
+	NodeRef square_main_param = make_call_param(graph, main_fn, 0, const5);
+	graph.add_node(main_fn_reg, square_main_param);
+
+	NodeRef square_call_main = make_node(graph, NodeType::CALL, "call_square_main", { square_fn, square_main_param });
+	graph.add_node(main_fn_reg, square_call_main);
+	set_fn_ref(graph, square_call_main, main_fn);
+
+	NodeRef cube_main_param = make_call_param(graph, main_fn, 0, const10);
+	graph.add_node(main_fn_reg, cube_main_param);
 
-	NodeRef main_entry = make_node(nodes, NodeType::ENTRY, "main_entry");
-	main_fn_reg->add_node(main_entry);
-	set_fn_ref(nodes, main_entry, main_fn);
+	NodeRef cube_call_main = make_node(graph, NodeType::CALL, "call_cube_main", { cube_fn, cube_main_param });
+	graph.add_node(main_fn_reg, cube_call_main);
+	set_fn_ref(graph, cube_call_main, main_fn);
 
-	NodeRef const5 = make_node(nodes, NodeType::CONST, "const5");
-	set_const(nodes, const5, 5);
-	main_fn_reg->add_node(const5);
+	NodeRef add_results = make_node(graph, NodeType::ADD, "square(5) + cube(10)", { square_call_main, cube_call_main });
+	graph.add_node(main_fn_reg, add_results);
+	set_fn_ref(graph, add_results, main_fn);
 
-	NodeRef const10 = make_node(nodes, NodeType::CONST, "const10");
-	set_const(nodes, const10, 10);
-	main_fn_reg->add_node(const10);
+	NodeRef fact_main_param = make_call_param(graph, main_fn, 0, const5);
+	graph.add_node(main_fn_reg, fact_main_param);
 
-	NodeRef square_main_param = make_call_param(nodes, main_fn, 0, const5);
-	main_fn_reg->add_node(square_main_param);
+	NodeRef fact_call_main = make_node(graph, NodeType::CALL, "call_fact_main", { fact_fn, fact_main_param });
+	graph.add_node(main_fn_reg, fact_call_main);
+	set_fn_ref(graph, fact_call_main, main_fn);
 
-	NodeRef square_call_main = make_node(nodes, NodeType::CALL, "call_square_main", { square_fn, square_main_param });
-	main_fn_reg->add_node(square_call_main);
-	set_fn_ref(nodes, square_call_main, main_fn);
+	NodeRef add_fact = make_node(graph, NodeType::ADD, "... + fact(5)", { add_results, fact_call_main });
+	graph.add_node(main_fn_reg, add_fact);
+	set_fn_ref(graph, add_fact, main_fn);
 
-	NodeRef cube_main_param = make_call_param(nodes, main_fn, 0, const10);
-	main_fn_reg->add_node(cube_main_param);
+	NodeRef buffer = make_node(graph, NodeType::MALLOC, "buffer");
+	graph.add_node(main_fn_reg, buffer);
+	set_fn_ref(graph, buffer, main_fn);
 
-	NodeRef cube_call_main = make_node(nodes, NodeType::CALL, "call_cube_main", { cube_fn, cube_main_param });
-	main_fn_reg->add_node(cube_call_main);
-	set_fn_ref(nodes, cube_call_main, main_fn);
+	NodeRef fill_main_param = make_call_param(graph, main_fn, 0, buffer);
+	graph.add_node(main_fn_reg, fill_main_param);
 
-	NodeRef add_results = make_node(nodes, NodeType::ADD, "square(5) + cube(10)", { square_call_main, cube_call_main });
-	main_fn_reg->add_node(add_results);
-	set_fn_ref(nodes, add_results, main_fn);
+	NodeRef fill_call_main = make_node(graph, NodeType::CALL, "call_fill_main", { fill_fn, fill_main_param });
+	graph.add_node(main_fn_reg, fill_call_main);
+	set_fn_ref(graph, fill_call_main, main_fn);
 
-	NodeRef main_ret = make_node(nodes, NodeType::RET, "main_return", { add_results });
-	main_fn_reg->add_node(main_ret);
-	set_fn_ref(nodes, main_ret, main_fn);
+	NodeRef main_ret = make_node(graph, NodeType::RET, "main_return", { add_fact });
+	graph.add_node(main_fn_reg, main_ret);
+	set_fn_ref(graph, main_ret, main_fn);
 }
 
 int main()
 {
-	std::vector<std::unique_ptr<SproutNode<> > > nodes;
-	const auto root = std::make_shared<SproutRegion>("root");
-	root->set_type(RegionType::ROOT);
+	SproutGraph graph;
+	const RegionRef root = graph.create_region("root", RegionType::ROOT);
 
-	interproc_test_ir(nodes, root);
+	interproc_test_ir(graph, root);
 
 	std::cout << "before optimization IR:\n";
-	dump_ir(root, nodes);
+	dump_ir(root, graph);
 	std::cout << "\n";
 
 	auto ipa = std::make_shared<IPAPass>();
-	ipa->run(root, nodes);
+	ipa->run(root, graph);
 
 	std::cout << "\nIPA result:\n";
 	ipa->dump_results(true);
 	std::cout << "\n";
 
 	IPOPass ipo(ipa);
-	ipo.run(root, nodes);
+	ipo.run(root, graph);
 
 	std::cout << "\nIPO result: \n";
 	ipo.dump_results(true);
 	std::cout << "\n";
 
 	std::cout << "\noptimized IR after IPO\n";
-	dump_ir(root, nodes);
+	dump_ir(root, graph);
 	std::cout << "\n";
 	DCEPass dce;
-	dce.run(root, nodes);
+	dce.run(root, graph);
 
 	std::cout << "\nDCE after IPO:\n";
-	dce.dump_results(dce.get_dead_nodes(), nodes, root, true);
+	dce.dump_results(dce.get_dead_nodes(), graph, root, true);
 	std::cout << "\n";
 
 	std::cout << "\nafter cleanup:\n";
-	dump_ir(root, nodes);
+	dump_ir(root, graph);
 
 	return 0;
 }
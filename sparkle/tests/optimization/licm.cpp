@@ -0,0 +1,163 @@
+#include <iostream>
+#include <memory>
+#include <sparkle/sprout/passes/licm.hpp>
+#include <sparkle/sprout/passes/manager.hpp>
+#include <sparkle/sprout/utils/dump.hpp>
+
+using namespace sprk;
+
+NodeRef make_node(SproutGraph &graph,
+                  const NodeType type,
+                  const NodeRef fn,
+                  const RegionRef region,
+                  const std::string &name,
+                  const std::vector<NodeRef> &inputs = {})
+{
+	const NodeRef id = graph.create(type);
+	graph.set_name(id, name);
+	graph.set_fn_ref(id, fn);
+	graph.add_node(region, id);
+
+	for (const NodeRef input: inputs)
+		graph.add_input(id, input);
+
+	return id;
+}
+
+NodeRef make_memory_op(SproutGraph &graph,
+                       const NodeType type,
+                       const NodeRef fn,
+                       const RegionRef region,
+                       const std::string &name,
+                       const std::vector<NodeRef> &inputs)
+{
+	const NodeRef id = make_node(graph, type, fn, region, name, inputs);
+	graph.set_mem_obj(id, inputs[0]);
+	return id;
+}
+
+RegionRef make_loop(SproutGraph &graph, const RegionRef parent, const std::string &name, const NodeRef control)
+{
+	const RegionRef loop = graph.create_region(name, RegionType::LOOP_BODY);
+	graph.add_child(parent, loop);
+	graph.set_imm_dominator(loop, parent);
+	graph.set_ctrl_deps(loop, control);
+	return loop;
+}
+
+/*
+ *  $(ROOT)
+ *		-> fn      a, b, n; table = malloc, out = malloc, log = malloc
+ *			-> outer   i = phi(0, i + 1)
+ *				   a * b, (a * b) + n, a / 4 and load table are invariant
+ *				   i * a is not; store log <- i stays, store out <- a * b is sunk
+ *				-> inner   j = phi(0, j + 1)
+ *					   b - n leaves both loops, (b - n) * i only the inner one
+ *					   a / n stays; n may be zero
+ *		-> counted  a, n; out = malloc
+ *			-> loop    i = phi(0, i + 1), control = i < n
+ *				   store out <- a is sunk; the control in the body is false
+ *				   once the loop exits, so the exit runs under 0 < n
+ */
+void build_ir(SproutGraph &graph, const RegionRef root)
+{
+	const RegionRef fn_reg = graph.create_region("fn", RegionType::FUNCTION);
+	graph.add_child(root, fn_reg);
+
+	const NodeRef fn = make_node(graph, NodeType::FUNCTION, NULL_REF, fn_reg, "fn");
+	const NodeRef entry = make_node(graph, NodeType::ENTRY, fn, fn_reg, "entry");
+	const NodeRef a = make_node(graph, NodeType::PARAM, fn, fn_reg, "a", { entry });
+	const NodeRef b = make_node(graph, NodeType::PARAM, fn, fn_reg, "b", { entry });
+	const NodeRef n = make_node(graph, NodeType::PARAM, fn, fn_reg, "n", { entry });
+	const NodeRef table = make_node(graph, NodeType::MALLOC, fn, fn_reg, "table");
+	const NodeRef out = make_node(graph, NodeType::MALLOC, fn, fn_reg, "out");
+	const NodeRef log = make_node(graph, NodeType::MALLOC, fn, fn_reg, "log");
+	make_memory_op(graph, NodeType::STORE, fn, fn_reg, "init table", { table, a });
+
+	const NodeRef zero = make_node(graph, NodeType::CONST, fn, fn_reg, "zero");
+	graph.set_value(zero, int64_t { 0 });
+	const NodeRef one = make_node(graph, NodeType::CONST, fn, fn_reg, "one");
+	graph.set_value(one, int64_t { 1 });
+	const NodeRef four = make_node(graph, NodeType::CONST, fn, fn_reg, "four");
+	graph.set_value(four, int64_t { 4 });
+
+	const NodeRef outer_cond = make_node(graph, NodeType::CMP, fn, fn_reg, "0 < n", { zero, n });
+	const NodeRef outer_control = make_node(graph, NodeType::CONTROL, fn, fn_reg, "outer_control", { outer_cond });
+	const RegionRef outer = make_loop(graph, fn_reg, "outer", outer_control);
+
+	const NodeRef i = make_node(graph, NodeType::PHI, fn, outer, "i", { zero });
+	const NodeRef next_i = make_node(graph, NodeType::ADD, fn, outer, "i + 1", { i, one });
+	graph.add_input(i, next_i);
+
+	const NodeRef ab = make_node(graph, NodeType::MUL, fn, outer, "a * b", { a, b });
+	make_node(graph, NodeType::ADD, fn, outer, "(a * b) + n", { ab, n });
+	make_node(graph, NodeType::DIV, fn, outer, "a / 4", { a, four });
+	make_memory_op(graph, NodeType::LOAD, fn, outer, "load table", { table });
+	const NodeRef ia = make_node(graph, NodeType::MUL, fn, outer, "i * a", { i, a });
+	make_memory_op(graph, NodeType::STORE, fn, outer, "store log", { log, ia });
+	make_memory_op(graph, NodeType::STORE, fn, outer, "store out", { out, ab });
+
+	const NodeRef inner_cond = make_node(graph, NodeType::CMP, fn, outer, "i < n", { i, n });
+	const NodeRef inner_control = make_node(graph, NodeType::CONTROL, fn, outer, "inner_control", { inner_cond });
+	const RegionRef inner = make_loop(graph, outer, "inner", inner_control);
+
+	const NodeRef j = make_node(graph, NodeType::PHI, fn, inner, "j", { zero });
+	const NodeRef next_j = make_node(graph, NodeType::ADD, fn, inner, "j + 1", { j, one });
+	graph.add_input(j, next_j);
+
+	const NodeRef bn = make_node(graph, NodeType::SUB, fn, inner, "b - n", { b, n });
+	const NodeRef bni = make_node(graph, NodeType::MUL, fn, inner, "(b - n) * i", { bn, i });
+	const NodeRef an = make_node(graph, NodeType::DIV, fn, inner, "a / n", { a, n });
+	const NodeRef sum = make_node(graph, NodeType::ADD, fn, inner, "sum", { bni, an });
+	const NodeRef total = make_node(graph, NodeType::ADD, fn, inner, "sum + j", { sum, j });
+	make_memory_op(graph, NodeType::STORE, fn, inner, "store log", { log, total });
+
+	make_node(graph, NodeType::RET, fn, fn_reg, "ret", { a });
+
+	const RegionRef counted_reg = graph.create_region("counted", RegionType::FUNCTION);
+	graph.add_child(root, counted_reg);
+
+	const NodeRef counted = make_node(graph, NodeType::FUNCTION, NULL_REF, counted_reg, "counted");
+	const NodeRef counted_entry = make_node(graph, NodeType::ENTRY, counted, counted_reg, "entry");
+	const NodeRef ca = make_node(graph, NodeType::PARAM, counted, counted_reg, "a", { counted_entry });
+	const NodeRef cn = make_node(graph, NodeType::PARAM, counted, counted_reg, "n", { counted_entry });
+	const NodeRef counted_out = make_node(graph, NodeType::MALLOC, counted, counted_reg, "out");
+	const NodeRef counted_zero = make_node(graph, NodeType::CONST, counted, counted_reg, "zero");
+	graph.set_value(counted_zero, int64_t { 0 });
+	const NodeRef counted_one = make_node(graph, NodeType::CONST, counted, counted_reg, "one");
+	graph.set_value(counted_one, int64_t { 1 });
+
+	const RegionRef loop = make_loop(graph, counted_reg, "loop", NULL_REF);
+	const NodeRef ci = make_node(graph, NodeType::PHI, counted, loop, "i", { counted_zero });
+	const NodeRef next_ci = make_node(graph, NodeType::ADD, counted, loop, "i + 1", { ci, counted_one });
+	graph.add_input(ci, next_ci);
+	make_memory_op(graph, NodeType::STORE, counted, loop, "store out", { counted_out, ca });
+
+	const NodeRef loop_cond = make_node(graph, NodeType::CMP, counted, loop, "i < n", { ci, cn });
+	const NodeRef loop_control = make_node(graph, NodeType::CONTROL, counted, loop, "loop_control", { loop_cond });
+	graph.set_ctrl_deps(loop, loop_control);
+
+	make_node(graph, NodeType::RET, counted, counted_reg, "ret", { ca });
+}
+
+int main()
+{
+	SproutGraph graph;
+	const RegionRef root = graph.create_region("root", RegionType::ROOT);
+	build_ir(graph, root);
+
+	std::cout << "before LICM:\n";
+	dump_ir(root, graph);
+
+	/* the manager runs the alias analysis LICM asks for */
+	PassManager manager;
+	const auto licm = std::make_shared<LICMPass>(manager.alias());
+	manager.add(licm);
+	manager.run(root, graph);
+	licm->dump_results(graph);
+
+	std::cout << "\nafter LICM:\n";
+	dump_ir(root, graph);
+
+	return 0;
+}
@@ -0,0 +1,141 @@
+#include <iostream>
+#include <sparkle/sprout/passes/dce.hpp>
+#include <sparkle/sprout/passes/ipo.hpp>
+#include <sparkle/sprout/passes/manager.hpp>
+#include <sparkle/sprout/passes/pre.hpp>
+#include <sparkle/sprout/utils/dump.hpp>
+
+using namespace sprk;
+
+NodeRef make_node(SproutGraph &graph,
+                  const NodeType type,
+                  const NodeRef fn,
+                  const std::string &name,
+                  const std::vector<NodeRef> &inputs = {})
+{
+	const NodeRef id = graph.create(type);
+	graph.set_name(id, name);
+	graph.set_fn_ref(id, fn);
+
+	for (const NodeRef input: inputs)
+		graph.add_input(id, input);
+
+	return id;
+}
+
+/* reads the cached analyses without touching the graph */
+class ProbePass final : public SproutPass
+{
+public:
+	ProbePass(const char *label, const PassManager &manager) : label(label), manager(manager) {}
+
+	void run(RegionRef, SproutGraph &) override
+	{
+		std::cout << "  " << label << ": call graph callers "
+				<< manager.ipa()->get_results().call_graph.size()
+				<< ", memory issues " << manager.alias()->get_issues().size()
+				<< " | computed ipa " << manager.compute_count(AnalysisKind::IPA)
+				<< ", alias " << manager.compute_count(AnalysisKind::ALIAS)
+				<< ", dominators " << manager.compute_count(AnalysisKind::DOMINATORS) << "\n";
+	}
+
+	[[nodiscard]] AnalysisSet required_analyses() const override
+	{
+		return analysis_bit(AnalysisKind::IPA) | analysis_bit(AnalysisKind::ALIAS);
+	}
+
+	[[nodiscard]] AnalysisSet preserved_analyses() const override
+	{
+		return ALL_ANALYSES;
+	}
+
+private:
+	const char *label;
+	const PassManager &manager;
+};
+
+/* main calls square(5) and recomputes a + b in both arms of a branch */
+void build_module(SproutGraph &graph, const RegionRef root)
+{
+	const RegionRef square_reg = graph.create_region("square_function", RegionType::FUNCTION);
+	const RegionRef main_reg = graph.create_region("main_function", RegionType::FUNCTION);
+	const RegionRef then_reg = graph.create_region("then", RegionType::BRANCH_THEN);
+	const RegionRef else_reg = graph.create_region("else", RegionType::BRANCH_ELSE);
+	graph.add_child(root, square_reg);
+	graph.add_child(root, main_reg);
+	graph.add_child(main_reg, then_reg);
+	graph.add_child(main_reg, else_reg);
+	graph.set_imm_dominator(then_reg, main_reg);
+	graph.set_imm_dominator(else_reg, main_reg);
+
+	const NodeRef square = make_node(graph, NodeType::FUNCTION, NULL_REF, "square");
+	const NodeRef square_entry = make_node(graph, NodeType::ENTRY, square, "square_entry");
+	const NodeRef x = make_node(graph, NodeType::PARAM, square, "x", { square_entry });
+	const NodeRef x2 = make_node(graph, NodeType::MUL, square, "x * x", { x, x });
+	const NodeRef square_ret = make_node(graph, NodeType::RET, square, "square_return", { x2 });
+	for (const NodeRef n: { square, square_entry, x, x2, square_ret })
+		graph.add_node(square_reg, n);
+
+	const NodeRef main = make_node(graph, NodeType::FUNCTION, NULL_REF, "main");
+	const NodeRef entry = make_node(graph, NodeType::ENTRY, main, "main_entry");
+	const NodeRef a = make_node(graph, NodeType::PARAM, main, "a", { entry });
+	const NodeRef b = make_node(graph, NodeType::PARAM, main, "b", { entry });
+	const NodeRef five = make_node(graph, NodeType::CONST, main, "const5");
+	graph.set_value(five, static_cast<int64_t>(5));
+	const NodeRef idx = make_node(graph, NodeType::CONST, main, "param_idx_0");
+	graph.set_value(idx, static_cast<int64_t>(0));
+	const NodeRef arg = make_node(graph, NodeType::CALL_PARAM, main, "param_0", { idx, five });
+	const NodeRef call = make_node(graph, NodeType::CALL, main, "call_square", { square, arg });
+	const NodeRef unused = make_node(graph, NodeType::SUB, main, "unused", { a, b });
+	for (const NodeRef n: { main, entry, a, b, five, idx, arg, call, unused })
+		graph.add_node(main_reg, n);
+
+	const NodeRef sum_then = make_node(graph, NodeType::ADD, main, "a + b (then)", { a, b });
+	const NodeRef sum_else = make_node(graph, NodeType::ADD, main, "a + b (else)", { a, b });
+	graph.add_node(then_reg, sum_then);
+	graph.add_node(else_reg, sum_else);
+
+	const NodeRef total = make_node(graph, NodeType::ADD, main, "total", { sum_then, sum_else });
+	const NodeRef result = make_node(graph, NodeType::MUL, main, "total * square(5)", { total, call });
+	const NodeRef ret = make_node(graph, NodeType::RET, main, "main_return", { result });
+	for (const NodeRef n: { total, result, ret })
+		graph.add_node(main_reg, n);
+}
+
+int main()
+{
+	SproutGraph graph;
+	const RegionRef root = graph.create_region("root", RegionType::ROOT);
+	build_module(graph, root);
+
+	std::cout << "before:\n";
+	dump_ir(root, graph);
+
+	PassManager manager;
+	manager.add(std::make_shared<ProbePass>("probe 1 (cold)", manager));
+	manager.add(std::make_shared<ProbePass>("probe 2 (cached)", manager));
+	manager.add(std::make_shared<DCEPass>());
+	manager.add(std::make_shared<ProbePass>("probe 3 (after dce, preserved)", manager));
+	manager.add(std::make_shared<IPOPass>(manager.ipa()));
+	manager.add(std::make_shared<ProbePass>("probe 4 (after ipo, recomputed)", manager));
+	manager.add(std::make_shared<PREPass>());
+	manager.add(std::make_shared<ProbePass>("probe 5 (after pre, recomputed)", manager));
+
+	std::cout << "\npipeline:\n";
+	manager.run(root, graph);
+
+	std::cout << "\nvalid after run: ipa " << manager.is_valid(AnalysisKind::IPA)
+			<< ", alias " << manager.is_valid(AnalysisKind::ALIAS)
+			<< ", dominators " << manager.is_valid(AnalysisKind::DOMINATORS) << "\n";
+
+	manager.invalidate(ALL_ANALYSES);
+	manager.compute(analysis_bit(AnalysisKind::IPA), root, graph);
+	std::cout << "after invalidate + compute(ipa): ipa " << manager.is_valid(AnalysisKind::IPA)
+			<< " (computed " << manager.compute_count(AnalysisKind::IPA) << "), alias "
+			<< manager.is_valid(AnalysisKind::ALIAS) << "\n";
+
+	std::cout << "\nafter:\n";
+	dump_ir(root, graph);
+
+	return 0;
+}
@@ -0,0 +1,231 @@
+#include <atomic>
+#include <iostream>
+#include <sparkle/sprout/passes/dce.hpp>
+#include <sparkle/sprout/passes/function.hpp>
+#include <sparkle/sprout/passes/pre.hpp>
+
+using namespace sprk;
+
+constexpr NodeRef FUNCTION_COUNT = 200;
+
+NodeRef make_node(SproutGraph &graph,
+                  const NodeType type,
+                  const NodeRef fn,
+                  const std::string &name,
+                  const std::vector<NodeRef> &inputs = {})
+{
+	const NodeRef id = graph.create(type);
+	graph.set_name(id, name);
+	graph.set_fn_ref(id, fn);
+
+	for (const NodeRef input: inputs)
+		graph.add_input(id, input);
+
+	return id;
+}
+
+/*
+ * every function recomputes a + b in both arms of a branch, keeps a dead
+ * SUB around and calls the previous function; a few nodes sit in the root
+ * region, outside every function
+ */
+void build_module(SproutGraph &graph, const RegionRef root)
+{
+	NodeRef prev_fn = NULL_REF;
+	for (NodeRef f = 0; f < FUNCTION_COUNT; f++)
+	{
+		const RegionRef fn_reg = graph.create_region("fn" + std::to_string(f), RegionType::FUNCTION);
+		const RegionRef then_reg = graph.create_region("then", RegionType::BRANCH_THEN);
+		const RegionRef else_reg = graph.create_region("else", RegionType::BRANCH_ELSE);
+		graph.add_child(root, fn_reg);
+		graph.add_child(fn_reg, then_reg);
+		graph.add_child(fn_reg, else_reg);
+		graph.set_imm_dominator(then_reg, fn_reg);
+		graph.set_imm_dominator(else_reg, fn_reg);
+
+		const NodeRef fn = make_node(graph, NodeType::FUNCTION, NULL_REF, "fn" + std::to_string(f));
+		const NodeRef entry = make_node(graph, NodeType::ENTRY, fn, "entry");
+		const NodeRef a = make_node(graph, NodeType::PARAM, fn, "a", { entry });
+		const NodeRef b = make_node(graph, NodeType::PARAM, fn, "b", { entry });
+		const NodeRef dead = make_node(graph, NodeType::SUB, fn, "dead", { a, b });
+		for (const NodeRef n: { fn, entry, a, b, dead })
+			graph.add_node(fn_reg, n);
+
+		NodeRef value = a;
+		if (prev_fn != NULL_REF)
+		{
+			const NodeRef arg = make_node(graph, NodeType::CALL_PARAM, fn, "param_0", { a });
+			value = make_node(graph, NodeType::CALL, fn, "call", { prev_fn, arg });
+			graph.add_node(fn_reg, arg);
+			graph.add_node(fn_reg, value);
+		}
+
+		const NodeRef sum_then = make_node(graph, NodeType::ADD, fn, "a + b", { a, b });
+		const NodeRef sum_else = make_node(graph, NodeType::ADD, fn, "b + a", { b, a });
+		graph.add_node(then_reg, sum_then);
+		graph.add_node(else_reg, sum_else);
+
+		const NodeRef total = make_node(graph, NodeType::MUL, fn, "total", { sum_then, sum_else });
+		const NodeRef result = make_node(graph, NodeType::ADD, fn, "result", { total, value });
+		const NodeRef ret = make_node(graph, NodeType::RET, fn, "ret", { result });
+		for (const NodeRef n: { total, result, ret })
+			graph.add_node(fn_reg, n);
+
+		prev_fn = fn;
+	}
+
+	const NodeRef code = make_node(graph, NodeType::CONST, NULL_REF, "exit_code");
+	graph.set_value(code, static_cast<int64_t>(0));
+	const NodeRef exit = make_node(graph, NodeType::EXIT, NULL_REF, "exit", { code });
+	const NodeRef unused = make_node(graph, NodeType::CONST, NULL_REF, "unused_global");
+	for (const NodeRef n: { code, exit, unused })
+		graph.add_node(root, n);
+}
+
+/* the whole-module mark DCE did before it was split by function */
+std::vector<NodeRef> reference_dead_nodes(const SproutGraph &graph)
+{
+	std::vector<uint8_t> alive(graph.size(), 0);
+	std::vector<NodeRef> worklist;
+	for (NodeRef i = 0; i < graph.size(); i++)
+	{
+		if (graph.contains(i) && (graph.type(i) == NodeType::RET || graph.type(i) == NodeType::EXIT))
+		{
+			alive[i] = 1;
+			worklist.push_back(i);
+		}
+	}
+
+	while (!worklist.empty())
+	{
+		const NodeRef curr = worklist.back();
+		worklist.pop_back();
+		for (const NodeRef input: graph.inputs(curr))
+		{
+			if (graph.contains(input) && !alive[input])
+			{
+				alive[input] = 1;
+				worklist.push_back(input);
+			}
+		}
+	}
+
+	std::vector<NodeRef> dead;
+	for (NodeRef i = 0; i < graph.size(); i++)
+	{
+		if (graph.contains(i) && !alive[i])
+			dead.push_back(i);
+	}
+
+	return dead;
+}
+
+bool same_nodes(const NodeSpan a, const std::vector<NodeRef> &b)
+{
+	return std::equal(a.begin(), a.end(), b.begin(), b.end());
+}
+
+bool same_graph(const SproutGraph &a, const SproutGraph &b)
+{
+	if (a.size() != b.size())
+		return false;
+
+	for (NodeRef i = 0; i < a.size(); i++)
+	{
+		if (a.contains(i) != b.contains(i) || a.type(i) != b.type(i) ||
+		    a.region_of(i) != b.region_of(i) || a.name(i) != b.name(i))
+			return false;
+
+		const NodeSpan ai = a.inputs(i), bi = b.inputs(i);
+		const NodeSpan au = a.users(i), bu = b.users(i);
+		if (!std::equal(ai.begin(), ai.end(), bi.begin(), bi.end()) ||
+		    !std::equal(au.begin(), au.end(), bu.begin(), bu.end()))
+			return false;
+	}
+
+	return true;
+}
+
+const char *yes_no(const bool value)
+{
+	return value ? "yes" : "no";
+}
+
+void test_pool()
+{
+	std::cout << "work-stealing pool:\n";
+
+	/* task cost grows with the index so the first workers run dry early and steal */
+	constexpr size_t TASKS = 1000;
+	std::vector<std::atomic<uint32_t> > runs(TASKS);
+	std::atomic<uint64_t> sum = 0;
+
+	WorkStealingPool pool(4);
+	for (int batch = 0; batch < 3; batch++)
+	{
+		pool.run(TASKS, [&](const size_t task, unsigned)
+		{
+			uint64_t local = 0;
+			for (size_t i = 0; i < task * 50; i++)
+				local += i % 7;
+			sum += local;
+			runs[task]++;
+		});
+	}
+
+	bool once_per_batch = true;
+	for (const auto &count: runs)
+		once_per_batch &= count == 3;
+
+	std::cout << "  workers: " << pool.size() << ", batches: 3, tasks per batch: " << TASKS << "\n";
+	std::cout << "  every task ran once per batch: " << yes_no(once_per_batch) << "\n";
+}
+
+void test_driver(const unsigned threads)
+{
+	SproutGraph serial, parallel;
+	const RegionRef serial_root = serial.create_region("root", RegionType::ROOT);
+	const RegionRef parallel_root = parallel.create_region("root", RegionType::ROOT);
+	build_module(serial, serial_root);
+	build_module(parallel, parallel_root);
+
+	FunctionPassDriver one(1);
+	FunctionPassDriver many(threads);
+
+	DCEPass dce_serial, dce_parallel;
+	one.run(dce_serial, serial_root, serial);
+	many.run(dce_parallel, parallel_root, parallel);
+
+	std::cout << "\n" << threads << " threads vs 1 over " << FUNCTION_COUNT << " functions:\n";
+	std::cout << "  dce dead nodes: " << dce_parallel.get_dead_nodes().size() << "\n";
+	std::cout << "  dce matches whole-module mark: "
+			<< yes_no(same_nodes(dce_parallel.get_dead_nodes(), reference_dead_nodes(parallel))) << "\n";
+	std::cout << "  dce matches serial driver: "
+			<< yes_no(dce_parallel.get_alive_nodes() == dce_serial.get_alive_nodes()) << "\n";
+
+	PREPass pre_serial, pre_parallel;
+	one.run(pre_serial, serial_root, serial);
+	many.run(pre_parallel, parallel_root, parallel);
+
+	bool same_results = pre_serial.get_results().size() == pre_parallel.get_results().size();
+	for (size_t i = 0; same_results && i < pre_serial.get_results().size(); i++)
+	{
+		const PREResult &s = pre_serial.get_results()[i];
+		const PREResult &p = pre_parallel.get_results()[i];
+		same_results = s.original_node == p.original_node && s.hoisted_node == p.hoisted_node &&
+		               s.target_region == p.target_region && s.instances_removed == p.instances_removed;
+	}
+
+	std::cout << "  pre hoisted: " << pre_parallel.get_results().size() << "\n";
+	std::cout << "  first hoist: " << pre_parallel.get_results().front().to_string(parallel) << "\n";
+	std::cout << "  pre results match serial driver: " << yes_no(same_results) << "\n";
+	std::cout << "  graphs identical after merge: " << yes_no(same_graph(serial, parallel)) << "\n";
+}
+
+int main()
+{
+	test_pool();
+	test_driver(2);
+	test_driver(8);
+	return 0;
+}
@@ -0,0 +1,166 @@
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <sparkle/sprout/passes/ipa.hpp>
+#include <sparkle/sprout/passes/ipo.hpp>
+#include <sparkle/sprout/utils/dump.hpp>
+#include <sparkle/sprout/utils/profile.hpp>
+
+using namespace sprk;
+
+NodeRef make_node(SproutGraph &graph,
+                  const NodeType type,
+                  const NodeRef fn,
+                  const RegionRef region,
+                  const std::string &name,
+                  const std::vector<NodeRef> &inputs = {})
+{
+	const NodeRef id = graph.create(type);
+	graph.set_name(id, name);
+	graph.set_fn_ref(id, fn);
+	if (region != NULL_REGION)
+		graph.add_node(region, id);
+
+	for (const NodeRef input: inputs)
+		graph.add_input(id, input);
+
+	return id;
+}
+
+NodeRef make_const(SproutGraph &graph, const NodeRef fn, const RegionRef region, const std::string &name,
+                   const int64_t value)
+{
+	const NodeRef id = make_node(graph, NodeType::CONST, fn, region, name);
+	graph.set_value(id, value);
+	return id;
+}
+
+/* f(x) = x + 1, then `steps` more rounds of * 2 + 3 */
+NodeRef make_function(SproutGraph &graph, const RegionRef root, const std::string &name, const int steps)
+{
+	const RegionRef region = graph.create_region(name + "_function", RegionType::FUNCTION);
+	graph.add_child(root, region);
+
+	const NodeRef fn = make_node(graph, NodeType::FUNCTION, NULL_REF, region, name);
+	const NodeRef entry = make_node(graph, NodeType::ENTRY, fn, region, name + "_entry");
+	const NodeRef x = make_node(graph, NodeType::PARAM, fn, region, "x", { entry });
+
+	NodeRef value = make_node(graph, NodeType::ADD, fn, region, "x + 1", { x, make_const(graph, fn, region, "one", 1) });
+	for (int i = 0; i < steps; i++)
+	{
+		value = make_node(graph, NodeType::MUL, fn, region, "* 2", { value, make_const(graph, fn, region, "two", 2) });
+		value = make_node(graph, NodeType::ADD, fn, region, "+ 3", { value, make_const(graph, fn, region, "three", 3) });
+	}
+
+	make_node(graph, NodeType::RET, fn, region, name + "_return", { value });
+	return fn;
+}
+
+NodeRef make_call(SproutGraph &graph, const NodeRef fn, const RegionRef region, const NodeRef callee,
+                  const std::string &name, const NodeRef arg)
+{
+	const NodeRef index = make_const(graph, fn, NULL_REGION, "param_idx_0", 0);
+	const NodeRef param = make_node(graph, NodeType::CALL_PARAM, fn, region, "param_0", { index, arg });
+	return make_node(graph, NodeType::CALL, fn, region, name, { callee, param });
+}
+
+struct Module
+{
+	NodeRef hot_call;
+	NodeRef cold_call;
+	RegionRef loop_block;
+};
+
+/*
+ *  $(ROOT)
+ *		-> main    a = hot(n)        called 100000 times
+ *			   b = cold(n)       never called
+ *			   c = tiny(n)       x + 1; inlining it shrinks main
+ *			-> loop_block        ran 5000 times
+ *				d = warm(n)  no count of its own; takes the block's
+ *		   return a + b + c + d
+ *		-> hot, cold, warm: x + 1, then two rounds of * 2 + 3
+ *		-> tiny: x + 1
+ *  the profile also holds a call past main's last and a function that is
+ *  gone; both are reported stale
+ */
+Module build_ir(SproutGraph &graph, const RegionRef root)
+{
+	const RegionRef main_reg = graph.create_region("main_function", RegionType::FUNCTION);
+	graph.add_child(root, main_reg);
+
+	const NodeRef hot = make_function(graph, root, "hot", 2);
+	const NodeRef cold = make_function(graph, root, "cold", 2);
+	const NodeRef warm = make_function(graph, root, "warm", 2);
+	const NodeRef tiny = make_function(graph, root, "tiny", 0);
+
+	const NodeRef fn = make_node(graph, NodeType::FUNCTION, NULL_REF, main_reg, "main");
+	const NodeRef entry = make_node(graph, NodeType::ENTRY, fn, main_reg, "main_entry");
+	const NodeRef n = make_node(graph, NodeType::PARAM, fn, main_reg, "n", { entry });
+
+	const RegionRef loop_block = graph.create_region("loop_block", RegionType::BASIC_BLOCK);
+	graph.add_child(main_reg, loop_block);
+	graph.set_imm_dominator(loop_block, main_reg);
+
+	Module module {};
+	module.hot_call = make_call(graph, fn, main_reg, hot, "call_hot", n);
+	module.cold_call = make_call(graph, fn, main_reg, cold, "call_cold", n);
+	module.loop_block = loop_block;
+
+	const NodeRef tiny_call = make_call(graph, fn, main_reg, tiny, "call_tiny", n);
+	const NodeRef warm_call = make_call(graph, fn, loop_block, warm, "call_warm", n);
+
+	NodeRef sum = make_node(graph, NodeType::ADD, fn, loop_block, "a + b", { module.hot_call, module.cold_call });
+	sum = make_node(graph, NodeType::ADD, fn, loop_block, "+ c", { sum, tiny_call });
+	sum = make_node(graph, NodeType::ADD, fn, loop_block, "+ d", { sum, warm_call });
+	make_node(graph, NodeType::RET, fn, loop_block, "main_return", { sum });
+
+	return module;
+}
+
+int main()
+{
+	SproutGraph graph;
+	const RegionRef root = graph.create_region("root", RegionType::ROOT);
+	const Module module = build_ir(graph, root);
+
+	std::cout << "before IPO:\n";
+	dump_ir(root, graph);
+
+	/* what an instrumented build would write */
+	ProfileData recorded;
+	recorded.add_call(graph, module.hot_call, 100000);
+	recorded.add_call(graph, module.cold_call, 0);
+	recorded.add_region(graph, module.loop_block, 5000);
+
+	/* and records of an older build, where main had more calls and `gone` still existed */
+	std::stringstream file;
+	recorded.write(file);
+	file << "call 9 50 main\nregion 0 10 gone\n";
+	std::cout << "\nprofile:\n" << file.str();
+
+	const auto profile = std::make_shared<ProfileData>();
+	std::cout << "read back: " << (profile->read(file) ? "ok" : "malformed") << "\n";
+
+	std::stringstream broken("call 3 12 main\nregion x 4 main\n");
+	std::cout << "a bad region ref: " << (ProfileData().read(broken) ? "ok" : "malformed") << "\n";
+
+	auto ipa = std::make_shared<IPAPass>();
+	ipa->set_profile(profile);
+	ipa->run(root, graph);
+
+	std::cout << "\nIPA result:\n";
+	ipa->dump_results(true);
+
+	/* room for one of hot and warm, which cost the same; the hotter goes in */
+	IPOPass ipo(ipa, 0, 8);
+	ipo.run(root, graph);
+
+	std::cout << "\nIPO result:\n";
+	ipo.dump_results(true);
+
+	std::cout << "\nafter IPO:\n";
+	dump_ir(root, graph);
+
+	return 0;
+}
@@ -5,175 +5,243 @@
 
 using namespace sprk;
 
-NodeRef make_node(std::vector<std::unique_ptr<SproutNode<>>> &nodes,
+NodeRef make_node(SproutGraph &graph,
                   const NodeType type,
                   const std::string &name = "",
                   const std::vector<NodeRef> &inputs = {})
 {
-    const auto id = static_cast<NodeRef>(nodes.size());
-    auto node = std::make_unique<SproutNode<>>();
-
-    node->id = id;
-    node->type = type;
-    node->input_count = 0;
-    node->user_count = 0;
+    const NodeRef id = graph.create(type);
 
     if (!name.empty())
-        node->string_id = reinterpret_cast<uint64_t>(strdup(name.c_str()));
+        graph.set_name(id, name);
 
     for (const NodeRef input: inputs)
     {
-        if (input < nodes.size() && nodes[input] && node->input_count < 4)
-        {
-            node->inputs[node->input_count++] = input;
-            if (nodes[input]->user_count < 4)
-                nodes[input]->users[nodes[input]->user_count++] = id;
-        }
+        if (graph.contains(input))
+            graph.add_input(id, input);
     }
 
-    nodes.push_back(std::move(node));
     return id;
 }
 
-void set_const(const std::vector<std::unique_ptr<SproutNode<>>> &nodes,
+void set_const(SproutGraph &graph,
                const NodeRef node_ref,
                int64_t value)
 {
-    if (node_ref < nodes.size() && nodes[node_ref])
-        nodes[node_ref]->value = value;
+    if (graph.contains(node_ref))
+        graph.set_value(node_ref, value);
 }
 
-void set_fn_ref(const std::vector<std::unique_ptr<SproutNode<>>> &nodes,
+void set_fn_ref(SproutGraph &graph,
                 const NodeRef node_ref,
                 const NodeRef fn_ref)
 {
-    if (node_ref < nodes.size() && nodes[node_ref])
-        nodes[node_ref]->fn_ref = fn_ref;
+    if (graph.contains(node_ref))
+        graph.set_fn_ref(node_ref, fn_ref);
 }
 
-void pre_test_ir(std::vector<std::unique_ptr<SproutNode<>>> &nodes,
-                 const std::shared_ptr<SproutRegion> &root_region)
+void pre_test_ir(SproutGraph &graph,
+                 const RegionRef root_region)
 {
-    auto function_region = std::make_shared<SproutRegion>("test_function");
-    function_region->set_type(RegionType::FUNCTION);
-    root_region->add_child(function_region);
-
-    auto entry_region = std::make_shared<SproutRegion>("entry");
-    entry_region->set_type(RegionType::BASIC_BLOCK);
-    function_region->add_child(entry_region);
-
-    auto if_condition_region = std::make_shared<SproutRegion>("if_condition");
-    if_condition_region->set_type(RegionType::BASIC_BLOCK);
-    function_region->add_child(if_condition_region);
-
-    auto then_region = std::make_shared<SproutRegion>("then_branch");
-    then_region->set_type(RegionType::BRANCH_THEN);
-    function_region->add_child(then_region);
-
-    auto else_region = std::make_shared<SproutRegion>("else_branch");
-    else_region->set_type(RegionType::BRANCH_ELSE);
-    function_region->add_child(else_region);
-
-    auto exit_region = std::make_shared<SproutRegion>("exit");
-    exit_region->set_type(RegionType::BASIC_BLOCK);
-    function_region->add_child(exit_region);
-
-    entry_region->set_imm_dominator(function_region);
-    if_condition_region->set_imm_dominator(entry_region);
-    then_region->set_imm_dominator(if_condition_region);
-    else_region->set_imm_dominator(if_condition_region);
-    exit_region->set_imm_dominator(if_condition_region);
-
-    NodeRef function_node = make_node(nodes, NodeType::FUNCTION, "test_function");
-    function_region->add_node(function_node);
-
-    NodeRef entry_node = make_node(nodes, NodeType::ENTRY, "entry");
-    entry_region->add_node(entry_node);
-    set_fn_ref(nodes, entry_node, function_node);
-
-    NodeRef param_a = make_node(nodes, NodeType::PARAM, "a", {entry_node});
-    NodeRef param_b = make_node(nodes, NodeType::PARAM, "b", {entry_node});
-    entry_region->add_node(param_a);
-    entry_region->add_node(param_b);
-    set_fn_ref(nodes, param_a, function_node);
-    set_fn_ref(nodes, param_b, function_node);
-
-    NodeRef const_10 = make_node(nodes, NodeType::CONST, "const10");
-    set_const(nodes, const_10, 10);
-    entry_region->add_node(const_10);
-
-    NodeRef condition = make_node(nodes, NodeType::CMP, "a < b", {param_a, param_b});
-    if_condition_region->add_node(condition);
-    set_fn_ref(nodes, condition, function_node);
-
-    const NodeRef control = make_node(nodes, NodeType::CONTROL, "if_control", {condition});
-    if_condition_region->add_node(control);
-    set_fn_ref(nodes, control, function_node);
-    then_region->set_ctrl_deps(control);
-    else_region->set_ctrl_deps(control);
-
-    NodeRef mul_then = make_node(nodes, NodeType::MUL, "a * 10 (then)", {param_a, const_10});
-    then_region->add_node(mul_then);
-    set_fn_ref(nodes, mul_then, function_node);
-
-    NodeRef add_then = make_node(nodes, NodeType::ADD, "a*10 + b (then)", {mul_then, param_b});
-    then_region->add_node(add_then);
-    set_fn_ref(nodes, add_then, function_node);
+    const RegionRef function_region = graph.create_region("test_function", RegionType::FUNCTION);
+    graph.add_child(root_region, function_region);
+
+    const RegionRef entry_region = graph.create_region("entry", RegionType::BASIC_BLOCK);
+    graph.add_child(function_region, entry_region);
+
+    const RegionRef if_condition_region = graph.create_region("if_condition", RegionType::BASIC_BLOCK);
+    graph.add_child(function_region, if_condition_region);
+
+    const RegionRef then_region = graph.create_region("then_branch", RegionType::BRANCH_THEN);
+    graph.add_child(function_region, then_region);
+
+    const RegionRef else_region = graph.create_region("else_branch", RegionType::BRANCH_ELSE);
+    graph.add_child(function_region, else_region);
+
+    const RegionRef exit_region = graph.create_region("exit", RegionType::BASIC_BLOCK);
+    graph.add_child(function_region, exit_region);
+
+    graph.set_imm_dominator(entry_region, function_region);
+    graph.set_imm_dominator(if_condition_region, entry_region);
+    graph.set_imm_dominator(then_region, if_condition_region);
+    graph.set_imm_dominator(else_region, if_condition_region);
+    graph.set_imm_dominator(exit_region, if_condition_region);
+
+    NodeRef function_node = make_node(graph, NodeType::FUNCTION, "test_function");
+    graph.add_node(function_region, function_node);
+
+    NodeRef entry_node = make_node(graph, NodeType::ENTRY, "entry");
+    graph.add_node(entry_region, entry_node);
+    set_fn_ref(graph, entry_node, function_node);
+
+    NodeRef param_a = make_node(graph, NodeType::PARAM, "a", {entry_node});
+    NodeRef param_b = make_node(graph, NodeType::PARAM, "b", {entry_node});
+    graph.add_node(entry_region, param_a);
+    graph.add_node(entry_region, param_b);
+    set_fn_ref(graph, param_a, function_node);
+    set_fn_ref(graph, param_b, function_node);
+
+    NodeRef const_10 = make_node(graph, NodeType::CONST, "const10");
+    set_const(graph, const_10, 10);
+    graph.add_node(entry_region, const_10);
+
+    NodeRef condition = make_node(graph, NodeType::CMP, "a < b", {param_a, param_b});
+    graph.add_node(if_condition_region, condition);
+    set_fn_ref(graph, condition, function_node);
+
+    const NodeRef control = make_node(graph, NodeType::CONTROL, "if_control", {condition});
+    graph.add_node(if_condition_region, control);
+    set_fn_ref(graph, control, function_node);
+    graph.set_ctrl_deps(then_region, control);
+    graph.set_ctrl_deps(else_region, control);
+
+    NodeRef mul_then = make_node(graph, NodeType::MUL, "a * 10 (then)", {param_a, const_10});
+    graph.add_node(then_region, mul_then);
+    set_fn_ref(graph, mul_then, function_node);
+
+    NodeRef add_then = make_node(graph, NodeType::ADD, "a*10 + b (then)", {mul_then, param_b});
+    graph.add_node(then_region, add_then);
+    set_fn_ref(graph, add_then, function_node);
 
     // Create same redundant computation in else branch: a * 10
-    NodeRef mul_else = make_node(nodes, NodeType::MUL, "a * 10 (else)", {param_a, const_10});
-    else_region->add_node(mul_else);
-    set_fn_ref(nodes, mul_else, function_node);
+    NodeRef mul_else = make_node(graph, NodeType::MUL, "a * 10 (else)", {param_a, const_10});
+    graph.add_node(else_region, mul_else);
+    set_fn_ref(graph, mul_else, function_node);
 
-    NodeRef sub_else = make_node(nodes, NodeType::SUB, "a*10 - b (else)", {mul_else, param_b});
-    else_region->add_node(sub_else);
-    set_fn_ref(nodes, sub_else, function_node);
+    NodeRef sub_else = make_node(graph, NodeType::SUB, "a*10 - b (else)", {mul_else, param_b});
+    graph.add_node(else_region, sub_else);
+    set_fn_ref(graph, sub_else, function_node);
 
-    NodeRef phi_result = make_node(nodes, NodeType::PHI, "result_phi", {add_then, sub_else});
-    exit_region->add_node(phi_result);
-    set_fn_ref(nodes, phi_result, function_node);
+    NodeRef phi_result = make_node(graph, NodeType::PHI, "result_phi", {add_then, sub_else});
+    graph.add_node(exit_region, phi_result);
+    set_fn_ref(graph, phi_result, function_node);
 
-    NodeRef mul_exit = make_node(nodes, NodeType::MUL, "a * 10 (exit)", {param_a, const_10});
-    exit_region->add_node(mul_exit);
-    set_fn_ref(nodes, mul_exit, function_node);
+    NodeRef mul_exit = make_node(graph, NodeType::MUL, "a * 10 (exit)", {param_a, const_10});
+    graph.add_node(exit_region, mul_exit);
+    set_fn_ref(graph, mul_exit, function_node);
 
-    NodeRef add_exit = make_node(nodes, NodeType::ADD, "phi + a*10", {phi_result, mul_exit});
-    exit_region->add_node(add_exit);
-    set_fn_ref(nodes, add_exit, function_node);
+    NodeRef add_exit = make_node(graph, NodeType::ADD, "phi + a*10", {phi_result, mul_exit});
+    graph.add_node(exit_region, add_exit);
+    set_fn_ref(graph, add_exit, function_node);
 
-    NodeRef ret_node = make_node(nodes, NodeType::RET, "return", {add_exit});
-    exit_region->add_node(ret_node);
-    set_fn_ref(nodes, ret_node, function_node);
+    NodeRef ret_node = make_node(graph, NodeType::RET, "return", {add_exit});
+    graph.add_node(exit_region, ret_node);
+    set_fn_ref(graph, ret_node, function_node);
+}
+
+/* a + b on the then path and again after the join; the else path never had it */
+void partial_test_ir(SproutGraph &graph,
+                     const RegionRef root_region)
+{
+    const RegionRef function_region = graph.create_region("partial_function", RegionType::FUNCTION);
+    graph.add_child(root_region, function_region);
+
+    const RegionRef entry_region = graph.create_region("entry", RegionType::BASIC_BLOCK);
+    graph.add_child(function_region, entry_region);
+
+    const RegionRef then_region = graph.create_region("then_only", RegionType::BRANCH_THEN);
+    graph.add_child(function_region, then_region);
+
+    const RegionRef exit_region = graph.create_region("exit", RegionType::BASIC_BLOCK);
+    graph.add_child(function_region, exit_region);
+
+    graph.set_imm_dominator(entry_region, function_region);
+    graph.set_imm_dominator(then_region, entry_region);
+    graph.set_imm_dominator(exit_region, entry_region);
+
+    NodeRef function_node = make_node(graph, NodeType::FUNCTION, "partial_function");
+    graph.add_node(function_region, function_node);
+
+    NodeRef entry_node = make_node(graph, NodeType::ENTRY, "entry");
+    NodeRef param_a = make_node(graph, NodeType::PARAM, "a", {entry_node});
+    NodeRef param_b = make_node(graph, NodeType::PARAM, "b", {entry_node});
+    NodeRef condition = make_node(graph, NodeType::CMP, "a < b", {param_a, param_b});
+    const NodeRef control = make_node(graph, NodeType::CONTROL, "if_control", {condition});
+    for (const NodeRef node_ref : {entry_node, param_a, param_b, condition, control})
+    {
+        graph.add_node(entry_region, node_ref);
+        set_fn_ref(graph, node_ref, function_node);
+    }
+    graph.set_ctrl_deps(then_region, control);
+
+    NodeRef add_then = make_node(graph, NodeType::ADD, "a + b (then)", {param_a, param_b});
+    NodeRef double_then = make_node(graph, NodeType::MUL, "(a+b) * b (then)", {add_then, param_b});
+    for (const NodeRef node_ref : {add_then, double_then})
+    {
+        graph.add_node(then_region, node_ref);
+        set_fn_ref(graph, node_ref, function_node);
+    }
+
+    NodeRef phi_result = make_node(graph, NodeType::PHI, "result_phi", {double_then, param_a, control});
+    NodeRef add_exit = make_node(graph, NodeType::ADD, "a + b (exit)", {param_a, param_b});
+    NodeRef sum = make_node(graph, NodeType::SUB, "phi - (a+b)", {phi_result, add_exit});
+    NodeRef ret_node = make_node(graph, NodeType::RET, "return", {sum});
+    for (const NodeRef node_ref : {phi_result, add_exit, sum, ret_node})
+    {
+        graph.add_node(exit_region, node_ref);
+        set_fn_ref(graph, node_ref, function_node);
+    }
 }
 
 int main()
 {
-    std::vector<std::unique_ptr<SproutNode<>>> nodes;
-    const auto root = std::make_shared<SproutRegion>("root");
-    root->set_type(RegionType::ROOT);
+    SproutGraph graph;
+    const RegionRef root = graph.create_region("root", RegionType::ROOT);
 
-    pre_test_ir(nodes, root);
+    pre_test_ir(graph, root);
 
     std::cout << "original:\n";
-    dump_ir(root, nodes);
+    dump_ir(root, graph);
     std::cout << "\n";
 
     PREPass pre;
-    pre.run(root, nodes);
+    pre.run(root, graph);
 
     std::cout << "\nbefore PRE:\n";
-    pre.dump_results(true);
+    pre.dump_results(graph, true);
     std::cout << "\n";
 
     std::cout << "\nafter PRE\n";
-    dump_ir(root, nodes);
+    dump_ir(root, graph);
     std::cout << "\n";
 
     DCEPass dce;
-    dce.run(root, nodes);
+    dce.run(root, graph);
 
     std::cout << "\nfinal result:\n";
-    dce.dump_results(dce.get_dead_nodes(), nodes, root, true);
+    dce.dump_results(dce.get_dead_nodes(), graph, root, true);
+    std::cout << "\n";
+
+    /* only the nodes PRE redirected, and whatever they alone kept alive */
+    const std::vector<NodeRef> removed = dce.remove_dead_from(pre.get_dirty_nodes(), graph);
+
+    std::cout << "incremental DCE from " << pre.get_dirty_nodes().size() << " dirty nodes removed:";
+    bool subset = true;
+    for (const NodeRef node_ref : removed)
+    {
+        std::cout << " #" << node_ref;
+        subset &= dce.is_dead(node_ref);
+    }
+    std::cout << "\nall of them in the full-run dead set: " << (subset ? "yes" : "no") << "\n";
+    std::cout << "nodes left: " << graph.live_size() << "\n";
+
+    /*
+     * lazy code motion: the exit copy of a * 10 is fully redundant through
+     * both arms and becomes a phi; a + b is only partially redundant, so it
+     * is computed on the missing arm and the exit copy goes away
+     */
+    SproutGraph lcm_graph;
+    const RegionRef lcm_root = lcm_graph.create_region("root", RegionType::ROOT);
+    pre_test_ir(lcm_graph, lcm_root);
+    partial_test_ir(lcm_graph, lcm_root);
+
+    PREPass lcm(PREMode::LAZY_CODE_MOTION);
+    lcm.run(lcm_root, lcm_graph);
+
+    std::cout << "\nlazy code motion:\n";
+    lcm.dump_results(lcm_graph, true);
+    std::cout << "\nafter lazy code motion\n";
+    dump_ir(lcm_root, lcm_graph);
     std::cout << "\n";
 
     return 0;
@@ -0,0 +1,129 @@
+#include <iostream>
+#include <sparkle/sprout/passes/dce.hpp>
+#include <sparkle/sprout/passes/sccp.hpp>
+#include <sparkle/sprout/utils/dump.hpp>
+
+using namespace sprk;
+
+NodeRef make_node(SproutGraph &graph,
+                  const NodeType type,
+                  const NodeRef fn,
+                  const RegionRef region,
+                  const std::string &name,
+                  const std::vector<NodeRef> &inputs = {})
+{
+	const NodeRef id = graph.create(type);
+	graph.set_name(id, name);
+	graph.set_fn_ref(id, fn);
+	graph.add_node(region, id);
+
+	for (const NodeRef input: inputs)
+		graph.add_input(id, input);
+
+	return id;
+}
+
+NodeRef make_const(SproutGraph &graph, const NodeRef fn, const RegionRef region, const std::string &name,
+                   const int64_t value)
+{
+	const NodeRef id = make_node(graph, NodeType::CONST, fn, region, name);
+	graph.set_value(id, value);
+	return id;
+}
+
+/*
+ *  $(ROOT)
+ *		-> fn      x = 2, y = 3, s = x + y, s < 10 decides the branch
+ *			-> then   t = s * 4, u = a * 4
+ *			-> else   e = s - a, v = a - 4  never runs
+ *			-> loop   y < x decides it      never runs
+ *			-> counted  i = phi(0, i + 1) while i < a, *p = i
+ *				    its control is in the body, so it may run and stays
+ *		phi(t, e) + phi(u, v) is returned
+ */
+void build_ir(SproutGraph &graph, const RegionRef root)
+{
+	const RegionRef fn_reg = graph.create_region("fn", RegionType::FUNCTION);
+	const RegionRef then_reg = graph.create_region("then", RegionType::BRANCH_THEN);
+	const RegionRef else_reg = graph.create_region("else", RegionType::BRANCH_ELSE);
+	const RegionRef loop_reg = graph.create_region("loop", RegionType::LOOP_BODY);
+	graph.add_child(root, fn_reg);
+	graph.add_child(fn_reg, then_reg);
+	graph.add_child(fn_reg, else_reg);
+	graph.add_child(fn_reg, loop_reg);
+	graph.set_imm_dominator(then_reg, fn_reg);
+	graph.set_imm_dominator(else_reg, fn_reg);
+	graph.set_imm_dominator(loop_reg, fn_reg);
+
+	const NodeRef fn = make_node(graph, NodeType::FUNCTION, NULL_REF, fn_reg, "fn");
+	const NodeRef entry = make_node(graph, NodeType::ENTRY, fn, fn_reg, "entry");
+	const NodeRef a = make_node(graph, NodeType::PARAM, fn, fn_reg, "a", { entry });
+
+	const NodeRef x = make_const(graph, fn, fn_reg, "x", 2);
+	const NodeRef y = make_const(graph, fn, fn_reg, "y", 3);
+	const NodeRef ten = make_const(graph, fn, fn_reg, "ten", 10);
+	const NodeRef four = make_const(graph, fn, fn_reg, "four", 4);
+	const NodeRef s = make_node(graph, NodeType::ADD, fn, fn_reg, "x + y", { x, y });
+	const NodeRef cond = make_node(graph, NodeType::CMP, fn, fn_reg, "s < 10", { s, ten });
+	const NodeRef control = make_node(graph, NodeType::CONTROL, fn, fn_reg, "if_control", { cond });
+	graph.set_ctrl_deps(then_reg, control);
+	graph.set_ctrl_deps(else_reg, control);
+
+	const NodeRef t = make_node(graph, NodeType::MUL, fn, then_reg, "s * 4", { s, four });
+	const NodeRef u = make_node(graph, NodeType::MUL, fn, then_reg, "a * 4", { a, four });
+	const NodeRef e = make_node(graph, NodeType::SUB, fn, else_reg, "s - a", { s, a });
+	const NodeRef v = make_node(graph, NodeType::SUB, fn, else_reg, "a - 4", { a, four });
+
+	const NodeRef loop_cond = make_node(graph, NodeType::CMP, fn, fn_reg, "y < x", { y, x });
+	const NodeRef loop_control = make_node(graph, NodeType::CONTROL, fn, fn_reg, "loop_control", { loop_cond });
+	graph.set_ctrl_deps(loop_reg, loop_control);
+	const NodeRef body = make_node(graph, NodeType::ADD, fn, loop_reg, "a + a", { a, a });
+	make_node(graph, NodeType::STORE, fn, loop_reg, "store", { body });
+
+	const RegionRef counted = graph.create_region("counted", RegionType::LOOP_BODY);
+	graph.add_child(fn_reg, counted);
+	graph.set_imm_dominator(counted, fn_reg);
+	const NodeRef p = make_node(graph, NodeType::PARAM, fn, fn_reg, "p", { entry });
+	const NodeRef zero = make_const(graph, fn, fn_reg, "zero", 0);
+	const NodeRef one = make_const(graph, fn, fn_reg, "one", 1);
+	const NodeRef i = make_node(graph, NodeType::PHI, fn, counted, "i", { zero });
+	const NodeRef next = make_node(graph, NodeType::ADD, fn, counted, "i + 1", { i, one });
+	graph.add_input(i, next);
+	const NodeRef in_range = make_node(graph, NodeType::CMP, fn, counted, "i < a", { i, a });
+	const NodeRef counted_control = make_node(graph, NodeType::CONTROL, fn, counted, "counted_control", { in_range });
+	graph.set_ctrl_deps(counted, counted_control);
+	make_node(graph, NodeType::PTR_STORE, fn, counted, "*p = i", { p, i });
+
+	const NodeRef phi = make_node(graph, NodeType::PHI, fn, fn_reg, "phi", { t, e, control });
+	const NodeRef varying_phi = make_node(graph, NodeType::PHI, fn, fn_reg, "varying_phi", { u, v, control });
+	const NodeRef sum = make_node(graph, NodeType::ADD, fn, fn_reg, "phi + varying_phi", { phi, varying_phi });
+	make_node(graph, NodeType::RET, fn, fn_reg, "ret", { sum });
+}
+
+int main()
+{
+	SproutGraph graph;
+	const RegionRef root = graph.create_region("root", RegionType::ROOT);
+	build_ir(graph, root);
+
+	std::cout << "before SCCP:\n";
+	dump_ir(root, graph);
+
+	SCCPPass sccp;
+	sccp.run(root, graph);
+	sccp.dump_results();
+
+	std::cout << "\nafter SCCP:\n";
+	dump_ir(root, graph);
+
+	/* what the folds and the pruned regions left without users */
+	DCEPass dce;
+	const std::vector<NodeRef> removed = dce.remove_dead_from(sccp.get_dirty_nodes(), graph);
+	std::cout << "\nincremental DCE from " << sccp.get_dirty_nodes().size() << " dirty nodes removed:";
+	for (const NodeRef node: removed)
+		std::cout << " #" << node;
+	std::cout << "\n\nafter DCE:\n";
+	dump_ir(root, graph);
+
+	return 0;
+}
@@ -0,0 +1,162 @@
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <sparkle/sprout/passes/manager.hpp>
+#include <sparkle/sprout/passes/slp.hpp>
+#include <sparkle/sprout/utils/dump.hpp>
+#include <sparkle/target/aarch64/lowering.hpp>
+
+using namespace sprk;
+
+NodeRef make_node(SproutGraph &graph,
+                  const NodeType type,
+                  const NodeRef fn,
+                  const RegionRef region,
+                  const std::string &name,
+                  const std::vector<NodeRef> &inputs = {})
+{
+	const NodeRef id = graph.create(type);
+	graph.set_name(id, name);
+	graph.set_fn_ref(id, fn);
+	graph.add_node(region, id);
+
+	for (const NodeRef input: inputs)
+		graph.add_input(id, input);
+
+	return id;
+}
+
+NodeRef make_const(SproutGraph &graph, const NodeRef fn, const RegionRef region, const std::string &name,
+                   const int64_t value)
+{
+	const NodeRef id = make_node(graph, NodeType::CONST, fn, region, name);
+	graph.set_value(id, value);
+	return id;
+}
+
+/* &base[k] for the byte offsets in `offsets`; the first element is the base itself */
+struct Elements
+{
+	SproutGraph &graph;
+	NodeRef fn;
+	RegionRef block;
+	std::vector<NodeRef> offsets;
+
+	NodeRef address(const NodeRef base, const size_t k, const std::string &name) const
+	{
+		if (k == 0)
+			return base;
+		return make_node(graph, NodeType::PTR_ADD, fn, block, "&" + name + "[" + std::to_string(k) + "]",
+		                 { base, offsets[k] });
+	}
+
+	NodeRef load(const NodeRef base, const size_t k, const std::string &name) const
+	{
+		return make_node(graph, NodeType::PTR_LOAD, fn, block, name + "[" + std::to_string(k) + "]",
+		                 { address(base, k, name) });
+	}
+
+	void store(const NodeRef base, const size_t k, const std::string &name, const NodeRef value) const
+	{
+		make_node(graph, NodeType::PTR_STORE, fn, block, name + "[" + std::to_string(k) + "] =",
+		          { address(base, k, name), value });
+	}
+};
+
+/*
+ *  $(ROOT)
+ *		-> fn      s, p; a, b, c, d, e = malloc
+ *			-> body    c[k] = a[k] + b[k]            packed
+ *				   d[k] = d[k] * s, in place     packed, s splatted
+ *				   e[k] = e[k] + 1               kept scalar; every sum is also returned
+ *				   p[k] = a[k] in turn           p may point at a
+ *		total of e's sums is returned
+ */
+void build_ir(SproutGraph &graph, const RegionRef root)
+{
+	const RegionRef fn_reg = graph.create_region("fn", RegionType::FUNCTION);
+	graph.add_child(root, fn_reg);
+
+	const NodeRef fn = make_node(graph, NodeType::FUNCTION, NULL_REF, fn_reg, "fn");
+	const NodeRef entry = make_node(graph, NodeType::ENTRY, fn, fn_reg, "entry");
+	const NodeRef s = make_node(graph, NodeType::PARAM, fn, fn_reg, "s", { entry });
+	const NodeRef p = make_node(graph, NodeType::PARAM, fn, fn_reg, "p", { entry });
+	const NodeRef a = make_node(graph, NodeType::MALLOC, fn, fn_reg, "a");
+	const NodeRef b = make_node(graph, NodeType::MALLOC, fn, fn_reg, "b");
+	const NodeRef c = make_node(graph, NodeType::MALLOC, fn, fn_reg, "c");
+	const NodeRef d = make_node(graph, NodeType::MALLOC, fn, fn_reg, "d");
+	const NodeRef e = make_node(graph, NodeType::MALLOC, fn, fn_reg, "e");
+	const NodeRef one = make_const(graph, fn, fn_reg, "one", 1);
+
+	const RegionRef block = graph.create_region("body", RegionType::BASIC_BLOCK);
+	graph.add_child(fn_reg, block);
+	graph.set_imm_dominator(block, fn_reg);
+
+	Elements elements { graph, fn, block, { NULL_REF } };
+	for (int64_t k = 1; k < 4; k++)
+		elements.offsets.push_back(make_const(graph, fn, fn_reg, std::to_string(k * 4), k * 4));
+
+	for (size_t k = 0; k < 4; k++)
+	{
+		const NodeRef sum = make_node(graph, NodeType::ADD, fn, block, "a + b",
+		                              { elements.load(a, k, "a"), elements.load(b, k, "b") });
+		elements.store(c, k, "c", sum);
+	}
+
+	for (size_t k = 0; k < 4; k++)
+	{
+		const NodeRef scaled = make_node(graph, NodeType::MUL, fn, block, "d * s", { elements.load(d, k, "d"), s });
+		elements.store(d, k, "d", scaled);
+	}
+
+	NodeRef total = NULL_REF;
+	for (size_t k = 0; k < 4; k++)
+	{
+		const NodeRef address = elements.address(e, k, "e");
+		const NodeRef loaded = make_node(graph, NodeType::PTR_LOAD, fn, block, "e[" + std::to_string(k) + "]", { address });
+		const NodeRef next = make_node(graph, NodeType::ADD, fn, block, "e + 1", { loaded, one });
+		make_node(graph, NodeType::PTR_STORE, fn, block, "e[" + std::to_string(k) + "] =", { address, next });
+		total = total == NULL_REF ? next : make_node(graph, NodeType::ADD, fn, block, "total", { total, next });
+	}
+
+	for (size_t k = 0; k < 4; k++)
+		elements.store(p, k, "p", elements.load(a, k, "a"));
+
+	make_node(graph, NodeType::RET, fn, fn_reg, "ret", { total });
+}
+
+int main()
+{
+	SproutGraph graph;
+	const RegionRef root = graph.create_region("root", RegionType::ROOT);
+	build_ir(graph, root);
+
+	std::cout << "before SLP:\n";
+	dump_ir(root, graph);
+
+	/* the manager runs the alias analysis the pass asks for */
+	PassManager manager;
+	const auto slp = std::make_shared<SLPVectorizePass>(manager.alias());
+	manager.add(slp);
+	manager.run(root, graph);
+	slp->dump_results(graph);
+
+	std::cout << "\nafter SLP:\n";
+	dump_ir(root, graph);
+
+	const RegionRef block = graph.region(graph.region(root).get_children()[0]).get_children()[0];
+	LoweredCode code;
+	std::cout << "\nAArch64 code for " << graph.region(block).get_name() << ":\n";
+	if (!aarch64::lower_block(graph, block, code))
+	{
+		std::cout << "  not lowered\n";
+		return 0;
+	}
+
+	for (const auto &[value, reg]: code.live_ins)
+		std::cout << "  live-in " << graph.name(value) << " in x" << reg << "\n";
+	for (const uint32_t word: code.words)
+		std::cout << "  " << std::hex << std::setw(8) << std::setfill('0') << word << std::dec << "\n";
+
+	return 0;
+}
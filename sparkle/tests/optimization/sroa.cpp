@@ -0,0 +1,173 @@
+#include <iostream>
+#include <memory>
+#include <sparkle/sprout/passes/manager.hpp>
+#include <sparkle/sprout/passes/sroa.hpp>
+#include <sparkle/sprout/utils/dump.hpp>
+
+using namespace sprk;
+
+NodeRef make_node(SproutGraph &graph,
+                  const NodeType type,
+                  const NodeRef fn,
+                  const RegionRef region,
+                  const std::string &name,
+                  const std::vector<NodeRef> &inputs = {})
+{
+	const NodeRef id = graph.create(type);
+	graph.set_name(id, name);
+	graph.set_fn_ref(id, fn);
+	graph.add_node(region, id);
+
+	for (const NodeRef input: inputs)
+		graph.add_input(id, input);
+
+	return id;
+}
+
+NodeRef make_const(SproutGraph &graph, const NodeRef fn, const RegionRef region, const std::string &name,
+                   const int64_t value)
+{
+	const NodeRef id = make_node(graph, NodeType::CONST, fn, region, name);
+	graph.set_value(id, value);
+	return id;
+}
+
+RegionRef make_region(SproutGraph &graph, const RegionRef parent, const std::string &name, const RegionType type,
+                      const NodeRef control = NULL_REF)
+{
+	const RegionRef region = graph.create_region(name, type);
+	graph.add_child(parent, region);
+	graph.set_imm_dominator(region, parent);
+	if (control != NULL_REF)
+		graph.set_ctrl_deps(region, control);
+	return region;
+}
+
+/*
+ *  $(ROOT)
+ *		-> fn      a, b, p = params; s = stack slot of { x, y }; v = &a; t = stack slot
+ *			   s.x = a; s.y = b; *t read before it is written, so t stays in memory
+ *			-> then    s.x = a * 2
+ *			-> else    s.y = 0
+ *			-> loop    s.x = s.x + 1; i = phi(0, i + 1) while i < b
+ *			-> exit    *v + s.x + s.y
+ *				   *p = a; *p is forwarded
+ *				   *(p + 8) = b; sink(); *(p + 8) is not
+ *		-> rotate  n, out = params
+ *			   *(out + 8) = n; a second out + 8 reads it back, forwarded
+ *			-> loop    i = phi(0, i + 1) while i < n; m = malloc; prev = phi(0, m)
+ *				   *m = i; *out = *prev is not forwarded; prev is last
+ *				   trip's object, though m and prev share an allocation site
+ */
+void build_ir(SproutGraph &graph, const RegionRef root)
+{
+	const RegionRef fn_reg = make_region(graph, root, "fn", RegionType::FUNCTION);
+	const NodeRef sink = make_node(graph, NodeType::FUNCTION, NULL_REF, root, "sink");
+	const NodeRef fn = make_node(graph, NodeType::FUNCTION, NULL_REF, fn_reg, "fn");
+	const NodeRef entry = make_node(graph, NodeType::ENTRY, fn, fn_reg, "entry");
+	const NodeRef a = make_node(graph, NodeType::PARAM, fn, fn_reg, "a", { entry });
+	const NodeRef b = make_node(graph, NodeType::PARAM, fn, fn_reg, "b", { entry });
+	const NodeRef p = make_node(graph, NodeType::PARAM, fn, fn_reg, "p", { entry });
+	const NodeRef zero = make_const(graph, fn, fn_reg, "0", 0);
+	const NodeRef one = make_const(graph, fn, fn_reg, "1", 1);
+	const NodeRef two = make_const(graph, fn, fn_reg, "2", 2);
+	const NodeRef eight = make_const(graph, fn, fn_reg, "8", 8);
+
+	const NodeRef s = make_node(graph, NodeType::STACK_ALLOC, fn, fn_reg, "s");
+	const NodeRef s_y = make_node(graph, NodeType::PTR_ADD, fn, fn_reg, "&s.y", { s, eight });
+	const NodeRef v = make_node(graph, NodeType::ADDR_OF, fn, fn_reg, "v", { a });
+	const NodeRef t = make_node(graph, NodeType::STACK_ALLOC, fn, fn_reg, "t");
+	make_node(graph, NodeType::PTR_STORE, fn, fn_reg, "s.x = a", { s, a });
+	make_node(graph, NodeType::PTR_STORE, fn, fn_reg, "s.y = b", { s_y, b });
+	const NodeRef early = make_node(graph, NodeType::PTR_LOAD, fn, fn_reg, "*t", { t });
+	make_node(graph, NodeType::PTR_STORE, fn, fn_reg, "*t = a", { t, a });
+
+	const NodeRef cond = make_node(graph, NodeType::CMP, fn, fn_reg, "a < b", { a, b });
+	const NodeRef if_control = make_node(graph, NodeType::CONTROL, fn, fn_reg, "if_control", { cond });
+	const RegionRef then_reg = make_region(graph, fn_reg, "then", RegionType::BRANCH_THEN, if_control);
+	const RegionRef else_reg = make_region(graph, fn_reg, "else", RegionType::BRANCH_ELSE, if_control);
+	const NodeRef doubled = make_node(graph, NodeType::MUL, fn, then_reg, "a * 2", { a, two });
+	make_node(graph, NodeType::PTR_STORE, fn, then_reg, "s.x = a * 2", { s, doubled });
+	make_node(graph, NodeType::PTR_STORE, fn, else_reg, "s.y = 0", { s_y, zero });
+
+	const NodeRef loop_control = make_node(graph, NodeType::CONTROL, fn, fn_reg, "loop_control");
+	const RegionRef loop = make_region(graph, fn_reg, "loop", RegionType::LOOP_BODY, loop_control);
+	const NodeRef i = make_node(graph, NodeType::PHI, fn, loop, "i", { zero });
+	const NodeRef next = make_node(graph, NodeType::ADD, fn, loop, "i + 1", { i, one });
+	graph.add_input(i, next);
+	const NodeRef in_range = make_node(graph, NodeType::CMP, fn, loop, "i < b", { i, b });
+	graph.add_input(loop_control, in_range);
+	const NodeRef x = make_node(graph, NodeType::PTR_LOAD, fn, loop, "s.x", { s });
+	const NodeRef bumped = make_node(graph, NodeType::ADD, fn, loop, "s.x + 1", { x, one });
+	make_node(graph, NodeType::PTR_STORE, fn, loop, "s.x = s.x + 1", { s, bumped });
+
+	const RegionRef exit = make_region(graph, fn_reg, "exit", RegionType::BASIC_BLOCK);
+	const NodeRef deref = make_node(graph, NodeType::PTR_LOAD, fn, exit, "*v", { v });
+	const NodeRef final_x = make_node(graph, NodeType::PTR_LOAD, fn, exit, "s.x", { s });
+	const NodeRef final_y = make_node(graph, NodeType::PTR_LOAD, fn, exit, "s.y", { s_y });
+	NodeRef sum = make_node(graph, NodeType::ADD, fn, exit, "*v + s.x", { deref, final_x });
+	sum = make_node(graph, NodeType::ADD, fn, exit, "+ s.y", { sum, final_y });
+	sum = make_node(graph, NodeType::ADD, fn, exit, "+ *t", { sum, early });
+
+	make_node(graph, NodeType::PTR_STORE, fn, exit, "*p = a", { p, a });
+	const NodeRef reread = make_node(graph, NodeType::PTR_LOAD, fn, exit, "*p", { p });
+	const NodeRef p_8 = make_node(graph, NodeType::PTR_ADD, fn, exit, "p + 8", { p, eight });
+	make_node(graph, NodeType::PTR_STORE, fn, exit, "*(p + 8) = b", { p_8, b });
+	make_node(graph, NodeType::CALL, fn, exit, "sink()", { sink });
+	const NodeRef after_call = make_node(graph, NodeType::PTR_LOAD, fn, exit, "*(p + 8)", { p_8 });
+	sum = make_node(graph, NodeType::ADD, fn, exit, "+ *p", { sum, reread });
+	sum = make_node(graph, NodeType::ADD, fn, exit, "+ *(p + 8)", { sum, after_call });
+	make_node(graph, NodeType::RET, fn, exit, "ret", { sum });
+
+	const RegionRef rotate_reg = make_region(graph, root, "rotate", RegionType::FUNCTION);
+	const NodeRef rotate = make_node(graph, NodeType::FUNCTION, NULL_REF, rotate_reg, "rotate");
+	const NodeRef rotate_entry = make_node(graph, NodeType::ENTRY, rotate, rotate_reg, "entry");
+	const NodeRef n = make_node(graph, NodeType::PARAM, rotate, rotate_reg, "n", { rotate_entry });
+	const NodeRef out = make_node(graph, NodeType::PARAM, rotate, rotate_reg, "out", { rotate_entry });
+	const NodeRef rotate_zero = make_const(graph, rotate, rotate_reg, "0", 0);
+	const NodeRef rotate_one = make_const(graph, rotate, rotate_reg, "1", 1);
+	const NodeRef rotate_eight = make_const(graph, rotate, rotate_reg, "8", 8);
+
+	const NodeRef out_8 = make_node(graph, NodeType::PTR_ADD, rotate, rotate_reg, "out + 8", { out, rotate_eight });
+	make_node(graph, NodeType::PTR_STORE, rotate, rotate_reg, "*(out + 8) = n", { out_8, n });
+	const NodeRef out_8_again = make_node(graph, NodeType::PTR_ADD, rotate, rotate_reg, "out + 8 again",
+	                                      { out, rotate_eight });
+	const NodeRef count = make_node(graph, NodeType::PTR_LOAD, rotate, rotate_reg, "*(out + 8)", { out_8_again });
+
+	const NodeRef rotate_control = make_node(graph, NodeType::CONTROL, rotate, rotate_reg, "loop_control");
+	const RegionRef rotate_loop = make_region(graph, rotate_reg, "loop", RegionType::LOOP_BODY, rotate_control);
+	const NodeRef j = make_node(graph, NodeType::PHI, rotate, rotate_loop, "i", { rotate_zero });
+	const NodeRef next_j = make_node(graph, NodeType::ADD, rotate, rotate_loop, "i + 1", { j, rotate_one });
+	graph.add_input(j, next_j);
+	const NodeRef j_in_range = make_node(graph, NodeType::CMP, rotate, rotate_loop, "i < n", { j, count });
+	graph.add_input(rotate_control, j_in_range);
+
+	const NodeRef m = make_node(graph, NodeType::MALLOC, rotate, rotate_loop, "m");
+	const NodeRef prev = make_node(graph, NodeType::PHI, rotate, rotate_loop, "prev", { rotate_zero, m });
+	make_node(graph, NodeType::PTR_STORE, rotate, rotate_loop, "*m = i", { m, j });
+	const NodeRef last = make_node(graph, NodeType::PTR_LOAD, rotate, rotate_loop, "*prev", { prev });
+	make_node(graph, NodeType::PTR_STORE, rotate, rotate_loop, "*out = *prev", { out, last });
+	make_node(graph, NodeType::RET, rotate, rotate_reg, "ret", { rotate_zero });
+}
+
+int main()
+{
+	SproutGraph graph;
+	const RegionRef root = graph.create_region("root", RegionType::ROOT);
+	build_ir(graph, root);
+
+	std::cout << "before SROA:\n";
+	dump_ir(root, graph);
+
+	/* the manager runs the alias analysis the forwarding asks for */
+	PassManager manager;
+	const auto sroa = std::make_shared<SROAPass>(manager.alias());
+	manager.add(sroa);
+	manager.run(root, graph);
+	sroa->dump_results(graph);
+
+	std::cout << "\nafter SROA:\n";
+	dump_ir(root, graph);
+
+	return 0;
+}
@@ -0,0 +1,135 @@
+#include <iostream>
+#include <sparkle/sprout/passes/unroll.hpp>
+#include <sparkle/sprout/utils/dump.hpp>
+
+using namespace sprk;
+
+NodeRef make_node(SproutGraph &graph,
+                  const NodeType type,
+                  const NodeRef fn,
+                  const RegionRef region,
+                  const std::string &name,
+                  const std::vector<NodeRef> &inputs = {})
+{
+	const NodeRef id = graph.create(type);
+	graph.set_name(id, name);
+	graph.set_fn_ref(id, fn);
+	graph.add_node(region, id);
+
+	for (const NodeRef input: inputs)
+		graph.add_input(id, input);
+
+	return id;
+}
+
+NodeRef make_const(SproutGraph &graph, const NodeRef fn, const RegionRef region, const std::string &name,
+                   const int64_t value)
+{
+	const NodeRef id = make_node(graph, NodeType::CONST, fn, region, name);
+	graph.set_value(id, value);
+	return id;
+}
+
+/* i = PHI(init, i + step) and CONTROL(i < bound) inside a new loop body */
+struct Loop
+{
+	RegionRef region;
+	NodeRef induction;
+};
+
+Loop make_loop(SproutGraph &graph,
+               const NodeRef fn,
+               const RegionRef parent,
+               const std::string &name,
+               const NodeRef init,
+               const NodeRef step,
+               const NodeRef bound)
+{
+	const RegionRef region = graph.create_region(name, RegionType::LOOP_BODY);
+	graph.add_child(parent, region);
+	graph.set_imm_dominator(region, parent);
+
+	const NodeRef induction = make_node(graph, NodeType::PHI, fn, region, name + "_i", { init });
+	const NodeRef next = make_node(graph, NodeType::ADD, fn, region, name + "_i + step", { induction, step });
+	graph.add_input(induction, next);
+
+	const NodeRef compare = make_node(graph, NodeType::CMP, fn, region, name + "_i < bound", { induction, bound });
+	const NodeRef control = make_node(graph, NodeType::CONTROL, fn, region, name + "_control", { compare });
+	graph.set_ctrl_deps(region, control);
+	return { region, induction };
+}
+
+/*
+ *  $(ROOT)
+ *		-> fn      a, base, n
+ *			-> sum     for i in 0..4:        acc += i * a        fully unrolled
+ *			-> scale   for j in 0..22 by 2:  base[j * 8] += a    unrolled by 4, 3 trips peeled
+ *			-> count   for k in 0..n:        store k * a         reduced only
+ *			-> last    for m in 0..n:        store m * a         kept; m * a is read after the loop
+ *			-> after   store m * a
+ *		acc is returned
+ */
+void build_ir(SproutGraph &graph, const RegionRef root)
+{
+	const RegionRef fn_reg = graph.create_region("fn", RegionType::FUNCTION);
+	graph.add_child(root, fn_reg);
+
+	const NodeRef fn = make_node(graph, NodeType::FUNCTION, NULL_REF, fn_reg, "fn");
+	const NodeRef entry = make_node(graph, NodeType::ENTRY, fn, fn_reg, "entry");
+	const NodeRef a = make_node(graph, NodeType::PARAM, fn, fn_reg, "a", { entry });
+	const NodeRef base = make_node(graph, NodeType::PARAM, fn, fn_reg, "base", { entry });
+	const NodeRef n = make_node(graph, NodeType::PARAM, fn, fn_reg, "n", { entry });
+	const NodeRef zero = make_const(graph, fn, fn_reg, "zero", 0);
+	const NodeRef one = make_const(graph, fn, fn_reg, "one", 1);
+	const NodeRef two = make_const(graph, fn, fn_reg, "two", 2);
+	const NodeRef four = make_const(graph, fn, fn_reg, "four", 4);
+	const NodeRef eight = make_const(graph, fn, fn_reg, "eight", 8);
+	const NodeRef twenty_two = make_const(graph, fn, fn_reg, "twenty_two", 22);
+
+	const auto [sum, i] = make_loop(graph, fn, fn_reg, "sum", zero, one, four);
+	const NodeRef acc = make_node(graph, NodeType::PHI, fn, sum, "acc", { zero });
+	const NodeRef ia = make_node(graph, NodeType::MUL, fn, sum, "i * a", { i, a });
+	const NodeRef next_acc = make_node(graph, NodeType::ADD, fn, sum, "acc + i * a", { acc, ia });
+	graph.add_input(acc, next_acc);
+
+	const auto [scale, j] = make_loop(graph, fn, fn_reg, "scale", zero, two, twenty_two);
+	const NodeRef offset = make_node(graph, NodeType::MUL, fn, scale, "j * 8", { j, eight });
+	const NodeRef address = make_node(graph, NodeType::PTR_ADD, fn, scale, "base + j * 8", { base, offset });
+	const NodeRef loaded = make_node(graph, NodeType::PTR_LOAD, fn, scale, "load", { address });
+	const NodeRef scaled = make_node(graph, NodeType::ADD, fn, scale, "load + a", { loaded, a });
+	make_node(graph, NodeType::PTR_STORE, fn, scale, "store", { address, scaled });
+
+	const auto [count, k] = make_loop(graph, fn, fn_reg, "count", zero, one, n);
+	const NodeRef ka = make_node(graph, NodeType::MUL, fn, count, "k * a", { k, a });
+	make_node(graph, NodeType::PTR_STORE, fn, count, "store", { base, ka });
+
+	const auto [last, m] = make_loop(graph, fn, fn_reg, "last", zero, one, n);
+	const NodeRef ma = make_node(graph, NodeType::MUL, fn, last, "m * a", { m, a });
+	make_node(graph, NodeType::PTR_STORE, fn, last, "store", { base, ma });
+
+	const RegionRef after = graph.create_region("after", RegionType::BASIC_BLOCK);
+	graph.add_child(fn_reg, after);
+	graph.set_imm_dominator(after, fn_reg);
+	make_node(graph, NodeType::PTR_STORE, fn, after, "store last", { base, ma });
+
+	make_node(graph, NodeType::RET, fn, fn_reg, "ret", { acc });
+}
+
+int main()
+{
+	SproutGraph graph;
+	const RegionRef root = graph.create_region("root", RegionType::ROOT);
+	build_ir(graph, root);
+
+	std::cout << "before unrolling:\n";
+	dump_ir(root, graph);
+
+	LoopUnrollPass unroll(4, 8);
+	unroll.run(root, graph);
+	unroll.dump_results(graph);
+
+	std::cout << "\nafter unrolling:\n";
+	dump_ir(root, graph);
+
+	return 0;
+}
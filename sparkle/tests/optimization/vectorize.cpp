@@ -0,0 +1,161 @@
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <sparkle/sprout/passes/manager.hpp>
+#include <sparkle/sprout/passes/vectorize.hpp>
+#include <sparkle/sprout/utils/dump.hpp>
+#include <sparkle/target/aarch64/lowering.hpp>
+#include <sparkle/target/risc-v/lowering.hpp>
+
+using namespace sprk;
+
+NodeRef make_node(SproutGraph &graph,
+                  const NodeType type,
+                  const NodeRef fn,
+                  const RegionRef region,
+                  const std::string &name,
+                  const std::vector<NodeRef> &inputs = {})
+{
+	const NodeRef id = graph.create(type);
+	graph.set_name(id, name);
+	graph.set_fn_ref(id, fn);
+	graph.add_node(region, id);
+
+	for (const NodeRef input: inputs)
+		graph.add_input(id, input);
+
+	return id;
+}
+
+NodeRef make_const(SproutGraph &graph, const NodeRef fn, const RegionRef region, const std::string &name,
+                   const int64_t value)
+{
+	const NodeRef id = make_node(graph, NodeType::CONST, fn, region, name);
+	graph.set_value(id, value);
+	return id;
+}
+
+/* i = PHI(0, i + 1) and CONTROL(i < n) inside a new loop body */
+std::pair<RegionRef, NodeRef> make_loop(SproutGraph &graph,
+                                        const NodeRef fn,
+                                        const RegionRef parent,
+                                        const std::string &name,
+                                        const NodeRef zero,
+                                        const NodeRef one,
+                                        const NodeRef bound)
+{
+	const RegionRef region = graph.create_region(name, RegionType::LOOP_BODY);
+	graph.add_child(parent, region);
+	graph.set_imm_dominator(region, parent);
+
+	const NodeRef induction = make_node(graph, NodeType::PHI, fn, region, name + "_i", { zero });
+	const NodeRef next = make_node(graph, NodeType::ADD, fn, region, name + "_i + 1", { induction, one });
+	graph.add_input(induction, next);
+
+	const NodeRef compare = make_node(graph, NodeType::CMP, fn, region, name + "_i < n", { induction, bound });
+	const NodeRef control = make_node(graph, NodeType::CONTROL, fn, region, name + "_control", { compare });
+	graph.set_ctrl_deps(region, control);
+	return { region, induction };
+}
+
+/*
+ *  $(ROOT)
+ *		-> fn      k, n, p; a, b, c = malloc
+ *			-> madd   for i in 0..n:  c[i] = a[i] * b[i] + k   vectorized
+ *			-> copy   for j in 0..n:  p[j] = a[j]              p may point anywhere
+ */
+void build_ir(SproutGraph &graph, const RegionRef root)
+{
+	const RegionRef fn_reg = graph.create_region("fn", RegionType::FUNCTION);
+	graph.add_child(root, fn_reg);
+
+	const NodeRef fn = make_node(graph, NodeType::FUNCTION, NULL_REF, fn_reg, "fn");
+	const NodeRef entry = make_node(graph, NodeType::ENTRY, fn, fn_reg, "entry");
+	const NodeRef k = make_node(graph, NodeType::PARAM, fn, fn_reg, "k", { entry });
+	const NodeRef n = make_node(graph, NodeType::PARAM, fn, fn_reg, "n", { entry });
+	const NodeRef p = make_node(graph, NodeType::PARAM, fn, fn_reg, "p", { entry });
+	const NodeRef a = make_node(graph, NodeType::MALLOC, fn, fn_reg, "a");
+	const NodeRef b = make_node(graph, NodeType::MALLOC, fn, fn_reg, "b");
+	const NodeRef c = make_node(graph, NodeType::MALLOC, fn, fn_reg, "c");
+	const NodeRef zero = make_const(graph, fn, fn_reg, "zero", 0);
+	const NodeRef one = make_const(graph, fn, fn_reg, "one", 1);
+	const NodeRef four = make_const(graph, fn, fn_reg, "four", 4);
+
+	const auto [madd, i] = make_loop(graph, fn, fn_reg, "madd", zero, one, n);
+	const NodeRef offset = make_node(graph, NodeType::MUL, fn, madd, "i * 4", { i, four });
+	const NodeRef a_i = make_node(graph, NodeType::PTR_ADD, fn, madd, "&a[i]", { a, offset });
+	const NodeRef b_i = make_node(graph, NodeType::PTR_ADD, fn, madd, "&b[i]", { b, offset });
+	const NodeRef c_i = make_node(graph, NodeType::PTR_ADD, fn, madd, "&c[i]", { c, offset });
+	const NodeRef load_a = make_node(graph, NodeType::PTR_LOAD, fn, madd, "a[i]", { a_i });
+	const NodeRef load_b = make_node(graph, NodeType::PTR_LOAD, fn, madd, "b[i]", { b_i });
+	const NodeRef product = make_node(graph, NodeType::MUL, fn, madd, "a[i] * b[i]", { load_a, load_b });
+	const NodeRef sum = make_node(graph, NodeType::ADD, fn, madd, "a[i] * b[i] + k", { product, k });
+	make_node(graph, NodeType::PTR_STORE, fn, madd, "c[i] =", { c_i, sum });
+
+	const auto [copy, j] = make_loop(graph, fn, fn_reg, "copy", zero, one, n);
+	const NodeRef copy_offset = make_node(graph, NodeType::MUL, fn, copy, "j * 4", { j, four });
+	const NodeRef a_j = make_node(graph, NodeType::PTR_ADD, fn, copy, "&a[j]", { a, copy_offset });
+	const NodeRef p_j = make_node(graph, NodeType::PTR_ADD, fn, copy, "&p[j]", { p, copy_offset });
+	const NodeRef load = make_node(graph, NodeType::PTR_LOAD, fn, copy, "a[j]", { a_j });
+	make_node(graph, NodeType::PTR_STORE, fn, copy, "p[j] =", { p_j, load });
+
+	make_node(graph, NodeType::RET, fn, fn_reg, "ret", { zero });
+}
+
+void print_code(const SproutGraph &graph, const LoweredCode &code)
+{
+	for (const auto &[value, reg]: code.live_ins)
+		std::cout << "  live-in " << graph.name(value) << " in x" << reg << "\n";
+
+	for (const uint32_t word: code.words)
+		std::cout << "  " << std::hex << std::setw(8) << std::setfill('0') << word << std::dec << "\n";
+}
+
+void vectorize(const VectorTarget target, const char *label)
+{
+	SproutGraph graph;
+	const RegionRef root = graph.create_region("root", RegionType::ROOT);
+	build_ir(graph, root);
+
+	/* the manager runs the alias analysis the vectorizer asks for */
+	PassManager manager;
+	const auto vectorizer = std::make_shared<VectorizePass>(manager.alias(), target);
+	manager.add(vectorizer);
+	manager.run(root, graph);
+	vectorizer->dump_results(graph);
+
+	std::cout << "\nafter vectorizing for " << label << ":\n";
+	dump_ir(root, graph);
+
+	for (const VectorizeResult &result: vectorizer->get_results())
+	{
+		std::vector<RegionRef> loops { result.vector_loop };
+		if (result.epilogue != NULL_REGION)
+			loops.push_back(result.epilogue);
+
+		LoweredCode code;
+		const bool lowered = target == VectorTarget::NEON
+			                     ? aarch64::lower_loops(graph, loops, code)
+			                     : riscv::lower_loops(graph, loops, code);
+		std::cout << "\n" << label << " code for " << graph.region(result.vector_loop).get_name() << ":\n";
+		if (lowered)
+			print_code(graph, code);
+		else
+			std::cout << "  not lowered\n";
+	}
+}
+
+int main()
+{
+	SproutGraph graph;
+	const RegionRef root = graph.create_region("root", RegionType::ROOT);
+	build_ir(graph, root);
+
+	std::cout << "before vectorizing:\n";
+	dump_ir(root, graph);
+
+	vectorize(VectorTarget::NEON, "NEON");
+	vectorize(VectorTarget::RVV, "RVV");
+
+	return 0;
+}